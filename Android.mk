@@ -5,20 +5,32 @@ include ${CLEAR_VARS}
 LOCAL_SRC_FILES := \
     gpkg/binstream.c \
     gpkg/blobio.c \
+    gpkg/contents_extent.c \
     gpkg/error.c \
+    gpkg/feature_cursor.c \
     gpkg/fp.c \
     gpkg/geomio.c \
     gpkg/gpkg.c \
     gpkg/gpkg_db.c \
     gpkg/gpkg_geom.c \
     gpkg/i18n.c \
+    gpkg/pip_index.c \
+    gpkg/point_encoder.c \
+    gpkg/rtree_query.c \
+    gpkg/simplify.c \
+    gpkg/spatial_vtab.c \
     gpkg/spatialdb.c \
     gpkg/spl_db.c \
     gpkg/spl_geom.c \
     gpkg/sql.c \
     gpkg/strbuf.c \
+    gpkg/tile_dedup.c \
+    gpkg/tile_import.c \
+    gpkg/tile_matrix.c \
+    gpkg/tile_reader.c \
     gpkg/wkb.c \
     gpkg/wkt.c \
+    gpkg/writer_pool.c \
 
 LOCAL_C_INCLUDES := \
     $(LOCAL_PATH)/sqlite
@@ -33,6 +45,8 @@ LOCAL_CFLAGS := \
     -DLIBGPKG_VERSION="\"$(gpkg_VERSION_MAJOR).$(gpkg_VERSION_MINOR).$(gpkg_VERSION_PATCH)\"" \
     -DGPKG_EXPORT="__attribute__((visibility(\"default\")))"
 
+LOCAL_LDLIBS := -ldl
+
 include $(BUILD_SHARED_LIBRARY)
 
 # Build the shell for android
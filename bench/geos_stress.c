@@ -0,0 +1,218 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * GEOS concurrency stress benchmark.
+ *
+ * Starts a number of threads that each repeatedly open a connection, evaluate GEOS predicates on random geometries
+ * and close the connection again, mimicking a multi-threaded tile server that uses short lived connections. The
+ * results of every query are checked against a plain coordinate computation so that handles shared incorrectly
+ * between threads show up as failures rather than just as crashes.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sqlite3.h"
+#include "gpkg.h"
+
+#define QUERY "SELECT ST_Intersects(ST_Buffer(MakePoint(?1, ?2), 1.0), ST_Buffer(MakePoint(?3, ?4), 1.0))"
+
+typedef struct {
+  int queries;
+  int queries_per_connection;
+  const char *geos_lib;
+  unsigned int seed;
+  long connections;
+  long failures;
+} worker_t;
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double next_coordinate(unsigned int *seed) {
+  *seed = *seed * 1103515245u + 12345u;
+  return ((*seed >> 8) % 10000) / 1000.0;
+}
+
+static sqlite3 *open_connection(worker_t *worker, sqlite3_stmt **stmt) {
+  sqlite3 *db = NULL;
+  char *err = NULL;
+
+  if (sqlite3_open(":memory:", &db) != SQLITE_OK) {
+    goto error;
+  }
+
+  if (sqlite3_gpkg_auto_init(db, NULL, NULL) != SQLITE_OK) {
+    goto error;
+  }
+
+  if (worker->geos_lib != NULL) {
+    char *sql = sqlite3_mprintf("SELECT GPKG_LoadGEOS(%Q)", worker->geos_lib);
+    int result = sqlite3_exec(db, sql, NULL, NULL, &err);
+    sqlite3_free(sql);
+    if (result != SQLITE_OK) {
+      goto error;
+    }
+  }
+
+  if (sqlite3_prepare_v2(db, QUERY, -1, stmt, NULL) != SQLITE_OK) {
+    goto error;
+  }
+
+  worker->connections++;
+  return db;
+
+  error:
+  fprintf(stderr, "Could not open connection: %s\n", err != NULL ? err : sqlite3_errmsg(db));
+  sqlite3_free(err);
+  sqlite3_close(db);
+  return NULL;
+}
+
+static void *run_worker(void *arg) {
+  worker_t *worker = (worker_t *) arg;
+  sqlite3 *db = NULL;
+  sqlite3_stmt *stmt = NULL;
+
+  for (int i = 0; i < worker->queries; i++) {
+    if (db == NULL) {
+      db = open_connection(worker, &stmt);
+      if (db == NULL) {
+        worker->failures += worker->queries - i;
+        return NULL;
+      }
+    }
+
+    double x1 = next_coordinate(&worker->seed);
+    double y1 = next_coordinate(&worker->seed);
+    double x2 = next_coordinate(&worker->seed);
+    double y2 = next_coordinate(&worker->seed);
+    double dx = x2 - x1;
+    double dy = y2 - y1;
+    double distance_squared = dx * dx + dy * dy;
+
+    sqlite3_bind_double(stmt, 1, x1);
+    sqlite3_bind_double(stmt, 2, y1);
+    sqlite3_bind_double(stmt, 3, x2);
+    sqlite3_bind_double(stmt, 4, y2);
+
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+      worker->failures++;
+    } else if (distance_squared < 3.9 || distance_squared > 4.1) {
+      // Buffers are approximated by polygons, so only pairs clearly apart or clearly overlapping are checked.
+      int expected = distance_squared < 4.0;
+      if (sqlite3_column_int(stmt, 0) != expected) {
+        worker->failures++;
+      }
+    }
+    sqlite3_reset(stmt);
+
+    if ((i + 1) % worker->queries_per_connection == 0) {
+      sqlite3_finalize(stmt);
+      sqlite3_close(db);
+      stmt = NULL;
+      db = NULL;
+    }
+  }
+
+  sqlite3_finalize(stmt);
+  sqlite3_close(db);
+  return NULL;
+}
+
+static void usage(const char *program) {
+  fprintf(
+    stderr,
+    "Usage: %s [-t threads] [-n queries per thread] [-c queries per connection] [-l GEOS library]\n"
+      "  -l is required when libgpkg was built with GPKG_GEOS_DL\n",
+    program
+  );
+}
+
+int main(int argc, char **argv) {
+  int thread_count = 4;
+  int queries = 100000;
+  int queries_per_connection = 1000;
+  const char *geos_lib = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      thread_count = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      queries = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      queries_per_connection = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+      geos_lib = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (thread_count <= 0 || queries <= 0 || queries_per_connection <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  pthread_t *threads = (pthread_t *) calloc((size_t) thread_count, sizeof(pthread_t));
+  worker_t *workers = (worker_t *) calloc((size_t) thread_count, sizeof(worker_t));
+  if (threads == NULL || workers == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  double start = now();
+  for (int i = 0; i < thread_count; i++) {
+    workers[i].queries = queries;
+    workers[i].queries_per_connection = queries_per_connection;
+    workers[i].geos_lib = geos_lib;
+    workers[i].seed = (unsigned int) i + 1;
+    if (pthread_create(&threads[i], NULL, run_worker, &workers[i]) != 0) {
+      fprintf(stderr, "Could not start thread %d\n", i);
+      return 1;
+    }
+  }
+
+  long connections = 0;
+  long failures = 0;
+  for (int i = 0; i < thread_count; i++) {
+    pthread_join(threads[i], NULL);
+    connections += workers[i].connections;
+    failures += workers[i].failures;
+  }
+  double elapsed = now() - start;
+
+  long total = (long) thread_count * queries;
+  printf("threads:       %d\n", thread_count);
+  printf("queries:       %ld\n", total);
+  printf("connections:   %ld\n", connections);
+  printf("failures:      %ld\n", failures);
+  printf("elapsed:       %.3f s\n", elapsed);
+  printf("queries/s:     %.0f\n", total / elapsed);
+  printf("connections/s: %.0f\n", connections / elapsed);
+
+  free(threads);
+  free(workers);
+  return failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Point encoding benchmark.
+ *
+ * Encodes the same points as GeoPackage point blobs for every coordinate type, once through a reused GeoPackage Binary
+ * writer (the generic path used by the geometry constructors) and once using the gpkg_point_blobs_encode bulk
+ * encoder. The blobs produced by both paths are compared before timing.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sqlite3.h"
+#include "blobio.h"
+#include "error.h"
+#include "fp.h"
+#include "geomio.h"
+#include "gpkg_geom.h"
+#include "point_encoder.h"
+
+static const char *layouts[] = {"XY", "XYZ", "XYM", "XYZM"};
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int write_generic(geom_blob_writer_t *writer, const geom_blob_header_t *initial, int32_t srid, coord_type_t coord_type, const double *coords, errorstream_t *error) {
+  geom_consumer_t *consumer = geom_blob_writer_geom_consumer(writer);
+  geom_header_t header;
+  int result;
+
+  header.geom_type = GEOM_POINT;
+  header.coord_type = coord_type;
+  header.coord_size = (uint32_t) geom_coord_dim(coord_type);
+
+  geom_blob_writer_reset(writer, initial, srid);
+  result = consumer->begin(consumer, error);
+  if (result == SQLITE_OK) {
+    result = consumer->begin_geometry(consumer, &header, error);
+  }
+  if (result == SQLITE_OK) {
+    result = consumer->coordinates(consumer, &header, 1, coords, 0, error);
+  }
+  if (result == SQLITE_OK) {
+    result = consumer->end_geometry(consumer, &header, error);
+  }
+  if (result == SQLITE_OK) {
+    result = consumer->end(consumer, error);
+  }
+  return result;
+}
+
+static int run(coord_type_t coord_type, const double *coords, size_t count, int iterations) {
+  char error_buffer[256];
+  errorstream_t error;
+  geom_blob_writer_t writer;
+  geom_blob_header_t initial;
+  size_t blob_size = gpkg_point_blob_size(coord_type);
+  int coord_size = geom_coord_dim(coord_type);
+  uint8_t *blobs;
+  int result;
+
+  error_init_fixed(&error, error_buffer, sizeof(error_buffer));
+  blobs = (uint8_t *) malloc(count * blob_size);
+  if (blobs == NULL) {
+    return SQLITE_NOMEM;
+  }
+  result = gpb_writer_init(&writer, 4326);
+  if (result != SQLITE_OK) {
+    free(blobs);
+    return result;
+  }
+  initial = writer.header;
+
+  result = gpkg_point_blobs_encode(4326, coord_type, coords, count, blobs, count * blob_size);
+  for (size_t i = 0; i < count && result == SQLITE_OK; i++) {
+    result = write_generic(&writer, &initial, 4326, coord_type, &coords[i * coord_size], &error);
+    if (result == SQLITE_OK && (geom_blob_writer_length(&writer) != blob_size || memcmp(geom_blob_writer_getdata(&writer), &blobs[i * blob_size], blob_size) != 0)) {
+      fprintf(stderr, "%s: blob %lu differs from the generic writer\n", layouts[coord_type], (unsigned long) i);
+      result = SQLITE_ERROR;
+    }
+  }
+
+  double start = now();
+  for (int n = 0; n < iterations && result == SQLITE_OK; n++) {
+    for (size_t i = 0; i < count && result == SQLITE_OK; i++) {
+      result = write_generic(&writer, &initial, 4326, coord_type, &coords[i * coord_size], &error);
+    }
+  }
+  double generic = now() - start;
+
+  start = now();
+  for (int n = 0; n < iterations && result == SQLITE_OK; n++) {
+    result = gpkg_point_blobs_encode(4326, coord_type, coords, count, blobs, count * blob_size);
+  }
+  double direct = now() - start;
+
+  if (result == SQLITE_OK) {
+    double points = (double) iterations * count;
+    printf("%-4s writer %8.2f ns/point   direct %8.2f ns/point   (%.1fx)\n", layouts[coord_type], generic * 1e9 / points, direct * 1e9 / points, generic / direct);
+  } else if (error_count(&error) > 0) {
+    fprintf(stderr, "%s: %s\n", layouts[coord_type], error_message(&error));
+  }
+
+  gpb_writer_destroy(&writer, 1);
+  free(blobs);
+  return result;
+}
+
+int main(int argc, char **argv) {
+  int iterations = 100;
+  int count = 100000;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      count = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "Usage: %s [-n iterations] [-c points]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (iterations <= 0 || count <= 0) {
+    return 1;
+  }
+
+  double *coords = (double *) malloc((size_t) count * GEOM_MAX_COORD_SIZE * sizeof(double));
+  if (coords == NULL) {
+    return 1;
+  }
+  for (int i = 0; i < count * GEOM_MAX_COORD_SIZE; i++) {
+    coords[i] = (i % 1000) * 0.25 - 90.0;
+  }
+  /* Include an empty point to check the empty flag */
+  for (int i = 0; i < GEOM_MAX_COORD_SIZE; i++) {
+    coords[i] = fp_nan();
+  }
+
+  int result = SQLITE_OK;
+  for (int t = GEOM_XY; t <= GEOM_XYZM && result == SQLITE_OK; t++) {
+    result = run((coord_type_t) t, coords, (size_t) count, iterations);
+  }
+
+  free(coords);
+  return result == SQLITE_OK ? 0 : 1;
+}
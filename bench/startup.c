@@ -0,0 +1,139 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Connection startup latency benchmark.
+ *
+ * Measures the time needed to open a connection to a GeoPackage file, initialize libgpkg on it, run a single trivial
+ * query and close it again. Plain SQLite connections are measured as a baseline so that the fixed cost added by
+ * libgpkg can be read off directly.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sqlite3.h"
+#include "gpkg.h"
+
+typedef int (*entry_point_t)(sqlite3 *db, const char **pzErrMsg, const sqlite3_api_routines *pThunk);
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int exec(sqlite3 *db, const char *sql) {
+  char *err = NULL;
+  int result = sqlite3_exec(db, sql, NULL, NULL, &err);
+  if (result != SQLITE_OK) {
+    fprintf(stderr, "%s: %s\n", sql, err != NULL ? err : sqlite3_errstr(result));
+    sqlite3_free(err);
+  }
+  return result;
+}
+
+static int create_database(const char *path) {
+  sqlite3 *db = NULL;
+  int result;
+
+  remove(path);
+  result = sqlite3_open(path, &db);
+  if (result == SQLITE_OK) {
+    result = sqlite3_gpkg_init(db, NULL, NULL);
+  }
+  if (result == SQLITE_OK) {
+    result = exec(db, "SELECT InitSpatialMetaData()");
+  }
+  if (result == SQLITE_OK) {
+    result = exec(db, "CREATE TABLE points (id INTEGER PRIMARY KEY)");
+  }
+  if (result == SQLITE_OK) {
+    result = exec(db, "SELECT AddGeometryColumn('points', 'geom', 'POINT', 0)");
+  }
+  if (result == SQLITE_OK) {
+    result = exec(db, "INSERT INTO points (geom) VALUES (GeomFromText('POINT(1 2)'))");
+  }
+  sqlite3_close(db);
+  return result;
+}
+
+static int run(const char *label, const char *path, entry_point_t entry_point, const char *sql, int iterations) {
+  double start = now();
+
+  for (int i = 0; i < iterations; i++) {
+    sqlite3 *db = NULL;
+    int result = sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, NULL);
+    if (result == SQLITE_OK && entry_point != NULL) {
+      result = entry_point(db, NULL, NULL);
+    }
+    if (result == SQLITE_OK) {
+      result = exec(db, sql);
+    }
+    sqlite3_close(db);
+
+    if (result != SQLITE_OK) {
+      fprintf(stderr, "%s: iteration %d failed\n", label, i);
+      return result;
+    }
+  }
+
+  double elapsed = now() - start;
+  printf("%-28s %10.1f us/connection\n", label, elapsed * 1e6 / iterations);
+  return SQLITE_OK;
+}
+
+int main(int argc, char **argv) {
+  const char *path = "gpkg_startup_bench.gpkg";
+  int iterations = 10000;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      path = argv[++i];
+    } else {
+      fprintf(stderr, "Usage: %s [-n iterations] [-f database file]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (iterations <= 0 || create_database(path) != SQLITE_OK) {
+    return 1;
+  }
+
+  int result = SQLITE_OK;
+  if (result == SQLITE_OK) {
+    result = run("sqlite", path, NULL, "SELECT count(*) FROM points", iterations);
+  }
+  if (result == SQLITE_OK) {
+    result = run("gpkg (explicit schema)", path, sqlite3_gpkg_init, "SELECT count(*) FROM points", iterations);
+  }
+  if (result == SQLITE_OK) {
+    result = run("gpkg (detected schema)", path, sqlite3_gpkg_auto_init, "SELECT count(*) FROM points", iterations);
+  }
+  if (result == SQLITE_OK) {
+    result = run("gpkg + ST_MinX", path, sqlite3_gpkg_auto_init, "SELECT ST_MinX(geom) FROM points", iterations);
+  }
+  if (result == SQLITE_OK) {
+    result = run("gpkg + GeomFromText", path, sqlite3_gpkg_auto_init, "SELECT ST_AsBinary(GeomFromText('POINT(1 2)'))", iterations);
+  }
+
+  remove(path);
+  return result == SQLITE_OK ? 0 : 1;
+}
@@ -0,0 +1,268 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Tile read throughput benchmark.
+ *
+ * Creates a tiles table in a temporary database file and requests tiles from it the way a tile server would, using a
+ * skewed access pattern where a small set of tiles receives most requests. Reports requests per second for:
+ *  - preparing, stepping and finalizing a SELECT per request
+ *  - reusing a single prepared SELECT
+ *  - the tile reader without a cache
+ *  - the tile reader with a cache
+ * The tile reader is released after every batch of requests to mimic a server that ends its read transaction
+ * periodically.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "sqlite3.h"
+#include "tile_reader.h"
+
+#define SELECT_TILE "SELECT tile_data FROM tiles WHERE zoom_level = ?1 AND tile_column = ?2 AND tile_row = ?3"
+
+static int zoom_levels = 8;
+static int tile_size = 16384;
+static int requests = 200000;
+static int batch = 100;
+static size_t cache_size = 64 * 1024 * 1024;
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int exec(sqlite3 *db, const char *sql) {
+  char *errmsg = NULL;
+  int result = sqlite3_exec(db, sql, NULL, NULL, &errmsg);
+  if (result != SQLITE_OK) {
+    fprintf(stderr, "%s: %s\n", sql, errmsg);
+    sqlite3_free(errmsg);
+  }
+  return result;
+}
+
+static int populate(sqlite3 *db) {
+  sqlite3_stmt *stmt = NULL;
+  int result = exec(db, "PRAGMA journal_mode=WAL");
+  if (result == SQLITE_OK) {
+    result = exec(db, "CREATE TABLE tiles (id INTEGER PRIMARY KEY AUTOINCREMENT, zoom_level INTEGER NOT NULL, tile_column INTEGER NOT NULL, tile_row INTEGER NOT NULL, tile_data BLOB NOT NULL, UNIQUE (zoom_level, tile_column, tile_row))");
+  }
+  if (result == SQLITE_OK) {
+    result = exec(db, "BEGIN");
+  }
+  if (result == SQLITE_OK) {
+    result = sqlite3_prepare_v2(db, "INSERT INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, randomblob(?))", -1, &stmt, NULL);
+  }
+
+  for (int z = 0; z < zoom_levels && result == SQLITE_OK; z++) {
+    for (int x = 0; x < (1 << z) && result == SQLITE_OK; x++) {
+      for (int y = 0; y < (1 << z) && result == SQLITE_OK; y++) {
+        sqlite3_bind_int(stmt, 1, z);
+        sqlite3_bind_int(stmt, 2, x);
+        sqlite3_bind_int(stmt, 3, y);
+        sqlite3_bind_int(stmt, 4, tile_size / 2 + rand() % tile_size);
+        result = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+        sqlite3_reset(stmt);
+      }
+    }
+  }
+
+  sqlite3_finalize(stmt);
+  if (result == SQLITE_OK) {
+    result = exec(db, "COMMIT");
+  }
+  return result;
+}
+
+/*
+ * Generates a request. Ninety percent of the requests go to the tiles of the three lowest zoom levels and to a
+ * handful of tiles around the center of the pyramid; the rest are spread uniformly.
+ */
+static void next_request(unsigned int *seed, int *z, int *x, int *y) {
+  *seed = *seed * 1103515245u + 12345u;
+  unsigned int r = *seed >> 8;
+  if (r % 10 != 0) {
+    *z = (int) ((r / 10) % (zoom_levels < 4 ? zoom_levels : 4));
+    int center = (1 << *z) / 2;
+    *x = center + (int) ((r / 40) % 2);
+    *y = center + (int) ((r / 80) % 2);
+    if (*x >= (1 << *z)) {
+      *x = 0;
+    }
+    if (*y >= (1 << *z)) {
+      *y = 0;
+    }
+  } else {
+    *z = (int) ((r / 10) % zoom_levels);
+    *x = (int) ((r / 100) % (1u << *z));
+    *y = (int) ((r / 7) % (1u << *z));
+  }
+}
+
+static int run_select(sqlite3 *db, int reuse) {
+  sqlite3_stmt *stmt = NULL;
+  unsigned int seed = 1;
+  size_t bytes = 0;
+  int result = SQLITE_OK;
+
+  double start = now();
+  for (int i = 0; i < requests && result == SQLITE_OK; i++) {
+    int z, x, y;
+    next_request(&seed, &z, &x, &y);
+
+    if (stmt == NULL) {
+      result = sqlite3_prepare_v2(db, SELECT_TILE, -1, &stmt, NULL);
+      if (result != SQLITE_OK) {
+        break;
+      }
+    }
+
+    sqlite3_bind_int(stmt, 1, z);
+    sqlite3_bind_int(stmt, 2, x);
+    sqlite3_bind_int(stmt, 3, y);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+      bytes += (size_t) sqlite3_column_bytes(stmt, 0);
+      (void) sqlite3_column_blob(stmt, 0);
+    }
+
+    if (reuse) {
+      sqlite3_reset(stmt);
+    } else {
+      sqlite3_finalize(stmt);
+      stmt = NULL;
+    }
+  }
+  double elapsed = now() - start;
+  sqlite3_finalize(stmt);
+
+  if (result != SQLITE_OK) {
+    fprintf(stderr, "%s\n", sqlite3_errmsg(db));
+    return result;
+  }
+
+  printf("%-28s %10.0f requests/s %8.1f MB/s\n", reuse ? "prepared select" : "prepare/step/finalize", requests / elapsed, bytes / elapsed / 1e6);
+  return SQLITE_OK;
+}
+
+static int run_reader(sqlite3 *db, size_t cache) {
+  gpkg_tile_reader_t *reader;
+  unsigned int seed = 1;
+  size_t bytes = 0;
+
+  int result = gpkg_tile_reader_open(db, NULL, "tiles", cache, &reader);
+  if (result != SQLITE_OK) {
+    fprintf(stderr, "%s\n", gpkg_tile_reader_errmsg(reader));
+    gpkg_tile_reader_close(reader);
+    return result;
+  }
+
+  double start = now();
+  for (int i = 0; i < requests; i++) {
+    int z, x, y;
+    const void *data;
+    size_t length;
+    next_request(&seed, &z, &x, &y);
+
+    result = gpkg_tile_reader_read(reader, z, x, y, &data, &length);
+    if (result == SQLITE_ROW) {
+      bytes += length;
+    } else if (result != SQLITE_DONE) {
+      fprintf(stderr, "%s\n", gpkg_tile_reader_errmsg(reader));
+      break;
+    }
+    result = SQLITE_OK;
+
+    if ((i + 1) % batch == 0) {
+      gpkg_tile_reader_release(reader);
+    }
+  }
+  double elapsed = now() - start;
+  gpkg_tile_reader_close(reader);
+
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  printf("%-28s %10.0f requests/s %8.1f MB/s\n", cache > 0 ? "tile reader, cached" : "tile reader", requests / elapsed, bytes / elapsed / 1e6);
+  return SQLITE_OK;
+}
+
+int main(int argc, char **argv) {
+  char path[] = "gpkg_tile_read_XXXXXX";
+  sqlite3 *db = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      requests = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-z") == 0 && i + 1 < argc) {
+      zoom_levels = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      tile_size = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      batch = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      cache_size = (size_t) atol(argv[++i]) * 1024 * 1024;
+    } else {
+      fprintf(stderr, "Usage: %s [-n requests] [-z zoom levels] [-s tile size] [-b requests per read transaction] [-c cache size in MB]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (requests <= 0 || zoom_levels <= 0 || zoom_levels > 12 || tile_size <= 0 || batch <= 0 || cache_size == 0) {
+    return 1;
+  }
+
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+
+  int result = sqlite3_open(path, &db);
+  if (result == SQLITE_OK) {
+    result = populate(db);
+  }
+  if (result == SQLITE_OK) {
+    result = run_select(db, 0);
+  }
+  if (result == SQLITE_OK) {
+    result = run_select(db, 1);
+  }
+  if (result == SQLITE_OK) {
+    result = run_reader(db, 0);
+  }
+  if (result == SQLITE_OK) {
+    result = run_reader(db, cache_size);
+  }
+
+  sqlite3_close(db);
+  unlink(path);
+  {
+    char wal[sizeof(path) + 4];
+    snprintf(wal, sizeof(wal), "%s-wal", path);
+    unlink(wal);
+    snprintf(wal, sizeof(wal), "%s-shm", path);
+    unlink(wal);
+  }
+  return result == SQLITE_OK ? 0 : 1;
+}
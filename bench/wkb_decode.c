@@ -0,0 +1,207 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * WKB decoding throughput benchmark.
+ *
+ * Builds a multipolygon with many polygons and rings for every coordinate layout, byte order and WKB dialect and
+ * measures how long wkb_read_geometry takes to decode it into a consumer that does nothing, and how long
+ * wkb_fill_envelope takes on the same blob. Each case is run with the specialized coordinate readers and again with
+ * the generic reader they replace, so the speedup can be read off directly. Results are reported per coordinate so
+ * that layouts can be compared.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sqlite3.h"
+#include "binstream.h"
+#include "error.h"
+#include "geomio.h"
+#include "wkb.h"
+
+typedef struct {
+  const char *name;
+  uint32_t modifier;
+  uint32_t coord_size;
+} layout_t;
+
+static const layout_t layouts[] = {
+  {"XY", 0, 2},
+  {"XYZ", 1000, 3},
+  {"XYM", 2000, 3},
+  {"XYZM", 3000, 4}
+};
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void write_header(binstream_t *stream, wkb_dialect dialect, binstream_endianness order, uint32_t type) {
+  if (dialect == WKB_ISO) {
+    binstream_write_u8(stream, order == LITTLE ? 1 : 0);
+  } else {
+    binstream_write_u8(stream, 1);
+  }
+  binstream_write_u32(stream, type);
+}
+
+static int create_multipolygon(binstream_t *stream, wkb_dialect dialect, binstream_endianness order, const layout_t *layout, int polygons, int rings, int points) {
+  int result = binstream_init_growable(stream, 4096);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+  binstream_set_endianness(stream, order);
+
+  write_header(stream, dialect, order, layout->modifier + 6);
+  binstream_write_u32(stream, (uint32_t) polygons);
+  for (int p = 0; p < polygons; p++) {
+    write_header(stream, dialect, order, layout->modifier + 3);
+    binstream_write_u32(stream, (uint32_t) rings);
+    for (int r = 0; r < rings; r++) {
+      binstream_write_u32(stream, (uint32_t) points);
+      for (int i = 0; i < points; i++) {
+        binstream_write_double(stream, p * 10.0 + i % 7);
+        binstream_write_double(stream, r * 10.0 + i % 5);
+        for (uint32_t c = 2; c < layout->coord_size; c++) {
+          binstream_write_double(stream, (double) i);
+        }
+      }
+    }
+  }
+
+  binstream_flip(stream);
+  return SQLITE_OK;
+}
+
+static int run(const char *label, binstream_t *stream, wkb_dialect dialect, binstream_endianness order, int envelope, int generic, size_t coord_count, int iterations, double *elapsed_out) {
+  char error_buffer[256];
+  errorstream_t error;
+  geom_consumer_t consumer;
+  geom_envelope_t env;
+  int result = SQLITE_OK;
+  size_t size;
+
+  binstream_seek(stream, 0);
+  size = binstream_available(stream);
+
+  error_init_fixed(&error, error_buffer, sizeof(error_buffer));
+  geom_consumer_init(&consumer, NULL, NULL, NULL, NULL, NULL);
+
+  wkb_set_generic_point_reader(generic);
+  double start = now();
+  for (int i = 0; i < iterations && result == SQLITE_OK; i++) {
+    binstream_seek(stream, 0);
+    binstream_set_endianness(stream, order);
+    if (envelope) {
+      result = wkb_fill_envelope(stream, dialect, &env, &error);
+    } else {
+      result = wkb_read_geometry(stream, dialect, &consumer, &error);
+    }
+  }
+  double elapsed = now() - start;
+  wkb_set_generic_point_reader(0);
+
+  if (result != SQLITE_OK) {
+    fprintf(stderr, "%s: %s\n", label, error_message(&error));
+    return result;
+  }
+
+  printf("%-44s %8.2f ns/coordinate %10.1f MB/s", label, elapsed * 1e9 / ((double) iterations * coord_count), (double) iterations * size / elapsed / 1e6);
+  if (generic && elapsed_out != NULL && *elapsed_out > 0) {
+    printf(" %6.2fx", elapsed / *elapsed_out);
+  }
+  printf("\n");
+
+  if (!generic && elapsed_out != NULL) {
+    *elapsed_out = elapsed;
+  }
+  return SQLITE_OK;
+}
+
+/*
+ * Runs a case with the specialized readers and then with the generic reader. The generic line reports how many times
+ * faster the specialized readers are.
+ */
+static int compare(const char *name, binstream_t *stream, wkb_dialect dialect, binstream_endianness order, int envelope, size_t coord_count, int iterations) {
+  char label[64];
+  double elapsed = 0;
+
+  snprintf(label, sizeof(label), "%s %s", name, envelope ? "envelope" : "decode");
+  int result = run(label, stream, dialect, order, envelope, 0, coord_count, iterations, &elapsed);
+  if (result == SQLITE_OK) {
+    snprintf(label, sizeof(label), "%s %s (generic)", name, envelope ? "envelope" : "decode");
+    result = run(label, stream, dialect, order, envelope, 1, coord_count, iterations, &elapsed);
+  }
+  return result;
+}
+
+int main(int argc, char **argv) {
+  int iterations = 200;
+  int polygons = 100;
+  int rings = 5;
+  int points = 200;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      polygons = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      rings = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      points = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "Usage: %s [-n iterations] [-p polygons] [-r rings per polygon] [-c points per ring]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (iterations <= 0 || polygons <= 0 || rings <= 0 || points <= 0) {
+    return 1;
+  }
+
+  int result = SQLITE_OK;
+  for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]) && result == SQLITE_OK; l++) {
+    for (int d = 0; d < 3 && result == SQLITE_OK; d++) {
+      wkb_dialect dialect = d < 2 ? WKB_ISO : WKB_SPATIALITE;
+      binstream_endianness order = d == 1 ? BIG : LITTLE;
+      binstream_t stream;
+      char name[32];
+
+      result = create_multipolygon(&stream, dialect, order, &layouts[l], polygons, rings, points);
+      if (result != SQLITE_OK) {
+        break;
+      }
+
+      size_t coord_count = (size_t) polygons * rings * points;
+      const char *dialect_name = dialect == WKB_ISO ? (order == LITTLE ? "ISO LE" : "ISO BE") : "SpatiaLite";
+      snprintf(name, sizeof(name), "%s %s", layouts[l].name, dialect_name);
+      result = compare(name, &stream, dialect, order, 0, coord_count, iterations);
+      if (result == SQLITE_OK) {
+        result = compare(name, &stream, dialect, order, 1, coord_count, iterations);
+      }
+
+      binstream_destroy(&stream, 1);
+    }
+  }
+
+  return result == SQLITE_OK ? 0 : 1;
+}
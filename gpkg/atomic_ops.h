@@ -19,6 +19,10 @@ static inline long atomic_dec_long(volatile long *value) {
   return InterlockedDecrement(value);
 }
 
+static inline int atomic_cas_pointer(void *volatile *target, void *expected, void *value) {
+  return InterlockedCompareExchangePointer(target, value, expected) == expected;
+}
+
 #elif defined(__MACH__) || defined(__APPLE__)
 
 #include <libkern/OSAtomic.h>
@@ -46,6 +50,10 @@ static inline long atomic_dec_long(volatile long *value) {
 
 #endif
 
+static inline int atomic_cas_pointer(void *volatile *target, void *expected, void *value) {
+  return OSAtomicCompareAndSwapPtrBarrier(expected, value, target);
+}
+
 #elif defined(__GNUC__) || (defined(__has_builtin) && __has_builtin(__sync_fetch_and_add) && __has_builtin(__sync_fetch_and_sub))
 
 static inline long atomic_inc_long(volatile long *value) {
@@ -56,6 +64,10 @@ static inline long atomic_dec_long(volatile long *value) {
   return __sync_sub_and_fetch(value, 1);
 }
 
+static inline int atomic_cas_pointer(void *volatile *target, void *expected, void *value) {
+  return __sync_bool_compare_and_swap(target, expected, value);
+}
+
 #elif defined(__sun)
 
 #include <atomic.h>
@@ -68,6 +80,10 @@ static inline long atomic_dec_long(volatile long *value) {
   return (long)atomic_dec_ulong_nv((volatile ulong_t *)value);
 }
 
+static inline int atomic_cas_pointer(void *volatile *target, void *expected, void *value) {
+  return atomic_cas_ptr(target, expected, value) == expected;
+}
+
 #else
 
 #error "Atomic operations not supported"
@@ -82,6 +98,14 @@ static inline long atomic_dec_long(volatile long *value) {
   return *value;
 }
 
+static inline int atomic_cas_pointer(void *volatile *target, void *expected, void *value) {
+  if (*target == expected) {
+    *target = value;
+    return 1;
+  }
+  return 0;
+}
+
 #endif
 
 #endif
@@ -23,6 +23,13 @@ size_t geom_blob_writer_length(geom_blob_writer_t *writer) {
   return binstream_available(&writer->wkb_writer.stream);
 }
 
+void geom_blob_writer_reset(geom_blob_writer_t *writer, const geom_blob_header_t *header, int32_t srid) {
+  writer->header = *header;
+  writer->header.srid = srid;
+  writer->geom_type = GEOM_GEOMETRY;
+  wkb_writer_reset(&writer->wkb_writer);
+}
+
 geom_consumer_t *geom_blob_writer_geom_consumer(geom_blob_writer_t *writer) {
   return &writer->geom_consumer;
 }
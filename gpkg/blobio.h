@@ -81,4 +81,12 @@ uint8_t *geom_blob_writer_getdata(geom_blob_writer_t *writer);
  */
 size_t geom_blob_writer_length(geom_blob_writer_t *writer);
 
+/**
+ * Resets a geometry blob writer so it can be used to write another geometry while retaining its internal buffer.
+ * @param writer the writer to reset
+ * @param header the blob header the writer had directly after it was initialized
+ * @param srid the SRID to use for the next geometry
+ */
+void geom_blob_writer_reset(geom_blob_writer_t *writer, const geom_blob_header_t *header, int32_t srid);
+
 #endif
@@ -0,0 +1,394 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string.h>
+#include "contents_extent.h"
+#include "rtree_query.h"
+#include "sql.h"
+#include "strbuf.h"
+
+#define CONTENTS_EXTENT_EXTENSION_NAME "libgpkg_contents_extent"
+#define CONTENTS_EXTENT_EXTENSION_DEFINITION "libgpkg gpkg_contents extent maintenance"
+#define CONTENTS_EXTENT_INDEX_TABLE "rtree_%s_%s"
+
+/*
+ * Extents read from a spatial index are rounded outwards to single precision, so a geometry on the boundary of the
+ * table extent can lie up to one float ulp inside the stored extent. Boundary tests use this relative tolerance so
+ * that removing such a geometry still marks the extent as stale; a false positive only costs an unneeded refresh.
+ */
+#define CONTENTS_EXTENT_TOLERANCE "4194304.0"
+
+int contents_extent_enabled(sqlite3 *db, const char *db_name, int *enabled) {
+  int count = 0;
+  int result = sql_exec_for_int(
+                 db, &count,
+                 "SELECT count(*) FROM \"%w\".gpkg_extensions WHERE table_name IS NULL AND extension_name = %Q",
+                 db_name, CONTENTS_EXTENT_EXTENSION_NAME
+               );
+  *enabled = result == SQLITE_OK && count > 0;
+  return result;
+}
+
+static int contents_extent_row(sqlite3 *db, sqlite3_stmt *stmt, void *data) {
+  geom_envelope_t *envelope = (geom_envelope_t *) data;
+  if (sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+    envelope->min_x = sqlite3_column_double(stmt, 0);
+    envelope->min_y = sqlite3_column_double(stmt, 1);
+    envelope->max_x = sqlite3_column_double(stmt, 2);
+    envelope->max_y = sqlite3_column_double(stmt, 3);
+    envelope->has_env_x = 1;
+    envelope->has_env_y = 1;
+  }
+  return SQLITE_ABORT;
+}
+
+int contents_extent_refresh(sqlite3 *db, const char *db_name, const char *table_name, const char *column_name, errorstream_t *error) {
+  int result;
+  int index_exists = 0;
+  geom_envelope_t envelope;
+  sqlite3_stmt *stmt = NULL;
+  char *sql = NULL;
+
+  char *index_table = sqlite3_mprintf(CONTENTS_EXTENT_INDEX_TABLE, table_name, column_name);
+  if (index_table == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  result = sql_check_table_exists(db, db_name, index_table, &index_exists);
+  if (result != SQLITE_OK) {
+    error_append(error, "Could not check if index table %s.%s exists: %s", db_name, index_table, sqlite3_errmsg(db));
+    goto exit;
+  }
+
+  if (index_exists) {
+    result = rtree_query_extent(db, db_name, index_table, &envelope, error);
+  } else {
+    geom_envelope_init(&envelope);
+    result = sql_exec_stmt(
+               db, contents_extent_row, NULL, &envelope,
+               "SELECT ST_MinX(e), ST_MinY(e), ST_MaxX(e), ST_MaxY(e) FROM (SELECT ST_Extent(\"%w\") AS e FROM \"%w\".\"%w\")",
+               column_name, db_name, table_name
+             );
+    if (result != SQLITE_OK) {
+      error_append(error, "Could not compute extent of %s.%s.%s: %s", db_name, table_name, column_name, sqlite3_errmsg(db));
+    }
+  }
+  if (result != SQLITE_OK) {
+    goto exit;
+  }
+
+  sql = sqlite3_mprintf("UPDATE \"%w\".gpkg_contents SET min_x = ?, min_y = ?, max_x = ?, max_y = ? WHERE table_name = %Q", db_name, table_name);
+  if (sql == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  result = sql_init_stmt(&stmt, db, sql);
+  if (result == SQLITE_OK && envelope.has_env_x && envelope.has_env_y) {
+    sqlite3_bind_double(stmt, 1, envelope.min_x);
+    sqlite3_bind_double(stmt, 2, envelope.min_y);
+    sqlite3_bind_double(stmt, 3, envelope.max_x);
+    sqlite3_bind_double(stmt, 4, envelope.max_y);
+  }
+  if (result == SQLITE_OK) {
+    result = sqlite3_step(stmt);
+    result = result == SQLITE_DONE ? SQLITE_OK : result;
+  }
+  if (result != SQLITE_OK) {
+    error_append(error, "Could not update extent of %s.%s: %s", db_name, table_name, sqlite3_errmsg(db));
+  }
+
+exit:
+  sqlite3_finalize(stmt);
+  sqlite3_free(sql);
+  sqlite3_free(index_table);
+  return result;
+}
+
+/*
+ * Appends a trigger that extends the table extent to include NEW.column. The UPDATE only writes to gpkg_contents if
+ * the geometry lies outside the current extent. A stale extent is recomputed first, so that it does not shrink to
+ * the new geometry; the spatial index may not contain NEW yet at that point, which is why NEW is added afterwards.
+ */
+static int contents_extent_append_grow(strbuf_t *sql, const char *trigger, const char *event, const char *table, const char *table_name, const char *column, const char *refresh) {
+  return strbuf_append(
+           sql,
+           "CREATE TRIGGER %s AFTER %s ON %s\n"
+           "    WHEN NEW.%s NOTNULL AND NOT ST_IsEmpty(NEW.%s)\n"
+           "BEGIN\n"
+           "  SELECT %s WHERE EXISTS (\n"
+           "    SELECT 1 FROM gpkg_contents WHERE table_name = %Q AND (min_x ISNULL OR min_y ISNULL OR max_x ISNULL OR max_y ISNULL)\n"
+           "  );\n"
+           "  UPDATE gpkg_contents SET\n"
+           "    min_x = min(coalesce(min_x, ST_MinX(NEW.%s)), ST_MinX(NEW.%s)),\n"
+           "    min_y = min(coalesce(min_y, ST_MinY(NEW.%s)), ST_MinY(NEW.%s)),\n"
+           "    max_x = max(coalesce(max_x, ST_MaxX(NEW.%s)), ST_MaxX(NEW.%s)),\n"
+           "    max_y = max(coalesce(max_y, ST_MaxY(NEW.%s)), ST_MaxY(NEW.%s))\n"
+           "  WHERE table_name = %Q AND (min_x ISNULL OR min_y ISNULL OR max_x ISNULL OR max_y ISNULL OR\n"
+           "    ST_MinX(NEW.%s) < min_x OR ST_MinY(NEW.%s) < min_y OR ST_MaxX(NEW.%s) > max_x OR ST_MaxY(NEW.%s) > max_y);\n"
+           "END",
+           trigger, event, table,
+           column, column,
+           refresh, table_name,
+           column, column, column, column, column, column, column, column,
+           table_name,
+           column, column, column, column
+         );
+}
+
+/*
+ * Appends a trigger that updates the table extent if OLD.column touched its boundary. If the column has a spatial
+ * index, the extent is recomputed from its root node, which only costs a single page read. Otherwise the extent is
+ * marked as stale; the WHEN clause then no longer matches, so a bulk delete writes gpkg_contents at most once.
+ */
+static int contents_extent_append_shrink(strbuf_t *sql, const char *trigger, const char *event, const char *table, const char *table_name, const char *column, const char *index_table, const char *refresh) {
+  return strbuf_append(
+           sql,
+           "CREATE TRIGGER %s AFTER %s ON %s\n"
+           "    WHEN OLD.%s NOTNULL AND NOT ST_IsEmpty(OLD.%s) AND EXISTS (\n"
+           "      SELECT 1 FROM gpkg_contents WHERE table_name = %Q AND (\n"
+           "        ST_MinX(OLD.%s) <= min_x + abs(min_x) / " CONTENTS_EXTENT_TOLERANCE " OR\n"
+           "        ST_MinY(OLD.%s) <= min_y + abs(min_y) / " CONTENTS_EXTENT_TOLERANCE " OR\n"
+           "        ST_MaxX(OLD.%s) >= max_x - abs(max_x) / " CONTENTS_EXTENT_TOLERANCE " OR\n"
+           "        ST_MaxY(OLD.%s) >= max_y - abs(max_y) / " CONTENTS_EXTENT_TOLERANCE "\n"
+           "      )\n"
+           "    )\n"
+           "BEGIN\n"
+           "  UPDATE gpkg_contents SET min_x = NULL, min_y = NULL, max_x = NULL, max_y = NULL WHERE table_name = %Q AND NOT EXISTS (\n"
+           "    SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = %Q\n"
+           "  );\n"
+           "  SELECT %s WHERE EXISTS (\n"
+           "    SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = %Q\n"
+           "  );\n"
+           "END",
+           trigger, event, table,
+           column, column, table_name, column, column, column, column,
+           table_name, index_table,
+           refresh, index_table
+         );
+}
+
+static int contents_extent_index_trigger_row(sqlite3 *db, sqlite3_stmt *stmt, void *data) {
+  strbuf_t *script = (strbuf_t *) data;
+  const char *name = (const char *) sqlite3_column_text(stmt, 0);
+  const char *sql = (const char *) sqlite3_column_text(stmt, 1);
+  const char *db_name = (const char *) sqlite3_column_text(stmt, 2);
+  static const char prefix[] = "CREATE TRIGGER ";
+
+  // SQLite stores the trigger definition without the schema name, so it is added back before the name
+  if (name == NULL || sql == NULL || sqlite3_strnicmp(sql, prefix, sizeof(prefix) - 1) != 0) {
+    return SQLITE_CORRUPT;
+  }
+  return strbuf_append(script, "DROP TRIGGER \"%w\".\"%w\";\nCREATE TRIGGER \"%w\".%s;\n", db_name, name, db_name, sql + sizeof(prefix) - 1);
+}
+
+/*
+ * SQLite runs the most recently created trigger first. The spatial index triggers must run before the extent triggers
+ * so that the index no longer contains OLD when the extent is read from it. If the index already exists its triggers
+ * are recreated, in their original order, after the extent triggers.
+ */
+static int contents_extent_reorder_index_triggers(sqlite3 *db, const char *db_name, const char *table_name, const char *index_table, errorstream_t *error) {
+  strbuf_t script;
+  char *prefix = NULL;
+  char *errmsg = NULL;
+
+  int result = strbuf_init(&script, 4096);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  prefix = sqlite3_mprintf("%s_", index_table);
+  if (prefix == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  result = sql_exec_stmt(
+             db, contents_extent_index_trigger_row, NULL, &script,
+             "SELECT name, sql, %Q FROM \"%w\".sqlite_master WHERE type = 'trigger' AND tbl_name = %Q AND substr(name, 1, length(%Q)) = %Q ORDER BY rowid",
+             db_name, db_name, table_name, prefix, prefix
+           );
+  if (result != SQLITE_OK) {
+    error_append(error, "Could not read spatial index triggers of %s.%s: %s", db_name, table_name, sqlite3_errmsg(db));
+    goto exit;
+  }
+
+  if (strbuf_length(&script) > 0) {
+    result = sqlite3_exec(db, strbuf_data_pointer(&script), NULL, NULL, &errmsg);
+    if (result != SQLITE_OK) {
+      error_append(error, "Could not recreate spatial index triggers of %s.%s: %s", db_name, table_name, errmsg);
+    }
+  }
+
+exit:
+  sqlite3_free(errmsg);
+  sqlite3_free(prefix);
+  strbuf_destroy(&script);
+  return result;
+}
+
+static int contents_extent_create_triggers(sqlite3 *db, const char *db_name, const char *table_name, const char *column_name, errorstream_t *error) {
+  static const char *suffixes[] = {"insert", "update1", "update2", "delete", NULL};
+  strbuf_t sql;
+  char *table = NULL;
+  char *column = NULL;
+  char *event = NULL;
+  char *refresh = NULL;
+  char *index_table = NULL;
+
+  int result = strbuf_init(&sql, 2048);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  table = sqlite3_mprintf("\"%w\"", table_name);
+  column = sqlite3_mprintf("\"%w\"", column_name);
+  event = sqlite3_mprintf("UPDATE OF \"%w\"", column_name);
+  refresh = sqlite3_mprintf("GPKG_RefreshContentsExtent(%Q, %Q, %Q)", db_name, table_name, column_name);
+  index_table = sqlite3_mprintf(CONTENTS_EXTENT_INDEX_TABLE, table_name, column_name);
+  if (table == NULL || column == NULL || event == NULL || refresh == NULL || index_table == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  for (const char **suffix = suffixes; *suffix != NULL && result == SQLITE_OK; suffix++) {
+    result = sql_exec(db, "DROP TRIGGER IF EXISTS \"%w\".\"contents_extent_%w_%w_%w\"", db_name, table_name, column_name, *suffix);
+  }
+  if (result != SQLITE_OK) {
+    error_append(error, "Could not drop extent triggers of %s.%s.%s: %s", db_name, table_name, column_name, sqlite3_errmsg(db));
+    goto exit;
+  }
+
+  for (const char **suffix = suffixes; *suffix != NULL && result == SQLITE_OK; suffix++) {
+    char *trigger = sqlite3_mprintf("\"%w\".\"contents_extent_%w_%w_%w\"", db_name, table_name, column_name, *suffix);
+    result = trigger == NULL ? SQLITE_NOMEM : strbuf_reset(&sql);
+    if (result == SQLITE_OK) {
+      if (strcmp(*suffix, "insert") == 0) {
+        // Insert
+        result = contents_extent_append_grow(&sql, trigger, "INSERT", table, table_name, column, refresh);
+      } else if (strcmp(*suffix, "update1") == 0) {
+        // Update of a geometry that extends the extent
+        result = contents_extent_append_grow(&sql, trigger, event, table, table_name, column, refresh);
+      } else if (strcmp(*suffix, "update2") == 0) {
+        // Update of a geometry on the boundary of the extent
+        result = contents_extent_append_shrink(&sql, trigger, event, table, table_name, column, index_table, refresh);
+      } else {
+        // Delete of a geometry on the boundary of the extent
+        result = contents_extent_append_shrink(&sql, trigger, "DELETE", table, table_name, column, index_table, refresh);
+      }
+    }
+    sqlite3_free(trigger);
+
+    if (result == SQLITE_OK) {
+      result = sql_exec(db, "%s", strbuf_data_pointer(&sql));
+      if (result != SQLITE_OK) {
+        error_append(error, "Could not create extent %s trigger: %s", *suffix, sqlite3_errmsg(db));
+      }
+    }
+  }
+
+  if (result == SQLITE_OK) {
+    result = contents_extent_reorder_index_triggers(db, db_name, table_name, index_table, error);
+  }
+
+exit:
+  sqlite3_free(table);
+  sqlite3_free(column);
+  sqlite3_free(event);
+  sqlite3_free(refresh);
+  sqlite3_free(index_table);
+  strbuf_destroy(&sql);
+  return result;
+}
+
+int contents_extent_install(sqlite3 *db, const char *db_name, const char *table_name, const char *column_name, errorstream_t *error) {
+  int result = contents_extent_create_triggers(db, db_name, table_name, column_name, error);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = sql_exec(
+             db,
+             "INSERT OR REPLACE INTO \"%w\".\"gpkg_extensions\" (table_name, column_name, extension_name, definition, scope) VALUES (%Q, %Q, %Q, %Q, %Q)",
+             db_name, table_name, column_name, CONTENTS_EXTENT_EXTENSION_NAME, CONTENTS_EXTENT_EXTENSION_DEFINITION, "write-only"
+           );
+  if (result != SQLITE_OK) {
+    error_append(error, "Could not register extent maintenance in gpkg_extensions: %s", sqlite3_errmsg(db));
+    return result;
+  }
+
+  return contents_extent_refresh(db, db_name, table_name, column_name, error);
+}
+
+typedef struct {
+  char *table_name;
+  char *column_name;
+} contents_extent_column_t;
+
+static int contents_extent_column_row(sqlite3 *db, sqlite3_stmt *stmt, void *data) {
+  contents_extent_column_t *column = (contents_extent_column_t *) data;
+  column->table_name = sqlite3_mprintf("%s", sqlite3_column_text(stmt, 0));
+  column->column_name = sqlite3_mprintf("%s", sqlite3_column_text(stmt, 1));
+  if (column->table_name == NULL || column->column_name == NULL) {
+    return SQLITE_NOMEM;
+  }
+  return SQLITE_ABORT;
+}
+
+int contents_extent_enable(sqlite3 *db, const char *db_name, errorstream_t *error) {
+  int result;
+
+  // Unique constraints do not apply to NULL values, so the database wide row is only inserted if it is missing
+  result = sql_exec(
+             db,
+             "INSERT INTO \"%w\".\"gpkg_extensions\" (table_name, column_name, extension_name, definition, scope) "
+             "SELECT NULL, NULL, %Q, %Q, %Q WHERE NOT EXISTS (SELECT 1 FROM \"%w\".\"gpkg_extensions\" WHERE table_name IS NULL AND extension_name = %Q)",
+             db_name, CONTENTS_EXTENT_EXTENSION_NAME, CONTENTS_EXTENT_EXTENSION_DEFINITION, "write-only", db_name, CONTENTS_EXTENT_EXTENSION_NAME
+           );
+  if (result != SQLITE_OK) {
+    error_append(error, "Could not register extent maintenance in gpkg_extensions: %s", sqlite3_errmsg(db));
+    return result;
+  }
+
+  /*
+   * Triggers cannot be created while gpkg_geometry_columns is being read, so the geometry columns are visited one at a
+   * time in key order.
+   */
+  contents_extent_column_t previous = {NULL, NULL};
+  while (result == SQLITE_OK) {
+    contents_extent_column_t next = {NULL, NULL};
+    result = sql_exec_stmt(
+               db, contents_extent_column_row, NULL, &next,
+               "SELECT table_name, column_name FROM \"%w\".gpkg_geometry_columns WHERE %Q ISNULL OR table_name > %Q OR (table_name = %Q AND column_name > %Q) ORDER BY table_name, column_name LIMIT 1",
+               db_name, previous.table_name, previous.table_name, previous.table_name, previous.column_name
+             );
+    sqlite3_free(previous.table_name);
+    sqlite3_free(previous.column_name);
+    previous = next;
+
+    if (result != SQLITE_OK) {
+      error_append(error, "Could not read %s.gpkg_geometry_columns: %s", db_name, sqlite3_errmsg(db));
+    } else if (next.table_name == NULL) {
+      break;
+    } else {
+      result = contents_extent_install(db, db_name, next.table_name, next.column_name, error);
+    }
+  }
+  sqlite3_free(previous.table_name);
+  sqlite3_free(previous.column_name);
+
+  return result;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GPKG_CONTENTS_EXTENT_H
+#define GPKG_CONTENTS_EXTENT_H
+
+#include "error.h"
+#include "sqlite.h"
+
+/**
+ * \addtogroup contents_extent gpkg_contents extent maintenance
+ *
+ * Keeps the min_x, min_y, max_x and max_y columns of gpkg_contents up to date for geometry columns. Maintenance is
+ * enabled per database and is then installed on every geometry column, including columns added later using
+ * AddGeometryColumn or indexed later using CreateSpatialIndex. The database wide setting and each maintained column
+ * are registered in gpkg_extensions as libgpkg_contents_extent.
+ *
+ * Inserts and updates only write to gpkg_contents when a geometry extends the current extent. Deletes and updates of a
+ * geometry that touched the boundary of the extent recompute it from the root node of the spatial index, which SQLite
+ * keeps rounded outwards to single precision. Columns without a spatial index would need a table scan instead, so
+ * there the extent is marked as stale by setting it to NULL, which costs a single write no matter how many rows a
+ * statement removes. A stale extent is recomputed once, by the next insert or update of a non empty geometry or by
+ * GPKG_RefreshContentsExtent.
+ * @{
+ */
+
+/**
+ * Checks whether gpkg_contents extent maintenance is enabled for a database.
+ * @param db the database handle
+ * @param db_name the database name (e.g. "main")
+ * @param[out] enabled set to 1 if maintenance is enabled and 0 otherwise
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+int contents_extent_enabled(sqlite3 *db, const char *db_name, int *enabled);
+
+/**
+ * Enables gpkg_contents extent maintenance for a database and installs it on all registered geometry columns.
+ * @param db the database handle
+ * @param db_name the database name (e.g. "main")
+ * @param error the error stream to write errors to
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+int contents_extent_enable(sqlite3 *db, const char *db_name, errorstream_t *error);
+
+/**
+ * Installs extent maintenance on a geometry column, replacing any previously installed maintenance, and recomputes
+ * the extent of the table.
+ * @param db the database handle
+ * @param db_name the database name (e.g. "main")
+ * @param table_name the name of the feature table
+ * @param column_name the name of the geometry column
+ * @param error the error stream to write errors to
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+int contents_extent_install(sqlite3 *db, const char *db_name, const char *table_name, const char *column_name, errorstream_t *error);
+
+/**
+ * Recomputes the extent of a geometry column and stores it in gpkg_contents. This executes a single UPDATE statement,
+ * so it can be used from triggers.
+ * @param db the database handle
+ * @param db_name the database name (e.g. "main")
+ * @param table_name the name of the feature table
+ * @param column_name the name of the geometry column
+ * @param error the error stream to write errors to
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+int contents_extent_refresh(sqlite3 *db, const char *db_name, const char *table_name, const char *column_name, errorstream_t *error);
+
+/** @} */
+
+#endif
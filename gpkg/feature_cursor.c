@@ -0,0 +1,540 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string.h>
+#include "binstream.h"
+#include "blobio.h"
+#include "error.h"
+#include "feature_cursor.h"
+#include "geomio.h"
+#include "spatialdb.h"
+#include "sql.h"
+#include "sqlite.h"
+
+#define CURSOR_ERROR_BUFFER_SIZE 256
+
+struct gpkg_feature_cursor_t {
+  /** @private */
+  geom_consumer_t geom_consumer;
+  /** @private */
+  sqlite3 *db;
+  /** @private */
+  sqlite3_stmt *stmt;
+  /** @private */
+  const spatialdb_t *spatialdb;
+  /** @private */
+  int column;
+  /** @private */
+  int has_bbox;
+  /** @private */
+  double bbox[4];
+  /** @private */
+  gpkg_feature_t feature;
+  /** @private */
+  geom_envelope_t envelope;
+  /** @private */
+  int fill_envelope;
+  /** @private */
+  int depth;
+  /** @private */
+  int multi_root;
+  /** @private */
+  double *coords;
+  /** @private */
+  size_t coords_capacity;
+  /** @private */
+  uint32_t *ring_offsets;
+  /** @private */
+  size_t ring_capacity;
+  /** @private */
+  uint32_t *part_offsets;
+  /** @private */
+  int *part_types;
+  /** @private */
+  size_t part_capacity;
+  /** @private */
+  errorstream_t error;
+  /** @private */
+  char error_buffer[CURSOR_ERROR_BUFFER_SIZE];
+};
+
+static int cursor_grow(void **buffer, size_t *capacity, size_t required, size_t element_size) {
+  if (required <= *capacity) {
+    return SQLITE_OK;
+  }
+
+  size_t new_capacity = *capacity == 0 ? 64 : *capacity;
+  while (new_capacity < required) {
+    new_capacity = (new_capacity * 3) / 2;
+  }
+
+  if (new_capacity * element_size > 0x7FFFFFFF) {
+    return SQLITE_NOMEM;
+  }
+
+  void *new_buffer = sqlite3_realloc(*buffer, (int) (new_capacity * element_size));
+  if (new_buffer == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  *buffer = new_buffer;
+  *capacity = new_capacity;
+  return SQLITE_OK;
+}
+
+static int cursor_grow_parts(gpkg_feature_cursor_t *cursor, size_t required) {
+  size_t offsets_capacity = cursor->part_capacity;
+  size_t types_capacity = cursor->part_capacity;
+
+  int result = cursor_grow((void **) &cursor->part_offsets, &offsets_capacity, required, sizeof(uint32_t));
+  if (result == SQLITE_OK) {
+    result = cursor_grow((void **) &cursor->part_types, &types_capacity, required, sizeof(int));
+  }
+  if (result == SQLITE_OK) {
+    cursor->part_capacity = offsets_capacity;
+  }
+  return result;
+}
+
+static int cursor_begin_part(gpkg_feature_cursor_t *cursor, geom_type_t geom_type) {
+  size_t part_count = cursor->feature.part_count;
+
+  int result = cursor_grow_parts(cursor, part_count + 2);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  cursor->part_offsets[part_count] = (uint32_t) cursor->feature.ring_count;
+  cursor->part_types[part_count] = geom_type;
+  cursor->feature.part_count++;
+  return SQLITE_OK;
+}
+
+static int cursor_begin_ring(gpkg_feature_cursor_t *cursor) {
+  size_t ring_count = cursor->feature.ring_count;
+
+  int result = cursor_grow((void **) &cursor->ring_offsets, &cursor->ring_capacity, ring_count + 2, sizeof(uint32_t));
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  cursor->ring_offsets[ring_count] = (uint32_t) cursor->feature.point_count;
+  cursor->feature.ring_count++;
+  return SQLITE_OK;
+}
+
+static int cursor_begin(const geom_consumer_t *consumer, errorstream_t *error) {
+  gpkg_feature_cursor_t *cursor = (gpkg_feature_cursor_t *) consumer;
+  cursor->depth = -1;
+  cursor->multi_root = 0;
+  cursor->feature.point_count = 0;
+  cursor->feature.ring_count = 0;
+  cursor->feature.part_count = 0;
+  return SQLITE_OK;
+}
+
+static int cursor_begin_geometry(const geom_consumer_t *consumer, const geom_header_t *header, errorstream_t *error) {
+  int result = SQLITE_OK;
+  gpkg_feature_cursor_t *cursor = (gpkg_feature_cursor_t *) consumer;
+
+  cursor->depth++;
+  if (cursor->depth == 0) {
+    cursor->feature.geom_type = header->geom_type;
+    cursor->feature.coord_type = header->coord_type;
+    cursor->feature.coord_size = (int) header->coord_size;
+
+    switch (header->geom_type) {
+      case GEOM_MULTIPOINT:
+      case GEOM_MULTILINESTRING:
+      case GEOM_MULTIPOLYGON:
+      case GEOM_MULTICURVE:
+      case GEOM_MULTISURFACE:
+      case GEOM_GEOMETRYCOLLECTION:
+        cursor->multi_root = 1;
+        break;
+      default:
+        cursor->multi_root = 0;
+        result = cursor_begin_part(cursor, header->geom_type);
+        break;
+    }
+  } else if (cursor->depth == 1 && cursor->multi_root) {
+    result = cursor_begin_part(cursor, header->geom_type);
+  }
+
+  if (result != SQLITE_OK) {
+    goto exit;
+  }
+
+  switch (header->geom_type) {
+    case GEOM_POINT:
+    case GEOM_LINESTRING:
+    case GEOM_LINEARRING:
+    case GEOM_CIRCULARSTRING:
+      result = cursor_begin_ring(cursor);
+      break;
+    default:
+      break;
+  }
+
+exit:
+  return result;
+}
+
+static int cursor_end_geometry(const geom_consumer_t *consumer, const geom_header_t *header, errorstream_t *error) {
+  gpkg_feature_cursor_t *cursor = (gpkg_feature_cursor_t *) consumer;
+  cursor->depth--;
+  return SQLITE_OK;
+}
+
+static int cursor_coordinates(const geom_consumer_t *consumer, const geom_header_t *header, size_t point_count, const double *coords, int skip_coords, errorstream_t *error) {
+  gpkg_feature_cursor_t *cursor = (gpkg_feature_cursor_t *) consumer;
+
+  if (cursor->fill_envelope) {
+    geom_envelope_accumulate(&cursor->envelope, header);
+    geom_envelope_fill(&cursor->envelope, header, point_count, coords);
+  }
+
+  size_t new_points = point_count - (skip_coords / header->coord_size);
+  size_t used = cursor->feature.point_count * header->coord_size;
+  size_t count = new_points * header->coord_size;
+
+  int result = cursor_grow((void **) &cursor->coords, &cursor->coords_capacity, used + count, sizeof(double));
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  memcpy(cursor->coords + used, coords + skip_coords, count * sizeof(double));
+  cursor->feature.point_count += new_points;
+  return SQLITE_OK;
+}
+
+static int cursor_end(const geom_consumer_t *consumer, errorstream_t *error) {
+  gpkg_feature_cursor_t *cursor = (gpkg_feature_cursor_t *) consumer;
+  gpkg_feature_t *feature = &cursor->feature;
+
+  int result = cursor_grow((void **) &cursor->ring_offsets, &cursor->ring_capacity, feature->ring_count + 1, sizeof(uint32_t));
+  if (result == SQLITE_OK) {
+    result = cursor_grow_parts(cursor, feature->part_count + 1);
+  }
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  cursor->ring_offsets[feature->ring_count] = (uint32_t) feature->point_count;
+  cursor->part_offsets[feature->part_count] = (uint32_t) feature->ring_count;
+
+  feature->coords = cursor->coords;
+  feature->ring_offsets = cursor->ring_offsets;
+  feature->part_offsets = cursor->part_offsets;
+  feature->part_types = cursor->part_types;
+  return SQLITE_OK;
+}
+
+static void cursor_set_envelope(gpkg_feature_t *feature, const geom_envelope_t *envelope) {
+  feature->has_env_xy = envelope->has_env_x && envelope->has_env_y;
+  feature->min_x = envelope->min_x;
+  feature->min_y = envelope->min_y;
+  feature->max_x = envelope->max_x;
+  feature->max_y = envelope->max_y;
+  feature->has_env_z = envelope->has_env_z;
+  feature->min_z = envelope->min_z;
+  feature->max_z = envelope->max_z;
+  feature->has_env_m = envelope->has_env_m;
+  feature->min_m = envelope->min_m;
+  feature->max_m = envelope->max_m;
+}
+
+static int cursor_in_bbox(const gpkg_feature_cursor_t *cursor) {
+  const gpkg_feature_t *feature = &cursor->feature;
+  if (!feature->has_env_xy) {
+    return 0;
+  }
+  return feature->min_x <= cursor->bbox[2] && feature->max_x >= cursor->bbox[0] && feature->min_y <= cursor->bbox[3] && feature->max_y >= cursor->bbox[1];
+}
+
+static gpkg_feature_cursor_t *cursor_init(sqlite3 *db) {
+  gpkg_feature_cursor_t *cursor = (gpkg_feature_cursor_t *)sqlite3_malloc(sizeof(gpkg_feature_cursor_t));
+  if (cursor == NULL) {
+    return NULL;
+  }
+
+  memset(cursor, 0, sizeof(gpkg_feature_cursor_t));
+  geom_consumer_init(&cursor->geom_consumer, cursor_begin, cursor_end, cursor_begin_geometry, cursor_end_geometry, cursor_coordinates);
+  error_init_fixed(&cursor->error, cursor->error_buffer, CURSOR_ERROR_BUFFER_SIZE);
+  cursor->db = db;
+  cursor->column = -1;
+  cursor->feature.is_null = 1;
+  return cursor;
+}
+
+static char *cursor_table_sql(gpkg_feature_cursor_t *cursor, const char *db_name, const char *table_name, const char *column_name) {
+  char *sql = NULL;
+  char *index_name = NULL;
+  int exists = 0;
+  const char *id = "id", *min_x = "minx", *max_x = "maxx", *min_y = "miny", *max_y = "maxy";
+
+  if (!cursor->has_bbox) {
+    return sqlite3_mprintf("SELECT * FROM \"%w\".\"%w\"", db_name, table_name);
+  }
+
+  index_name = sqlite3_mprintf("rtree_%s_%s", table_name, column_name);
+  if (index_name == NULL) {
+    goto exit;
+  }
+  sql_check_table_exists(cursor->db, db_name, index_name, &exists);
+
+  if (!exists) {
+    sqlite3_free(index_name);
+    index_name = sqlite3_mprintf("idx_%s_%s", table_name, column_name);
+    if (index_name == NULL) {
+      goto exit;
+    }
+    sql_check_table_exists(cursor->db, db_name, index_name, &exists);
+    id = "pkid";
+    min_x = "xmin";
+    max_x = "xmax";
+    min_y = "ymin";
+    max_y = "ymax";
+  }
+
+  if (!exists) {
+    /* No spatial index; rows are filtered on their envelope only */
+    sql = sqlite3_mprintf("SELECT * FROM \"%w\".\"%w\"", db_name, table_name);
+    goto exit;
+  }
+
+  /* Both index flavours store the rowid of the feature, so there is no need to look up the primary key column */
+  sql = sqlite3_mprintf(
+          "SELECT * FROM \"%w\".\"%w\" WHERE rowid IN (SELECT %s FROM \"%w\".\"%w\" WHERE %s <= ?3 AND %s >= ?1 AND %s <= ?4 AND %s >= ?2)",
+          db_name, table_name,
+          id, db_name, index_name, min_x, max_x, min_y, max_y
+        );
+
+exit:
+  sqlite3_free(index_name);
+  return sql;
+}
+
+GPKG_EXPORT int GPKG_CALL gpkg_feature_cursor_open(sqlite3 *db, const char *db_name, const char *table_name, const char *column_name, const double *bbox, gpkg_feature_cursor_t **cursor_out) {
+  int result = SQLITE_OK;
+  char *sql = NULL;
+
+  gpkg_feature_cursor_t *cursor = cursor_init(db);
+  *cursor_out = cursor;
+  if (cursor == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  if (db_name == NULL) {
+    db_name = "main";
+  }
+
+  if (bbox != NULL) {
+    cursor->has_bbox = 1;
+    memcpy(cursor->bbox, bbox, 4 * sizeof(double));
+  }
+
+  cursor->spatialdb = spatialdb_detect_schema(db);
+
+  sql = cursor_table_sql(cursor, db_name, table_name, column_name);
+  if (sql == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  result = sqlite3_prepare_v2(db, sql, -1, &cursor->stmt, NULL);
+  if (result != SQLITE_OK) {
+    error_append(&cursor->error, "%s", sqlite3_errmsg(db));
+    goto exit;
+  }
+
+  for (int i = 0; i < sqlite3_column_count(cursor->stmt); i++) {
+    if (sqlite3_stricmp(sqlite3_column_name(cursor->stmt, i), column_name) == 0) {
+      cursor->column = i;
+      break;
+    }
+  }
+
+  if (cursor->column < 0) {
+    error_append(&cursor->error, "No such column: %s.%s", table_name, column_name);
+    result = SQLITE_ERROR;
+    goto exit;
+  }
+
+  if (cursor->has_bbox && sqlite3_bind_parameter_count(cursor->stmt) == 4) {
+    for (int i = 0; i < 4; i++) {
+      sqlite3_bind_double(cursor->stmt, i + 1, cursor->bbox[i]);
+    }
+  }
+
+exit:
+  sqlite3_free(sql);
+  return result;
+}
+
+GPKG_EXPORT int GPKG_CALL gpkg_feature_cursor_open_query(sqlite3 *db, const char *sql, int column, gpkg_feature_cursor_t **cursor_out) {
+  int result = SQLITE_OK;
+
+  gpkg_feature_cursor_t *cursor = cursor_init(db);
+  *cursor_out = cursor;
+  if (cursor == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  cursor->spatialdb = spatialdb_detect_schema(db);
+
+  result = sqlite3_prepare_v2(db, sql, -1, &cursor->stmt, NULL);
+  if (result != SQLITE_OK) {
+    error_append(&cursor->error, "%s", sqlite3_errmsg(db));
+    goto exit;
+  }
+
+  if (column < 0 || column >= sqlite3_column_count(cursor->stmt)) {
+    error_append(&cursor->error, "Column index out of range: %d", column);
+    result = SQLITE_RANGE;
+    goto exit;
+  }
+  cursor->column = column;
+
+exit:
+  return result;
+}
+
+static int cursor_decode(gpkg_feature_cursor_t *cursor, int *skip) {
+  int result = SQLITE_OK;
+  gpkg_feature_t *feature = &cursor->feature;
+  const spatialdb_t *spatialdb = cursor->spatialdb;
+  geom_blob_header_t header;
+  binstream_t stream;
+
+  *skip = 0;
+
+  const void *blob = sqlite3_column_blob(cursor->stmt, cursor->column);
+  int length = sqlite3_column_bytes(cursor->stmt, cursor->column);
+  if (blob == NULL || length == 0) {
+    feature->is_null = 1;
+    feature->point_count = 0;
+    feature->ring_count = 0;
+    feature->part_count = 0;
+    *skip = cursor->has_bbox;
+    goto exit;
+  }
+  feature->is_null = 0;
+
+  binstream_init(&stream, (uint8_t *) blob, (size_t) length);
+  result = spatialdb->read_blob_header(&stream, &header, &cursor->error);
+  if (result != SQLITE_OK) {
+    if (error_count(&cursor->error) == 0) {
+      error_append(&cursor->error, "Invalid geometry blob header");
+    }
+    goto exit;
+  }
+
+  feature->srid = header.srid;
+  feature->empty = header.empty;
+
+  cursor->fill_envelope = !(header.envelope.has_env_x && header.envelope.has_env_y);
+  if (cursor->fill_envelope) {
+    geom_envelope_init(&cursor->envelope);
+  } else {
+    cursor_set_envelope(feature, &header.envelope);
+    if (cursor->has_bbox && !cursor_in_bbox(cursor)) {
+      *skip = 1;
+      goto exit;
+    }
+  }
+
+  result = spatialdb->read_geometry(&stream, &cursor->geom_consumer, &cursor->error);
+  if (result != SQLITE_OK) {
+    if (error_count(&cursor->error) == 0) {
+      error_append(&cursor->error, "Invalid geometry blob");
+    }
+    goto exit;
+  }
+
+  if (cursor->fill_envelope) {
+    geom_envelope_finalize(&cursor->envelope);
+    cursor_set_envelope(feature, &cursor->envelope);
+    if (cursor->has_bbox && !cursor_in_bbox(cursor)) {
+      *skip = 1;
+    }
+  }
+
+exit:
+  return result;
+}
+
+GPKG_EXPORT int GPKG_CALL gpkg_feature_cursor_next(gpkg_feature_cursor_t *cursor) {
+  if (cursor->stmt == NULL) {
+    return SQLITE_MISUSE;
+  }
+
+  error_reset(&cursor->error);
+
+  while (1) {
+    int result = sqlite3_step(cursor->stmt);
+    if (result != SQLITE_ROW) {
+      if (result != SQLITE_DONE) {
+        error_append(&cursor->error, "%s", sqlite3_errmsg(cursor->db));
+      }
+      return result;
+    }
+
+    int skip;
+    result = cursor_decode(cursor, &skip);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+
+    if (!skip) {
+      return SQLITE_ROW;
+    }
+  }
+}
+
+GPKG_EXPORT const gpkg_feature_t *GPKG_CALL gpkg_feature_cursor_feature(gpkg_feature_cursor_t *cursor) {
+  return &cursor->feature;
+}
+
+GPKG_EXPORT sqlite3_stmt *GPKG_CALL gpkg_feature_cursor_stmt(gpkg_feature_cursor_t *cursor) {
+  return cursor->stmt;
+}
+
+GPKG_EXPORT int GPKG_CALL gpkg_feature_cursor_reset(gpkg_feature_cursor_t *cursor) {
+  error_reset(&cursor->error);
+  cursor->feature.is_null = 1;
+  return cursor->stmt == NULL ? SQLITE_MISUSE : sqlite3_reset(cursor->stmt);
+}
+
+GPKG_EXPORT const char *GPKG_CALL gpkg_feature_cursor_errmsg(gpkg_feature_cursor_t *cursor) {
+  if (cursor == NULL) {
+    return "out of memory";
+  }
+  return error_message(&cursor->error);
+}
+
+GPKG_EXPORT void GPKG_CALL gpkg_feature_cursor_close(gpkg_feature_cursor_t *cursor) {
+  if (cursor == NULL) {
+    return;
+  }
+
+  sqlite3_finalize(cursor->stmt);
+  sqlite3_free(cursor->coords);
+  sqlite3_free(cursor->ring_offsets);
+  sqlite3_free(cursor->part_offsets);
+  sqlite3_free(cursor->part_types);
+  error_destroy(&cursor->error);
+  sqlite3_free(cursor);
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GPKG_FEATURE_CURSOR_H
+#define GPKG_FEATURE_CURSOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "gpkg.h"
+
+/**
+ * \addtogroup feature_cursor Feature cursors
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A decoded feature geometry. All pointers refer to buffers owned by the cursor. They remain valid until the next
+ * call to gpkg_feature_cursor_next() or gpkg_feature_cursor_close().
+ *
+ * The coordinates of the geometry are stored as a single interleaved array. Each leaf sequence (a point, line string,
+ * linear ring or circular string) is a 'ring'. Ring i consists of the points in the range
+ * [ring_offsets[i], ring_offsets[i + 1]). Each direct child of a multi geometry or geometry collection is a 'part';
+ * for all other geometry types the root geometry is the only part. Part i consists of the rings in the range
+ * [part_offsets[i], part_offsets[i + 1]).
+ */
+typedef struct {
+  /**
+   * Non-zero if the geometry column of the current row is NULL. All other fields are undefined in that case.
+   */
+  int is_null;
+  /**
+   * The SRID of the geometry.
+   */
+  int32_t srid;
+  /**
+   * Non-zero if the geometry is empty.
+   */
+  int empty;
+  /**
+   * The geometry type code of the root geometry (1 = Point, 2 = LineString, 3 = Polygon, ...).
+   */
+  int geom_type;
+  /**
+   * The coordinate type of the geometry (0 = XY, 1 = XYZ, 2 = XYM, 3 = XYZM).
+   */
+  int coord_type;
+  /**
+   * The number of ordinates per coordinate.
+   */
+  int coord_size;
+  /**
+   * Non-zero if min/max X and Y values are present.
+   */
+  int has_env_xy;
+  double min_x;
+  double min_y;
+  double max_x;
+  double max_y;
+  /**
+   * Non-zero if min/max Z values are present.
+   */
+  int has_env_z;
+  double min_z;
+  double max_z;
+  /**
+   * Non-zero if min/max M values are present.
+   */
+  int has_env_m;
+  double min_m;
+  double max_m;
+  /**
+   * The total number of points.
+   */
+  size_t point_count;
+  /**
+   * The coordinates. This array contains (point_count * coord_size) values.
+   */
+  const double *coords;
+  /**
+   * The number of rings.
+   */
+  size_t ring_count;
+  /**
+   * The point offsets of the rings. This array contains (ring_count + 1) values.
+   */
+  const uint32_t *ring_offsets;
+  /**
+   * The number of parts.
+   */
+  size_t part_count;
+  /**
+   * The ring offsets of the parts. This array contains (part_count + 1) values.
+   */
+  const uint32_t *part_offsets;
+  /**
+   * The geometry type code of each part. This array contains part_count values.
+   */
+  const int *part_types;
+} gpkg_feature_t;
+
+/**
+ * A forward only cursor over the geometries of a table or query.
+ */
+typedef struct gpkg_feature_cursor_t gpkg_feature_cursor_t;
+
+/**
+ * Opens a cursor over all rows of a feature table. If bbox is not NULL only rows whose geometry envelope intersects
+ * the given bounding box are returned. When a spatial index exists for the geometry column it is used to select the
+ * candidate rows.
+ *
+ * Even when this function fails a cursor handle will usually be returned which can be passed to
+ * gpkg_feature_cursor_errmsg(). In all cases the cursor should be closed using gpkg_feature_cursor_close().
+ *
+ * @param db the database handle
+ * @param db_name the database name (e.g. "main")
+ * @param table_name the name of the feature table
+ * @param column_name the name of the geometry column
+ * @param bbox NULL or an array containing min x, min y, max x and max y
+ * @param[out] cursor the new cursor
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+GPKG_EXPORT int GPKG_CALL gpkg_feature_cursor_open(sqlite3 *db, const char *db_name, const char *table_name, const char *column_name, const double *bbox, gpkg_feature_cursor_t **cursor);
+
+/**
+ * Opens a cursor over the rows of an arbitrary query. Query parameters can be bound using the statement returned by
+ * gpkg_feature_cursor_stmt().
+ *
+ * @param db the database handle
+ * @param sql the query to execute
+ * @param column the index of the result column containing the geometry
+ * @param[out] cursor the new cursor
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+GPKG_EXPORT int GPKG_CALL gpkg_feature_cursor_open_query(sqlite3 *db, const char *sql, int column, gpkg_feature_cursor_t **cursor);
+
+/**
+ * Advances the cursor to the next row and decodes its geometry. No memory is allocated once the internal buffers
+ * have grown to the size of the largest geometry seen so far.
+ *
+ * @param cursor the cursor
+ * @return SQLITE_ROW if a row is available, SQLITE_DONE at the end of the result set, an error code otherwise
+ */
+GPKG_EXPORT int GPKG_CALL gpkg_feature_cursor_next(gpkg_feature_cursor_t *cursor);
+
+/**
+ * Returns the geometry of the current row.
+ * @param cursor the cursor
+ * @return the decoded geometry
+ */
+GPKG_EXPORT const gpkg_feature_t *GPKG_CALL gpkg_feature_cursor_feature(gpkg_feature_cursor_t *cursor);
+
+/**
+ * Returns the statement backing the cursor. This statement can be used to bind query parameters and to read the
+ * other columns of the current row. It should not be stepped or finalized directly.
+ * @param cursor the cursor
+ * @return the statement
+ */
+GPKG_EXPORT sqlite3_stmt *GPKG_CALL gpkg_feature_cursor_stmt(gpkg_feature_cursor_t *cursor);
+
+/**
+ * Resets the cursor to the start of its result set. Bound parameters are retained.
+ * @param cursor the cursor
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+GPKG_EXPORT int GPKG_CALL gpkg_feature_cursor_reset(gpkg_feature_cursor_t *cursor);
+
+/**
+ * Returns a description of the last error that occurred.
+ * @param cursor the cursor
+ * @return an error message
+ */
+GPKG_EXPORT const char *GPKG_CALL gpkg_feature_cursor_errmsg(gpkg_feature_cursor_t *cursor);
+
+/**
+ * Closes a cursor and releases all of its resources.
+ * @param cursor the cursor to close. May be NULL.
+ */
+GPKG_EXPORT void GPKG_CALL gpkg_feature_cursor_close(gpkg_feature_cursor_t *cursor);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+
+#endif
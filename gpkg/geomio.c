@@ -21,6 +21,18 @@
 #include "geomio.h"
 #include "fp.h"
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define GEOM_ENVELOPE_SSE2
+#include <emmintrin.h>
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define GEOM_ENVELOPE_AVX
+#include <immintrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define GEOM_ENVELOPE_NEON
+#include <arm_neon.h>
+#endif
+
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
@@ -321,43 +333,109 @@ static void geom_envelope_fill_arc(geom_envelope_t *envelope, const geom_header_
 #undef MIN_MAX
 }
 
+/*
+ * Vectorized min/max reduction over interleaved coordinates. Each kernel processes blocks of 'regs' vector registers
+ * at a time, where the block size is a multiple of the coordinate dimension so that every vector lane always sees the
+ * same ordinate. The lanes are folded into min and max per ordinate afterwards. Accumulators start at +/-DBL_MAX and
+ * the new values are passed as first operand to the min and max instructions so that NaN ordinates are ignored, just
+ * like in the scalar code. Returns the number of values that were processed; the caller handles the remainder.
+ */
+#define GEOM_ENVELOPE_KERNEL(name, attributes, vector_t, width, regs, load, store, splat, vmin, vmax) \
+attributes static size_t name(const double *coords, size_t value_count, int dim, double *min, double *max) { \
+  const size_t block = (width) * (regs); \
+  size_t count = value_count - value_count % block; \
+  vector_t vec_min[regs]; \
+  vector_t vec_max[regs]; \
+  double lane_min[(width) * (regs)]; \
+  double lane_max[(width) * (regs)]; \
+\
+  if (count == 0) { \
+    return 0; \
+  } \
+\
+  for (int r = 0; r < (regs); r++) { \
+    vec_min[r] = splat(DBL_MAX); \
+    vec_max[r] = splat(-DBL_MAX); \
+  } \
+  for (size_t i = 0; i < count; i += block) { \
+    for (int r = 0; r < (regs); r++) { \
+      vector_t v = load(coords + i + r * (width)); \
+      vec_min[r] = vmin(v, vec_min[r]); \
+      vec_max[r] = vmax(v, vec_max[r]); \
+    } \
+  } \
+  for (int r = 0; r < (regs); r++) { \
+    store(lane_min + r * (width), vec_min[r]); \
+    store(lane_max + r * (width), vec_max[r]); \
+  } \
+  for (size_t i = 0; i < block; i++) { \
+    if (lane_min[i] < min[i % dim]) min[i % dim] = lane_min[i]; \
+    if (lane_max[i] > max[i % dim]) max[i % dim] = lane_max[i]; \
+  } \
+  return count; \
+}
+
+#if defined(GEOM_ENVELOPE_SSE2)
+GEOM_ENVELOPE_KERNEL(geom_envelope_sse2_2, , __m128d, 2, 2, _mm_loadu_pd, _mm_storeu_pd, _mm_set1_pd, _mm_min_pd, _mm_max_pd)
+GEOM_ENVELOPE_KERNEL(geom_envelope_sse2_3, , __m128d, 2, 3, _mm_loadu_pd, _mm_storeu_pd, _mm_set1_pd, _mm_min_pd, _mm_max_pd)
+#endif
+
+#if defined(GEOM_ENVELOPE_AVX)
+GEOM_ENVELOPE_KERNEL(geom_envelope_avx_2, __attribute__((target("avx"))), __m256d, 4, 2, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd, _mm256_min_pd, _mm256_max_pd)
+GEOM_ENVELOPE_KERNEL(geom_envelope_avx_3, __attribute__((target("avx"))), __m256d, 4, 3, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd, _mm256_min_pd, _mm256_max_pd)
+#endif
+
+#if defined(GEOM_ENVELOPE_NEON)
+GEOM_ENVELOPE_KERNEL(geom_envelope_neon_2, , float64x2_t, 2, 2, vld1q_f64, vst1q_f64, vdupq_n_f64, vminnmq_f64, vmaxnmq_f64)
+GEOM_ENVELOPE_KERNEL(geom_envelope_neon_3, , float64x2_t, 2, 3, vld1q_f64, vst1q_f64, vdupq_n_f64, vminnmq_f64, vmaxnmq_f64)
+#endif
+
+#undef GEOM_ENVELOPE_KERNEL
+
+static size_t geom_envelope_fill_vector(const double *coords, size_t value_count, int dim, double *min, double *max) {
+#if defined(GEOM_ENVELOPE_AVX)
+  if (__builtin_cpu_supports("avx")) {
+    return dim == 3 ? geom_envelope_avx_3(coords, value_count, dim, min, max) : geom_envelope_avx_2(coords, value_count, dim, min, max);
+  }
+#endif
+#if defined(GEOM_ENVELOPE_SSE2)
+  return dim == 3 ? geom_envelope_sse2_3(coords, value_count, dim, min, max) : geom_envelope_sse2_2(coords, value_count, dim, min, max);
+#elif defined(GEOM_ENVELOPE_NEON)
+  return dim == 3 ? geom_envelope_neon_3(coords, value_count, dim, min, max) : geom_envelope_neon_2(coords, value_count, dim, min, max);
+#else
+  return 0;
+#endif
+}
+
 static void geom_envelope_fill_simple(geom_envelope_t *envelope, const geom_header_t *header, size_t point_count, const double *coords) {
-#define MIN_MAX(coord) double coord = coords[offset++]; \
-        if (coord < envelope->min_##coord) envelope->min_##coord = coord; \
-        if (coord > envelope->max_##coord) envelope->max_##coord = coord;
+  double *env_min[4] = {&envelope->min_x, &envelope->min_y, &envelope->min_z, &envelope->min_m};
+  double *env_max[4] = {&envelope->max_x, &envelope->max_y, &envelope->max_z, &envelope->max_m};
+  double min[4];
+  double max[4];
+  int dim = geom_coord_dim(header->coord_type);
+  size_t value_count = point_count * dim;
+
+  if (header->coord_type == GEOM_XYM) {
+    env_min[2] = &envelope->min_m;
+    env_max[2] = &envelope->max_m;
+  }
 
-  int offset = 0;
-  switch (header->coord_type) {
-    case GEOM_XY:
-      for (size_t i = 0; i < point_count; i++) {
-        MIN_MAX(x)
-        MIN_MAX(y)
-      }
-      break;
-    case GEOM_XYZ:
-      for (size_t i = 0; i < point_count; i++) {
-        MIN_MAX(x)
-        MIN_MAX(y)
-        MIN_MAX(z)
-      }
-      break;
-    case GEOM_XYM:
-      for (size_t i = 0; i < point_count; i++) {
-        MIN_MAX(x)
-        MIN_MAX(y)
-        MIN_MAX(m)
-      }
-      break;
-    default:
-      for (size_t i = 0; i < point_count; i++) {
-        MIN_MAX(x)
-        MIN_MAX(y)
-        MIN_MAX(z)
-        MIN_MAX(m)
-      }
+  for (int d = 0; d < dim; d++) {
+    min[d] = *env_min[d];
+    max[d] = *env_max[d];
   }
 
-#undef MIN_MAX
+  size_t i = geom_envelope_fill_vector(coords, value_count, dim, min, max);
+  for (; i < value_count; i += dim) {
+    for (int d = 0; d < dim; d++) {
+      min_max(coords[i + d], &min[d], &max[d]);
+    }
+  }
+
+  for (int d = 0; d < dim; d++) {
+    *env_min[d] = min[d];
+    *env_max[d] = max[d];
+  }
 }
 
 void geom_consumer_init(
@@ -680,3 +758,60 @@ void geom_envelope_fill(geom_envelope_t *envelope, const geom_header_t *header,
   }
 }
 
+int geom_envelope_write(const geom_envelope_t *envelope, const geom_consumer_t *consumer, errorstream_t *error) {
+  geom_header_t header;
+  geom_header_t ring_header;
+  double coords[10];
+  size_t point_count;
+  int result;
+
+  header.coord_type = GEOM_XY;
+  header.coord_size = 2;
+  coords[0] = envelope->min_x;
+  coords[1] = envelope->min_y;
+  if (envelope->min_x == envelope->max_x && envelope->min_y == envelope->max_y) {
+    header.geom_type = GEOM_POINT;
+    point_count = 1;
+  } else if (envelope->min_x == envelope->max_x || envelope->min_y == envelope->max_y) {
+    header.geom_type = GEOM_LINESTRING;
+    coords[2] = envelope->max_x;
+    coords[3] = envelope->max_y;
+    point_count = 2;
+  } else {
+    header.geom_type = GEOM_POLYGON;
+    coords[2] = envelope->max_x;
+    coords[3] = envelope->min_y;
+    coords[4] = envelope->max_x;
+    coords[5] = envelope->max_y;
+    coords[6] = envelope->min_x;
+    coords[7] = envelope->max_y;
+    coords[8] = envelope->min_x;
+    coords[9] = envelope->min_y;
+    point_count = 5;
+  }
+
+  result = consumer->begin(consumer, error);
+  if (result == SQLITE_OK) {
+    result = consumer->begin_geometry(consumer, &header, error);
+  }
+  if (result == SQLITE_OK && header.geom_type == GEOM_POLYGON) {
+    ring_header = header;
+    ring_header.geom_type = GEOM_LINEARRING;
+    result = consumer->begin_geometry(consumer, &ring_header, error);
+    if (result == SQLITE_OK) {
+      result = consumer->coordinates(consumer, &ring_header, point_count, coords, 0, error);
+    }
+    if (result == SQLITE_OK) {
+      result = consumer->end_geometry(consumer, &ring_header, error);
+    }
+  } else if (result == SQLITE_OK) {
+    result = consumer->coordinates(consumer, &header, point_count, coords, 0, error);
+  }
+  if (result == SQLITE_OK) {
+    result = consumer->end_geometry(consumer, &header, error);
+  }
+  if (result == SQLITE_OK) {
+    result = consumer->end(consumer, error);
+  }
+  return result;
+}
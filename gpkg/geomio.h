@@ -335,6 +335,16 @@ int geom_envelope_finalize(geom_envelope_t *envelope);
  */
 void geom_envelope_fill(geom_envelope_t *envelope, const geom_header_t *header, size_t point_count, const double *coords);
 
+/**
+ * Writes an envelope as an XY geometry. Like GEOS, degenerate envelopes are written as a point or a line string rather
+ * than as a polygon.
+ * @param envelope the envelope to write
+ * @param consumer the geometry consumer that receives the geometry
+ * @param error the error stream to write errors to
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+int geom_envelope_write(const geom_envelope_t *envelope, const geom_consumer_t *consumer, errorstream_t *error);
+
 /** @} */
 
 #endif
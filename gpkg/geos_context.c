@@ -1,7 +1,10 @@
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+#include "atomic_ops.h"
 #include "geos.h"
 #include "geos_context.h"
+#include "sql.h"
 #include "sqlite.h"
 #include "tls.h"
 
@@ -55,19 +58,39 @@ geos_handle_t * geom_geos_init(errorstream_t *error) {
   return geos;
 }
 #else
-geos_handle_t *geom_geos_init(char const *geos_lib, errorstream_t *error) {
-  GPKG_TLS_KEY_CREATE(last_geos_error);
+/*
+ * Libraries loaded by geom_geos_library_acquire(). The list is protected by geos_libraries_mutex.
+ */
+static geos_library_t *geos_libraries = NULL;
+static sqlite3_mutex *volatile geos_libraries_mutex = NULL;
+
+static int geom_geos_same_lib(geos_library_t *library, char const *geos_lib) {
+  if (library->geos_lib_path == NULL || geos_lib == NULL) {
+    return library->geos_lib_path == NULL && geos_lib == NULL;
+  } else {
+    return strcmp(library->geos_lib_path, geos_lib) == 0;
+  }
+}
 
-  geos_handle_t* handle = NULL;
+static geos_library_t *geom_geos_library_load(char const *geos_lib, errorstream_t *error) {
+  geos_library_t *library = NULL;
   void *lib = NULL;
 
-  handle = (geos_handle_t*)sqlite3_malloc(sizeof(geos_handle_t));
-  if (handle == NULL) {
-    error_append(error, "Could not allocate memory for GEOS handle");
+  library = (geos_library_t *)sqlite3_malloc(sizeof(geos_library_t));
+  if (library == NULL) {
+    error_append(error, "Could not allocate memory for GEOS library");
     goto error;
   }
 
-  memset(handle, 0, sizeof(geos_handle_t));
+  memset(library, 0, sizeof(geos_library_t));
+
+  if (geos_lib != NULL) {
+    library->geos_lib_path = sqlite3_mprintf("%s", geos_lib);
+    if (library->geos_lib_path == NULL) {
+      error_append(error, "Could not allocate memory for GEOS library");
+      goto error;
+    }
+  }
 
   lib = dynlib_open(geos_lib);
   if (lib == NULL) {
@@ -75,89 +98,88 @@ geos_handle_t *geom_geos_init(char const *geos_lib, errorstream_t *error) {
     goto error;
   }
 
-  handle->geos_lib = lib;
-  handle->api.initGEOS_r = (GEOSContextHandle_t (*)(GEOSMessageHandler,GEOSMessageHandler)) dynlib_sym(lib, "initGEOS_r");
-  handle->api.finishGEOS_r = (void (*)(GEOSContextHandle_t)) dynlib_sym(lib, "finishGEOS_r");
-  handle->api.GEOSversion = (const char * (*)()) dynlib_sym(lib, "GEOSversion");
-  handle->api.GEOSisClosed_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSisClosed_r");
-  handle->api.GEOSisEmpty_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSisEmpty_r");
-  handle->api.GEOSisSimple_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSisSimple_r");
-  handle->api.GEOSisRing_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSisRing_r");
-  handle->api.GEOSisValid_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSisValid_r");
-  handle->api.GEOSPreparedCovers_r = (int (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedCovers_r");
-  handle->api.GEOSPreparedCoveredBy_r = (int (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedCoveredBy_r");
-  handle->api.GEOSPreparedDisjoint_r = (int (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedDisjoint_r");
-  handle->api.GEOSPreparedIntersects_r = (int (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedIntersects_r");
-  handle->api.GEOSPreparedTouches_r = (int (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedTouches_r");
-  handle->api.GEOSPreparedCrosses_r = (int (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedCrosses_r");
-  handle->api.GEOSPreparedWithin_r = (int (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedWithin_r");
-  handle->api.GEOSPreparedContains_r = (int (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedContains_r");
-  handle->api.GEOSPreparedOverlaps_r = (int (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedOverlaps_r");
-  handle->api.GEOSEquals_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSEquals_r");
-  handle->api.GEOSArea_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*,double*)) dynlib_sym(lib, "GEOSArea_r");
-  handle->api.GEOSLength_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*,double*)) dynlib_sym(lib, "GEOSLength_r");
-  handle->api.GEOSDistance_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*,double*)) dynlib_sym(lib, "GEOSDistance_r");
-  handle->api.GEOSHausdorffDistance_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*,double*)) dynlib_sym(lib, "GEOSHausdorffDistance_r");
-  handle->api.GEOSBoundary_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSBoundary_r");
-  handle->api.GEOSConvexHull_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSConvexHull_r");
-  handle->api.GEOSEnvelope_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSEnvelope_r");
-  handle->api.GEOSGetCentroid_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGetCentroid_r");
-  handle->api.GEOSGeomGetNumPoints_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGeomGetNumPoints_r");
-  handle->api.GEOSGeomGetPointN_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,int)) dynlib_sym(lib, "GEOSGeomGetPointN_r");
-  handle->api.GEOSGeomGetStartPoint_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGeomGetStartPoint_r");
-  handle->api.GEOSGeomGetEndPoint_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGeomGetEndPoint_r");
-  handle->api.GEOSGetNumInteriorRings_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGetNumInteriorRings_r");
-  handle->api.GEOSGetInteriorRingN_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,int)) dynlib_sym(lib, "GEOSGetInteriorRingN_r");
-  handle->api.GEOSGetExteriorRing_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGetExteriorRing_r");
-  handle->api.GEOSGetNumGeometries_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGetNumGeometries_r");
-  handle->api.GEOSGetGeometryN_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,int)) dynlib_sym(lib, "GEOSGetGeometryN_r");
-  handle->api.GEOSDifference_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSDifference_r");
-  handle->api.GEOSSymDifference_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSSymDifference_r");
-  handle->api.GEOSIntersection_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSIntersection_r");
-  handle->api.GEOSUnion_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSUnion_r");
-  handle->api.GEOSBuffer_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,double,int)) dynlib_sym(lib, "GEOSBuffer_r");
-  handle->api.GEOSRelatePattern_r = (char (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*,const char *)) dynlib_sym(lib, "GEOSRelatePattern_r");
-  handle->api.GEOSGeomTypeId_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGeomTypeId_r");
-  handle->api.GEOSGetSRID_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGetSRID_r");
-  handle->api.GEOSSetSRID_r = (void (*)(GEOSContextHandle_t,const GEOSGeometry*,int)) dynlib_sym(lib, "GEOSSetSRID_r");
-  handle->api.GEOSGeom_createPoint_r = (GEOSGeometry* (*)(GEOSContextHandle_t,GEOSCoordSequence*)) dynlib_sym(lib, "GEOSGeom_createPoint_r");
-  handle->api.GEOSGeom_createEmptyPoint_r = (GEOSGeometry* (*)(GEOSContextHandle_t)) dynlib_sym(lib, "GEOSGeom_createEmptyPoint_r");
-  handle->api.GEOSGeom_createLinearRing_r = (GEOSGeometry* (*)(GEOSContextHandle_t,GEOSCoordSequence*)) dynlib_sym(lib, "GEOSGeom_createLinearRing_r");
-  handle->api.GEOSGeom_createLineString_r = (GEOSGeometry* (*)(GEOSContextHandle_t,GEOSCoordSequence*)) dynlib_sym(lib, "GEOSGeom_createLineString_r");
-  handle->api.GEOSGeom_createEmptyLineString_r = (GEOSGeometry* (*)(GEOSContextHandle_t)) dynlib_sym(lib, "GEOSGeom_createEmptyLineString_r");
-  handle->api.GEOSGeom_createEmptyPolygon_r = (GEOSGeometry* (*)(GEOSContextHandle_t)) dynlib_sym(lib, "GEOSGeom_createEmptyPolygon_r");
-  handle->api.GEOSGeom_createPolygon_r = (GEOSGeometry* (*)(GEOSContextHandle_t,GEOSGeometry*,GEOSGeometry**,unsigned int)) dynlib_sym(lib, "GEOSGeom_createPolygon_r");
-  handle->api.GEOSGeom_createCollection_r = (GEOSGeometry* (*)(GEOSContextHandle_t,int,GEOSGeometry**,unsigned int)) dynlib_sym(lib, "GEOSGeom_createCollection_r");
-  handle->api.GEOSGeom_createEmptyCollection_r = (GEOSGeometry* (*)(GEOSContextHandle_t,int)) dynlib_sym(lib, "GEOSGeom_createEmptyCollection_r");
-  handle->api.GEOSGeom_getCoordSeq_r = (const GEOSCoordSequence* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGeom_getCoordSeq_r");
-  handle->api.GEOSCoordSeq_create_r = (GEOSCoordSequence* (*)(GEOSContextHandle_t,unsigned int,unsigned int)) dynlib_sym(lib, "GEOSCoordSeq_create_r");
-  handle->api.GEOSCoordSeq_getSize_r = (int (*)(GEOSContextHandle_t,const GEOSCoordSequence*,unsigned int *)) dynlib_sym(lib, "GEOSCoordSeq_getSize_r");
-  handle->api.GEOSCoordSeq_getX_r = (int (*)(GEOSContextHandle_t,const GEOSCoordSequence*,unsigned int,double*)) dynlib_sym(lib, "GEOSCoordSeq_getX_r");
-  handle->api.GEOSCoordSeq_getY_r = (int (*)(GEOSContextHandle_t,const GEOSCoordSequence*,unsigned int,double*)) dynlib_sym(lib, "GEOSCoordSeq_getY_r");
-  handle->api.GEOSCoordSeq_setX_r = (int (*)(GEOSContextHandle_t,GEOSCoordSequence*,unsigned int,double)) dynlib_sym(lib, "GEOSCoordSeq_setX_r");
-  handle->api.GEOSCoordSeq_setY_r = (int (*)(GEOSContextHandle_t,GEOSCoordSequence*,unsigned int,double)) dynlib_sym(lib, "GEOSCoordSeq_setY_r");
-  handle->api.GEOSPrepare_r = (GEOSPreparedGeometry const *(*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPrepare_r");
-  handle->api.GEOSPreparedGeom_destroy_r = (void (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*)) dynlib_sym(lib, "GEOSPreparedGeom_destroy_r");
-  handle->api.GEOSGeom_destroy_r = (void (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGeom_destroy_r");
-
-  // Only init GEOS if the bare minimum set of functions is available to
-  // initialize, cleanup and determine the version number.
-  if (handle->api.initGEOS_r && handle->api.finishGEOS_r && handle->api.GEOSversion) {
-    handle->context = handle->api.initGEOS_r(geom_null_msg_handler, geom_tls_msg_handler);
+  library->geos_lib = lib;
+  library->api.initGEOS_r = (GEOSContextHandle_t (*)(GEOSMessageHandler,GEOSMessageHandler)) dynlib_sym(lib, "initGEOS_r");
+  library->api.finishGEOS_r = (void (*)(GEOSContextHandle_t)) dynlib_sym(lib, "finishGEOS_r");
+  library->api.GEOSversion = (const char * (*)()) dynlib_sym(lib, "GEOSversion");
+  library->api.GEOSisClosed_r = (char (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSisClosed_r");
+  library->api.GEOSisEmpty_r = (char (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSisEmpty_r");
+  library->api.GEOSisSimple_r = (char (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSisSimple_r");
+  library->api.GEOSisRing_r = (char (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSisRing_r");
+  library->api.GEOSisValid_r = (char (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSisValid_r");
+  library->api.GEOSPreparedCovers_r = (char (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedCovers_r");
+  library->api.GEOSPreparedCoveredBy_r = (char (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedCoveredBy_r");
+  library->api.GEOSPreparedDisjoint_r = (char (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedDisjoint_r");
+  library->api.GEOSPreparedIntersects_r = (char (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedIntersects_r");
+  library->api.GEOSPreparedTouches_r = (char (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedTouches_r");
+  library->api.GEOSPreparedCrosses_r = (char (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedCrosses_r");
+  library->api.GEOSPreparedWithin_r = (char (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedWithin_r");
+  library->api.GEOSPreparedContains_r = (char (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedContains_r");
+  library->api.GEOSPreparedOverlaps_r = (char (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPreparedOverlaps_r");
+  library->api.GEOSEquals_r = (char (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSEquals_r");
+  library->api.GEOSArea_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*,double*)) dynlib_sym(lib, "GEOSArea_r");
+  library->api.GEOSLength_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*,double*)) dynlib_sym(lib, "GEOSLength_r");
+  library->api.GEOSDistance_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*,double*)) dynlib_sym(lib, "GEOSDistance_r");
+  library->api.GEOSHausdorffDistance_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*,double*)) dynlib_sym(lib, "GEOSHausdorffDistance_r");
+  library->api.GEOSBoundary_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSBoundary_r");
+  library->api.GEOSConvexHull_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSConvexHull_r");
+  library->api.GEOSEnvelope_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSEnvelope_r");
+  library->api.GEOSGetCentroid_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGetCentroid_r");
+  library->api.GEOSGeomGetNumPoints_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGeomGetNumPoints_r");
+  library->api.GEOSGeomGetPointN_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,int)) dynlib_sym(lib, "GEOSGeomGetPointN_r");
+  library->api.GEOSGeomGetStartPoint_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGeomGetStartPoint_r");
+  library->api.GEOSGeomGetEndPoint_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGeomGetEndPoint_r");
+  library->api.GEOSGetNumInteriorRings_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGetNumInteriorRings_r");
+  library->api.GEOSGetInteriorRingN_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,int)) dynlib_sym(lib, "GEOSGetInteriorRingN_r");
+  library->api.GEOSGetExteriorRing_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGetExteriorRing_r");
+  library->api.GEOSGetNumGeometries_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGetNumGeometries_r");
+  library->api.GEOSGetGeometryN_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,int)) dynlib_sym(lib, "GEOSGetGeometryN_r");
+  library->api.GEOSDifference_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSDifference_r");
+  library->api.GEOSSymDifference_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSSymDifference_r");
+  library->api.GEOSIntersection_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSIntersection_r");
+  library->api.GEOSUnion_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*)) dynlib_sym(lib, "GEOSUnion_r");
+  library->api.GEOSUnaryUnion_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSUnaryUnion_r");
+  library->api.GEOSBuffer_r = (GEOSGeometry* (*)(GEOSContextHandle_t,const GEOSGeometry*,double,int)) dynlib_sym(lib, "GEOSBuffer_r");
+  library->api.GEOSRelatePattern_r = (char (*)(GEOSContextHandle_t,const GEOSGeometry*,const GEOSGeometry*,const char *)) dynlib_sym(lib, "GEOSRelatePattern_r");
+  library->api.GEOSGeomTypeId_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGeomTypeId_r");
+  library->api.GEOSGetSRID_r = (int (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGetSRID_r");
+  library->api.GEOSSetSRID_r = (void (*)(GEOSContextHandle_t,const GEOSGeometry*,int)) dynlib_sym(lib, "GEOSSetSRID_r");
+  library->api.GEOSGeom_createPoint_r = (GEOSGeometry* (*)(GEOSContextHandle_t,GEOSCoordSequence*)) dynlib_sym(lib, "GEOSGeom_createPoint_r");
+  library->api.GEOSGeom_createEmptyPoint_r = (GEOSGeometry* (*)(GEOSContextHandle_t)) dynlib_sym(lib, "GEOSGeom_createEmptyPoint_r");
+  library->api.GEOSGeom_createLinearRing_r = (GEOSGeometry* (*)(GEOSContextHandle_t,GEOSCoordSequence*)) dynlib_sym(lib, "GEOSGeom_createLinearRing_r");
+  library->api.GEOSGeom_createLineString_r = (GEOSGeometry* (*)(GEOSContextHandle_t,GEOSCoordSequence*)) dynlib_sym(lib, "GEOSGeom_createLineString_r");
+  library->api.GEOSGeom_createEmptyLineString_r = (GEOSGeometry* (*)(GEOSContextHandle_t)) dynlib_sym(lib, "GEOSGeom_createEmptyLineString_r");
+  library->api.GEOSGeom_createEmptyPolygon_r = (GEOSGeometry* (*)(GEOSContextHandle_t)) dynlib_sym(lib, "GEOSGeom_createEmptyPolygon_r");
+  library->api.GEOSGeom_createPolygon_r = (GEOSGeometry* (*)(GEOSContextHandle_t,GEOSGeometry*,GEOSGeometry**,unsigned int)) dynlib_sym(lib, "GEOSGeom_createPolygon_r");
+  library->api.GEOSGeom_createCollection_r = (GEOSGeometry* (*)(GEOSContextHandle_t,int,GEOSGeometry**,unsigned int)) dynlib_sym(lib, "GEOSGeom_createCollection_r");
+  library->api.GEOSGeom_createEmptyCollection_r = (GEOSGeometry* (*)(GEOSContextHandle_t,int)) dynlib_sym(lib, "GEOSGeom_createEmptyCollection_r");
+  library->api.GEOSGeom_getCoordSeq_r = (const GEOSCoordSequence* (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGeom_getCoordSeq_r");
+  library->api.GEOSCoordSeq_create_r = (GEOSCoordSequence* (*)(GEOSContextHandle_t,unsigned int,unsigned int)) dynlib_sym(lib, "GEOSCoordSeq_create_r");
+  library->api.GEOSCoordSeq_getSize_r = (int (*)(GEOSContextHandle_t,const GEOSCoordSequence*,unsigned int *)) dynlib_sym(lib, "GEOSCoordSeq_getSize_r");
+  library->api.GEOSCoordSeq_getX_r = (int (*)(GEOSContextHandle_t,const GEOSCoordSequence*,unsigned int,double*)) dynlib_sym(lib, "GEOSCoordSeq_getX_r");
+  library->api.GEOSCoordSeq_getY_r = (int (*)(GEOSContextHandle_t,const GEOSCoordSequence*,unsigned int,double*)) dynlib_sym(lib, "GEOSCoordSeq_getY_r");
+  library->api.GEOSCoordSeq_setX_r = (int (*)(GEOSContextHandle_t,GEOSCoordSequence*,unsigned int,double)) dynlib_sym(lib, "GEOSCoordSeq_setX_r");
+  library->api.GEOSCoordSeq_setY_r = (int (*)(GEOSContextHandle_t,GEOSCoordSequence*,unsigned int,double)) dynlib_sym(lib, "GEOSCoordSeq_setY_r");
+  library->api.GEOSCoordSeq_copyFromBuffer_r = (GEOSCoordSequence* (*)(GEOSContextHandle_t,const double*,unsigned int,int,int)) dynlib_sym(lib, "GEOSCoordSeq_copyFromBuffer_r");
+  library->api.GEOSCoordSeq_copyToBuffer_r = (int (*)(GEOSContextHandle_t,const GEOSCoordSequence*,double*,int,int)) dynlib_sym(lib, "GEOSCoordSeq_copyToBuffer_r");
+  library->api.GEOSPrepare_r = (GEOSPreparedGeometry const *(*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSPrepare_r");
+  library->api.GEOSPreparedGeom_destroy_r = (void (*)(GEOSContextHandle_t,const GEOSPreparedGeometry*)) dynlib_sym(lib, "GEOSPreparedGeom_destroy_r");
+  library->api.GEOSGeom_destroy_r = (void (*)(GEOSContextHandle_t,const GEOSGeometry*)) dynlib_sym(lib, "GEOSGeom_destroy_r");
 
-    if (handle->context != NULL) {
-      return handle;
-    } else {
-      error_append(error, "GEOS initialization failed");
-    }
+  // Only use the library if the bare minimum set of functions is available to
+  // initialize, cleanup and determine the version number.
+  if (library->api.initGEOS_r && library->api.finishGEOS_r && library->api.GEOSversion) {
+    library->ref_count = 1;
+    return library;
   } else {
     error_append(error, "Could not load symbols 'initGEOS_r', 'finishGEOS_r' and/or 'GEOSversion' from '%s'", geos_lib);
   }
 
   error:
 
-  if (handle != NULL) {
-    sqlite3_free(handle);
+  if (library != NULL) {
+    sqlite3_free(library->geos_lib_path);
+    sqlite3_free(library);
   }
 
   if (lib != NULL) {
@@ -166,6 +188,92 @@ geos_handle_t *geom_geos_init(char const *geos_lib, errorstream_t *error) {
 
   return NULL;
 }
+
+/*
+ * Returns the process wide library for the given path, loading it and resolving its symbols the first time it is
+ * requested. The returned library must be released using geom_geos_library_release().
+ */
+static geos_library_t *geom_geos_library_acquire(char const *geos_lib, errorstream_t *error) {
+  sqlite3_mutex *mutex = sql_mutex_once(&geos_libraries_mutex);
+  geos_library_t *library;
+
+  sqlite3_mutex_enter(mutex);
+  for (library = geos_libraries; library != NULL; library = library->next) {
+    if (geom_geos_same_lib(library, geos_lib)) {
+      library->ref_count++;
+      break;
+    }
+  }
+
+  if (library == NULL) {
+    library = geom_geos_library_load(geos_lib, error);
+    if (library != NULL) {
+      library->next = geos_libraries;
+      geos_libraries = library;
+    }
+  }
+  sqlite3_mutex_leave(mutex);
+
+  return library;
+}
+
+static void geom_geos_library_release(geos_library_t *library) {
+  sqlite3_mutex *mutex = sql_mutex_once(&geos_libraries_mutex);
+  int unload = 0;
+
+  sqlite3_mutex_enter(mutex);
+  if (--library->ref_count == 0) {
+    geos_library_t **prev = &geos_libraries;
+    while (*prev != library) {
+      prev = &(*prev)->next;
+    }
+    *prev = library->next;
+    unload = 1;
+  }
+  sqlite3_mutex_leave(mutex);
+
+  if (unload) {
+    dynlib_close(library->geos_lib);
+    sqlite3_free(library->geos_lib_path);
+    sqlite3_free(library);
+  }
+}
+
+/*
+ * Creates a GEOS handle for an acquired library. Ownership of the library reference is passed to the handle, even if
+ * the handle could not be created.
+ */
+static geos_handle_t *geom_geos_create(geos_library_t *library, errorstream_t *error) {
+  geos_handle_t *handle = (geos_handle_t*)sqlite3_malloc(sizeof(geos_handle_t));
+  if (handle == NULL) {
+    error_append(error, "Could not allocate memory for GEOS handle");
+    geom_geos_library_release(library);
+    return NULL;
+  }
+
+  handle->api = &library->api;
+  handle->library = library;
+  handle->context = library->api.initGEOS_r(geom_null_msg_handler, geom_tls_msg_handler);
+  if (handle->context == NULL) {
+    error_append(error, "GEOS initialization failed");
+    sqlite3_free(handle);
+    geom_geos_library_release(library);
+    return NULL;
+  }
+
+  return handle;
+}
+
+geos_handle_t *geom_geos_init(char const *geos_lib, errorstream_t *error) {
+  GPKG_TLS_KEY_CREATE(last_geos_error);
+
+  geos_library_t *library = geom_geos_library_acquire(geos_lib, error);
+  if (library == NULL) {
+    return NULL;
+  }
+
+  return geom_geos_create(library, error);
+}
 #endif
 
 void geom_geos_destroy(geos_handle_t *geos) {
@@ -179,9 +287,92 @@ void geom_geos_destroy(geos_handle_t *geos) {
 
 #else
 
-  geos->api.finishGEOS_r(geos->context);
-  dynlib_close(geos->geos_lib);
+  geos->api->finishGEOS_r(geos->context);
+  geom_geos_library_release(geos->library);
   sqlite3_free(geos);
 
 #endif
 }
+
+/*
+ * Idle GEOS handles. A slot is claimed by swapping its handle for NULL and refilled by swapping NULL for a handle, so
+ * a handle is never owned by more than one thread at a time and the pool never needs a lock.
+ */
+static void *volatile geos_handle_pool[GEOS_HANDLE_POOL_SIZE];
+
+static geos_handle_t *geom_geos_pool_take() {
+  for (int i = 0; i < GEOS_HANDLE_POOL_SIZE; i++) {
+    void *handle = geos_handle_pool[i];
+    if (handle != NULL && atomic_cas_pointer(&geos_handle_pool[i], handle, NULL)) {
+      return (geos_handle_t *) handle;
+    }
+  }
+  return NULL;
+}
+
+static int geom_geos_pool_put(geos_handle_t *geos) {
+  for (int i = 0; i < GEOS_HANDLE_POOL_SIZE; i++) {
+    if (geos_handle_pool[i] == NULL && atomic_cas_pointer(&geos_handle_pool[i], NULL, geos)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+#if GPKG_GEOM_FUNC == GPKG_GEOS
+geos_handle_t *geom_geos_acquire(errorstream_t *error) {
+  geos_handle_t *geos = geom_geos_pool_take();
+  if (geos != NULL) {
+    return geos;
+  }
+  return geom_geos_init(error);
+}
+#else
+geos_handle_t *geom_geos_acquire(char const *geos_lib, errorstream_t *error) {
+  geos_handle_t *mismatched[GEOS_HANDLE_POOL_SIZE];
+  int mismatched_count = 0;
+  geos_handle_t *geos = NULL;
+
+  GPKG_TLS_KEY_CREATE(last_geos_error);
+
+  geos_library_t *library = geom_geos_library_acquire(geos_lib, error);
+  if (library == NULL) {
+    return NULL;
+  }
+
+  // Handles are only inspected once they have been taken out of the pool. Handles for other libraries are put back
+  // after the search so that the same handle is not examined twice.
+  while (mismatched_count < GEOS_HANDLE_POOL_SIZE) {
+    geos_handle_t *candidate = geom_geos_pool_take();
+    if (candidate == NULL) {
+      break;
+    } else if (candidate->library == library) {
+      geos = candidate;
+      break;
+    } else {
+      mismatched[mismatched_count++] = candidate;
+    }
+  }
+
+  for (int i = 0; i < mismatched_count; i++) {
+    geom_geos_release(mismatched[i]);
+  }
+
+  if (geos != NULL) {
+    // The pooled handle already holds a reference to the library
+    geom_geos_library_release(library);
+    return geos;
+  }
+  return geom_geos_create(library, error);
+}
+#endif
+
+void geom_geos_release(geos_handle_t *geos) {
+  if (geos == NULL) {
+    return;
+  }
+
+  if (!geom_geos_pool_put(geos)) {
+    geom_geos_destroy(geos);
+  }
+}
@@ -16,4 +16,25 @@ geos_handle_t *geom_geos_init(char const *geos_lib, errorstream_t *error);
 
 void geom_geos_destroy(geos_handle_t * geos);
 
+/**
+ * The maximum number of idle GEOS handles retained by the process wide handle pool.
+ */
+#define GEOS_HANDLE_POOL_SIZE 16
+
+/**
+ * Obtains a GEOS handle for exclusive use by the caller. An idle handle from the process wide pool is reused when one
+ * is available; otherwise a new handle is initialized. The returned handle must be returned using geom_geos_release().
+ */
+#if GPKG_GEOM_FUNC == GPKG_GEOS
+geos_handle_t *geom_geos_acquire(errorstream_t *error);
+#else
+geos_handle_t *geom_geos_acquire(char const *geos_lib, errorstream_t *error);
+#endif
+
+/**
+ * Returns a GEOS handle obtained using geom_geos_acquire() to the handle pool. The handle is destroyed if the pool is
+ * full. The caller must not use the handle, or any geometry created with it, afterwards.
+ */
+void geom_geos_release(geos_handle_t *geos);
+
 #endif
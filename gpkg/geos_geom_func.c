@@ -13,15 +13,33 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "atomic_ops.h"
 #include "geos_context.h"
 #include "geos_geom_io.h"
 #include "geom_func.h"
+#include "pip_index.h"
 #include "spatialdb_internal.h"
 #include "sql.h"
 #include "geos.h"
 
+#if defined(_WIN32) || defined(WIN32) || defined(__MINGW32__)
+#define UNION_WINDOWS
+#include <Windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+
+/*
+ * A GEOS handle must never be used by two threads at the same time. Each connection therefore gets its own context,
+ * holding a handle that is borrowed exclusively from the process wide handle pool until the last function using it is
+ * unregistered. When GEOS is linked directly the handle is only borrowed once a GEOS function is first used, so
+ * connections that never call GEOS functions do not pay for it.
+ */
 typedef struct {
   volatile long ref_count;
   geos_handle_t *geos_handle;
@@ -40,15 +58,16 @@ static geos_context_t *geos_context_init(spatialdb_t *spatialdb, char const *geo
   }
 
 #if GPKG_GEOM_FUNC == GPKG_GEOS
-  geos_handle_t *geos_handle = geom_geos_init(error);
+  // The handle is acquired when the first geometry is converted
+  geos_handle_t *geos_handle = NULL;
 #else
-  geos_handle_t *geos_handle = geom_geos_init(geos_lib, error);
-#endif
+  geos_handle_t *geos_handle = geom_geos_acquire(geos_lib, error);
 
   if (geos_handle == NULL) {
     sqlite3_free(ctx);
     return NULL;
   }
+#endif
 
   ctx->ref_count = 1;
   ctx->geos_handle = geos_handle;
@@ -56,6 +75,15 @@ static geos_context_t *geos_context_init(spatialdb_t *spatialdb, char const *geo
   return ctx;
 }
 
+static geos_handle_t *geos_context_handle(geos_context_t *ctx, errorstream_t *error) {
+#if GPKG_GEOM_FUNC == GPKG_GEOS
+  if (ctx->geos_handle == NULL) {
+    ctx->geos_handle = geom_geos_acquire(error);
+  }
+#endif
+  return ctx->geos_handle;
+}
+
 static void geos_context_acquire(geos_context_t *ctx) {
   if (ctx) {
     atomic_inc_long(&ctx->ref_count);
@@ -66,128 +94,107 @@ static void geos_context_release(geos_context_t *ctx) {
   if (ctx) {
     long newval = atomic_dec_long(&ctx->ref_count);
     if (newval == 0) {
-      geom_geos_destroy(ctx->geos_handle);
+      geom_geos_release(ctx->geos_handle);
       ctx->geos_handle = NULL;
       sqlite3_free(ctx);
     }
   }
 }
 
+/*
+ * A geometry argument as kept in the auxiliary data of a function. The GEOS geometry is NULL if the argument has so
+ * far only been used by the native point in polygon test, which only needs the edge index.
+ */
 typedef struct {
   GEOSGeometry* geometry;
+  const GEOSPreparedGeometry* prepared;
+  pip_index_t *pip_index;
   geos_handle_t *context;
   int srid;
 } geos_geometry_t;
 
-static geos_geometry_t *get_geos_geom(sqlite3_context *context, const geos_context_t *geos_context, sqlite3_value *value, errorstream_t *error) {
+static int read_geos_geom(geos_context_t *geos_context, sqlite3_value *value, geos_geometry_t *geom, errorstream_t *error) {
   geom_blob_header_t header;
 
   uint8_t *blob = (uint8_t *)sqlite3_value_blob(value);
   size_t blob_length = (size_t) sqlite3_value_bytes(value);
 
   if (blob == NULL) {
-    return NULL;
+    return SQLITE_ERROR;
+  }
+  STATS_BYTES(blob_length);
+
+  if (geos_context_handle(geos_context, error) == NULL) {
+    return SQLITE_ERROR;
   }
 
   binstream_t stream;
   binstream_init(&stream, blob, blob_length);
 
+  if (geos_context->spatialdb->read_blob_header(&stream, &header, error) != SQLITE_OK) {
+    return SQLITE_ERROR;
+  }
+
   geos_writer_t writer;
   geos_writer_init_srid(&writer, geos_context->geos_handle, header.srid);
-
-  geos_context->spatialdb->read_blob_header(&stream, &header, error);
   geos_context->spatialdb->read_geometry(&stream, geos_writer_geom_consumer(&writer), error);
 
   GEOSGeometry *g = geos_writer_getgeometry(&writer);
   geos_writer_destroy(&writer, g == NULL);
 
   if (g == NULL) {
-    return NULL;
-  }
-
-  geos_geometry_t *result = sqlite3_malloc(sizeof(geos_geometry_t));
-  if (result == NULL) {
-    return NULL;
+    return SQLITE_ERROR;
   }
 
-  result->context = geos_context->geos_handle;
-  result->geometry = g;
-  result->srid = header.srid;
-
-  return result;
+  geom->context = geos_context->geos_handle;
+  geom->geometry = g;
+  geom->srid = header.srid;
+  return SQLITE_OK;
 }
 
-static void free_geos_geom(void* data) {
-  if (data == NULL) {
-    return;
-  }
-
-  geos_geometry_t* geom = (geos_geometry_t*)data;
-  GEOSGeom_destroy_r(geom->context, geom->geometry);
-
-  geom->context = NULL;
-  geom->geometry = NULL;
-
-  sqlite3_free(data);
-}
-
-typedef struct {
-  const GEOSPreparedGeometry* geometry;
-  geos_handle_t *context;
-  int srid;
-} geos_prepared_geometry_t;
-
-static geos_prepared_geometry_t *get_geos_prepared_geom(sqlite3_context *context, const geos_context_t *geos_context, sqlite3_value *value, errorstream_t *error) {
-  geom_blob_header_t header;
-
-  uint8_t *blob = (uint8_t *)sqlite3_value_blob(value);
-  size_t blob_length = (size_t) sqlite3_value_bytes(value);
-
-  if (blob == NULL) {
+static geos_geometry_t *get_geos_geom(sqlite3_context *context, geos_context_t *geos_context, sqlite3_value *value, errorstream_t *error) {
+  if (sqlite3_value_blob(value) == NULL) {
     return NULL;
   }
 
-  binstream_t stream;
-  binstream_init(&stream, blob, blob_length);
-
-  geos_writer_t writer;
-  geos_writer_init_srid(&writer, geos_context->geos_handle, header.srid);
-
-  geos_context->spatialdb->read_blob_header(&stream, &header, error);
-  geos_context->spatialdb->read_geometry(&stream, geos_writer_geom_consumer(&writer), error);
-
-  GEOSGeometry *g = geos_writer_getgeometry(&writer);
-  geos_writer_destroy(&writer, g == NULL);
-
-  if (g == NULL) {
-    return NULL;
-  }
-
-  struct GEOSPrepGeom_t const *prepared_g = GEOSPrepare_r(geos_context->geos_handle, g);
-  if (prepared_g == NULL) {
+  geos_geometry_t *result = sqlite3_malloc(sizeof(geos_geometry_t));
+  if (result == NULL) {
     return NULL;
   }
+  memset(result, 0, sizeof(geos_geometry_t));
 
-  geos_prepared_geometry_t *result = sqlite3_malloc(sizeof(geos_prepared_geometry_t));
-  if (result == NULL) {
-    GEOSPreparedGeom_destroy_r(geos_context->geos_handle, prepared_g);
+  if (read_geos_geom(geos_context, value, result, error) != SQLITE_OK) {
+    sqlite3_free(result);
     return NULL;
   }
 
-  result->context = geos_context->geos_handle;
-  result->geometry = prepared_g;
-  result->srid = header.srid;
-
   return result;
 }
 
-static void free_geos_prepared_geom(void* data) {
+/*
+ * Returns the prepared form of a geometry, preparing it on first use. The prepared geometry is owned by the geometry
+ * and is reused for as long as the geometry is kept as auxiliary data.
+ */
+static const GEOSPreparedGeometry *get_geos_prepared_geom(geos_geometry_t *geom) {
+  if (geom->prepared == NULL) {
+    geom->prepared = GEOSPrepare_r(geom->context, geom->geometry);
+  }
+  return geom->prepared;
+}
+
+static void free_geos_geom(void* data) {
   if (data == NULL) {
     return;
   }
 
-  geos_prepared_geometry_t* geom = (geos_prepared_geometry_t*)data;
-  GEOSPreparedGeom_destroy_r(geom->context, geom->geometry);
+  geos_geometry_t* geom = (geos_geometry_t*)data;
+  if (geom->prepared != NULL) {
+    GEOSPreparedGeom_destroy_r(geom->context, geom->prepared);
+  }
+  if (geom->geometry != NULL) {
+    GEOSGeom_destroy_r(geom->context, geom->geometry);
+  }
+  pip_index_free(geom->pip_index);
 
   geom->context = NULL;
   geom->geometry = NULL;
@@ -219,38 +226,133 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
   }
 }
 
+/*
+ * Predicates between a point and a polygon or multipolygon are answered without GEOS whenever the location of the
+ * point can be determined reliably. The edge index of a constant polygon argument is kept in its auxiliary data;
+ * a polygon that is not known to be constant yet is tested while it is decoded. The outcome of a predicate is given
+ * as the set of point locations for which it holds, once for the polygon being the first and once for it being the
+ * second argument.
+ */
+#define PIP_HOLDS_INTERIOR (1 << PIP_INTERIOR)
+#define PIP_HOLDS_EXTERIOR (1 << PIP_EXTERIOR)
+
+static int pip_read_arg(const spatialdb_t *spatialdb, sqlite3_value *value, binstream_t *stream, geom_blob_header_t *header, geom_type_t *geom_type, errorstream_t *error) {
+  uint8_t *blob = (uint8_t *)sqlite3_value_blob(value);
+  size_t blob_length = (size_t) sqlite3_value_bytes(value);
+  geom_header_t geom_header;
+
+  if (blob == NULL) {
+    return SQLITE_ERROR;
+  }
+  STATS_BYTES(blob_length);
+
+  binstream_init(stream, blob, blob_length);
+  if (spatialdb->read_blob_header(stream, header, error) != SQLITE_OK) {
+    return SQLITE_ERROR;
+  }
+
+  size_t body = binstream_position(stream);
+  if (spatialdb->read_geometry_header(stream, &geom_header, error) != SQLITE_OK) {
+    return SQLITE_ERROR;
+  }
+  *geom_type = geom_header.geom_type;
+  return binstream_seek(stream, body);
+}
+
+/*
+ * Returns the value of a point/polygon predicate, or -1 if it has to be evaluated using GEOS. This includes all
+ * error cases, so that errors are reported the same way as for any other input.
+ */
+static int pip_predicate(sqlite3_context *context, geos_context_t *geos_context, sqlite3_value **args, int polygon_first, int polygon_second) {
+  const spatialdb_t *spatialdb = geos_context->spatialdb;
+  char error_buffer[256];
+  errorstream_t error;
+  binstream_t stream[2];
+  geom_blob_header_t header[2];
+  geom_type_t geom_type[2];
+  int point, polygon, holds;
+
+  error_init_fixed(&error, error_buffer, 256);
+  for (int i = 0; i < 2; i++) {
+    if (pip_read_arg(spatialdb, args[i], &stream[i], &header[i], &geom_type[i], &error) != SQLITE_OK) {
+      return -1;
+    }
+  }
+
+  if (geom_type[0] == GEOM_POINT && (geom_type[1] == GEOM_POLYGON || geom_type[1] == GEOM_MULTIPOLYGON)) {
+    point = 0;
+    polygon = 1;
+    holds = polygon_second;
+  } else if (geom_type[1] == GEOM_POINT && (geom_type[0] == GEOM_POLYGON || geom_type[0] == GEOM_MULTIPOLYGON)) {
+    point = 1;
+    polygon = 0;
+    holds = polygon_first;
+  } else {
+    return -1;
+  }
+
+  if (header[0].srid != header[1].srid) {
+    return -1;
+  }
+
+  double x, y;
+  int empty;
+  if (pip_read_point(spatialdb, &stream[point], &x, &y, &empty, &error) != SQLITE_OK || empty) {
+    return -1;
+  }
+
+  int location;
+  geos_geometry_t *cached = sqlite3_get_auxdata(context, polygon);
+  if (cached != NULL) {
+    if (cached->pip_index == NULL && pip_index_build(spatialdb, &stream[polygon], &cached->pip_index, &error) != SQLITE_OK) {
+      return -1;
+    }
+    location = pip_index_locate(cached->pip_index, x, y);
+  } else {
+    if (pip_locate(spatialdb, &stream[polygon], x, y, &location, &error) != SQLITE_OK) {
+      return -1;
+    }
+    if (location != PIP_UNKNOWN) {
+      // SQLite only keeps this if the polygon is constant, in which case it is indexed on the next call
+      cached = sqlite3_malloc(sizeof(geos_geometry_t));
+      if (cached != NULL) {
+        memset(cached, 0, sizeof(geos_geometry_t));
+        cached->srid = header[polygon].srid;
+        sqlite3_set_auxdata(context, polygon, cached, free_geos_geom);
+      }
+    }
+  }
+
+  if (location == PIP_UNKNOWN) {
+    return -1;
+  }
+  return (holds & (1 << location)) != 0;
+}
+
 #define GEOS_START(context) \
-  const geos_context_t *geos_context = (const geos_context_t *)sqlite3_user_data(context); \
+  STATS_START(__func__);\
+  geos_context_t *geos_context = (geos_context_t *)sqlite3_user_data(context); \
   char error_buffer[256];\
   errorstream_t error;\
   error_init_fixed(&error, error_buffer, 256)
+#define GEOS_END STATS_END(error_count(&error) > 0)
 #define GEOS_CONTEXT geos_context
 #define GEOS_HANDLE geos_context->geos_handle
 
 #define GEOS_GET_GEOM(name, args, i) \
-  const geos_geometry_t *name = sqlite3_get_auxdata(context, i); \
+  geos_geometry_t *name = sqlite3_get_auxdata(context, i); \
   int name##_set_auxdata = 0; \
   if (name == NULL) { \
     name = get_geos_geom( context, geos_context, args[i], &error ); \
     name##_set_auxdata = 1;\
+  } else if (name->geometry == NULL && read_geos_geom( geos_context, args[i], name, &error ) != SQLITE_OK) { \
+    name = NULL; \
   }
 #define GEOS_FREE_GEOM(name, i) \
   if (name != NULL && name##_set_auxdata) { \
     sqlite3_set_auxdata(context, i, (void*)name, free_geos_geom); \
   }
 
-#define GEOS_GET_PREPARED_GEOM(name, args, i) \
-  const geos_prepared_geometry_t *name = sqlite3_get_auxdata(context, i); \
-  int name##_set_auxdata = 0; \
-  if (name == NULL) { \
-    name = get_geos_prepared_geom( context, geos_context, args[i], &error ); \
-    name##_set_auxdata = 1;\
-  }
-#define GEOS_FREE_PREPARED_GEOM(name, i) \
-  if (name != NULL && name##_set_auxdata) { \
-    sqlite3_set_auxdata(context, i, (void*)name, free_geos_prepared_geom); \
-  }
-
 #define GEOS_FUNC_GEOM__INTEGER_(sql_name, geos_name) static void ST_##sql_name(sqlite3_context *context, int nbArgs, sqlite3_value **args) {\
   GEOS_START(context);\
   GEOS_GET_GEOM( g1, args, 0 );\
@@ -260,6 +362,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
     } else {\
       sqlite3_result_null(context);\
     }\
+    GEOS_END;\
     return;\
   }\
   char result = GEOS##geos_name##_r(GEOS_HANDLE, g1->geometry );\
@@ -270,6 +373,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
     sqlite3_result_int(context, result);\
   }\
   GEOS_FREE_GEOM( g1, 0 );\
+  GEOS_END;\
 }
 
 #define GEOS_FUNC_GEOM_INTEGER__SUBGEOM_(sql_name, geos_name) static void ST_##sql_name(sqlite3_context *context, int nbArgs, sqlite3_value **args) {\
@@ -282,6 +386,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
     } else {\
       sqlite3_result_null(context);\
     }\
+    GEOS_END;\
     return;\
   }\
   const GEOSGeometry *result = GEOS##geos_name##_r(GEOS_HANDLE, g1->geometry, n);\
@@ -292,6 +397,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
     sqlite3_result_error(context, error_message(&error), -1);\
   }\
   GEOS_FREE_GEOM( g1, 0 );\
+  GEOS_END;\
 }
 
 #define GEOS_FUNC_GEOM_INTEGER__GEOM(name) GEOS_FUNC_GEOM__INTEGER_(name, name)
@@ -306,6 +412,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
     } else {\
       sqlite3_result_null(context);\
     }\
+    GEOS_END;\
     return;\
   }\
   int srid1 = g1->srid;\
@@ -313,6 +420,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
   if (srid1 != srid2 ) {\
     error_append(&error, "Cannot apply %s when SRIDs differ: %d != %d", #name, srid1, srid2);\
     sqlite3_result_error(context, error_message(&error), -1);\
+    GEOS_END;\
     return;\
   }\
   char result = GEOS##name##_r(GEOS_HANDLE, g1->geometry, g2->geometry);\
@@ -324,11 +432,24 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
   }\
   GEOS_FREE_GEOM( g1, 0 );\
   GEOS_FREE_GEOM( g2, 1 );\
+  GEOS_END;\
 }
 
-#define GEOS_FUNC_PREPGEOM_GEOM__INTEGER(name) static void ST_##name(sqlite3_context *context, int nbArgs, sqlite3_value **args) {\
+/*
+ * Predicates that are evaluated using a prepared geometry. SQLite only keeps auxiliary data for arguments that are
+ * constant for the statement, so an argument that was found in the auxiliary data is the constant one. If that is the
+ * second argument, it is prepared and the inverse predicate is evaluated. As long as neither argument is known to be
+ * constant, the first argument is prepared. Point/polygon pairs are tried natively first, see pip_predicate.
+ */
+#define GEOS_FUNC_PREPGEOM_GEOM__INTEGER(name, inverse, pip_polygon_first, pip_polygon_second) static void ST_##name(sqlite3_context *context, int nbArgs, sqlite3_value **args) {\
   GEOS_START(context);\
-  GEOS_GET_PREPARED_GEOM( g1, args, 0 );\
+  int pip_result = pip_predicate(context, GEOS_CONTEXT, args, pip_polygon_first, pip_polygon_second);\
+  if (pip_result >= 0) {\
+    sqlite3_result_int(context, pip_result);\
+    GEOS_END;\
+    return;\
+  }\
+  GEOS_GET_GEOM( g1, args, 0 );\
   GEOS_GET_GEOM( g2, args, 1 );\
   if (g1 == NULL || g2 == NULL) {\
     if (error_count(&error) > 0) {\
@@ -336,6 +457,9 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
     } else {\
       sqlite3_result_null(context);\
     }\
+    GEOS_FREE_GEOM( g1, 0 );\
+    GEOS_FREE_GEOM( g2, 1 );\
+    GEOS_END;\
     return;\
   }\
   int srid1 = g1->srid;\
@@ -343,17 +467,28 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
   if (srid1 != srid2 ) {\
     error_append(&error, "Cannot apply %s when SRIDs differ: %d != %d", #name, srid1, srid2);\
     sqlite3_result_error(context, error_message(&error), -1);\
+    GEOS_FREE_GEOM( g1, 0 );\
+    GEOS_FREE_GEOM( g2, 1 );\
+    GEOS_END;\
     return;\
   }\
-  char result = GEOSPrepared##name##_r(GEOS_HANDLE, g1->geometry, g2->geometry);\
+  char result;\
+  if (g1_set_auxdata && !g2_set_auxdata) {\
+    const GEOSPreparedGeometry *prepared = get_geos_prepared_geom(g2);\
+    result = prepared == NULL ? 2 : GEOSPrepared##inverse##_r(GEOS_HANDLE, prepared, g1->geometry);\
+  } else {\
+    const GEOSPreparedGeometry *prepared = get_geos_prepared_geom(g1);\
+    result = prepared == NULL ? 2 : GEOSPrepared##name##_r(GEOS_HANDLE, prepared, g2->geometry);\
+  }\
   if (result == 2) {\
     geom_geos_get_error(&error);\
     sqlite3_result_error(context, error_message(&error), -1);\
   } else {\
     sqlite3_result_int(context, result);\
   }\
-  GEOS_FREE_PREPARED_GEOM( g1, 0 );\
-  GEOS_FREE_GEOM( g2, 0 );\
+  GEOS_FREE_GEOM( g1, 0 );\
+  GEOS_FREE_GEOM( g2, 1 );\
+  GEOS_END;\
 }
 
 #define GEOS_FUNC_GEOM__DOUBLE(name) static void ST_##name(sqlite3_context *context, int nbArgs, sqlite3_value **args) {\
@@ -365,6 +500,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
     } else {\
       sqlite3_result_null(context);\
     }\
+    GEOS_END;\
     return;\
   }\
   double val;\
@@ -376,6 +512,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
     sqlite3_result_error(context, error_message(&error), -1);\
   }\
   GEOS_FREE_GEOM( g1, 0 );\
+  GEOS_END;\
 }
 
 #define GEOS_FUNC_GEOM_GEOM__DOUBLE(name) static void ST_##name(sqlite3_context *context, int nbArgs, sqlite3_value **args) {\
@@ -388,6 +525,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
     } else {\
       sqlite3_result_null(context);\
     }\
+    GEOS_END;\
     return;\
   }\
   int srid1 = g1->srid;\
@@ -395,6 +533,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
   if (srid1 != srid2 ) {\
     error_append(&error, "Cannot apply %s when SRIDs differ: %d != %d", #name, srid1, srid2);\
     sqlite3_result_error(context, error_message(&error), -1);\
+    GEOS_END;\
     return;\
   }\
   double val;\
@@ -407,6 +546,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
   }\
   GEOS_FREE_GEOM( g1, 0 );\
   GEOS_FREE_GEOM( g2, 1 );\
+  GEOS_END;\
 }
 
 #define GEOS_FUNC_GEOM__GEOM_(sql_name, geos_name) static void ST_##sql_name(sqlite3_context *context, int nbArgs, sqlite3_value **args) {\
@@ -418,6 +558,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
     } else {\
       sqlite3_result_null(context);\
     }\
+    GEOS_END;\
     return;\
   }\
   GEOSGeometry *result = GEOS##geos_name##_r(GEOS_HANDLE, g1->geometry);\
@@ -429,6 +570,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
     sqlite3_result_error(context, error_message(&error), -1);\
   }\
   GEOS_FREE_GEOM( g1, 0 );\
+  GEOS_END;\
 }
 
 #define GEOS_FUNC_GEOM__GEOM(name) GEOS_FUNC_GEOM__GEOM_(name, name)
@@ -442,6 +584,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
     } else {\
       sqlite3_result_null(context);\
     }\
+    GEOS_END;\
     return;\
   }\
   const GEOSGeometry *result = GEOS##geos_name##_r(GEOS_HANDLE, g1->geometry);\
@@ -452,6 +595,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
     sqlite3_result_error(context, error_message(&error), -1);\
   }\
   GEOS_FREE_GEOM( g1, 0 );\
+  GEOS_END;\
 }
 
 #define GEOS_FUNC_GEOM_GEOM__GEOM(name) static void ST_##name(sqlite3_context *context, int nbArgs, sqlite3_value **args) {\
@@ -464,6 +608,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
     } else {\
       sqlite3_result_null(context);\
     }\
+    GEOS_END;\
     return;\
   }\
   int srid1 = g1->srid;\
@@ -471,6 +616,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
   if (srid1 != srid2 ) {\
     error_append(&error, "Cannot apply %s when SRIDs differ: %d != %d", #name, srid1, srid2);\
     sqlite3_result_error(context, error_message(&error), -1);\
+    GEOS_END;\
     return;\
   }\
   GEOSGeometry *result = GEOS##name##_r(GEOS_HANDLE, g1->geometry, g2->geometry);\
@@ -483,6 +629,7 @@ static int set_geos_geom_result(sqlite3_context *context, const geos_context_t *
   }\
   GEOS_FREE_GEOM( g1, 0 );\
   GEOS_FREE_GEOM( g2, 1 );\
+  GEOS_END;\
 }
 
 static void ST_Relate(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
@@ -496,6 +643,7 @@ static void ST_Relate(sqlite3_context *context, int nbArgs, sqlite3_value **args
     } else {
       sqlite3_result_null(context);
     }
+    GEOS_END;
     return;
   }
 
@@ -508,6 +656,7 @@ static void ST_Relate(sqlite3_context *context, int nbArgs, sqlite3_value **args
   }
   GEOS_FREE_GEOM(g1, 0);
   GEOS_FREE_GEOM(g2, 1);
+  GEOS_END;
 }
 
 // Copied from geos::operation::buffer::BufferParameters
@@ -523,6 +672,7 @@ static void ST_Buffer(sqlite3_context *context, int nbArgs, sqlite3_value **args
     } else {
       sqlite3_result_null(context);
     }
+    GEOS_END;
     return;
   }
 
@@ -535,20 +685,380 @@ static void ST_Buffer(sqlite3_context *context, int nbArgs, sqlite3_value **args
     sqlite3_result_error(context, error_message(&error), -1);
   }
   GEOS_FREE_GEOM( g1, 0 );
+  GEOS_END;
+}
+
+#if GPKG_GEOM_FUNC == GPKG_GEOS_DL || (GEOS_VERSION_MAJOR > 3 || (GEOS_VERSION_MAJOR == 3 && GEOS_VERSION_MINOR >= 3))
+/*
+ * The ST_Union aggregate decodes its input while stepping and unions everything at once when finalized, using the
+ * cascaded union of GEOSUnaryUnion. Large inputs are ordered along a Z-order curve over the centers of their
+ * envelopes and cut into partitions of neighbouring geometries. The partitions are unioned on worker threads, each
+ * using its own GEOS handle, and the partial results are merged in groups of neighbours until one geometry remains.
+ * Only neighbouring geometries are merged at every level, so the work per level stays close to linear.
+ */
+#define UNION_THREADS 4
+#define UNION_PARTITION_SIZE 1024
+#define UNION_MERGE_SIZE 8
+
+typedef struct {
+  GEOSGeometry *geometry;
+  double x;
+  double y;
+  uint64_t key;
+} union_item_t;
+
+typedef struct {
+  union_item_t *items;
+  size_t count;
+  size_t capacity;
+  int has_srid;
+  int32_t srid;
+  int failed;
+} union_state_t;
+
+typedef struct {
+  GEOSGeometry **geometries;
+  unsigned int count;
+  GEOSGeometry *result;
+  char error_buffer[256];
+  errorstream_t error;
+} union_task_t;
+
+typedef struct {
+  union_task_t *tasks;
+  long task_count;
+  volatile long next;
+  geos_handle_t *geos_handle;
+} union_batch_t;
+
+static void ST_Union_step(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  GEOS_START(context);
+  const spatialdb_t *spatialdb = GEOS_CONTEXT->spatialdb;
+  union_state_t *state = (union_state_t *)sqlite3_aggregate_context(context, sizeof(union_state_t));
+  uint8_t *blob = (uint8_t *)sqlite3_value_blob(args[0]);
+  size_t blob_length = (size_t) sqlite3_value_bytes(args[0]);
+  geom_blob_header_t header;
+  binstream_t stream;
+
+  if (state == NULL) {
+    sqlite3_result_error_nomem(context);
+    GEOS_END;
+    return;
+  }
+  if (blob == NULL || state->failed) {
+    GEOS_END;
+    return;
+  }
+  STATS_BYTES(blob_length);
+
+  binstream_init(&stream, blob, blob_length);
+  if (spatialdb->read_blob_header(&stream, &header, &error) != SQLITE_OK) {
+    goto error;
+  }
+
+  if (!state->has_srid) {
+    state->has_srid = 1;
+    state->srid = header.srid;
+  } else if (state->srid != header.srid) {
+    error_append(&error, "Cannot apply Union when SRIDs differ: %d != %d", state->srid, header.srid);
+    goto error;
+  }
+
+  size_t body = binstream_position(&stream);
+  if (!header.envelope.has_env_x) {
+    if (spatialdb->fill_envelope(&stream, &header.envelope, &error) != SQLITE_OK || binstream_seek(&stream, body) != SQLITE_OK) {
+      goto error;
+    }
+  }
+  if (!header.envelope.has_env_x || !header.envelope.has_env_y) {
+    // Empty geometries do not contribute to the union
+    GEOS_END;
+    return;
+  }
+
+  if (state->count == state->capacity) {
+    size_t capacity = state->capacity == 0 ? 256 : state->capacity * 2;
+    union_item_t *items = sqlite3_realloc(state->items, (int) (capacity * sizeof(union_item_t)));
+    if (items == NULL) {
+      error_append(&error, "Out of memory");
+      goto error;
+    }
+    state->items = items;
+    state->capacity = capacity;
+  }
+
+  if (geos_context_handle(GEOS_CONTEXT, &error) == NULL) {
+    goto error;
+  }
+  geos_writer_t writer;
+  geos_writer_init_srid(&writer, GEOS_HANDLE, header.srid);
+  spatialdb->read_geometry(&stream, geos_writer_geom_consumer(&writer), &error);
+  GEOSGeometry *g = geos_writer_getgeometry(&writer);
+  geos_writer_destroy(&writer, g == NULL);
+  if (g == NULL) {
+    goto error;
+  }
+
+  union_item_t *item = &state->items[state->count++];
+  item->geometry = g;
+  item->x = (header.envelope.min_x + header.envelope.max_x) / 2;
+  item->y = (header.envelope.min_y + header.envelope.max_y) / 2;
+  GEOS_END;
+  return;
+
+error:
+  state->failed = 1;
+  sqlite3_result_error(context, error_message(&error), -1);
+  GEOS_END;
+}
+
+/*
+ * Spreads the lower 32 bits of a value over the even bits of the result.
+ */
+static uint64_t union_spread_bits(uint64_t v) {
+  v &= 0xFFFFFFFFULL;
+  v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+  v = (v | (v << 8)) & 0x00FF00FF00FF00FFULL;
+  v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  v = (v | (v << 2)) & 0x3333333333333333ULL;
+  v = (v | (v << 1)) & 0x5555555555555555ULL;
+  return v;
+}
+
+static int union_compare_items(const void *a, const void *b) {
+  uint64_t key_a = ((const union_item_t *) a)->key;
+  uint64_t key_b = ((const union_item_t *) b)->key;
+  return key_a < key_b ? -1 : key_a > key_b;
+}
+
+static void union_sort_items(union_item_t *items, size_t count) {
+  double min_x = items[0].x, max_x = items[0].x, min_y = items[0].y, max_y = items[0].y;
+  for (size_t i = 1; i < count; i++) {
+    min_x = items[i].x < min_x ? items[i].x : min_x;
+    max_x = items[i].x > max_x ? items[i].x : max_x;
+    min_y = items[i].y < min_y ? items[i].y : min_y;
+    max_y = items[i].y > max_y ? items[i].y : max_y;
+  }
+
+  double scale_x = max_x > min_x ? 4294967295.0 / (max_x - min_x) : 0;
+  double scale_y = max_y > min_y ? 4294967295.0 / (max_y - min_y) : 0;
+  for (size_t i = 0; i < count; i++) {
+    uint64_t cell_x = (uint64_t) ((items[i].x - min_x) * scale_x);
+    uint64_t cell_y = (uint64_t) ((items[i].y - min_y) * scale_y);
+    items[i].key = union_spread_bits(cell_x) | (union_spread_bits(cell_y) << 1);
+  }
+
+  qsort(items, count, sizeof(union_item_t), union_compare_items);
+}
+
+/*
+ * Runs the tasks of a batch that have not been claimed yet. The collection built for a task takes ownership of its
+ * input geometries.
+ */
+static void union_batch_run(union_batch_t *batch, geos_handle_t *geos) {
+  long i;
+  while ((i = atomic_inc_long(&batch->next) - 1) < batch->task_count) {
+    union_task_t *task = &batch->tasks[i];
+    GEOSGeometry *collection = GEOSGeom_createCollection_r(geos, GEOS_GEOMETRYCOLLECTION, task->geometries, task->count);
+    if (collection != NULL) {
+      task->result = GEOSUnaryUnion_r(geos, collection);
+      GEOSGeom_destroy_r(geos, collection);
+    }
+    if (task->result == NULL) {
+      geom_geos_get_error(&task->error);
+    }
+  }
+}
+
+static void union_batch_work(union_batch_t *batch) {
+  char error_buffer[256];
+  errorstream_t error;
+  error_init_fixed(&error, error_buffer, 256);
+
+#if GPKG_GEOM_FUNC == GPKG_GEOS
+  geos_handle_t *geos = geom_geos_acquire(&error);
+#else
+  geos_handle_t *geos = geom_geos_acquire(batch->geos_handle->library->geos_lib_path, &error);
+#endif
+  // Without a handle of its own the worker leaves the remaining tasks to the calling thread
+  if (geos != NULL) {
+    union_batch_run(batch, geos);
+    geom_geos_release(geos);
+  }
+}
+
+#ifdef UNION_WINDOWS
+static unsigned __stdcall union_worker(void *data) {
+  union_batch_work((union_batch_t *) data);
+  return 0;
+}
+#else
+static void *union_worker(void *data) {
+  union_batch_work((union_batch_t *) data);
+  return NULL;
+}
+#endif
+
+/*
+ * Runs all tasks of a batch, on worker threads if there is more than one task. The calling thread runs tasks as well,
+ * so the batch completes even if no threads could be started.
+ */
+static void union_batch_execute(union_batch_t *batch) {
+  int thread_count = 0;
+#ifdef UNION_WINDOWS
+  HANDLE threads[UNION_THREADS - 1];
+#else
+  pthread_t threads[UNION_THREADS - 1];
+#endif
+
+  for (long i = 1; i < batch->task_count && thread_count < UNION_THREADS - 1; i++) {
+#ifdef UNION_WINDOWS
+    uintptr_t handle = _beginthreadex(NULL, 0, union_worker, batch, 0, NULL);
+    if (handle == 0) {
+      break;
+    }
+    threads[thread_count++] = (HANDLE) handle;
+#else
+    if (pthread_create(&threads[thread_count], NULL, union_worker, batch) != 0) {
+      break;
+    }
+    thread_count++;
+#endif
+  }
+
+  union_batch_run(batch, batch->geos_handle);
+
+  for (int i = 0; i < thread_count; i++) {
+#ifdef UNION_WINDOWS
+    WaitForSingleObject(threads[i], INFINITE);
+    CloseHandle(threads[i]);
+#else
+    pthread_join(threads[i], NULL);
+#endif
+  }
 }
 
+/*
+ * Unions an array of geometries, taking ownership of them. Returns NULL and appends to error if the union failed.
+ */
+static GEOSGeometry *union_geometries(geos_handle_t *geos, GEOSGeometry **geometries, size_t count, errorstream_t *error) {
+  size_t group_size = UNION_PARTITION_SIZE;
+  GEOSGeometry *result = NULL;
+  union_batch_t batch;
+
+  batch.geos_handle = geos;
+  batch.tasks = sqlite3_malloc((int) (((count + group_size - 1) / group_size) * sizeof(union_task_t)));
+  if (batch.tasks == NULL) {
+    error_append(error, "Out of memory");
+    goto exit;
+  }
+
+  do {
+    batch.task_count = (long) ((count + group_size - 1) / group_size);
+    batch.next = 0;
+    for (long i = 0; i < batch.task_count; i++) {
+      union_task_t *task = &batch.tasks[i];
+      size_t start = (size_t) i * group_size;
+      task->geometries = geometries + start;
+      task->count = (unsigned int) (count - start < group_size ? count - start : group_size);
+      task->result = NULL;
+      error_init_fixed(&task->error, task->error_buffer, sizeof(task->error_buffer));
+    }
+
+    union_batch_execute(&batch);
+
+    // The results of a level are the input of the next one, still in Z-order
+    int failed = 0;
+    for (long i = 0; i < batch.task_count; i++) {
+      if (batch.tasks[i].result == NULL && !failed) {
+        error_append(error, "%s", error_message(&batch.tasks[i].error));
+        failed = 1;
+      }
+      geometries[i] = batch.tasks[i].result;
+    }
+    count = (size_t) batch.task_count;
+    if (failed) {
+      goto exit;
+    }
+
+    group_size = UNION_MERGE_SIZE;
+  } while (count > 1);
+
+  result = geometries[0];
+  count = 0;
+
+exit:
+  for (size_t i = 0; i < count; i++) {
+    if (geometries[i] != NULL) {
+      GEOSGeom_destroy_r(geos, geometries[i]);
+    }
+  }
+  sqlite3_free(batch.tasks);
+  return result;
+}
+
+static void ST_Union_final(sqlite3_context *context) {
+  GEOS_START(context);
+  union_state_t *state = (union_state_t *)sqlite3_aggregate_context(context, 0);
+  GEOSGeometry **geometries = NULL;
+
+  if (state == NULL || state->count == 0) {
+    if (state == NULL || !state->failed) {
+      sqlite3_result_null(context);
+    }
+    goto exit;
+  }
+
+  if (state->failed) {
+    goto exit;
+  }
+
+  if (state->count > UNION_PARTITION_SIZE) {
+    union_sort_items(state->items, state->count);
+  }
+
+  // The items are no longer needed once sorted, so their storage is reused for the geometry pointers
+  geometries = (GEOSGeometry **) state->items;
+  for (size_t i = 0; i < state->count; i++) {
+    geometries[i] = state->items[i].geometry;
+  }
+  size_t count = state->count;
+  state->count = 0;
+
+  GEOSGeometry *result = union_geometries(GEOS_HANDLE, geometries, count, &error);
+  if (result != NULL) {
+    GEOSSetSRID_r(GEOS_HANDLE, result, state->srid);
+    set_geos_geom_result(context, GEOS_CONTEXT, result, &error);
+    GEOSGeom_destroy_r(GEOS_HANDLE, result);
+  } else {
+    sqlite3_result_error(context, error_message(&error), -1);
+  }
+
+exit:
+  if (state != NULL) {
+    for (size_t i = 0; i < state->count; i++) {
+      GEOSGeom_destroy_r(GEOS_HANDLE, state->items[i].geometry);
+    }
+    sqlite3_free(state->items);
+    state->items = NULL;
+    state->count = 0;
+  }
+  GEOS_END;
+}
+#endif
+
 GEOS_FUNC_GEOM__INTEGER_(IsSimple, isSimple)
 GEOS_FUNC_GEOM__INTEGER_(IsRing, isRing)
 
 GEOS_FUNC_GEOM__INTEGER_(IsValid, isValid)
 
-GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Disjoint)
-GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Intersects)
-GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Touches)
-GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Crosses)
-GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Within)
-GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Contains)
-GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Overlaps)
+GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Disjoint, Disjoint, PIP_HOLDS_EXTERIOR, PIP_HOLDS_EXTERIOR)
+GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Intersects, Intersects, PIP_HOLDS_INTERIOR, PIP_HOLDS_INTERIOR)
+GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Touches, Touches, 0, 0)
+GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Crosses, Crosses, 0, 0)
+GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Within, Contains, 0, PIP_HOLDS_INTERIOR)
+GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Contains, Within, PIP_HOLDS_INTERIOR, 0)
+GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Overlaps, Overlaps, 0, 0)
 
 GEOS_FUNC_GEOM_GEOM__INTEGER(Equals)
 
@@ -560,7 +1070,6 @@ GEOS_FUNC_GEOM_GEOM__DOUBLE(HausdorffDistance)
 
 GEOS_FUNC_GEOM__GEOM(Boundary)
 GEOS_FUNC_GEOM__GEOM(ConvexHull)
-GEOS_FUNC_GEOM__GEOM(Envelope)
 
 GEOS_FUNC_GEOM__GEOM_(Centroid, GetCentroid)
 
@@ -583,8 +1092,8 @@ GEOS_FUNC_GEOM_GEOM__GEOM(Union)
 
 #if GPKG_GEOM_FUNC == GPKG_GEOS_DL || (GEOS_VERSION_MAJOR > 3 || (GEOS_VERSION_MAJOR == 3 && GEOS_VERSION_MINOR >= 3))
 GEOS_FUNC_GEOM__INTEGER_(IsClosed, isClosed)
-GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Covers)
-GEOS_FUNC_PREPGEOM_GEOM__INTEGER(CoveredBy)
+GEOS_FUNC_PREPGEOM_GEOM__INTEGER(Covers, CoveredBy, PIP_HOLDS_INTERIOR, 0)
+GEOS_FUNC_PREPGEOM_GEOM__INTEGER(CoveredBy, Covers, 0, PIP_HOLDS_INTERIOR)
 #endif
 
 static void GPKG_GEOSVersion(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
@@ -595,7 +1104,7 @@ static void GPKG_GEOSVersion(sqlite3_context *context, int nbArgs, sqlite3_value
 #define STR(x) #x
 
 #if GPKG_GEOM_FUNC == GPKG_GEOS_DL
-#define GEOS_FUNC_AVAILABLE(ctx, name) (ctx->geos_handle->api.name != NULL)
+#define GEOS_FUNC_AVAILABLE(ctx, name) (ctx->geos_handle->api->name != NULL)
 #else
 #define GEOS_FUNC_AVAILABLE(ctx, name) 1
 #endif
@@ -608,6 +1117,14 @@ static void GPKG_GEOSVersion(sqlite3_context *context, int nbArgs, sqlite3_value
     }                                                                                                                  \
 } while (0)
 
+#define GEOS_AGGREGATE(db, name, stepName, finalName, geosName, nbArgs, ctx, error)                                    \
+  do {                                                                                                                 \
+    if (GEOS_FUNC_AVAILABLE(ctx,geosName)) {                                                                           \
+      geos_context_acquire(ctx);                                                                                       \
+      sql_create_aggregate(db, name, stepName, finalName, nbArgs, SQL_DETERMINISTIC, ctx, (void(*)(void*))geos_context_release, error); \
+    }                                                                                                                  \
+} while (0)
+
 #define GEOS_FUNCTION3(db, prefix, name, geosName, nbArgs, ctx, error)                                                 \
   GEOS_FUNCTION4(db, STR(name), prefix##_##name, geosName, nbArgs, ctx, error);                                        \
   GEOS_FUNCTION4(db, STR(prefix##_##name), prefix##_##name, geosName, nbArgs, ctx, error);
@@ -648,7 +1165,6 @@ static void geom_func_register(sqlite3 *db, errorstream_t *error, geos_context_t
 
   GEOS_FUNCTION(db, ST, Boundary, 1, ctx, error);
   GEOS_FUNCTION(db, ST, ConvexHull, 1, ctx, error);
-  GEOS_FUNCTION(db, ST, Envelope, 1, ctx, error);
 
   GEOS_FUNCTION(db, ST, Difference, 2, ctx, error);
   GEOS_FUNCTION(db, ST, SymDifference, 2, ctx, error);
@@ -677,6 +1193,8 @@ static void geom_func_register(sqlite3 *db, errorstream_t *error, geos_context_t
     GEOS_FUNCTION2(db, ST, IsClosed, isClosed, 1, ctx, error);
     GEOS_FUNCTION_PREP(db, ST, Covers, 2, ctx, error);
     GEOS_FUNCTION_PREP(db, ST, CoveredBy, 2, ctx, error);
+    GEOS_AGGREGATE(db, "ST_Union", ST_Union_step, ST_Union_final, GEOSUnaryUnion_r, 1, ctx, error);
+    GEOS_AGGREGATE(db, "GUnion", ST_Union_step, ST_Union_final, GEOSUnaryUnion_r, 1, ctx, error);
   }
 #endif
 
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include "geos_context.h"
 #include "geos_geom_io.h"
 
@@ -60,10 +61,13 @@ static int geos_add_geometry(geos_writer_t *writer, GEOSGeometry *geom) {
   return SQLITE_OK;
 }
 
-static int geos_add_coordinate(geos_writer_t *writer, double x, double y) {
+static int geos_add_coordinates(geos_writer_t *writer, const geom_header_t *header, size_t point_count, const double *coords) {
   geos_data_t *childData = &writer->childData[writer->offset];
-  if (childData->count == childData->capacity) {
+  if (childData->count + point_count > childData->capacity) {
     size_t new_capacity = childData->capacity * 3 / 2;
+    if (new_capacity < childData->count + point_count) {
+      new_capacity = childData->count + point_count;
+    }
     void *new_data = sqlite3_realloc(childData->data, new_capacity * 2 * sizeof(double));
     if (new_data == NULL) {
       return SQLITE_NOMEM;
@@ -72,24 +76,36 @@ static int geos_add_coordinate(geos_writer_t *writer, double x, double y) {
     childData->capacity = new_capacity;
   }
 
-  double *coords = (double *)childData->data;
-  size_t offset = 2 * childData->count;
-  coords[offset] = x;
-  coords[offset + 1] = y;
-  childData->count++;
+  double *out = (double *)childData->data + 2 * childData->count;
+  if (header->coord_size == 2) {
+    memcpy(out, coords, point_count * 2 * sizeof(double));
+  } else {
+    for (size_t i = 0; i < point_count; i++) {
+      *out++ = coords[0];
+      *out++ = coords[1];
+      coords += header->coord_size;
+    }
+  }
+  childData->count += point_count;
   return SQLITE_OK;
 }
 
 static GEOSCoordSequence *geos_create_coord_seq(geos_writer_t *writer) {
   geos_data_t *childData = &writer->childData[writer->offset];
   size_t childCount = childData->count;
+  double *coords = (double *)childData->data;
+
+#ifdef GPKG_GEOS_COORDSEQ_BUFFER
+  if (GPKG_GEOS_HAS_COORDSEQ_BUFFER(writer->context)) {
+    return GEOSCoordSeq_copyFromBuffer_r(writer->context, coords, (unsigned int) childCount, 0, 0);
+  }
+#endif
 
   GEOSCoordSequence *seq = GEOSCoordSeq_create_r(writer->context, childCount, 2);
   if (seq == NULL) {
     return NULL;
   }
 
-  double *coords = (double *)childData->data;
   for (size_t i = 0; i < childCount; i++) {
     GEOSCoordSeq_setX_r(writer->context, seq, i, *coords++);
     GEOSCoordSeq_setY_r(writer->context, seq, i, *coords++);
@@ -214,16 +230,8 @@ static int geos_end_geometry(const struct geom_consumer_t *consumer, const geom_
 }
 
 static int geos_coordinates(const struct geom_consumer_t *consumer, const geom_header_t *header, size_t point_count, const double *coords, int skip_coords, errorstream_t *error) {
-  int result = SQLITE_OK;
   geos_writer_t *writer = (geos_writer_t *) consumer;
-
-  size_t offset = 0;
-  for (int i = 0; result == SQLITE_OK && i < point_count; i++) {
-    result = geos_add_coordinate(writer, coords[offset], coords[offset + 1]);
-    offset += header->coord_size;
-  }
-
-  return result;
+  return geos_add_coordinates(writer, header, point_count, coords);
 }
 
 int geos_writer_init_srid(geos_writer_t *writer, geos_handle_t *context, int srid) {
@@ -276,14 +284,39 @@ GEOSGeometry *geos_writer_getgeometry(geos_writer_t *writer) {
 static int read_geos_coordseq(geos_handle_t *geos, geom_header_t *header, const GEOSCoordSequence *coordseq, geom_consumer_t const *consumer, errorstream_t *error) {
   int result = SQLITE_OK;
   double coord[2 * COORD_BATCH_SIZE];
-  uint32_t remaining;
-  GEOSCoordSeq_getSize_r(geos, coordseq, &remaining);
-
-  while (remaining > 0) {
-    uint32_t points_to_read = (remaining > COORD_BATCH_SIZE ? COORD_BATCH_SIZE : remaining);
-    for (int i = 0, ix = 0; i < points_to_read; i++, ix += 2) {
-      GEOSCoordSeq_getX_r(geos, coordseq, i, &coord[ix]);
-      GEOSCoordSeq_getY_r(geos, coordseq, i, &coord[ix + 1]);
+  unsigned int size = 0;
+  GEOSCoordSeq_getSize_r(geos, coordseq, &size);
+
+#ifdef GPKG_GEOS_COORDSEQ_BUFFER
+  if (GPKG_GEOS_HAS_COORDSEQ_BUFFER(geos) && size > 0) {
+    double *coords = coord;
+    if (size > COORD_BATCH_SIZE) {
+      coords = (double *)sqlite3_malloc(size * 2 * sizeof(double));
+      if (coords == NULL) {
+        return SQLITE_NOMEM;
+      }
+    }
+
+    if (GEOSCoordSeq_copyToBuffer_r(geos, coordseq, coords, 0, 0) == 0) {
+      geom_geos_get_error(error);
+      result = SQLITE_ERROR;
+    } else {
+      result = consumer->coordinates(consumer, header, size, coords, 0, error);
+    }
+
+    if (coords != coord) {
+      sqlite3_free(coords);
+    }
+    return result;
+  }
+#endif
+
+  unsigned int index = 0;
+  while (index < size) {
+    unsigned int points_to_read = (size - index > COORD_BATCH_SIZE ? COORD_BATCH_SIZE : size - index);
+    for (unsigned int i = 0, ix = 0; i < points_to_read; i++, ix += 2) {
+      GEOSCoordSeq_getX_r(geos, coordseq, index + i, &coord[ix]);
+      GEOSCoordSeq_getY_r(geos, coordseq, index + i, &coord[ix + 1]);
     }
 
     result = consumer->coordinates(consumer, header, points_to_read, coord, 0, error);
@@ -291,7 +324,7 @@ static int read_geos_coordseq(geos_handle_t *geos, geom_header_t *header, const
       return result;
     }
 
-    remaining -= points_to_read;
+    index += points_to_read;
   }
 
   return result;
@@ -85,6 +85,24 @@ GPKG_EXPORT int GPKG_CALL sqlite3_gpkg_spl3_init(sqlite3 *db, const char **pzErr
  */
 GPKG_EXPORT int GPKG_CALL sqlite3_gpkg_spl4_init(sqlite3 *db, const char **pzErrMsg, const sqlite3_api_routines *pThunk);
 
+/**
+ * Imports a tile pyramid in the spherical mercator (EPSG:3857) world grid into a tiles table, creating the table and
+ * the spatial metadata tables if they do not exist yet. The source is either a directory tree laid out as
+ * zoom/column/row.ext or an MBTiles file. This is the same import that the SQL function GPKG_ImportTiles performs,
+ * which is only registered when SQLite supports restricting it to top level statements (3.30.0 or later).
+ *
+ * The import runs in its own savepoint, so it is rolled back completely if it fails.
+ *
+ * @param db the database handle
+ * @param db_name the database name (e.g. "main"), or NULL for "main"
+ * @param table_name the name of the tiles table
+ * @param source the path of the directory tree or MBTiles file
+ * @param[out] tile_count receives the number of imported tiles, may be NULL
+ * @param[out] errmsg receives an error message on failure which must be freed using sqlite3_free(), may be NULL
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+GPKG_EXPORT int GPKG_CALL gpkg_import_tiles(sqlite3 *db, const char *db_name, const char *table_name, const char *source, sqlite3_int64 *tile_count, char **errmsg);
+
 #ifdef __cplusplus
 }
 #endif
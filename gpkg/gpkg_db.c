@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 #include "spatialdb_internal.h"
+#include "contents_extent.h"
 #include "gpkg_geom.h"
 #include "sql.h"
 #include "sqlite.h"
@@ -752,6 +753,17 @@ static int add_geometry_column(sqlite3 *db, const char *db_name, const char *tab
     return result;
   }
 
+  int maintain_extent = 0;
+  result = contents_extent_enabled(db, db_name, &maintain_extent);
+  if (result != SQLITE_OK) {
+    error_append(error, "Could not check if extent maintenance is enabled: %s", sqlite3_errmsg(db));
+    return result;
+  }
+
+  if (maintain_extent) {
+    return contents_extent_install(db, db_name, table_name, column_name, error);
+  }
+
   return SQLITE_OK;
 }
 
@@ -48,7 +48,7 @@ int gpb_read_header(binstream_t *stream, geom_blob_header_t *gpb, errorstream_t
 
   if (memcmp(head, "GP", 2) != 0) {
     if (error) {
-      error_append(error, "Incorrect GPB magic number [expected: GP, actual:%*s]", 2, head);
+      error_append(error, "Incorrect GPB magic number [expected: GP, actual:%.*s]", 2, head);
     }
     return SQLITE_IOERR;
   }
@@ -331,3 +331,41 @@ int gpb_writer_init(geom_blob_writer_t *writer, int32_t srid) {
 void gpb_writer_destroy(geom_blob_writer_t *writer, int free_data) {
   wkb_writer_destroy(&writer->wkb_writer, free_data);
 }
+
+static void gpb_encode_u32_le(uint8_t *buffer, uint32_t value) {
+  buffer[0] = (uint8_t) value;
+  buffer[1] = (uint8_t) (value >> 8);
+  buffer[2] = (uint8_t) (value >> 16);
+  buffer[3] = (uint8_t) (value >> 24);
+}
+
+static void gpb_encode_u64_le(uint8_t *buffer, uint64_t value) {
+  gpb_encode_u32_le(buffer, (uint32_t) value);
+  gpb_encode_u32_le(buffer + 4, (uint32_t) (value >> 32));
+}
+
+size_t gpb_point_size(coord_type_t coord_type) {
+  return (size_t) 8 /* Magic number and SRID */ + 5 /* WKB header */ + 8 * geom_coord_dim(coord_type);
+}
+
+size_t gpb_write_point(uint8_t *buffer, int32_t srid, coord_type_t coord_type, const double *coords) {
+  /* ISO WKB point type code per coordinate type */
+  static const uint32_t wkb_point_types[] = {1, 1001, 2001, 3001};
+  int coord_size = geom_coord_dim(coord_type);
+  /* Matches gpb_end, which flags the blob as empty if no X or Y value was accumulated in the envelope */
+  int empty = fp_isnan(coords[0]) || fp_isnan(coords[1]);
+
+  buffer[0] = 'G';
+  buffer[1] = 'P';
+  buffer[2] = GPB_VERSION;
+  buffer[3] = (uint8_t) ((empty << 4) | GPB_LITTLE_ENDIAN);
+  gpb_encode_u32_le(buffer + 4, (uint32_t) srid);
+
+  buffer[8] = 1;
+  gpb_encode_u32_le(buffer + 9, wkb_point_types[coord_type]);
+  for (int i = 0; i < coord_size; i++) {
+    gpb_encode_u64_le(buffer + 13 + 8 * i, fp_double_to_uint64(coords[i]));
+  }
+
+  return gpb_point_size(coord_type);
+}
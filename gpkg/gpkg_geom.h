@@ -65,6 +65,30 @@ int gpb_read_header(binstream_t *stream, geom_blob_header_t *header, errorstream
  */
 int gpb_write_header(binstream_t *stream, geom_blob_header_t *header, errorstream_t *error);
 
+/**
+ * The size of the largest point blob written by gpb_write_point().
+ */
+#define GPB_POINT_MAX_SIZE 45
+
+/**
+ * Returns the size of a GeoPackage Binary point blob.
+ * @param coord_type the coordinate type of the point
+ * @return the number of bytes gpb_write_point() writes for a point with the given coordinate type
+ */
+size_t gpb_point_size(coord_type_t coord_type);
+
+/**
+ * Writes a GeoPackage Binary point blob directly to a buffer. The blob is identical to the one written by a
+ * GeoPackage Binary writer for the same point: it is little endian, has no envelope and is flagged as empty if the X
+ * or Y ordinate is NaN. This avoids the geometry consumer pipeline for the most common case of constructing a point.
+ * @param[out] buffer the buffer to write to. This buffer should be at least gpb_point_size(coord_type) bytes long.
+ * @param srid the SRID of the point
+ * @param coord_type the coordinate type of the point
+ * @param coords the ordinates of the point
+ * @return the number of bytes written to buffer
+ */
+size_t gpb_write_point(uint8_t *buffer, int32_t srid, coord_type_t coord_type, const double *coords);
+
 /** @} */
 
 #endif
@@ -0,0 +1,511 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include "geomio.h"
+#include "pip_index.h"
+#include "sqlite.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define PIP_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define PIP_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * Average number of distinct edges per slab. Edges spanning several slabs are stored in each of them; if that makes
+ * the index more than PIP_MAX_DUPLICATION times larger than the edge list, the number of slabs is halved.
+ */
+#define PIP_EDGES_PER_SLAB 8
+#define PIP_MAX_SLABS 4096
+#define PIP_MAX_DUPLICATION 4
+
+/*
+ * Relative error bound on the orientation determinant (Shewchuk's ccwerrboundA). If the magnitude of the determinant
+ * does not exceed this bound its sign cannot be trusted.
+ */
+#define PIP_ORIENT_BOUND ((3.0 + 8.0 * DBL_EPSILON) * DBL_EPSILON / 2.0)
+
+struct pip_index_t {
+  int usable;
+  double min_x;
+  double max_x;
+  double min_y;
+  double max_y;
+  double slab_scale;
+  size_t slab_count;
+  size_t *slab_start;
+  double *x0;
+  double *y0;
+  double *x1;
+  double *y1;
+};
+
+/*
+ * Walks the rings of a polygonal geometry. Depending on the mode the edges are either collected for indexing or
+ * tested against a point directly.
+ */
+typedef struct {
+  geom_consumer_t consumer;
+  int usable;
+  int locate;
+  double x;
+  double y;
+  int crossings;
+  int unknown;
+  size_t ring_points;
+  double first_x;
+  double first_y;
+  double prev_x;
+  double prev_y;
+  double *edges;
+  size_t edge_count;
+  size_t edge_capacity;
+} pip_walker_t;
+
+/*
+ * Tests a single edge against the horizontal ray from (x, y) towards positive X. Returns 1 if the ray crosses the
+ * edge using the half-open rule on Y, 0 otherwise. Sets *unknown if the point lies within the bounding box of the edge
+ * and its side of the edge cannot be determined reliably.
+ */
+static int pip_edge_crosses(double x0, double y0, double x1, double y1, double x, double y, int *unknown) {
+  double min_x = x0 < x1 ? x0 : x1;
+  double max_x = x0 < x1 ? x1 : x0;
+  double min_y = y0 < y1 ? y0 : y1;
+  double max_y = y0 < y1 ? y1 : y0;
+
+  if (y < min_y || y > max_y || x > max_x) {
+    return 0;
+  }
+
+  int straddle = (y0 > y) != (y1 > y);
+  if (x < min_x) {
+    return straddle;
+  }
+
+  double left = (x0 - x) * (y1 - y);
+  double right = (y0 - y) * (x1 - x);
+  double det = left - right;
+  if (fabs(det) <= PIP_ORIENT_BOUND * (fabs(left) + fabs(right))) {
+    *unknown = 1;
+    return 0;
+  }
+
+  return straddle && ((det > 0) == (y1 > y0));
+}
+
+static int pip_locate_edges(const pip_index_t *index, size_t begin, size_t end, double x, double y) {
+  int crossings = 0;
+  int unknown = 0;
+  size_t i = begin;
+
+#if defined(PIP_SSE2)
+  const __m128d px = _mm_set1_pd(x);
+  const __m128d py = _mm_set1_pd(y);
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d bound = _mm_set1_pd(PIP_ORIENT_BOUND);
+
+  for (; i + 2 <= end; i += 2) {
+    __m128d x0 = _mm_loadu_pd(index->x0 + i);
+    __m128d y0 = _mm_loadu_pd(index->y0 + i);
+    __m128d x1 = _mm_loadu_pd(index->x1 + i);
+    __m128d y1 = _mm_loadu_pd(index->y1 + i);
+    __m128d min_x = _mm_min_pd(x0, x1);
+    __m128d max_x = _mm_max_pd(x0, x1);
+
+    __m128d straddle = _mm_xor_pd(_mm_cmpgt_pd(y0, py), _mm_cmpgt_pd(y1, py));
+    __m128d inbox = _mm_and_pd(
+      _mm_and_pd(_mm_cmple_pd(min_x, px), _mm_cmple_pd(px, max_x)),
+      _mm_and_pd(_mm_cmple_pd(_mm_min_pd(y0, y1), py), _mm_cmple_pd(py, _mm_max_pd(y0, y1)))
+    );
+
+    __m128d left = _mm_mul_pd(_mm_sub_pd(x0, px), _mm_sub_pd(y1, py));
+    __m128d right = _mm_mul_pd(_mm_sub_pd(y0, py), _mm_sub_pd(x1, px));
+    __m128d det = _mm_sub_pd(left, right);
+    __m128d sum = _mm_add_pd(_mm_max_pd(left, _mm_sub_pd(zero, left)), _mm_max_pd(right, _mm_sub_pd(zero, right)));
+    __m128d certain = _mm_cmpgt_pd(_mm_max_pd(det, _mm_sub_pd(zero, det)), _mm_mul_pd(bound, sum));
+    __m128d wrong_side = _mm_xor_pd(_mm_cmpgt_pd(det, zero), _mm_cmpgt_pd(y1, y0));
+
+    __m128d crossing = _mm_and_pd(straddle, _mm_or_pd(
+      _mm_cmplt_pd(px, min_x),
+      _mm_andnot_pd(wrong_side, _mm_and_pd(inbox, certain))
+    ));
+    int mask = _mm_movemask_pd(crossing);
+    crossings += (mask & 1) + (mask >> 1);
+    unknown |= _mm_movemask_pd(_mm_andnot_pd(certain, inbox));
+  }
+#elif defined(PIP_NEON)
+  const float64x2_t px = vdupq_n_f64(x);
+  const float64x2_t py = vdupq_n_f64(y);
+  const float64x2_t zero = vdupq_n_f64(0.0);
+  const float64x2_t bound = vdupq_n_f64(PIP_ORIENT_BOUND);
+
+  for (; i + 2 <= end; i += 2) {
+    float64x2_t x0 = vld1q_f64(index->x0 + i);
+    float64x2_t y0 = vld1q_f64(index->y0 + i);
+    float64x2_t x1 = vld1q_f64(index->x1 + i);
+    float64x2_t y1 = vld1q_f64(index->y1 + i);
+    float64x2_t min_x = vminq_f64(x0, x1);
+    float64x2_t max_x = vmaxq_f64(x0, x1);
+
+    uint64x2_t straddle = veorq_u64(vcgtq_f64(y0, py), vcgtq_f64(y1, py));
+    uint64x2_t inbox = vandq_u64(
+      vandq_u64(vcleq_f64(min_x, px), vcleq_f64(px, max_x)),
+      vandq_u64(vcleq_f64(vminq_f64(y0, y1), py), vcleq_f64(py, vmaxq_f64(y0, y1)))
+    );
+
+    float64x2_t left = vmulq_f64(vsubq_f64(x0, px), vsubq_f64(y1, py));
+    float64x2_t right = vmulq_f64(vsubq_f64(y0, py), vsubq_f64(x1, px));
+    float64x2_t det = vsubq_f64(left, right);
+    float64x2_t sum = vaddq_f64(vabsq_f64(left), vabsq_f64(right));
+    uint64x2_t certain = vcgtq_f64(vabsq_f64(det), vmulq_f64(bound, sum));
+    uint64x2_t wrong_side = veorq_u64(vcgtq_f64(det, zero), vcgtq_f64(y1, y0));
+
+    uint64x2_t crossing = vandq_u64(straddle, vorrq_u64(
+      vcltq_f64(px, min_x),
+      vbicq_u64(vandq_u64(inbox, certain), wrong_side)
+    ));
+    uint64x2_t uncertain = vbicq_u64(inbox, certain);
+    crossings += (int) ((vgetq_lane_u64(crossing, 0) & 1) + (vgetq_lane_u64(crossing, 1) & 1));
+    unknown |= (int) ((vgetq_lane_u64(uncertain, 0) | vgetq_lane_u64(uncertain, 1)) & 1);
+  }
+#endif
+
+  for (; i < end; i++) {
+    crossings += pip_edge_crosses(index->x0[i], index->y0[i], index->x1[i], index->y1[i], x, y, &unknown);
+  }
+
+  if (unknown) {
+    return PIP_UNKNOWN;
+  }
+  return (crossings & 1) ? PIP_INTERIOR : PIP_EXTERIOR;
+}
+
+static int pip_walker_add_edge(pip_walker_t *walker, double x0, double y0, double x1, double y1) {
+  if (walker->locate) {
+    walker->crossings += pip_edge_crosses(x0, y0, x1, y1, walker->x, walker->y, &walker->unknown);
+    walker->edge_count++;
+    return SQLITE_OK;
+  }
+
+  if (walker->edge_count == walker->edge_capacity) {
+    size_t capacity = walker->edge_capacity == 0 ? 64 : walker->edge_capacity * 2;
+    if (capacity > (size_t) INT_MAX / (4 * sizeof(double))) {
+      return SQLITE_NOMEM;
+    }
+    double *edges = (double *) sqlite3_realloc(walker->edges, (int) (capacity * 4 * sizeof(double)));
+    if (edges == NULL) {
+      return SQLITE_NOMEM;
+    }
+    walker->edges = edges;
+    walker->edge_capacity = capacity;
+  }
+
+  double *edge = walker->edges + walker->edge_count * 4;
+  edge[0] = x0;
+  edge[1] = y0;
+  edge[2] = x1;
+  edge[3] = y1;
+  walker->edge_count++;
+  return SQLITE_OK;
+}
+
+static int pip_walker_begin_geometry(const geom_consumer_t *consumer, const geom_header_t *header, errorstream_t *error) {
+  pip_walker_t *walker = (pip_walker_t *) consumer;
+
+  switch (header->geom_type) {
+    case GEOM_POLYGON:
+    case GEOM_MULTIPOLYGON:
+      break;
+    case GEOM_LINEARRING:
+      walker->ring_points = 0;
+      break;
+    default:
+      walker->usable = 0;
+      break;
+  }
+  return SQLITE_OK;
+}
+
+static int pip_walker_end_geometry(const geom_consumer_t *consumer, const geom_header_t *header, errorstream_t *error) {
+  pip_walker_t *walker = (pip_walker_t *) consumer;
+
+  if (header->geom_type == GEOM_LINEARRING && walker->ring_points > 0) {
+    if (walker->ring_points < 4 || walker->first_x != walker->prev_x || walker->first_y != walker->prev_y) {
+      walker->usable = 0;
+    }
+  }
+  return SQLITE_OK;
+}
+
+static int pip_walker_coordinates(const geom_consumer_t *consumer, const geom_header_t *header, size_t point_count, const double *coords, int skip_coords, errorstream_t *error) {
+  pip_walker_t *walker = (pip_walker_t *) consumer;
+
+  if (!walker->usable || header->geom_type != GEOM_LINEARRING) {
+    return SQLITE_OK;
+  }
+
+  for (size_t i = (size_t) skip_coords; i < point_count * header->coord_size; i += header->coord_size) {
+    double x = coords[i];
+    double y = coords[i + 1];
+    if (isnan(x) || isnan(y)) {
+      walker->usable = 0;
+      return SQLITE_OK;
+    }
+
+    if (walker->ring_points == 0) {
+      walker->first_x = x;
+      walker->first_y = y;
+    } else {
+      int result = pip_walker_add_edge(walker, walker->prev_x, walker->prev_y, x, y);
+      if (result != SQLITE_OK) {
+        return result;
+      }
+    }
+    walker->prev_x = x;
+    walker->prev_y = y;
+    walker->ring_points++;
+  }
+  return SQLITE_OK;
+}
+
+static void pip_walker_init(pip_walker_t *walker, int locate, double x, double y) {
+  memset(walker, 0, sizeof(pip_walker_t));
+  geom_consumer_init(&walker->consumer, NULL, NULL, pip_walker_begin_geometry, pip_walker_end_geometry, pip_walker_coordinates);
+  walker->usable = 1;
+  walker->locate = locate;
+  walker->x = x;
+  walker->y = y;
+}
+
+static size_t pip_index_slab(const pip_index_t *index, double y) {
+  double s = (y - index->min_y) * index->slab_scale;
+  if (s <= 0.0) {
+    return 0;
+  }
+  size_t slab = (size_t) s;
+  return slab < index->slab_count ? slab : index->slab_count - 1;
+}
+
+static size_t pip_index_entry_count(const pip_index_t *index, const double *edges, size_t edge_count) {
+  size_t total = 0;
+  for (size_t i = 0; i < edge_count; i++) {
+    const double *edge = edges + i * 4;
+    size_t a = pip_index_slab(index, edge[1]);
+    size_t b = pip_index_slab(index, edge[3]);
+    total += a < b ? b - a + 1 : a - b + 1;
+  }
+  return total;
+}
+
+static int pip_index_fill(pip_index_t *index, const double *edges, size_t edge_count) {
+  index->min_x = index->max_x = edges[0];
+  index->min_y = index->max_y = edges[1];
+  for (size_t i = 0; i < edge_count * 4; i += 2) {
+    double x = edges[i];
+    double y = edges[i + 1];
+    index->min_x = x < index->min_x ? x : index->min_x;
+    index->max_x = x > index->max_x ? x : index->max_x;
+    index->min_y = y < index->min_y ? y : index->min_y;
+    index->max_y = y > index->max_y ? y : index->max_y;
+  }
+
+  size_t slab_count = edge_count / PIP_EDGES_PER_SLAB;
+  slab_count = slab_count < 1 ? 1 : (slab_count > PIP_MAX_SLABS ? PIP_MAX_SLABS : slab_count);
+
+  size_t total;
+  while (1) {
+    index->slab_count = slab_count;
+    index->slab_scale = slab_count > 1 && index->max_y > index->min_y ? slab_count / (index->max_y - index->min_y) : 0.0;
+    total = pip_index_entry_count(index, edges, edge_count);
+    if (slab_count == 1 || total <= PIP_MAX_DUPLICATION * edge_count) {
+      break;
+    }
+    slab_count /= 2;
+  }
+
+  if (total > (size_t) INT_MAX / (4 * sizeof(double)) || slab_count + 1 > (size_t) INT_MAX / sizeof(size_t)) {
+    return SQLITE_NOMEM;
+  }
+
+  index->slab_start = (size_t *) sqlite3_malloc((int) ((slab_count + 1) * sizeof(size_t)));
+  index->x0 = (double *) sqlite3_malloc((int) (total * 4 * sizeof(double)));
+  if (index->slab_start == NULL || index->x0 == NULL) {
+    return SQLITE_NOMEM;
+  }
+  index->y0 = index->x0 + total;
+  index->x1 = index->y0 + total;
+  index->y1 = index->x1 + total;
+
+  /* Count the entries per slab, turn the counts into start offsets and use those as insertion cursors */
+  memset(index->slab_start, 0, (slab_count + 1) * sizeof(size_t));
+  for (size_t i = 0; i < edge_count; i++) {
+    const double *edge = edges + i * 4;
+    size_t a = pip_index_slab(index, edge[1]);
+    size_t b = pip_index_slab(index, edge[3]);
+    for (size_t s = a < b ? a : b; s <= (a < b ? b : a); s++) {
+      index->slab_start[s + 1]++;
+    }
+  }
+  for (size_t s = 1; s <= slab_count; s++) {
+    index->slab_start[s] += index->slab_start[s - 1];
+  }
+  for (size_t i = 0; i < edge_count; i++) {
+    const double *edge = edges + i * 4;
+    size_t a = pip_index_slab(index, edge[1]);
+    size_t b = pip_index_slab(index, edge[3]);
+    for (size_t s = a < b ? a : b; s <= (a < b ? b : a); s++) {
+      size_t j = index->slab_start[s]++;
+      index->x0[j] = edge[0];
+      index->y0[j] = edge[1];
+      index->x1[j] = edge[2];
+      index->y1[j] = edge[3];
+    }
+  }
+  /* The cursors now hold the end offsets; shift them back into start offsets */
+  for (size_t s = slab_count; s > 0; s--) {
+    index->slab_start[s] = index->slab_start[s - 1];
+  }
+  index->slab_start[0] = 0;
+
+  return SQLITE_OK;
+}
+
+int pip_index_build(const spatialdb_t *spatialdb, binstream_t *stream, pip_index_t **index, errorstream_t *error) {
+  pip_walker_t walker;
+  pip_walker_init(&walker, 0, 0.0, 0.0);
+
+  int result = spatialdb->read_geometry(stream, &walker.consumer, error);
+  if (result != SQLITE_OK) {
+    sqlite3_free(walker.edges);
+    return result;
+  }
+
+  pip_index_t *new_index = (pip_index_t *) sqlite3_malloc(sizeof(pip_index_t));
+  if (new_index == NULL) {
+    sqlite3_free(walker.edges);
+    return SQLITE_NOMEM;
+  }
+  memset(new_index, 0, sizeof(pip_index_t));
+
+  if (walker.usable && walker.edge_count > 0) {
+    result = pip_index_fill(new_index, walker.edges, walker.edge_count);
+    new_index->usable = result == SQLITE_OK;
+  }
+  sqlite3_free(walker.edges);
+
+  if (result == SQLITE_NOMEM) {
+    /* Too large to index; the caller will use its exact fallback for every point */
+    sqlite3_free(new_index->slab_start);
+    sqlite3_free(new_index->x0);
+    new_index->slab_start = NULL;
+    new_index->x0 = NULL;
+  }
+
+  *index = new_index;
+  return SQLITE_OK;
+}
+
+int pip_index_locate(const pip_index_t *index, double x, double y) {
+  if (!index->usable || isnan(x) || isnan(y)) {
+    return PIP_UNKNOWN;
+  }
+
+  if (x < index->min_x || x > index->max_x || y < index->min_y || y > index->max_y) {
+    return PIP_EXTERIOR;
+  }
+
+  size_t slab = pip_index_slab(index, y);
+  return pip_locate_edges(index, index->slab_start[slab], index->slab_start[slab + 1], x, y);
+}
+
+void pip_index_free(pip_index_t *index) {
+  if (index == NULL) {
+    return;
+  }
+
+  sqlite3_free(index->slab_start);
+  sqlite3_free(index->x0);
+  sqlite3_free(index);
+}
+
+int pip_locate(const spatialdb_t *spatialdb, binstream_t *stream, double x, double y, int *location, errorstream_t *error) {
+  pip_walker_t walker;
+
+  if (isnan(x) || isnan(y)) {
+    *location = PIP_UNKNOWN;
+    return SQLITE_OK;
+  }
+
+  pip_walker_init(&walker, 1, x, y);
+  int result = spatialdb->read_geometry(stream, &walker.consumer, error);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  if (!walker.usable || walker.unknown || walker.edge_count == 0) {
+    *location = PIP_UNKNOWN;
+  } else {
+    *location = (walker.crossings & 1) ? PIP_INTERIOR : PIP_EXTERIOR;
+  }
+  return SQLITE_OK;
+}
+
+typedef struct {
+  geom_consumer_t consumer;
+  int is_point;
+  int empty;
+  double x;
+  double y;
+} pip_point_t;
+
+static int pip_point_begin_geometry(const geom_consumer_t *consumer, const geom_header_t *header, errorstream_t *error) {
+  pip_point_t *point = (pip_point_t *) consumer;
+  point->is_point = header->geom_type == GEOM_POINT;
+  return SQLITE_OK;
+}
+
+static int pip_point_coordinates(const geom_consumer_t *consumer, const geom_header_t *header, size_t point_count, const double *coords, int skip_coords, errorstream_t *error) {
+  pip_point_t *point = (pip_point_t *) consumer;
+
+  if (point->is_point && point_count * header->coord_size > (size_t) skip_coords) {
+    point->x = coords[skip_coords];
+    point->y = coords[skip_coords + 1];
+    point->empty = isnan(point->x) || isnan(point->y);
+  }
+  return SQLITE_OK;
+}
+
+int pip_read_point(const spatialdb_t *spatialdb, binstream_t *stream, double *x, double *y, int *empty, errorstream_t *error) {
+  pip_point_t point;
+  memset(&point, 0, sizeof(pip_point_t));
+  geom_consumer_init(&point.consumer, NULL, NULL, pip_point_begin_geometry, NULL, pip_point_coordinates);
+  point.empty = 1;
+
+  int result = spatialdb->read_geometry(stream, &point.consumer, error);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  *x = point.x;
+  *y = point.y;
+  *empty = point.empty || !point.is_point;
+  return SQLITE_OK;
+}
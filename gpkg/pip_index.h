@@ -0,0 +1,111 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GPKG_PIP_INDEX_H
+#define GPKG_PIP_INDEX_H
+
+#include "binstream.h"
+#include "error.h"
+#include "spatialdb.h"
+
+/**
+ * \addtogroup pip_index Point in polygon tests
+ *
+ * Locates points relative to Polygon and MultiPolygon geometries without converting them to another geometry
+ * library. The location is determined using the even-odd crossing rule over all rings, which is correct for valid
+ * polygonal geometries.
+ *
+ * Orientation tests are done in double precision with an error bound. Points that lie on the boundary, or so close to
+ * it that the orientation cannot be determined reliably, are reported as PIP_UNKNOWN so that the caller can fall back
+ * to an exact implementation. The same is done for geometries that are not made up of closed rings.
+ * @{
+ */
+
+/**
+ * The point lies in the exterior of the geometry.
+ */
+#define PIP_EXTERIOR 0
+/**
+ * The point lies in the interior of the geometry.
+ */
+#define PIP_INTERIOR 1
+/**
+ * The location of the point could not be determined.
+ */
+#define PIP_UNKNOWN 2
+
+/**
+ * An edge index over the rings of a polygonal geometry. Edges are bucketed into horizontal slabs so that a point only
+ * needs to be tested against the edges that span its Y coordinate.
+ */
+typedef struct pip_index_t pip_index_t;
+
+/**
+ * Builds an edge index for a geometry. The stream is expected to be positioned at the start of the geometry body
+ * (i.e., immediately after the blob header). If the geometry is not a Polygon or MultiPolygon made up of closed rings
+ * an index is still returned, but it will locate every point as PIP_UNKNOWN.
+ * @param spatialdb the spatial database schema used to decode the geometry
+ * @param stream the geometry blob stream
+ * @param[out] index receives the edge index. Must be freed using pip_index_free.
+ * @param error the error stream to write errors to
+ * @return SQLITE_OK or an error code
+ */
+int pip_index_build(const spatialdb_t *spatialdb, binstream_t *stream, pip_index_t **index, errorstream_t *error);
+
+/**
+ * Locates a point using an edge index.
+ * @param index the edge index
+ * @param x the X coordinate of the point
+ * @param y the Y coordinate of the point
+ * @return PIP_EXTERIOR, PIP_INTERIOR or PIP_UNKNOWN
+ */
+int pip_index_locate(const pip_index_t *index, double x, double y);
+
+/**
+ * Frees an edge index.
+ * @param index the edge index. May be NULL.
+ */
+void pip_index_free(pip_index_t *index);
+
+/**
+ * Locates a point relative to a geometry while decoding it, without building an index. This is cheaper than
+ * pip_index_build followed by pip_index_locate if the geometry is only used once. The stream is expected to be
+ * positioned at the start of the geometry body.
+ * @param spatialdb the spatial database schema used to decode the geometry
+ * @param stream the geometry blob stream
+ * @param x the X coordinate of the point
+ * @param y the Y coordinate of the point
+ * @param[out] location receives PIP_EXTERIOR, PIP_INTERIOR or PIP_UNKNOWN
+ * @param error the error stream to write errors to
+ * @return SQLITE_OK or an error code
+ */
+int pip_locate(const spatialdb_t *spatialdb, binstream_t *stream, double x, double y, int *location, errorstream_t *error);
+
+/**
+ * Reads the coordinates of a Point geometry. The stream is expected to be positioned at the start of the geometry
+ * body.
+ * @param spatialdb the spatial database schema used to decode the geometry
+ * @param stream the geometry blob stream
+ * @param[out] x receives the X coordinate of the point
+ * @param[out] y receives the Y coordinate of the point
+ * @param[out] empty receives 1 if the geometry is an empty point or not a point at all, 0 otherwise
+ * @param error the error stream to write errors to
+ * @return SQLITE_OK or an error code
+ */
+int pip_read_point(const spatialdb_t *spatialdb, binstream_t *stream, double *x, double *y, int *empty, errorstream_t *error);
+
+/** @} */
+
+#endif
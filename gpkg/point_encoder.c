@@ -0,0 +1,41 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "geomio.h"
+#include "gpkg_geom.h"
+#include "point_encoder.h"
+#include "sqlite.h"
+
+GPKG_EXPORT size_t GPKG_CALL gpkg_point_blob_size(int coord_type) {
+  if (coord_type < GEOM_XY || coord_type > GEOM_XYZM) {
+    return 0;
+  }
+  return gpb_point_size((coord_type_t) coord_type);
+}
+
+GPKG_EXPORT int GPKG_CALL gpkg_point_blobs_encode(int32_t srid, int coord_type, const double *coords, size_t point_count, uint8_t *blobs, size_t blobs_size) {
+  size_t blob_size = gpkg_point_blob_size(coord_type);
+  if (blob_size == 0 || point_count > blobs_size / blob_size) {
+    return SQLITE_MISUSE;
+  }
+
+  int coord_size = geom_coord_dim((coord_type_t) coord_type);
+  for (size_t i = 0; i < point_count; i++) {
+    gpb_write_point(blobs, srid, (coord_type_t) coord_type, coords);
+    blobs += blob_size;
+    coords += coord_size;
+  }
+  return SQLITE_OK;
+}
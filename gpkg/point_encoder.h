@@ -0,0 +1,62 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GPKG_POINT_ENCODER_H
+#define GPKG_POINT_ENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "gpkg.h"
+
+/**
+ * \addtogroup point_encoder Point encoding
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Returns the size of a GeoPackage point geometry blob.
+ * @param coord_type the coordinate type of the point (0 = XY, 1 = XYZ, 2 = XYM, 3 = XYZM)
+ * @return the size of the blob in bytes, or 0 if coord_type is not valid
+ */
+GPKG_EXPORT size_t GPKG_CALL gpkg_point_blob_size(int coord_type);
+
+/**
+ * Encodes points as GeoPackage geometry blobs, for instance to bind them to an INSERT statement while ingesting
+ * large numbers of points. The blobs are identical to the ones returned by ST_Point in a GeoPackage database. All
+ * blobs have the same size, so blob i starts at offset (i * gpkg_point_blob_size(coord_type)) in the output buffer.
+ *
+ * @param srid the SRID of the points
+ * @param coord_type the coordinate type of the points (0 = XY, 1 = XYZ, 2 = XYM, 3 = XYZM)
+ * @param coords the interleaved ordinates of the points. This array contains (point_count * coord_size) values. A
+ *        point with NaN X and Y ordinates is encoded as an empty point.
+ * @param point_count the number of points to encode
+ * @param[out] blobs the buffer to write the blobs to
+ * @param blobs_size the size of the blobs buffer in bytes
+ * @return SQLITE_OK on success\n
+ *         SQLITE_MISUSE if coord_type is not valid or the blobs buffer is too small
+ */
+GPKG_EXPORT int GPKG_CALL gpkg_point_blobs_encode(int32_t srid, int coord_type, const double *coords, size_t point_count, uint8_t *blobs, size_t blobs_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+
+#endif
@@ -0,0 +1,659 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <math.h>
+#include <string.h>
+#include "binstream.h"
+#include "geomio.h"
+#include "rtree_query.h"
+#include "sql.h"
+#include "sqlite.h"
+
+#if !defined(SQLITE_CORE)
+#if defined(_WIN32) || defined(WIN32) || defined(__MINGW32__)
+#include <Windows.h>
+#else
+#include <dlfcn.h>
+#endif
+#endif
+
+#define RTREE_PART_POINT 0
+#define RTREE_PART_LINE 1
+#define RTREE_PART_RING 2
+
+#define RTREE_MIN_X 0
+#define RTREE_MAX_X 1
+#define RTREE_MIN_Y 2
+#define RTREE_MAX_Y 3
+
+typedef int (*rtree_query_callback_t)(
+  sqlite3 *db,
+  const char *name,
+  int (*query)(sqlite3_rtree_query_info *),
+  void *context,
+  void (*destructor)(void *)
+);
+
+typedef struct {
+  int type;
+  size_t offset;
+  size_t point_count;
+} rtree_part_t;
+
+/*
+ * A query geometry flattened into points, line strings and polygon rings. Curves are not interpolated; if the query
+ * geometry contains any, only its envelope is used.
+ */
+typedef struct {
+  geom_consumer_t consumer;
+  double *coords;
+  size_t point_count;
+  size_t coords_capacity;
+  rtree_part_t *parts;
+  size_t part_count;
+  size_t part_capacity;
+  int has_area;
+  int approximate;
+  int empty;
+  double min_x;
+  double max_x;
+  double min_y;
+  double max_y;
+} rtree_shape_t;
+
+typedef struct {
+  int empty;
+  double x;
+  double y;
+  double distance;
+} rtree_distance_t;
+
+static void rtree_shape_free(void *data) {
+  rtree_shape_t *shape = (rtree_shape_t *) data;
+  if (shape == NULL) {
+    return;
+  }
+
+  sqlite3_free(shape->coords);
+  sqlite3_free(shape->parts);
+  sqlite3_free(shape);
+}
+
+static int rtree_shape_begin_geometry(const geom_consumer_t *consumer, const geom_header_t *header, errorstream_t *error) {
+  rtree_shape_t *shape = (rtree_shape_t *) consumer;
+  int type;
+
+  switch (header->geom_type) {
+    case GEOM_POINT:
+      type = RTREE_PART_POINT;
+      break;
+    case GEOM_LINESTRING:
+      type = RTREE_PART_LINE;
+      break;
+    case GEOM_LINEARRING:
+      type = RTREE_PART_RING;
+      shape->has_area = 1;
+      break;
+    case GEOM_CIRCULARSTRING:
+    case GEOM_COMPOUNDCURVE:
+    case GEOM_CURVEPOLYGON:
+      shape->approximate = 1;
+      return SQLITE_OK;
+    default:
+      return SQLITE_OK;
+  }
+
+  if (shape->part_count == shape->part_capacity) {
+    size_t capacity = shape->part_capacity == 0 ? 8 : shape->part_capacity * 2;
+    rtree_part_t *parts = (rtree_part_t *) sqlite3_realloc(shape->parts, (int) (capacity * sizeof(rtree_part_t)));
+    if (parts == NULL) {
+      return SQLITE_NOMEM;
+    }
+    shape->parts = parts;
+    shape->part_capacity = capacity;
+  }
+
+  rtree_part_t *part = &shape->parts[shape->part_count++];
+  part->type = type;
+  part->offset = shape->point_count;
+  part->point_count = 0;
+  return SQLITE_OK;
+}
+
+static int rtree_shape_coordinates(const geom_consumer_t *consumer, const geom_header_t *header, size_t point_count, const double *coords, int skip_coords, errorstream_t *error) {
+  rtree_shape_t *shape = (rtree_shape_t *) consumer;
+
+  if (shape->part_count == 0 || shape->approximate) {
+    return SQLITE_OK;
+  }
+
+  if (shape->point_count + point_count > shape->coords_capacity) {
+    size_t capacity = shape->coords_capacity == 0 ? 64 : shape->coords_capacity;
+    while (capacity < shape->point_count + point_count) {
+      capacity *= 2;
+    }
+    double *new_coords = (double *) sqlite3_realloc(shape->coords, (int) (capacity * 2 * sizeof(double)));
+    if (new_coords == NULL) {
+      return SQLITE_NOMEM;
+    }
+    shape->coords = new_coords;
+    shape->coords_capacity = capacity;
+  }
+
+  rtree_part_t *part = &shape->parts[shape->part_count - 1];
+  for (size_t i = (size_t) skip_coords; i < point_count * header->coord_size; i += header->coord_size) {
+    double x = coords[i];
+    double y = coords[i + 1];
+    if (isnan(x) || isnan(y)) {
+      continue;
+    }
+
+    shape->coords[shape->point_count * 2] = x;
+    shape->coords[shape->point_count * 2 + 1] = y;
+    shape->point_count++;
+    part->point_count++;
+  }
+  return SQLITE_OK;
+}
+
+static int rtree_shape_read(const spatialdb_t *spatialdb, sqlite3_value *value, rtree_shape_t **out, errorstream_t *error) {
+  geom_blob_header_t header;
+  binstream_t stream;
+  int result;
+
+  rtree_shape_t *shape = (rtree_shape_t *) sqlite3_malloc(sizeof(rtree_shape_t));
+  if (shape == NULL) {
+    return SQLITE_NOMEM;
+  }
+  memset(shape, 0, sizeof(rtree_shape_t));
+  geom_consumer_init(&shape->consumer, NULL, NULL, rtree_shape_begin_geometry, NULL, rtree_shape_coordinates);
+  shape->empty = 1;
+
+  const uint8_t *blob = (const uint8_t *) sqlite3_value_blob(value);
+  size_t length = (size_t) sqlite3_value_bytes(value);
+  if (blob == NULL || length == 0) {
+    *out = shape;
+    return SQLITE_OK;
+  }
+
+  binstream_init(&stream, (uint8_t *) blob, length);
+  result = spatialdb->read_blob_header(&stream, &header, error);
+  if (result == SQLITE_OK) {
+    result = spatialdb->read_geometry(&stream, &shape->consumer, error);
+  }
+  binstream_destroy(&stream, 0);
+
+  if (result != SQLITE_OK) {
+    rtree_shape_free(shape);
+    return result;
+  }
+
+  for (size_t i = 0; i < shape->point_count; i++) {
+    double x = shape->coords[i * 2];
+    double y = shape->coords[i * 2 + 1];
+    if (shape->empty) {
+      shape->min_x = shape->max_x = x;
+      shape->min_y = shape->max_y = y;
+      shape->empty = 0;
+    } else {
+      shape->min_x = x < shape->min_x ? x : shape->min_x;
+      shape->max_x = x > shape->max_x ? x : shape->max_x;
+      shape->min_y = y < shape->min_y ? y : shape->min_y;
+      shape->max_y = y > shape->max_y ? y : shape->max_y;
+    }
+  }
+
+  if (shape->approximate) {
+    geom_envelope_t *envelope = &header.envelope;
+    if (!envelope->has_env_x) {
+      binstream_init(&stream, (uint8_t *) blob, length);
+      result = spatialdb->read_blob_header(&stream, &header, error);
+      if (result == SQLITE_OK) {
+        result = spatialdb->fill_envelope(&stream, envelope, error);
+      }
+      binstream_destroy(&stream, 0);
+      if (result != SQLITE_OK) {
+        rtree_shape_free(shape);
+        return result;
+      }
+    }
+    shape->empty = !(envelope->has_env_x && envelope->has_env_y);
+    shape->min_x = envelope->min_x;
+    shape->max_x = envelope->max_x;
+    shape->min_y = envelope->min_y;
+    shape->max_y = envelope->max_y;
+  }
+
+  *out = shape;
+  return SQLITE_OK;
+}
+
+static int rtree_segment_intersects_box(const sqlite3_rtree_dbl *box, double x1, double y1, double x2, double y2) {
+  double p[4] = {x1 - x2, x2 - x1, y1 - y2, y2 - y1};
+  double q[4] = {x1 - box[RTREE_MIN_X], box[RTREE_MAX_X] - x1, y1 - box[RTREE_MIN_Y], box[RTREE_MAX_Y] - y1};
+  double t0 = 0.0;
+  double t1 = 1.0;
+
+  /* Liang-Barsky clipping of the segment against the box */
+  for (int i = 0; i < 4; i++) {
+    if (p[i] == 0.0) {
+      if (q[i] < 0.0) {
+        return 0;
+      }
+    } else {
+      double t = q[i] / p[i];
+      if (p[i] < 0.0) {
+        if (t > t1) {
+          return 0;
+        } else if (t > t0) {
+          t0 = t;
+        }
+      } else {
+        if (t < t0) {
+          return 0;
+        } else if (t < t1) {
+          t1 = t;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+static int rtree_shape_contains_point(const rtree_shape_t *shape, double x, double y) {
+  int inside = 0;
+
+  /* Even-odd rule over all rings, which is correct for valid (multi)polygons */
+  for (size_t i = 0; i < shape->part_count; i++) {
+    const rtree_part_t *part = &shape->parts[i];
+    if (part->type != RTREE_PART_RING || part->point_count < 3) {
+      continue;
+    }
+
+    const double *coords = shape->coords + part->offset * 2;
+    for (size_t j = 0, k = part->point_count - 1; j < part->point_count; k = j++) {
+      double xj = coords[j * 2], yj = coords[j * 2 + 1];
+      double xk = coords[k * 2], yk = coords[k * 2 + 1];
+      if ((yj > y) != (yk > y) && x < (xk - xj) * (y - yj) / (yk - yj) + xj) {
+        inside = !inside;
+      }
+    }
+  }
+  return inside;
+}
+
+/*
+ * Determines how a node or entry bounding box relates to the query geometry. Returns PARTLY_WITHIN if the box
+ * intersects the boundary or the lines and points of the geometry, FULLY_WITHIN if the box lies inside the polygonal
+ * area of the geometry and NOT_WITHIN if they are disjoint.
+ */
+static int rtree_shape_relate(const rtree_shape_t *shape, const sqlite3_rtree_dbl *box) {
+  if (shape->empty) {
+    return NOT_WITHIN;
+  }
+
+  if (box[RTREE_MIN_X] > shape->max_x || box[RTREE_MAX_X] < shape->min_x || box[RTREE_MIN_Y] > shape->max_y || box[RTREE_MAX_Y] < shape->min_y) {
+    return NOT_WITHIN;
+  }
+
+  if (shape->approximate) {
+    return PARTLY_WITHIN;
+  }
+
+  for (size_t i = 0; i < shape->part_count; i++) {
+    const rtree_part_t *part = &shape->parts[i];
+    const double *coords = shape->coords + part->offset * 2;
+
+    if (part->point_count == 1) {
+      if (coords[0] >= box[RTREE_MIN_X] && coords[0] <= box[RTREE_MAX_X] && coords[1] >= box[RTREE_MIN_Y] && coords[1] <= box[RTREE_MAX_Y]) {
+        return PARTLY_WITHIN;
+      }
+      continue;
+    }
+
+    for (size_t j = 1; j < part->point_count; j++) {
+      if (rtree_segment_intersects_box(box, coords[j * 2 - 2], coords[j * 2 - 1], coords[j * 2], coords[j * 2 + 1])) {
+        return PARTLY_WITHIN;
+      }
+    }
+  }
+
+  /* The boundary does not cross the box, so the box is either completely inside or completely outside */
+  if (shape->has_area && rtree_shape_contains_point(shape, box[RTREE_MIN_X], box[RTREE_MIN_Y])) {
+    return FULLY_WITHIN;
+  }
+
+  return NOT_WITHIN;
+}
+
+/*
+ * The R*Tree module does not pass on error messages from query callbacks; it aborts the statement with the returned
+ * error code only. Invalid query arguments are therefore reported as SQLITE_MISMATCH ('datatype mismatch'), which
+ * is not used by the module itself, and the actual message is written to the SQLite error log.
+ */
+static int rtree_query_error(const char *function_name, errorstream_t *error) {
+  char *message = error_message(error);
+  size_t length = strlen(message);
+  while (length > 0 && message[length - 1] == '\n') {
+    length--;
+  }
+  sqlite3_log(SQLITE_MISMATCH, "%s: %.*s", function_name, (int) length, message);
+  return SQLITE_MISMATCH;
+}
+
+static int rtree_query_shape(sqlite3_rtree_query_info *info, const char *function_name, rtree_shape_t **shape) {
+  if (info->pUser == NULL) {
+    char error_buffer[256];
+    errorstream_t error;
+    int result;
+
+    error_init_fixed(&error, error_buffer, 256);
+    if (info->nParam != 1 || info->nCoord < 4) {
+      error_append(&error, "Expected a single geometry argument and a two dimensional index");
+      return rtree_query_error(function_name, &error);
+    }
+
+    result = rtree_shape_read((const spatialdb_t *) info->pContext, info->apSqlParam[0], shape, &error);
+    if (result == SQLITE_NOMEM) {
+      return result;
+    } else if (result != SQLITE_OK) {
+      if (error_count(&error) == 0) {
+        error_append(&error, "Invalid query geometry");
+      }
+      return rtree_query_error(function_name, &error);
+    }
+    info->pUser = *shape;
+    info->xDelUser = rtree_shape_free;
+  }
+
+  *shape = (rtree_shape_t *) info->pUser;
+  return SQLITE_OK;
+}
+
+static int rtree_intersects(sqlite3_rtree_query_info *info) {
+  rtree_shape_t *shape;
+  int result = rtree_query_shape(info, "gpkg_rtree_intersects", &shape);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  if (info->eParentWithin == FULLY_WITHIN) {
+    info->eWithin = FULLY_WITHIN;
+  } else {
+    info->eWithin = rtree_shape_relate(shape, info->aCoord);
+  }
+  return SQLITE_OK;
+}
+
+static int rtree_polygon(sqlite3_rtree_query_info *info) {
+  rtree_shape_t *shape;
+  int result = rtree_query_shape(info, "gpkg_rtree_polygon", &shape);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  if (info->eParentWithin == FULLY_WITHIN) {
+    info->eWithin = FULLY_WITHIN;
+    return SQLITE_OK;
+  }
+
+  int within = rtree_shape_relate(shape, info->aCoord);
+  if (within == PARTLY_WITHIN && info->iLevel == 0 && !shape->approximate) {
+    /* Entries crossing the boundary are not inside the polygon; nodes may still contain entries that are */
+    within = NOT_WITHIN;
+  }
+  info->eWithin = within;
+  return SQLITE_OK;
+}
+
+static int rtree_distance_read(sqlite3_rtree_query_info *info, rtree_distance_t **out, errorstream_t *error) {
+  rtree_distance_t *distance = (rtree_distance_t *) sqlite3_malloc(sizeof(rtree_distance_t));
+  if (distance == NULL) {
+    return SQLITE_NOMEM;
+  }
+  memset(distance, 0, sizeof(rtree_distance_t));
+
+  if (info->nParam == 3) {
+    distance->x = info->aParam[0];
+    distance->y = info->aParam[1];
+    distance->distance = info->aParam[2];
+  } else if (info->nParam == 2) {
+    rtree_shape_t *shape = NULL;
+    int result = rtree_shape_read((const spatialdb_t *) info->pContext, info->apSqlParam[0], &shape, error);
+    if (result != SQLITE_OK) {
+      sqlite3_free(distance);
+      return result;
+    }
+
+    if (shape->empty) {
+      distance->empty = 1;
+    } else if (shape->point_count == 1 && shape->part_count == 1 && !shape->approximate) {
+      distance->x = shape->coords[0];
+      distance->y = shape->coords[1];
+    } else {
+      error_append(error, "Query geometry must be a point");
+      result = SQLITE_ERROR;
+    }
+    distance->distance = info->aParam[1];
+    rtree_shape_free(shape);
+
+    if (result != SQLITE_OK) {
+      sqlite3_free(distance);
+      return result;
+    }
+  } else {
+    error_append(error, "Expected (point, distance) or (x, y, distance) arguments");
+    sqlite3_free(distance);
+    return SQLITE_ERROR;
+  }
+
+  *out = distance;
+  return SQLITE_OK;
+}
+
+static int rtree_within_distance(sqlite3_rtree_query_info *info) {
+  rtree_distance_t *distance = (rtree_distance_t *) info->pUser;
+
+  if (distance == NULL) {
+    char error_buffer[256];
+    errorstream_t error;
+    int result;
+
+    error_init_fixed(&error, error_buffer, 256);
+    if (info->nCoord < 4) {
+      error_append(&error, "Expected a two dimensional index");
+      return rtree_query_error("gpkg_rtree_within_distance", &error);
+    }
+
+    result = rtree_distance_read(info, &distance, &error);
+    if (result == SQLITE_NOMEM) {
+      return result;
+    } else if (result != SQLITE_OK) {
+      if (error_count(&error) == 0) {
+        error_append(&error, "Invalid query geometry");
+      }
+      return rtree_query_error("gpkg_rtree_within_distance", &error);
+    }
+    info->pUser = distance;
+    info->xDelUser = sqlite3_free;
+  }
+
+  if (distance->empty) {
+    info->eWithin = NOT_WITHIN;
+    return SQLITE_OK;
+  }
+
+  const sqlite3_rtree_dbl *box = info->aCoord;
+  double dx = fmax(fmax(box[RTREE_MIN_X] - distance->x, distance->x - box[RTREE_MAX_X]), 0.0);
+  double dy = fmax(fmax(box[RTREE_MIN_Y] - distance->y, distance->y - box[RTREE_MAX_Y]), 0.0);
+  double nearest = sqrt(dx * dx + dy * dy);
+
+  if (nearest > distance->distance) {
+    info->eWithin = NOT_WITHIN;
+    return SQLITE_OK;
+  }
+
+  double far_x = fmax(fabs(box[RTREE_MIN_X] - distance->x), fabs(box[RTREE_MAX_X] - distance->x));
+  double far_y = fmax(fabs(box[RTREE_MIN_Y] - distance->y), fabs(box[RTREE_MAX_Y] - distance->y));
+  info->eWithin = sqrt(far_x * far_x + far_y * far_y) <= distance->distance ? FULLY_WITHIN : PARTLY_WITHIN;
+
+  /* The R*Tree visits nodes and returns entries in order of increasing score, giving nearest first results */
+  info->rScore = nearest;
+  return SQLITE_OK;
+}
+
+#if !defined(SQLITE_CORE)
+/*
+ * ISO C does not allow conversions between function and object pointers, but the symbol lookup functions work with
+ * both. The conversions go through this union instead of a cast.
+ */
+typedef union {
+  const char *(*libversion)(void);
+  rtree_query_callback_t query_callback;
+  void *address;
+#if defined(_WIN32) || defined(WIN32) || defined(__MINGW32__)
+  FARPROC proc;
+#endif
+} rtree_symbol_t;
+#endif
+
+/*
+ * sqlite3_rtree_query_callback is not part of the loadable extension API. When built as an extension, the function
+ * is looked up in the module that provides the SQLite API instead.
+ */
+static rtree_query_callback_t rtree_query_resolve() {
+#if defined(SQLITE_CORE)
+  return sqlite3_rtree_query_callback;
+#elif defined(_WIN32) || defined(WIN32) || defined(__MINGW32__)
+  HMODULE module = NULL;
+  rtree_symbol_t symbol;
+  symbol.libversion = sqlite3_api->libversion;
+  if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCSTR) symbol.address, &module)) {
+    return NULL;
+  }
+  symbol.proc = GetProcAddress(module, "sqlite3_rtree_query_callback");
+  return symbol.query_callback;
+#else
+  rtree_symbol_t symbol;
+  Dl_info info;
+  void *module = NULL;
+
+  symbol.libversion = sqlite3_api->libversion;
+  if (dladdr(symbol.address, &info) != 0 && info.dli_fname != NULL) {
+#ifdef RTLD_NOLOAD
+    module = dlopen(info.dli_fname, RTLD_LAZY | RTLD_NOLOAD);
+#else
+    module = dlopen(info.dli_fname, RTLD_LAZY);
+#endif
+  }
+  if (module == NULL) {
+    /* SQLite is linked into the executable */
+    module = dlopen(NULL, RTLD_LAZY);
+  }
+  symbol.address = NULL;
+  if (module != NULL) {
+    symbol.address = dlsym(module, "sqlite3_rtree_query_callback");
+    dlclose(module);
+  }
+  return symbol.query_callback;
+#endif
+}
+
+void rtree_query_init(sqlite3 *db, const spatialdb_t *spatialdb, errorstream_t *error) {
+  /* Query callbacks need access to the original parameter values, which was added in 3.8.11 */
+  if (sqlite3_libversion_number() < 3008011) {
+    return;
+  }
+
+  rtree_query_callback_t query_callback = rtree_query_resolve();
+  if (query_callback == NULL) {
+    return;
+  }
+
+  const char *names[] = {"gpkg_rtree_intersects", "gpkg_rtree_polygon", "gpkg_rtree_within_distance"};
+  int (*callbacks[])(sqlite3_rtree_query_info *) = {rtree_intersects, rtree_polygon, rtree_within_distance};
+  for (int i = 0; i < 3; i++) {
+    int result = query_callback(db, names[i], callbacks[i], (void *) spatialdb, NULL);
+    if (result != SQLITE_OK) {
+      error_append(error, "Error registering function %s: %s", names[i], sqlite3_errmsg(db));
+    }
+  }
+}
+
+/*
+ * Reads a big endian single precision float from an R*Tree node.
+ */
+static double rtree_node_float(const uint8_t *data) {
+  uint32_t bits = ((uint32_t) data[0] << 24) | ((uint32_t) data[1] << 16) | ((uint32_t) data[2] << 8) | (uint32_t) data[3];
+  float value;
+  memcpy(&value, &bits, sizeof(float));
+  return (double) value;
+}
+
+static int rtree_root_row(sqlite3 *db, sqlite3_stmt *stmt, void *data) {
+  geom_envelope_t *envelope = (geom_envelope_t *) data;
+  const uint8_t *node = (const uint8_t *) sqlite3_column_blob(stmt, 0);
+  size_t length = (size_t) sqlite3_column_bytes(stmt, 0);
+
+  /* A node starts with its depth and cell count, followed by cells holding a rowid and min/max per dimension */
+  if (node == NULL || length < 4) {
+    return SQLITE_CORRUPT;
+  }
+  size_t cell_count = ((size_t) node[2] << 8) | node[3];
+  size_t cell_size = 8 + 4 * 4;
+  if (4 + cell_count * cell_size > length) {
+    return SQLITE_CORRUPT;
+  }
+
+  for (size_t i = 0; i < cell_count; i++) {
+    const uint8_t *cell = node + 4 + i * cell_size + 8;
+    double min_x = rtree_node_float(cell);
+    double max_x = rtree_node_float(cell + 4);
+    double min_y = rtree_node_float(cell + 8);
+    double max_y = rtree_node_float(cell + 12);
+    if (min_x < envelope->min_x) {
+      envelope->min_x = min_x;
+    }
+    if (max_x > envelope->max_x) {
+      envelope->max_x = max_x;
+    }
+    if (min_y < envelope->min_y) {
+      envelope->min_y = min_y;
+    }
+    if (!envelope->has_env_y || max_y > envelope->max_y) {
+      envelope->max_y = max_y;
+    }
+    envelope->has_env_x = 1;
+    envelope->has_env_y = 1;
+  }
+  return SQLITE_OK;
+}
+
+int rtree_query_extent(sqlite3 *db, const char *db_name, const char *index_table, geom_envelope_t *envelope, errorstream_t *error) {
+  geom_envelope_init(envelope);
+
+  /* The root node of an R*Tree is always node 1 */
+  int result = sql_exec_stmt(db, rtree_root_row, NULL, envelope, "SELECT data FROM \"%w\".\"%w_node\" WHERE nodeno = 1", db_name, index_table);
+  if (result == SQLITE_CORRUPT) {
+    error_append(error, "Invalid root node in spatial index %s", index_table);
+  } else if (result != SQLITE_OK) {
+    error_append(error, "Could not read spatial index %s: %s", index_table, sqlite3_errmsg(db));
+  }
+  return result;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GPKG_RTREE_QUERY_H
+#define GPKG_RTREE_QUERY_H
+
+#include "error.h"
+#include "geomio.h"
+#include "spatialdb.h"
+#include "sqlite.h"
+
+/**
+ * \addtogroup rtree_query Spatial index query functions
+ *
+ * Query functions for use with the MATCH operator on spatial index tables. Unlike a range query on the index
+ * columns, these functions test index nodes against the query geometry itself rather than its bounding box, so that
+ * diagonal or irregular search areas visit fewer index nodes.
+ *
+ * - gpkg_rtree_intersects(geom): entries whose bounding box intersects geom
+ * - gpkg_rtree_polygon(geom): entries whose bounding box lies completely inside the polygonal area of geom
+ * - gpkg_rtree_within_distance(point, r) or gpkg_rtree_within_distance(x, y, r): entries whose bounding box is
+ *   within distance r of the point. Entries are returned nearest first.
+ *
+ * Example: SELECT id FROM rtree_roads_geom WHERE id MATCH gpkg_rtree_intersects(:area)
+ *
+ * The functions are only available if SQLite was built with the R*Tree module and is version 3.8.11 or later.
+ * Invalid query geometries abort the query with SQLITE_MISMATCH. The R*Tree module does not report messages from
+ * query functions, so the reason is written to the SQLite error log (see SQLITE_CONFIG_LOG).
+ * @{
+ */
+
+/**
+ * Registers the spatial index query functions with a database connection.
+ * @param db the database connection
+ * @param spatialdb the spatial database schema used to decode geometry blobs
+ * @param error the error stream to write errors to
+ */
+void rtree_query_init(sqlite3 *db, const spatialdb_t *spatialdb, errorstream_t *error);
+
+/**
+ * Determines the extent of all entries of a two dimensional spatial index from the cells of its root node, without
+ * visiting any other node. SQLite stores index coordinates as single precision floats rounded outwards, so the
+ * extent may be slightly larger than the exact extent of the indexed geometries.
+ * @param db the database connection
+ * @param db_name the database name (e.g. "main")
+ * @param index_table the name of the R*Tree virtual table
+ * @param[out] envelope receives the extent. has_env_x and has_env_y are set to 0 if the index is empty.
+ * @param error the error stream to write errors to
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+int rtree_query_extent(sqlite3 *db, const char *db_name, const char *index_table, geom_envelope_t *envelope, errorstream_t *error);
+
+/** @} */
+
+#endif
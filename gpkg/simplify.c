@@ -0,0 +1,282 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <limits.h>
+#include <string.h>
+#include "simplify.h"
+#include "sqlite.h"
+
+static int simplify_is_sequence(const geom_header_t *header) {
+  return header->geom_type == GEOM_LINESTRING || header->geom_type == GEOM_LINEARRING;
+}
+
+/*
+ * Returns the squared distance from point p to the segment from a to b.
+ */
+static double simplify_distance2(const double *p, const double *a, const double *b) {
+  double dx = b[0] - a[0];
+  double dy = b[1] - a[1];
+  double len2 = dx * dx + dy * dy;
+  double x = a[0];
+  double y = a[1];
+
+  if (len2 > 0) {
+    double t = ((p[0] - a[0]) * dx + (p[1] - a[1]) * dy) / len2;
+    if (t >= 1) {
+      x = b[0];
+      y = b[1];
+    } else if (t > 0) {
+      x += t * dx;
+      y += t * dy;
+    }
+  }
+
+  x = p[0] - x;
+  y = p[1] - y;
+  return x * x + y * y;
+}
+
+/*
+ * Returns the index of the vertex in (first, last) furthest from the segment between first and last, or first if
+ * there is no such vertex. Vertices that are already kept are skipped.
+ */
+static size_t simplify_furthest(geom_simplifier_t *simplifier, uint32_t coord_size, size_t first, size_t last, double *distance2) {
+  const double *coords = simplifier->coords;
+  const double *a = &coords[first * coord_size];
+  const double *b = &coords[last * coord_size];
+  size_t furthest = first;
+
+  *distance2 = -1;
+  for (size_t i = first + 1; i < last; i++) {
+    if (simplifier->keep[i]) {
+      continue;
+    }
+    double d = simplify_distance2(&coords[i * coord_size], a, b);
+    if (d > *distance2) {
+      *distance2 = d;
+      furthest = i;
+    }
+  }
+  return furthest;
+}
+
+static int simplify_reserve(geom_simplifier_t *simplifier, uint32_t coord_size, size_t point_count) {
+  if (point_count <= simplifier->point_capacity) {
+    return SQLITE_OK;
+  }
+
+  size_t capacity = simplifier->point_capacity == 0 ? 256 : simplifier->point_capacity;
+  while (capacity < point_count) {
+    capacity *= 2;
+  }
+  if (capacity > INT_MAX / (GEOM_MAX_COORD_SIZE * sizeof(double))) {
+    return SQLITE_NOMEM;
+  }
+
+  double *coords = (double *) sqlite3_realloc(simplifier->coords, (int) (capacity * GEOM_MAX_COORD_SIZE * sizeof(double)));
+  if (coords == NULL) {
+    return SQLITE_NOMEM;
+  }
+  simplifier->coords = coords;
+
+  uint8_t *keep = (uint8_t *) sqlite3_realloc(simplifier->keep, (int) capacity);
+  if (keep == NULL) {
+    return SQLITE_NOMEM;
+  }
+  simplifier->keep = keep;
+
+  size_t *stack = (size_t *) sqlite3_realloc(simplifier->stack, (int) (capacity * 2 * sizeof(size_t)));
+  if (stack == NULL) {
+    return SQLITE_NOMEM;
+  }
+  simplifier->stack = stack;
+
+  simplifier->point_capacity = capacity;
+  return SQLITE_OK;
+}
+
+/*
+ * Marks the vertices of the buffered sequence that are retained. The recursion of the Douglas-Peucker algorithm is
+ * replaced by an explicit stack of index ranges so that very long sequences cannot overflow the call stack.
+ * Returns the number of retained vertices.
+ */
+static size_t simplify_mark(geom_simplifier_t *simplifier, uint32_t coord_size) {
+  size_t last = simplifier->point_count - 1;
+  double tolerance2 = simplifier->tolerance * simplifier->tolerance;
+  size_t *stack = simplifier->stack;
+  size_t depth = 0;
+  size_t kept = 2;
+
+  memset(simplifier->keep, 0, simplifier->point_count);
+  simplifier->keep[0] = 1;
+  simplifier->keep[last] = 1;
+
+  stack[depth++] = 0;
+  stack[depth++] = last;
+  while (depth > 0) {
+    size_t to = stack[--depth];
+    size_t from = stack[--depth];
+    double distance2;
+    size_t furthest = simplify_furthest(simplifier, coord_size, from, to, &distance2);
+    if (furthest != from && distance2 > tolerance2) {
+      simplifier->keep[furthest] = 1;
+      kept++;
+      stack[depth++] = from;
+      stack[depth++] = furthest;
+      stack[depth++] = furthest;
+      stack[depth++] = to;
+    }
+  }
+
+  return kept;
+}
+
+/*
+ * Keeps the vertex furthest from the ranges between the retained vertices until a linear ring has at least four
+ * points, so that it does not collapse.
+ */
+static size_t simplify_keep_ring(geom_simplifier_t *simplifier, uint32_t coord_size, size_t kept) {
+  while (kept < 4) {
+    size_t best = 0;
+    double best_distance2 = -1;
+    size_t from = 0;
+    for (size_t i = 1; i < simplifier->point_count; i++) {
+      if (!simplifier->keep[i]) {
+        continue;
+      }
+      double distance2;
+      size_t furthest = simplify_furthest(simplifier, coord_size, from, i, &distance2);
+      if (furthest != from && distance2 > best_distance2) {
+        best_distance2 = distance2;
+        best = furthest;
+      }
+      from = i;
+    }
+    if (best == 0) {
+      break;
+    }
+    simplifier->keep[best] = 1;
+    kept++;
+  }
+  return kept;
+}
+
+static int simplify_flush(geom_simplifier_t *simplifier, const geom_header_t *header, errorstream_t *error) {
+  uint32_t coord_size = header->coord_size;
+  size_t point_count = simplifier->point_count;
+
+  int ring = header->geom_type == GEOM_LINEARRING;
+  if (point_count > (ring ? 4 : 2)) {
+    size_t kept = simplify_mark(simplifier, coord_size);
+    if (ring) {
+      kept = simplify_keep_ring(simplifier, coord_size, kept);
+    }
+
+    double *coords = simplifier->coords;
+    size_t j = 0;
+    for (size_t i = 0; i < point_count; i++) {
+      if (simplifier->keep[i]) {
+        if (i != j) {
+          memcpy(&coords[j * coord_size], &coords[i * coord_size], coord_size * sizeof(double));
+        }
+        j++;
+      }
+    }
+    point_count = kept;
+  }
+
+  simplifier->point_count = 0;
+  if (point_count == 0) {
+    return SQLITE_OK;
+  }
+  return simplifier->target->coordinates(simplifier->target, header, point_count, simplifier->coords, 0, error);
+}
+
+static int simplify_begin(const geom_consumer_t *consumer, errorstream_t *error) {
+  geom_simplifier_t *simplifier = (geom_simplifier_t *) consumer;
+  return simplifier->target->begin(simplifier->target, error);
+}
+
+static int simplify_end(const geom_consumer_t *consumer, errorstream_t *error) {
+  geom_simplifier_t *simplifier = (geom_simplifier_t *) consumer;
+  return simplifier->target->end(simplifier->target, error);
+}
+
+static int simplify_begin_geometry(const geom_consumer_t *consumer, const geom_header_t *header, errorstream_t *error) {
+  geom_simplifier_t *simplifier = (geom_simplifier_t *) consumer;
+  simplifier->buffering = simplify_is_sequence(header);
+  simplifier->point_count = 0;
+  return simplifier->target->begin_geometry(simplifier->target, header, error);
+}
+
+static int simplify_end_geometry(const geom_consumer_t *consumer, const geom_header_t *header, errorstream_t *error) {
+  geom_simplifier_t *simplifier = (geom_simplifier_t *) consumer;
+
+  if (simplifier->buffering) {
+    simplifier->buffering = 0;
+    int result = simplify_flush(simplifier, header, error);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+  }
+
+  return simplifier->target->end_geometry(simplifier->target, header, error);
+}
+
+static int simplify_coordinates(const geom_consumer_t *consumer, const geom_header_t *header, size_t point_count, const double *coords, int skip_coords, errorstream_t *error) {
+  geom_simplifier_t *simplifier = (geom_simplifier_t *) consumer;
+
+  if (!simplifier->buffering) {
+    return simplifier->target->coordinates(simplifier->target, header, point_count, coords, skip_coords, error);
+  }
+
+  int result = simplify_reserve(simplifier, header->coord_size, simplifier->point_count + point_count);
+  if (result != SQLITE_OK) {
+    if (error) {
+      error_append(error, "Could not allocate simplification buffer");
+    }
+    return result;
+  }
+
+  memcpy(&simplifier->coords[simplifier->point_count * header->coord_size], coords, point_count * header->coord_size * sizeof(double));
+  simplifier->point_count += point_count;
+  return SQLITE_OK;
+}
+
+void geom_simplifier_init(geom_simplifier_t *simplifier, const geom_consumer_t *target, double tolerance) {
+  geom_consumer_init(&simplifier->geom_consumer, simplify_begin, simplify_end, simplify_begin_geometry, simplify_end_geometry, simplify_coordinates);
+  simplifier->target = target;
+  simplifier->tolerance = tolerance;
+  simplifier->buffering = 0;
+  simplifier->coords = NULL;
+  simplifier->point_count = 0;
+  simplifier->point_capacity = 0;
+  simplifier->keep = NULL;
+  simplifier->stack = NULL;
+}
+
+void geom_simplifier_destroy(geom_simplifier_t *simplifier) {
+  sqlite3_free(simplifier->coords);
+  sqlite3_free(simplifier->keep);
+  sqlite3_free(simplifier->stack);
+  simplifier->coords = NULL;
+  simplifier->keep = NULL;
+  simplifier->stack = NULL;
+  simplifier->point_capacity = 0;
+}
+
+geom_consumer_t *geom_simplifier_geom_consumer(geom_simplifier_t *simplifier) {
+  return &simplifier->geom_consumer;
+}
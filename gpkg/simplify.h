@@ -0,0 +1,84 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GPKG_SIMPLIFY_H
+#define GPKG_SIMPLIFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "error.h"
+#include "geomio.h"
+
+/**
+ * \addtogroup simplify Geometry simplification
+ * @{
+ */
+
+/**
+ * A Douglas-Peucker geometry simplifier. geom_simplifier_t instances are geometry consumers that pass a simplified
+ * version of the geometry they receive on to another consumer, so they can be placed between any geometry source and
+ * any geometry writer. Use geom_simplifier_geom_consumer() to obtain a geom_consumer_t pointer that can be passed to
+ * geometry sources.
+ *
+ * Only the coordinates of the line string or linear ring that is currently being read are buffered. Points, circular
+ * strings and the structure of the geometry are passed on unchanged. Distances are computed in the XY plane; Z and M
+ * values of the retained vertices are kept. Line strings always keep their end points and linear rings always keep at
+ * least four points, so simplification never removes parts or rings from a geometry.
+ */
+typedef struct {
+  /** @private */
+  geom_consumer_t geom_consumer;
+  /** @private */
+  const geom_consumer_t *target;
+  /** @private */
+  double tolerance;
+  /** @private */
+  int buffering;
+  /** @private */
+  double *coords;
+  /** @private */
+  size_t point_count;
+  /** @private */
+  size_t point_capacity;
+  /** @private */
+  uint8_t *keep;
+  /** @private */
+  size_t *stack;
+} geom_simplifier_t;
+
+/**
+ * Initializes a geometry simplifier.
+ * @param simplifier the simplifier to initialize
+ * @param target the consumer the simplified geometry is passed to
+ * @param tolerance the maximum distance between a removed vertex and the simplified line
+ */
+void geom_simplifier_init(geom_simplifier_t *simplifier, const geom_consumer_t *target, double tolerance);
+
+/**
+ * Destroys a geometry simplifier and releases its buffers.
+ * @param simplifier the simplifier to destroy
+ */
+void geom_simplifier_destroy(geom_simplifier_t *simplifier);
+
+/**
+ * Returns a geometry simplifier as a geometry consumer. This function should be used
+ * to pass the simplifier to another function that takes a geom_consumer_t as input.
+ * @param simplifier the simplifier
+ */
+geom_consumer_t *geom_simplifier_geom_consumer(geom_simplifier_t *simplifier);
+
+/** @} */
+
+#endif
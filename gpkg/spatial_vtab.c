@@ -0,0 +1,674 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <math.h>
+#include <string.h>
+#include "binstream.h"
+#include "blobio.h"
+#include "spatial_vtab.h"
+#include "sql.h"
+#include "sqlite.h"
+
+/*
+ * Spatial predicates that can be answered using the spatial index. The values are offsets from
+ * SQLITE_INDEX_CONSTRAINT_FUNCTION and are also used as characters in idxStr.
+ */
+#define SPATIAL_OP_INTERSECTS 1
+#define SPATIAL_OP_CONTAINS 2
+#define SPATIAL_OP_WITHIN 3
+#define SPATIAL_OP_COUNT 4
+
+#define SPATIAL_PLAN_SCAN 0
+#define SPATIAL_PLAN_ROWID 1
+#define SPATIAL_PLAN_INDEX 2
+
+/*
+ * The maximum number of spatial constraints that are pushed down into a single index scan.
+ */
+#define SPATIAL_MAX_CONSTRAINTS 8
+
+#if SQLITE_VERSION_NUMBER >= 3025000
+#define SPATIAL_HAVE_FUNCTION_CONSTRAINTS 1
+#endif
+
+/*
+ * The exact predicate for rows produced by an index scan. SQLite always evaluates the predicate for every row since
+ * the spatial index only contains envelopes; this is done by running the SQL function that is registered under the
+ * predicate name, so the result is exactly the same as without the virtual table.
+ */
+typedef struct {
+  const char *name;
+  sqlite3_stmt *stmt;
+} spatial_refine_t;
+
+typedef struct {
+  sqlite3_vtab base;
+  sqlite3 *db;
+  const spatialdb_t *spatialdb;
+  int column_count;
+  int geometry_column;
+  char *select_sql;
+  char *rowid_column;
+  char *index_sql;
+  int index_is_spatialite;
+  spatial_refine_t refine[SPATIAL_OP_COUNT];
+} spatial_vtab_t;
+
+typedef struct {
+  sqlite3_vtab_cursor base;
+  sqlite3_stmt *stmt;
+  int idx_num;
+  char *idx_str;
+  int eof;
+} spatial_cursor_t;
+
+static const char *spatial_op_names[SPATIAL_OP_COUNT] = {
+  NULL,
+  "ST_Intersects",
+  "ST_Contains",
+  "ST_Within"
+};
+
+static void spatial_vtab_free(spatial_vtab_t *vtab) {
+  if (vtab == NULL) {
+    return;
+  }
+
+  for (int i = 0; i < SPATIAL_OP_COUNT; i++) {
+    sqlite3_finalize(vtab->refine[i].stmt);
+  }
+  sqlite3_free(vtab->select_sql);
+  sqlite3_free(vtab->rowid_column);
+  sqlite3_free(vtab->index_sql);
+  sqlite3_free(vtab);
+}
+
+static char *spatial_dequote(const char *value) {
+  size_t length = strlen(value);
+  char quote = value[0];
+
+  if (length < 2 || (quote != '"' && quote != '\'' && quote != '`' && quote != '[')) {
+    return sqlite3_mprintf("%s", value);
+  }
+
+  char end = quote == '[' ? ']' : quote;
+  char *result = sqlite3_malloc((int) length);
+  if (result == NULL) {
+    return NULL;
+  }
+
+  size_t j = 0;
+  for (size_t i = 1; i < length - 1; i++) {
+    result[j++] = value[i];
+    if (value[i] == end && value[i + 1] == end) {
+      i++;
+    }
+  }
+  result[j] = '\0';
+  return result;
+}
+
+typedef struct {
+  spatial_vtab_t *vtab;
+  const char *geometry_column;
+  char *declaration;
+  char *columns;
+  char *pk_column;
+  int pk_count;
+} spatial_columns_t;
+
+static int spatial_column_row(sqlite3 *db, sqlite3_stmt *stmt, void *data) {
+  spatial_columns_t *c = (spatial_columns_t *) data;
+  const char *name = (const char *) sqlite3_column_text(stmt, 1);
+  const char *type = (const char *) sqlite3_column_text(stmt, 2);
+  const char *separator = c->vtab->column_count == 0 ? "" : ", ";
+
+  if (name == NULL) {
+    return SQLITE_OK;
+  }
+
+  if (c->geometry_column != NULL && sqlite3_stricmp(name, c->geometry_column) == 0) {
+    c->vtab->geometry_column = c->vtab->column_count;
+  }
+
+  if (sqlite3_column_int(stmt, 5) > 0) {
+    c->pk_count++;
+    if (type != NULL && sqlite3_stricmp(type, "INTEGER") == 0) {
+      sqlite3_free(c->pk_column);
+      c->pk_column = sqlite3_mprintf("%s", name);
+      if (c->pk_column == NULL) {
+        return SQLITE_NOMEM;
+      }
+    }
+  }
+
+  char *declaration = sqlite3_mprintf("%z%s\"%w\" %s", c->declaration, separator, name, type != NULL ? type : "");
+  c->declaration = declaration;
+  char *columns = sqlite3_mprintf("%z, \"%w\"", c->columns, name);
+  c->columns = columns;
+  if (declaration == NULL || columns == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  c->vtab->column_count++;
+  return SQLITE_OK;
+}
+
+static int spatial_connect(sqlite3 *db, void *aux, int argc, const char *const *argv, sqlite3_vtab **vtab_out, char **err) {
+  int result = SQLITE_OK;
+  spatial_vtab_t *vtab = NULL;
+  char *schema = NULL;
+  char *table = NULL;
+  char *geometry_column = NULL;
+  char *prefix = NULL;
+  char *index_table = NULL;
+  int index_exists = 0;
+  spatial_columns_t columns;
+
+  memset(&columns, 0, sizeof(spatial_columns_t));
+
+  if (argc < 4 || argc > 5) {
+    *err = sqlite3_mprintf("usage: CREATE VIRTUAL TABLE name USING gpkg_spatial(table [, geometry column])");
+    return SQLITE_ERROR;
+  }
+
+  vtab = (spatial_vtab_t *) sqlite3_malloc(sizeof(spatial_vtab_t));
+  if (vtab == NULL) {
+    return SQLITE_NOMEM;
+  }
+  memset(vtab, 0, sizeof(spatial_vtab_t));
+  vtab->db = db;
+  vtab->spatialdb = (const spatialdb_t *) aux;
+  vtab->geometry_column = -1;
+  for (int i = 1; i < SPATIAL_OP_COUNT; i++) {
+    vtab->refine[i].name = spatial_op_names[i];
+  }
+
+  /* The table may be qualified with a schema name; otherwise SQLite's normal name resolution applies */
+  table = spatial_dequote(argv[3]);
+  if (table == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+  char *dot = strchr(table, '.');
+  if (dot != NULL && argv[3][0] != '"' && argv[3][0] != '`' && argv[3][0] != '[') {
+    *dot = '\0';
+    schema = table;
+    table = sqlite3_mprintf("%s", dot + 1);
+    if (table == NULL) {
+      result = SQLITE_NOMEM;
+      goto exit;
+    }
+  }
+  prefix = schema != NULL ? sqlite3_mprintf("\"%w\".", schema) : sqlite3_mprintf("");
+  if (prefix == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  if (argc == 5) {
+    geometry_column = spatial_dequote(argv[4]);
+  } else {
+    result = sql_exec_for_string(db, &geometry_column, "SELECT column_name FROM %sgpkg_geometry_columns WHERE table_name LIKE %Q", prefix, table);
+    if (result != SQLITE_OK || geometry_column == NULL) {
+      result = sql_exec_for_string(db, &geometry_column, "SELECT f_geometry_column FROM %sgeometry_columns WHERE f_table_name LIKE %Q", prefix, table);
+    }
+    if (result != SQLITE_OK || geometry_column == NULL) {
+      *err = sqlite3_mprintf("%s is not a registered feature table; specify the geometry column explicitly", table);
+      result = SQLITE_ERROR;
+      goto exit;
+    }
+  }
+  if (geometry_column == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  columns.vtab = vtab;
+  columns.geometry_column = geometry_column;
+  result = sql_exec_stmt(db, spatial_column_row, NULL, &columns, "PRAGMA %stable_info(\"%w\")", prefix, table);
+  if (result != SQLITE_OK) {
+    *err = sqlite3_mprintf("could not read columns of %s: %s", table, sqlite3_errmsg(db));
+    goto exit;
+  }
+  if (vtab->column_count == 0) {
+    *err = sqlite3_mprintf("no such table: %s", table);
+    result = SQLITE_ERROR;
+    goto exit;
+  }
+  if (vtab->geometry_column < 0) {
+    *err = sqlite3_mprintf("no such column: %s.%s", table, geometry_column);
+    result = SQLITE_ERROR;
+    goto exit;
+  }
+
+  /* An INTEGER PRIMARY KEY is an alias for the rowid, which is also the id used by the spatial index */
+  if (columns.pk_count == 1 && columns.pk_column != NULL) {
+    vtab->rowid_column = sqlite3_mprintf("\"%w\"", columns.pk_column);
+  } else {
+    vtab->rowid_column = sqlite3_mprintf("rowid");
+  }
+  vtab->select_sql = sqlite3_mprintf("SELECT %s%s FROM %s\"%w\"", vtab->rowid_column, columns.columns, prefix, table);
+  if (vtab->rowid_column == NULL || vtab->select_sql == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  index_table = sqlite3_mprintf("rtree_%s_%s", table, geometry_column);
+  if (index_table == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+  sql_check_table_exists(db, schema != NULL ? schema : "main", index_table, &index_exists);
+  if (!index_exists) {
+    sqlite3_free(index_table);
+    index_table = sqlite3_mprintf("idx_%s_%s", table, geometry_column);
+    if (index_table == NULL) {
+      result = SQLITE_NOMEM;
+      goto exit;
+    }
+    sql_check_table_exists(db, schema != NULL ? schema : "main", index_table, &index_exists);
+    vtab->index_is_spatialite = 1;
+  }
+  if (index_exists) {
+    vtab->index_sql = sqlite3_mprintf(
+      "SELECT %s FROM %s\"%w\"",
+      vtab->index_is_spatialite ? "pkid" : "id", prefix, index_table
+    );
+    if (vtab->index_sql == NULL) {
+      result = SQLITE_NOMEM;
+      goto exit;
+    }
+  }
+
+  char *create_sql = sqlite3_mprintf("CREATE TABLE x(%s)", columns.declaration);
+  if (create_sql == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+  result = sqlite3_declare_vtab(db, create_sql);
+  sqlite3_free(create_sql);
+
+exit:
+  if (result == SQLITE_OK) {
+    *vtab_out = (sqlite3_vtab *) vtab;
+  } else {
+    spatial_vtab_free(vtab);
+  }
+  sqlite3_free(schema);
+  sqlite3_free(table);
+  sqlite3_free(geometry_column);
+  sqlite3_free(prefix);
+  sqlite3_free(index_table);
+  sqlite3_free(columns.declaration);
+  sqlite3_free(columns.columns);
+  sqlite3_free(columns.pk_column);
+  return result;
+}
+
+static int spatial_disconnect(sqlite3_vtab *vtab) {
+  spatial_vtab_free((spatial_vtab_t *) vtab);
+  return SQLITE_OK;
+}
+
+static int spatial_best_index(sqlite3_vtab *vtab, sqlite3_index_info *info) {
+  spatial_vtab_t *v = (spatial_vtab_t *) vtab;
+  char ops[SPATIAL_MAX_CONSTRAINTS + 1];
+  int op_count = 0;
+
+  for (int i = 0; i < info->nConstraint; i++) {
+    const struct sqlite3_index_constraint *constraint = &info->aConstraint[i];
+    if (constraint->usable && constraint->iColumn < 0 && constraint->op == SQLITE_INDEX_CONSTRAINT_EQ) {
+      info->aConstraintUsage[i].argvIndex = 1;
+      info->aConstraintUsage[i].omit = 1;
+      info->idxNum = SPATIAL_PLAN_ROWID;
+      info->estimatedCost = 1.0;
+      return SQLITE_OK;
+    }
+  }
+
+#ifdef SPATIAL_HAVE_FUNCTION_CONSTRAINTS
+  if (v->index_sql != NULL) {
+    for (int i = 0; i < info->nConstraint && op_count < SPATIAL_MAX_CONSTRAINTS; i++) {
+      const struct sqlite3_index_constraint *constraint = &info->aConstraint[i];
+      int op = constraint->op - SQLITE_INDEX_CONSTRAINT_FUNCTION;
+      if (constraint->usable && constraint->iColumn == v->geometry_column && op > 0 && op < SPATIAL_OP_COUNT) {
+        ops[op_count++] = (char) ('0' + op);
+        info->aConstraintUsage[i].argvIndex = op_count;
+        info->aConstraintUsage[i].omit = 0;
+      }
+    }
+  }
+#endif
+
+  if (op_count > 0) {
+    ops[op_count] = '\0';
+    info->idxNum = SPATIAL_PLAN_INDEX;
+    info->idxStr = sqlite3_mprintf("%s", ops);
+    if (info->idxStr == NULL) {
+      return SQLITE_NOMEM;
+    }
+    info->needToFreeIdxStr = 1;
+    info->estimatedCost = 1000.0;
+  } else {
+    info->idxNum = SPATIAL_PLAN_SCAN;
+    info->estimatedCost = 1000000.0;
+  }
+
+  return SQLITE_OK;
+}
+
+static int spatial_open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **cursor) {
+  spatial_cursor_t *c = (spatial_cursor_t *) sqlite3_malloc(sizeof(spatial_cursor_t));
+  if (c == NULL) {
+    return SQLITE_NOMEM;
+  }
+  memset(c, 0, sizeof(spatial_cursor_t));
+  c->idx_num = -1;
+  *cursor = (sqlite3_vtab_cursor *) c;
+  return SQLITE_OK;
+}
+
+static int spatial_close(sqlite3_vtab_cursor *cursor) {
+  spatial_cursor_t *c = (spatial_cursor_t *) cursor;
+  sqlite3_finalize(c->stmt);
+  sqlite3_free(c->idx_str);
+  sqlite3_free(c);
+  return SQLITE_OK;
+}
+
+/*
+ * Rounds a value down to the nearest single precision float. SQLite's rtree stores envelopes as floats rounded
+ * outwards, so this gives a bound that can safely be compared with the stored values.
+ */
+static double spatial_float_down(double value) {
+  float f = (float) value;
+  if ((double) f > value) {
+    f = nextafterf(f, -INFINITY);
+  }
+  return (double) f;
+}
+
+static double spatial_float_up(double value) {
+  float f = (float) value;
+  if ((double) f < value) {
+    f = nextafterf(f, INFINITY);
+  }
+  return (double) f;
+}
+
+static char *spatial_index_sql(spatial_vtab_t *vtab, const char *ops) {
+  const char *min_x = vtab->index_is_spatialite ? "xmin" : "minx";
+  const char *max_x = vtab->index_is_spatialite ? "xmax" : "maxx";
+  const char *min_y = vtab->index_is_spatialite ? "ymin" : "miny";
+  const char *max_y = vtab->index_is_spatialite ? "ymax" : "maxy";
+
+  char *where = sqlite3_mprintf("");
+  for (int i = 0; ops[i] != '\0' && where != NULL; i++) {
+    int p = i * 4;
+    const char *separator = i == 0 ? "" : " AND ";
+    switch (ops[i] - '0') {
+      case SPATIAL_OP_CONTAINS:
+        where = sqlite3_mprintf("%z%s%s <= ?%d AND %s >= ?%d AND %s <= ?%d AND %s >= ?%d", where, separator, min_x, p + 1, max_x, p + 2, min_y, p + 3, max_y, p + 4);
+        break;
+      case SPATIAL_OP_WITHIN:
+        where = sqlite3_mprintf("%z%s%s >= ?%d AND %s <= ?%d AND %s >= ?%d AND %s <= ?%d", where, separator, min_x, p + 1, max_x, p + 2, min_y, p + 3, max_y, p + 4);
+        break;
+      default:
+        where = sqlite3_mprintf("%z%s%s <= ?%d AND %s >= ?%d AND %s <= ?%d AND %s >= ?%d", where, separator, min_x, p + 2, max_x, p + 1, min_y, p + 4, max_y, p + 3);
+        break;
+    }
+  }
+
+  if (where == NULL) {
+    return NULL;
+  }
+  return sqlite3_mprintf("%s WHERE %s IN (%s WHERE %z)", vtab->select_sql, vtab->rowid_column, vtab->index_sql, where);
+}
+
+/*
+ * Binds the envelope of a geometry argument as min x, max x, min y, max y. Returns SQLITE_DONE if the geometry is
+ * NULL or empty, in which case none of the supported predicates can be true.
+ */
+static int spatial_bind_envelope(spatial_vtab_t *vtab, sqlite3_stmt *stmt, int op, int offset, sqlite3_value *value) {
+  char error_buffer[256];
+  errorstream_t error;
+  geom_blob_header_t header;
+  binstream_t stream;
+
+  const uint8_t *blob = (const uint8_t *) sqlite3_value_blob(value);
+  size_t length = (size_t) sqlite3_value_bytes(value);
+  if (blob == NULL || length == 0) {
+    return SQLITE_DONE;
+  }
+
+  error_init_fixed(&error, error_buffer, 256);
+  binstream_init(&stream, (uint8_t *) blob, length);
+  int result = vtab->spatialdb->read_blob_header(&stream, &header, &error);
+  if (result == SQLITE_OK && !header.envelope.has_env_x) {
+    result = vtab->spatialdb->fill_envelope(&stream, &header.envelope, &error);
+  }
+  binstream_destroy(&stream, 0);
+
+  if (result != SQLITE_OK) {
+    sqlite3_free(vtab->base.zErrMsg);
+    vtab->base.zErrMsg = sqlite3_mprintf("%s", error_count(&error) > 0 ? error_message(&error) : "Invalid geometry blob header");
+    return SQLITE_ERROR;
+  }
+
+  geom_envelope_t *envelope = &header.envelope;
+  if (!envelope->has_env_x || !envelope->has_env_y) {
+    return SQLITE_DONE;
+  }
+
+  if (op == SPATIAL_OP_WITHIN) {
+    sqlite3_bind_double(stmt, offset + 1, spatial_float_down(envelope->min_x));
+    sqlite3_bind_double(stmt, offset + 2, spatial_float_up(envelope->max_x));
+    sqlite3_bind_double(stmt, offset + 3, spatial_float_down(envelope->min_y));
+    sqlite3_bind_double(stmt, offset + 4, spatial_float_up(envelope->max_y));
+  } else {
+    sqlite3_bind_double(stmt, offset + 1, envelope->min_x);
+    sqlite3_bind_double(stmt, offset + 2, envelope->max_x);
+    sqlite3_bind_double(stmt, offset + 3, envelope->min_y);
+    sqlite3_bind_double(stmt, offset + 4, envelope->max_y);
+  }
+  return SQLITE_OK;
+}
+
+static int spatial_next(sqlite3_vtab_cursor *cursor) {
+  spatial_cursor_t *c = (spatial_cursor_t *) cursor;
+  int result = sqlite3_step(c->stmt);
+  if (result == SQLITE_ROW) {
+    return SQLITE_OK;
+  }
+
+  c->eof = 1;
+  if (result == SQLITE_DONE) {
+    return SQLITE_OK;
+  }
+
+  spatial_vtab_t *vtab = (spatial_vtab_t *) cursor->pVtab;
+  sqlite3_free(vtab->base.zErrMsg);
+  vtab->base.zErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(vtab->db));
+  return result;
+}
+
+static int spatial_filter(sqlite3_vtab_cursor *cursor, int idx_num, const char *idx_str, int argc, sqlite3_value **argv) {
+  spatial_cursor_t *c = (spatial_cursor_t *) cursor;
+  spatial_vtab_t *vtab = (spatial_vtab_t *) cursor->pVtab;
+  int result;
+
+  /* Nested loop joins filter the same cursor many times using the same plan; keep the statement in that case */
+  int same_plan = c->stmt != NULL && c->idx_num == idx_num && ((idx_str == NULL && c->idx_str == NULL) || (idx_str != NULL && c->idx_str != NULL && strcmp(idx_str, c->idx_str) == 0));
+  if (same_plan) {
+    sqlite3_reset(c->stmt);
+    sqlite3_clear_bindings(c->stmt);
+  } else {
+    char *sql;
+
+    sqlite3_finalize(c->stmt);
+    c->stmt = NULL;
+    sqlite3_free(c->idx_str);
+    c->idx_str = NULL;
+
+    if (idx_num == SPATIAL_PLAN_ROWID) {
+      sql = sqlite3_mprintf("%s WHERE %s = ?1", vtab->select_sql, vtab->rowid_column);
+    } else if (idx_num == SPATIAL_PLAN_INDEX && idx_str != NULL) {
+      sql = spatial_index_sql(vtab, idx_str);
+    } else {
+      sql = sqlite3_mprintf("%s", vtab->select_sql);
+    }
+    if (sql == NULL) {
+      return SQLITE_NOMEM;
+    }
+
+    result = sqlite3_prepare_v2(vtab->db, sql, -1, &c->stmt, NULL);
+    sqlite3_free(sql);
+    if (result != SQLITE_OK) {
+      sqlite3_free(vtab->base.zErrMsg);
+      vtab->base.zErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(vtab->db));
+      return result;
+    }
+
+    c->idx_num = idx_num;
+    if (idx_str != NULL) {
+      c->idx_str = sqlite3_mprintf("%s", idx_str);
+      if (c->idx_str == NULL) {
+        return SQLITE_NOMEM;
+      }
+    }
+  }
+
+  c->eof = 0;
+  if (idx_num == SPATIAL_PLAN_ROWID) {
+    sqlite3_bind_value(c->stmt, 1, argv[0]);
+  } else if (idx_num == SPATIAL_PLAN_INDEX && idx_str != NULL) {
+    for (int i = 0; i < argc && idx_str[i] != '\0'; i++) {
+      result = spatial_bind_envelope(vtab, c->stmt, idx_str[i] - '0', i * 4, argv[i]);
+      if (result == SQLITE_DONE) {
+        c->eof = 1;
+        return SQLITE_OK;
+      } else if (result != SQLITE_OK) {
+        return result;
+      }
+    }
+  }
+
+  return spatial_next(cursor);
+}
+
+static int spatial_eof(sqlite3_vtab_cursor *cursor) {
+  spatial_cursor_t *c = (spatial_cursor_t *) cursor;
+  return c->eof;
+}
+
+static int spatial_column(sqlite3_vtab_cursor *cursor, sqlite3_context *context, int column) {
+  spatial_cursor_t *c = (spatial_cursor_t *) cursor;
+  sqlite3_result_value(context, sqlite3_column_value(c->stmt, column + 1));
+  return SQLITE_OK;
+}
+
+static int spatial_rowid(sqlite3_vtab_cursor *cursor, sqlite3_int64 *rowid) {
+  spatial_cursor_t *c = (spatial_cursor_t *) cursor;
+  *rowid = sqlite3_column_int64(c->stmt, 0);
+  return SQLITE_OK;
+}
+
+static void spatial_refine(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  spatial_refine_t *refine = (spatial_refine_t *) sqlite3_user_data(context);
+  sqlite3 *db = sqlite3_context_db_handle(context);
+
+  if (refine->stmt == NULL) {
+    char *sql = sqlite3_mprintf("SELECT %s(?1, ?2)", refine->name);
+    if (sql == NULL) {
+      sqlite3_result_error_nomem(context);
+      return;
+    }
+    int result = sqlite3_prepare_v2(db, sql, -1, &refine->stmt, NULL);
+    sqlite3_free(sql);
+    if (result != SQLITE_OK) {
+      sqlite3_result_error(context, sqlite3_errmsg(db), -1);
+      return;
+    }
+  }
+
+  sqlite3_bind_value(refine->stmt, 1, args[0]);
+  sqlite3_bind_value(refine->stmt, 2, args[1]);
+  if (sqlite3_step(refine->stmt) == SQLITE_ROW) {
+    sqlite3_result_value(context, sqlite3_column_value(refine->stmt, 0));
+    sqlite3_reset(refine->stmt);
+  } else {
+    sqlite3_reset(refine->stmt);
+    sqlite3_result_error(context, sqlite3_errmsg(db), -1);
+  }
+  sqlite3_clear_bindings(refine->stmt);
+}
+
+/*
+ * SQLite only calls this for functions whose first argument is a column of this table, so predicates with the geometry
+ * column as second argument are never pushed down.
+ */
+static int spatial_find_function(sqlite3_vtab *vtab, int nbArgs, const char *name, void (**func)(sqlite3_context *, int, sqlite3_value **), void **user_data) {
+#ifdef SPATIAL_HAVE_FUNCTION_CONSTRAINTS
+  spatial_vtab_t *v = (spatial_vtab_t *) vtab;
+
+  if (nbArgs != 2 || v->index_sql == NULL) {
+    return 0;
+  }
+
+  if (sqlite3_strnicmp(name, "ST_", 3) == 0) {
+    name += 3;
+  }
+
+  for (int op = 1; op < SPATIAL_OP_COUNT; op++) {
+    if (sqlite3_stricmp(name, spatial_op_names[op] + 3) == 0) {
+      *func = spatial_refine;
+      *user_data = &v->refine[op];
+      return SQLITE_INDEX_CONSTRAINT_FUNCTION + op;
+    }
+  }
+#endif
+  return 0;
+}
+
+static sqlite3_module spatial_module = {
+  0,                     /* iVersion */
+  spatial_connect,       /* xCreate */
+  spatial_connect,       /* xConnect */
+  spatial_best_index,    /* xBestIndex */
+  spatial_disconnect,    /* xDisconnect */
+  spatial_disconnect,    /* xDestroy */
+  spatial_open,          /* xOpen */
+  spatial_close,         /* xClose */
+  spatial_filter,        /* xFilter */
+  spatial_next,          /* xNext */
+  spatial_eof,           /* xEof */
+  spatial_column,        /* xColumn */
+  spatial_rowid,         /* xRowid */
+  NULL,                  /* xUpdate */
+  NULL,                  /* xBegin */
+  NULL,                  /* xSync */
+  NULL,                  /* xCommit */
+  NULL,                  /* xRollback */
+  spatial_find_function, /* xFindFunction */
+  NULL                   /* xRename */
+};
+
+void spatial_vtab_init(sqlite3 *db, const spatialdb_t *spatialdb, errorstream_t *error) {
+  int result = sqlite3_create_module(db, "gpkg_spatial", &spatial_module, (void *) spatialdb);
+  if (result != SQLITE_OK) {
+    error_append(error, "Error registering module gpkg_spatial: %s", sqlite3_errmsg(db));
+  }
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GPKG_SPATIAL_VTAB_H
+#define GPKG_SPATIAL_VTAB_H
+
+#include "error.h"
+#include "spatialdb.h"
+#include "sqlite.h"
+
+/**
+ * \addtogroup spatial_vtab Spatially indexed feature table wrapper
+ *
+ * The gpkg_spatial virtual table module exposes an existing feature table with the same columns and rows. When a
+ * query constrains the geometry column using ST_Intersects, ST_Contains or ST_Within, the candidate rows are taken
+ * from the spatial index of the table instead of scanning the whole table. The predicate itself is still evaluated
+ * for every candidate, so results are identical to querying the feature table directly.
+ *
+ * SQLite only lets a virtual table take over a function if the first argument of the function is a column of the
+ * table, so the geometry column must be the first argument. ST_Contains(geom, :area) uses the spatial index, but
+ * ST_Contains(:area, geom) scans the whole table; write the latter as ST_Within(geom, :area) instead.
+ *
+ * Usage: CREATE VIRTUAL TABLE temp.roads_idx USING gpkg_spatial(roads [, geometry column])
+ * @{
+ */
+
+/**
+ * Registers the gpkg_spatial virtual table module with a database connection.
+ * @param db the database connection
+ * @param spatialdb the spatial database schema used to decode geometry blobs
+ * @param error the error stream to write errors to
+ */
+void spatial_vtab_init(sqlite3 *db, const spatialdb_t *spatialdb, errorstream_t *error);
+
+/** @} */
+
+#endif
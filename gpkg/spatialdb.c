@@ -13,25 +13,39 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <limits.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <sqlite3.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <errno.h>
+#include <string.h>
 #include "error.h"
 #include "atomic_ops.h"
 #include "binstream.h"
 #include "blobio.h"
+#include "contents_extent.h"
 #ifdef GPKG_HAVE_CONFIG_H
 #include "config.h"
 #endif
+#include "fp.h"
 #include "geomio.h"
 #include "geom_func.h"
+#include "gpkg_geom.h"
 #include "i18n.h"
+#include "rtree_query.h"
+#include "simplify.h"
 #include "sql.h"
 #include "sqlite.h"
+#include "spatial_vtab.h"
 #include "spatialdb_internal.h"
+#include "tile_dedup.h"
+#include "tile_import.h"
+#include "tile_matrix.h"
 #include "wkb.h"
 #include "wkt.h"
+#include "writer_pool.h"
 
 #define ST_MIN_MAX(name, check, field) static void ST_##name(sqlite3_context *context, int nbArgs, sqlite3_value **args) { \
     spatialdb_t *spatialdb; \
@@ -66,6 +80,66 @@ ST_MIN_MAX(MaxZ, has_env_z, max_z)
 ST_MIN_MAX(MinM, has_env_m, min_m)
 ST_MIN_MAX(MaxM, has_env_m, max_m)
 
+/*
+ * Makes sure the envelope of a geometry argument is available. The envelope is taken from the blob header when present
+ * and is otherwise computed from the coordinates without constructing the geometry.
+ */
+static int geom_arg_envelope(const spatialdb_t *spatialdb, binstream_t *stream, geom_blob_header_t *header, errorstream_t *error) {
+  if (header->envelope.has_env_x) {
+    return SQLITE_OK;
+  }
+
+  int result = spatialdb->fill_envelope(stream, &header->envelope, error);
+  if (result != SQLITE_OK && error_count(error) == 0) {
+    error_append(error, "Invalid geometry blob header");
+  }
+  return result;
+}
+
+static int envelope_intersects(const geom_envelope_t *a, const geom_envelope_t *b) {
+  if (!a->has_env_x || !a->has_env_y || !b->has_env_x || !b->has_env_y) {
+    return 0;
+  }
+  return a->min_x <= b->max_x && a->max_x >= b->min_x && a->min_y <= b->max_y && a->max_y >= b->min_y;
+}
+
+static int envelope_contains(const geom_envelope_t *a, const geom_envelope_t *b) {
+  if (!a->has_env_x || !a->has_env_y || !b->has_env_x || !b->has_env_y) {
+    return 0;
+  }
+  return a->min_x <= b->min_x && a->max_x >= b->max_x && a->min_y <= b->min_y && a->max_y >= b->max_y;
+}
+
+static int envelope_within(const geom_envelope_t *a, const geom_envelope_t *b) {
+  return envelope_contains(b, a);
+}
+
+#define ST_ENV_PREDICATE(name, predicate) static void ST_##name(sqlite3_context *context, int nbArgs, sqlite3_value **args) { \
+    spatialdb_t *spatialdb; \
+    FUNCTION_GEOM_ARG(geom1); \
+    FUNCTION_GEOM_ARG(geom2); \
+\
+    FUNCTION_START_STATIC(context, 256); \
+    spatialdb = (spatialdb_t *)sqlite3_user_data(context); \
+    FUNCTION_GET_GEOM_ARG_UNSAFE(context, spatialdb, geom1, 0); \
+    FUNCTION_GET_GEOM_ARG_UNSAFE(context, spatialdb, geom2, 1); \
+\
+    FUNCTION_RESULT = geom_arg_envelope(spatialdb, &FUNCTION_GEOM_ARG_STREAM(geom1), &geom1, FUNCTION_ERROR); \
+    if (FUNCTION_RESULT == SQLITE_OK) { \
+        FUNCTION_RESULT = geom_arg_envelope(spatialdb, &FUNCTION_GEOM_ARG_STREAM(geom2), &geom2, FUNCTION_ERROR); \
+    } \
+    if (FUNCTION_RESULT == SQLITE_OK) { \
+        sqlite3_result_int(context, predicate(&geom1.envelope, &geom2.envelope)); \
+    } \
+    FUNCTION_END(context); \
+    FUNCTION_FREE_GEOM_ARG(geom1); \
+    FUNCTION_FREE_GEOM_ARG(geom2); \
+}
+
+ST_ENV_PREDICATE(EnvIntersects, envelope_intersects)
+ST_ENV_PREDICATE(EnvContains, envelope_contains)
+ST_ENV_PREDICATE(EnvWithin, envelope_within)
+
 static void ST_SRID(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
   spatialdb_t *spatialdb;
   FUNCTION_GEOM_ARG(geomblob);
@@ -174,43 +248,130 @@ static void ST_GeometryType(sqlite3_context *context, int nbArgs, sqlite3_value
   FUNCTION_FREE_WKB_ARG(wkb);
 }
 
+/*
+ * Per connection state shared by the functions that produce geometries. Besides the locale used to parse WKT this
+ * holds a pool of writers so that repeated calls do not need to allocate new buffers for each result. The locale is
+ * only created when WKT is parsed for the first time, which keeps connection setup cheap.
+ */
 typedef struct {
+  volatile long ref_count;
+  const spatialdb_t *spatialdb;
+  i18n_locale_t *locale;
+  writer_pool_t pool;
+} spatialdb_ctx_t;
+
+static spatialdb_ctx_t *spatialdb_ctx_init(const spatialdb_t *spatialdb) {
+  spatialdb_ctx_t *ctx = (spatialdb_ctx_t *)sqlite3_malloc(sizeof(spatialdb_ctx_t));
+
+  if (ctx == NULL) {
+    return NULL;
+  }
+
+  ctx->ref_count = 1;
+  ctx->locale = NULL;
+  ctx->spatialdb = spatialdb;
+  writer_pool_init(&ctx->pool, spatialdb);
+  return ctx;
+}
+
+static i18n_locale_t *spatialdb_ctx_locale(sqlite3_context *context, spatialdb_ctx_t *ctx) {
+  if (ctx->locale == NULL) {
+    ctx->locale = i18n_locale_init("C");
+    if (ctx->locale == NULL) {
+      sqlite3_result_error(context, "Could not create C locale", -1);
+    }
+  }
+  return ctx->locale;
+}
+
+static void spatialdb_ctx_acquire(spatialdb_ctx_t *ctx) {
+  if (ctx) {
+    atomic_inc_long(&ctx->ref_count);
+  }
+}
+
+static void spatialdb_ctx_release(spatialdb_ctx_t *ctx) {
+  if (ctx) {
+    long newval = atomic_dec_long(&ctx->ref_count);
+    if (newval == 0) {
+      writer_pool_destroy(&ctx->pool);
+      if (ctx->locale != NULL) {
+        i18n_locale_destroy(ctx->locale);
+        ctx->locale = NULL;
+      }
+      sqlite3_free(ctx);
+    }
+  }
+}
+
+/*
+ * Cached constructor result. Small results are copied into the same pooled block as this struct; larger ones are
+ * owned separately.
+ */
+typedef struct {
+  spatialdb_ctx_t *ctx;
   uint8_t *data;
   int length;
+  int owns_data;
 } geom_blob_auxdata;
 
-static geom_blob_auxdata *geom_blob_auxdata_malloc() {
-  return (geom_blob_auxdata *)sqlite3_malloc(sizeof(geom_blob_auxdata));
+static geom_blob_auxdata *geom_blob_auxdata_malloc(spatialdb_ctx_t *ctx, uint8_t *data, int length, int copy) {
+  geom_blob_auxdata *geom = (geom_blob_auxdata *)writer_pool_block_alloc(&ctx->pool, sizeof(geom_blob_auxdata) + (copy ? (size_t) length : 0));
+  if (geom == NULL) {
+    return NULL;
+  }
+
+  if (copy) {
+    geom->data = (uint8_t *)(geom + 1);
+    memcpy(geom->data, data, (size_t) length);
+  } else {
+    geom->data = data;
+  }
+  geom->length = length;
+  geom->owns_data = !copy;
+  geom->ctx = ctx;
+  spatialdb_ctx_acquire(ctx);
+  return geom;
 }
 
 static void geom_blob_auxdata_free(void *auxdata) {
   if (auxdata != NULL) {
     geom_blob_auxdata *geom = (geom_blob_auxdata *)auxdata;
-    sqlite3_free(geom->data);
+    spatialdb_ctx_t *ctx = geom->ctx;
+    if (geom->owns_data) {
+      sqlite3_free(geom->data);
+    }
     geom->data = NULL;
-    sqlite3_free(geom);
+    writer_pool_block_free(&ctx->pool, geom);
+    spatialdb_ctx_release(ctx);
   }
 }
 
 static void ST_AsBinary(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
-  spatialdb_t *spatialdb;
+  spatialdb_ctx_t *ctx;
+  wkb_writer_t local_writer;
+  wkb_writer_t *writer;
   FUNCTION_GEOM_ARG(geomblob);
 
   FUNCTION_START_STATIC(context, 256);
-  spatialdb = (spatialdb_t *)sqlite3_user_data(context);
-  FUNCTION_GET_GEOM_ARG_UNSAFE(context, spatialdb, geomblob, 0);
+  ctx = (spatialdb_ctx_t *)sqlite3_user_data(context);
+  FUNCTION_GET_GEOM_ARG_UNSAFE(context, ctx->spatialdb, geomblob, 0);
 
-  wkb_writer_t writer;
-  wkb_writer_init(&writer, WKB_ISO);
+  writer = writer_pool_wkb_acquire(&ctx->pool, &local_writer);
+  if (writer == NULL) {
+    FUNCTION_RESULT = SQLITE_NOMEM;
+    goto exit;
+  }
 
-  FUNCTION_RESULT = spatialdb->read_geometry(&FUNCTION_GEOM_ARG_STREAM(geomblob), wkb_writer_geom_consumer(&writer), FUNCTION_ERROR);
+  FUNCTION_RESULT = ctx->spatialdb->read_geometry(&FUNCTION_GEOM_ARG_STREAM(geomblob), wkb_writer_geom_consumer(writer), FUNCTION_ERROR);
 
+  int transferred = 0;
   if (FUNCTION_RESULT == SQLITE_OK) {
-    sqlite3_result_blob(context, wkb_writer_getwkb(&writer), (int) wkb_writer_length(&writer), sqlite3_free);
-    wkb_writer_destroy(&writer, 0);
-  } else {
-    wkb_writer_destroy(&writer, 1);
+    size_t length = wkb_writer_length(writer);
+    transferred = length >= WRITER_POOL_TRANSFER_SIZE;
+    sqlite3_result_blob(context, wkb_writer_getwkb(writer), (int) length, transferred ? sqlite3_free : SQLITE_TRANSIENT);
   }
+  writer_pool_wkb_release(&ctx->pool, writer, transferred);
 
   FUNCTION_END(context);
 
@@ -218,26 +379,749 @@ static void ST_AsBinary(sqlite3_context *context, int nbArgs, sqlite3_value **ar
 }
 
 static void ST_AsText(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
-  spatialdb_t *spatialdb;
+  spatialdb_ctx_t *ctx;
+  wkt_writer_t local_writer;
+  wkt_writer_t *writer;
   FUNCTION_GEOM_ARG(geomblob);
 
   FUNCTION_START_STATIC(context, 256);
-  spatialdb = (spatialdb_t *)sqlite3_user_data(context);
+  ctx = (spatialdb_ctx_t *)sqlite3_user_data(context);
+  FUNCTION_GET_GEOM_ARG_UNSAFE(context, ctx->spatialdb, geomblob, 0);
+
+  writer = writer_pool_wkt_acquire(&ctx->pool, &local_writer);
+  if (writer == NULL) {
+    FUNCTION_RESULT = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  FUNCTION_RESULT = ctx->spatialdb->read_geometry(&FUNCTION_GEOM_ARG_STREAM(geomblob), wkt_writer_geom_consumer(writer), FUNCTION_ERROR);
+
+  int transferred = 0;
+  if (FUNCTION_RESULT == SQLITE_OK) {
+    size_t length = wkt_writer_length(writer);
+    transferred = length >= WRITER_POOL_TRANSFER_SIZE;
+    sqlite3_result_text(context, wkt_writer_getwkt(writer), (int) length, transferred ? sqlite3_free : SQLITE_TRANSIENT);
+  }
+  writer_pool_wkt_release(&ctx->pool, writer, transferred);
+
+  FUNCTION_END(context);
+
+  FUNCTION_FREE_GEOM_ARG(geomblob);
+}
+
+static void ST_Envelope(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  spatialdb_ctx_t *ctx;
+  geom_blob_writer_t local_writer;
+  geom_blob_writer_t *writer;
+  FUNCTION_GEOM_ARG(geomblob);
+
+  FUNCTION_START_STATIC(context, 256);
+  ctx = (spatialdb_ctx_t *)sqlite3_user_data(context);
+  FUNCTION_GET_GEOM_ARG_UNSAFE(context, ctx->spatialdb, geomblob, 0);
+
+  FUNCTION_RESULT = geom_arg_envelope(ctx->spatialdb, &FUNCTION_GEOM_ARG_STREAM(geomblob), &geomblob, FUNCTION_ERROR);
+  if (FUNCTION_RESULT != SQLITE_OK) {
+    goto exit;
+  }
+
+  if (geomblob.empty || !geomblob.envelope.has_env_x || !geomblob.envelope.has_env_y || fp_isnan(geomblob.envelope.min_x) || fp_isnan(geomblob.envelope.min_y)) {
+    /* The envelope of an empty geometry is the empty geometry itself. Empty GeoPackage blobs may carry a NaN envelope. */
+    sqlite3_result_value(context, args[0]);
+    goto exit;
+  }
+
+  writer = writer_pool_blob_acquire(&ctx->pool, &local_writer, 1, geomblob.srid);
+  if (writer == NULL) {
+    FUNCTION_RESULT = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  FUNCTION_RESULT = geom_envelope_write(&geomblob.envelope, geom_blob_writer_geom_consumer(writer), FUNCTION_ERROR);
+  if (FUNCTION_RESULT == SQLITE_OK) {
+    sqlite3_result_blob(context, geom_blob_writer_getdata(writer), (int) geom_blob_writer_length(writer), SQLITE_TRANSIENT);
+  }
+  writer_pool_blob_release(&ctx->pool, writer, 0);
+
+  FUNCTION_END(context);
+
+  FUNCTION_FREE_GEOM_ARG(geomblob);
+}
+
+static void ST_Simplify(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  spatialdb_ctx_t *ctx;
+  geom_blob_writer_t local_writer;
+  geom_blob_writer_t *writer;
+  geom_simplifier_t simplifier;
+  FUNCTION_GEOM_ARG(geomblob);
+
+  FUNCTION_START_STATIC(context, 256);
+  ctx = (spatialdb_ctx_t *)sqlite3_user_data(context);
+  FUNCTION_GET_GEOM_ARG_UNSAFE(context, ctx->spatialdb, geomblob, 0);
+
+  if (sqlite3_value_type(args[1]) == SQLITE_NULL) {
+    sqlite3_result_null(context);
+    goto exit;
+  }
+  double tolerance = sqlite3_value_double(args[1]);
+  if (!(tolerance >= 0)) {
+    error_append(FUNCTION_ERROR, "ST_Simplify: tolerance must not be negative");
+    goto exit;
+  }
+
+  writer = writer_pool_blob_acquire(&ctx->pool, &local_writer, 1, geomblob.srid);
+  if (writer == NULL) {
+    FUNCTION_RESULT = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  geom_simplifier_init(&simplifier, geom_blob_writer_geom_consumer(writer), tolerance);
+  FUNCTION_RESULT = ctx->spatialdb->read_geometry(&FUNCTION_GEOM_ARG_STREAM(geomblob), geom_simplifier_geom_consumer(&simplifier), FUNCTION_ERROR);
+  geom_simplifier_destroy(&simplifier);
+
+  int transferred = 0;
+  if (FUNCTION_RESULT == SQLITE_OK) {
+    size_t length = geom_blob_writer_length(writer);
+    transferred = length >= WRITER_POOL_TRANSFER_SIZE;
+    sqlite3_result_blob(context, geom_blob_writer_getdata(writer), (int) length, transferred ? sqlite3_free : SQLITE_TRANSIENT);
+  }
+  writer_pool_blob_release(&ctx->pool, writer, transferred);
+
+  FUNCTION_END(context);
+
+  FUNCTION_FREE_GEOM_ARG(geomblob);
+}
+
+/*
+ * Running state of ST_Extent. Each value is only parsed up to its blob header; the coordinates are only scanned for
+ * blobs without a header envelope.
+ */
+typedef struct {
+  int has_srid;
+  int32_t srid;
+  geom_envelope_t envelope;
+} extent_state_t;
+
+static void ST_Extent_step(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  const spatialdb_t *spatialdb;
+  extent_state_t *state;
+  FUNCTION_GEOM_ARG(geomblob);
+
+  FUNCTION_START_STATIC(context, 256);
+  spatialdb = (const spatialdb_t *)sqlite3_user_data(context);
   FUNCTION_GET_GEOM_ARG_UNSAFE(context, spatialdb, geomblob, 0);
 
-  wkt_writer_t writer;
-  wkt_writer_init(&writer);
+  state = (extent_state_t *)sqlite3_aggregate_context(context, sizeof(extent_state_t));
+  if (state == NULL) {
+    FUNCTION_RESULT = SQLITE_NOMEM;
+    goto exit;
+  }
+  if (!state->has_srid) {
+    geom_envelope_init(&state->envelope);
+    state->has_srid = 1;
+    state->srid = geomblob.srid;
+  } else if (state->srid != geomblob.srid) {
+    error_append(FUNCTION_ERROR, "ST_Extent: geometries have different SRIDs (%d and %d)", state->srid, geomblob.srid);
+    goto exit;
+  }
+
+  if (!geomblob.envelope.has_env_x) {
+    FUNCTION_RESULT = spatialdb->fill_envelope(&FUNCTION_GEOM_ARG_STREAM(geomblob), &geomblob.envelope, FUNCTION_ERROR);
+    if (FUNCTION_RESULT != SQLITE_OK) {
+      goto exit;
+    }
+  }
+
+  if (geomblob.envelope.has_env_x && geomblob.envelope.has_env_y) {
+    geom_envelope_t *envelope = &state->envelope;
+    envelope->has_env_x = 1;
+    envelope->has_env_y = 1;
+    envelope->min_x = geomblob.envelope.min_x < envelope->min_x ? geomblob.envelope.min_x : envelope->min_x;
+    envelope->max_x = geomblob.envelope.max_x > envelope->max_x ? geomblob.envelope.max_x : envelope->max_x;
+    envelope->min_y = geomblob.envelope.min_y < envelope->min_y ? geomblob.envelope.min_y : envelope->min_y;
+    envelope->max_y = geomblob.envelope.max_y > envelope->max_y ? geomblob.envelope.max_y : envelope->max_y;
+  }
+
+  FUNCTION_END(context);
+
+  FUNCTION_FREE_GEOM_ARG(geomblob);
+}
+
+static int extent_result(sqlite3_context *context, const spatialdb_t *spatialdb, const geom_envelope_t *envelope, int has_srid, int32_t srid, errorstream_t *error) {
+  geom_blob_writer_t writer;
+  int result;
+
+  if (!envelope->has_env_x || !envelope->has_env_y) {
+    sqlite3_result_null(context);
+    return SQLITE_OK;
+  }
+
+  result = has_srid ? spatialdb->writer_init_srid(&writer, srid) : spatialdb->writer_init(&writer);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+  result = geom_envelope_write(envelope, geom_blob_writer_geom_consumer(&writer), error);
+  if (result == SQLITE_OK) {
+    sqlite3_result_blob(context, geom_blob_writer_getdata(&writer), (int) geom_blob_writer_length(&writer), sqlite3_free);
+  }
+  spatialdb->writer_destroy(&writer, result != SQLITE_OK);
+  return result;
+}
+
+static void ST_Extent_final(sqlite3_context *context) {
+  const spatialdb_t *spatialdb;
+  extent_state_t *state;
+
+  FUNCTION_START_STATIC(context, 256);
+  spatialdb = (const spatialdb_t *)sqlite3_user_data(context);
+
+  state = (extent_state_t *)sqlite3_aggregate_context(context, 0);
+  if (state == NULL || !state->has_srid) {
+    sqlite3_result_null(context);
+    goto exit;
+  }
+  FUNCTION_RESULT = extent_result(context, spatialdb, &state->envelope, 1, state->srid, FUNCTION_ERROR);
+
+  FUNCTION_END(context);
+}
+
+/*
+ * Common state of the ST_Collect and ST_MakeLine aggregates. The result is written by a single blob writer whose
+ * buffer grows as values are added: each value is read through the consumer of the aggregate, which forwards the parts
+ * or vertices of the value to the writer. The root geometry is started when the first value is read and ended by the
+ * final function, at which point its type is known.
+ */
+typedef struct {
+  geom_consumer_t consumer;
+  geom_blob_writer_t writer;
+  const spatialdb_t *spatialdb;
+  const char *name;
+  int initialized;
+  int started;
+  int failed;
+  int32_t srid;
+  geom_header_t header;
+  int depth;
+} geom_aggregate_t;
+
+static int geom_aggregate_add(geom_aggregate_t *aggregate, const spatialdb_t *spatialdb, const char *name, binstream_t *stream, const geom_blob_header_t *blob, errorstream_t *error) {
+  int result;
+
+  if (!aggregate->initialized) {
+    result = spatialdb->writer_init_srid(&aggregate->writer, blob->srid);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    aggregate->initialized = 1;
+    aggregate->spatialdb = spatialdb;
+    aggregate->name = name;
+    aggregate->srid = blob->srid;
+  } else if (aggregate->srid != blob->srid) {
+    error_append(error, "%s: geometries have different SRIDs (%d and %d)", name, aggregate->srid, blob->srid);
+    return SQLITE_OK;
+  }
+
+  aggregate->depth = 0;
+  return spatialdb->read_geometry(stream, &aggregate->consumer, error);
+}
+
+static int geom_aggregate_start(geom_aggregate_t *aggregate, geom_type_t geom_type, const geom_header_t *header, errorstream_t *error) {
+  geom_consumer_t *writer = geom_blob_writer_geom_consumer(&aggregate->writer);
+  int result;
+
+  if (aggregate->started) {
+    if (header->coord_type != aggregate->header.coord_type) {
+      error_append(error, "%s: geometries have different dimensions", aggregate->name);
+      return SQLITE_MISMATCH;
+    }
+    return SQLITE_OK;
+  }
+
+  aggregate->header.geom_type = geom_type;
+  aggregate->header.coord_type = header->coord_type;
+  aggregate->header.coord_size = header->coord_size;
+
+  result = writer->begin(writer, error);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+  result = writer->begin_geometry(writer, &aggregate->header, error);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+  aggregate->started = 1;
+  return SQLITE_OK;
+}
+
+static int geom_aggregate_result(sqlite3_context *context, geom_aggregate_t *aggregate, geom_type_t geom_type, errorstream_t *error) {
+  geom_consumer_t *writer = geom_blob_writer_geom_consumer(&aggregate->writer);
+  int result;
+
+  aggregate->header.geom_type = geom_type;
+  result = writer->end_geometry(writer, &aggregate->header, error);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+  result = writer->end(writer, error);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  sqlite3_result_blob(context, geom_blob_writer_getdata(&aggregate->writer), (int) geom_blob_writer_length(&aggregate->writer), sqlite3_free);
+  aggregate->spatialdb->writer_destroy(&aggregate->writer, 0);
+  aggregate->initialized = 0;
+  return SQLITE_OK;
+}
+
+static void geom_aggregate_destroy(geom_aggregate_t *aggregate) {
+  if (aggregate->initialized) {
+    aggregate->spatialdb->writer_destroy(&aggregate->writer, 1);
+    aggregate->initialized = 0;
+  }
+}
+
+static int geom_is_collection(geom_type_t geom_type) {
+  switch (geom_type) {
+    case GEOM_MULTIPOINT:
+    case GEOM_MULTILINESTRING:
+    case GEOM_MULTIPOLYGON:
+    case GEOM_GEOMETRYCOLLECTION:
+    case GEOM_MULTICURVE:
+    case GEOM_MULTISURFACE:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/*
+ * Running state of ST_Collect. Collections are flattened: only their non-collection parts are copied to the result.
+ * part_type tracks the type shared by all parts so far, GEOM_GEOMETRY if there are none and
+ * GEOM_GEOMETRYCOLLECTION if they differ.
+ */
+typedef struct {
+  geom_aggregate_t aggregate;
+  int part_depth;
+  geom_type_t part_type;
+} collect_state_t;
+
+static int collect_begin_geometry(const geom_consumer_t *consumer, const geom_header_t *header, errorstream_t *error) {
+  collect_state_t *state = (collect_state_t *) consumer;
+  geom_aggregate_t *aggregate = &state->aggregate;
+  geom_consumer_t *writer = geom_blob_writer_geom_consumer(&aggregate->writer);
+  int result;
+
+  if (aggregate->depth == 0) {
+    result = geom_aggregate_start(aggregate, GEOM_GEOMETRYCOLLECTION, header, error);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+  }
+
+  if (state->part_depth < 0) {
+    if (geom_is_collection(header->geom_type)) {
+      aggregate->depth++;
+      return SQLITE_OK;
+    }
+
+    state->part_depth = aggregate->depth;
+    if (state->part_type == GEOM_GEOMETRY) {
+      state->part_type = header->geom_type;
+    } else if (state->part_type != header->geom_type) {
+      state->part_type = GEOM_GEOMETRYCOLLECTION;
+    }
+  }
+
+  aggregate->depth++;
+  return writer->begin_geometry(writer, header, error);
+}
+
+static int collect_end_geometry(const geom_consumer_t *consumer, const geom_header_t *header, errorstream_t *error) {
+  collect_state_t *state = (collect_state_t *) consumer;
+  geom_aggregate_t *aggregate = &state->aggregate;
+  geom_consumer_t *writer = geom_blob_writer_geom_consumer(&aggregate->writer);
+
+  aggregate->depth--;
+  if (state->part_depth < 0) {
+    return SQLITE_OK;
+  }
+  if (aggregate->depth == state->part_depth) {
+    state->part_depth = -1;
+  }
+  return writer->end_geometry(writer, header, error);
+}
+
+static int collect_coordinates(const geom_consumer_t *consumer, const geom_header_t *header, size_t point_count, const double *coords, int skip_coords, errorstream_t *error) {
+  collect_state_t *state = (collect_state_t *) consumer;
+  geom_consumer_t *writer = geom_blob_writer_geom_consumer(&state->aggregate.writer);
+  return writer->coordinates(writer, header, point_count, coords, skip_coords, error);
+}
+
+static void ST_Collect_step(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  const spatialdb_t *spatialdb;
+  collect_state_t *state;
+  FUNCTION_GEOM_ARG(geomblob);
+
+  FUNCTION_START_STATIC(context, 256);
+  spatialdb = (const spatialdb_t *)sqlite3_user_data(context);
+  FUNCTION_GET_GEOM_ARG_UNSAFE(context, spatialdb, geomblob, 0);
+
+  state = (collect_state_t *)sqlite3_aggregate_context(context, sizeof(collect_state_t));
+  if (state == NULL) {
+    FUNCTION_RESULT = SQLITE_NOMEM;
+    goto exit;
+  }
+  if (state->aggregate.failed) {
+    goto exit;
+  }
+  if (!state->aggregate.initialized) {
+    geom_consumer_init(&state->aggregate.consumer, NULL, NULL, collect_begin_geometry, collect_end_geometry, collect_coordinates);
+    state->part_depth = -1;
+    state->part_type = GEOM_GEOMETRY;
+  }
+
+  FUNCTION_RESULT = geom_aggregate_add(&state->aggregate, spatialdb, "ST_Collect", &FUNCTION_GEOM_ARG_STREAM(geomblob), &geomblob, FUNCTION_ERROR);
+  if (FUNCTION_RESULT != SQLITE_OK || error_count(FUNCTION_ERROR) > 0) {
+    state->aggregate.failed = 1;
+  }
+
+  FUNCTION_END(context);
+
+  FUNCTION_FREE_GEOM_ARG(geomblob);
+}
+
+static void ST_Collect_final(sqlite3_context *context) {
+  collect_state_t *state = NULL;
+  geom_type_t geom_type;
+
+  FUNCTION_START_STATIC(context, 256);
+
+  state = (collect_state_t *)sqlite3_aggregate_context(context, 0);
+  if (state == NULL || !state->aggregate.started || state->aggregate.failed) {
+    sqlite3_result_null(context);
+    goto exit;
+  }
+
+  switch (state->part_type) {
+    case GEOM_POINT:
+      geom_type = GEOM_MULTIPOINT;
+      break;
+    case GEOM_LINESTRING:
+      geom_type = GEOM_MULTILINESTRING;
+      break;
+    case GEOM_POLYGON:
+      geom_type = GEOM_MULTIPOLYGON;
+      break;
+    default:
+      geom_type = GEOM_GEOMETRYCOLLECTION;
+      break;
+  }
+  FUNCTION_RESULT = geom_aggregate_result(context, &state->aggregate, geom_type, FUNCTION_ERROR);
+
+  FUNCTION_END(context);
+
+  if (state != NULL) {
+    geom_aggregate_destroy(&state->aggregate);
+  }
+}
+
+/*
+ * A vertex of an ordered ST_MakeLine. seq is the position in which the vertex was added and keeps the sort stable.
+ */
+typedef struct {
+  double key;
+  size_t seq;
+  double coords[GEOM_MAX_COORD_SIZE];
+} makeline_vertex_t;
+
+/*
+ * Running state of ST_MakeLine. Without an order key the vertices are written as they arrive. With an order key they
+ * are collected in vertices instead and written in key order by the final function; sorting is skipped when the keys
+ * were already ascending.
+ */
+typedef struct {
+  geom_aggregate_t aggregate;
+  int ordered;
+  int sorted;
+  double key;
+  makeline_vertex_t *vertices;
+  size_t vertex_count;
+  size_t vertex_capacity;
+} makeline_state_t;
+
+static int makeline_begin_geometry(const geom_consumer_t *consumer, const geom_header_t *header, errorstream_t *error) {
+  makeline_state_t *state = (makeline_state_t *) consumer;
+  geom_aggregate_t *aggregate = &state->aggregate;
+  int result;
+
+  if (aggregate->depth == 0) {
+    if (header->geom_type != GEOM_POINT && header->geom_type != GEOM_MULTIPOINT && header->geom_type != GEOM_LINESTRING) {
+      const char *type_name = NULL;
+      geom_type_name(header->geom_type, &type_name);
+      error_append(error, "ST_MakeLine: expected Point, MultiPoint or LineString but got %s", type_name != NULL ? type_name : "unknown type");
+      return SQLITE_MISMATCH;
+    }
+
+    result = geom_aggregate_start(aggregate, GEOM_LINESTRING, header, error);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+  }
+
+  aggregate->depth++;
+  return SQLITE_OK;
+}
+
+static int makeline_end_geometry(const geom_consumer_t *consumer, const geom_header_t *header, errorstream_t *error) {
+  makeline_state_t *state = (makeline_state_t *) consumer;
+  state->aggregate.depth--;
+  return SQLITE_OK;
+}
+
+static int makeline_append(makeline_state_t *state, size_t point_count, const double *coords, uint32_t coord_size) {
+  if (state->vertex_count + point_count > state->vertex_capacity) {
+    size_t capacity = state->vertex_capacity == 0 ? 256 : state->vertex_capacity;
+    while (capacity < state->vertex_count + point_count) {
+      capacity *= 2;
+    }
+    if (capacity > INT_MAX / sizeof(makeline_vertex_t)) {
+      return SQLITE_NOMEM;
+    }
+    makeline_vertex_t *vertices = (makeline_vertex_t *) sqlite3_realloc(state->vertices, (int) (capacity * sizeof(makeline_vertex_t)));
+    if (vertices == NULL) {
+      return SQLITE_NOMEM;
+    }
+    state->vertices = vertices;
+    state->vertex_capacity = capacity;
+  }
+
+  if (state->vertex_count > 0 && state->key < state->vertices[state->vertex_count - 1].key) {
+    state->sorted = 0;
+  }
+
+  for (size_t i = 0; i < point_count; i++) {
+    makeline_vertex_t *vertex = &state->vertices[state->vertex_count];
+    vertex->key = state->key;
+    vertex->seq = state->vertex_count;
+    memcpy(vertex->coords, &coords[i * coord_size], coord_size * sizeof(double));
+    state->vertex_count++;
+  }
+  return SQLITE_OK;
+}
+
+static int makeline_coordinates(const geom_consumer_t *consumer, const geom_header_t *header, size_t point_count, const double *coords, int skip_coords, errorstream_t *error) {
+  makeline_state_t *state = (makeline_state_t *) consumer;
+  geom_aggregate_t *aggregate = &state->aggregate;
+
+  if (header->geom_type == GEOM_POINT) {
+    /* Empty points are encoded as NaN coordinates and do not contribute a vertex */
+    int allnan = 1;
+    for (uint32_t i = 0; i < header->coord_size; i++) {
+      allnan &= fp_isnan(coords[i]);
+    }
+    if (allnan) {
+      return SQLITE_OK;
+    }
+  }
+
+  if (state->ordered) {
+    return makeline_append(state, point_count, coords, header->coord_size);
+  } else {
+    geom_consumer_t *writer = geom_blob_writer_geom_consumer(&aggregate->writer);
+    return writer->coordinates(writer, &aggregate->header, point_count, coords, 0, error);
+  }
+}
+
+static int makeline_vertex_compare(const void *a, const void *b) {
+  const makeline_vertex_t *va = (const makeline_vertex_t *) a;
+  const makeline_vertex_t *vb = (const makeline_vertex_t *) b;
+  if (va->key != vb->key) {
+    return va->key < vb->key ? -1 : 1;
+  }
+  return va->seq < vb->seq ? -1 : (va->seq > vb->seq ? 1 : 0);
+}
+
+static int makeline_write_vertices(makeline_state_t *state, errorstream_t *error) {
+  geom_aggregate_t *aggregate = &state->aggregate;
+  geom_consumer_t *writer = geom_blob_writer_geom_consumer(&aggregate->writer);
+  uint32_t coord_size = aggregate->header.coord_size;
+  double coords[GEOM_MAX_COORD_SIZE * 256];
+  int result;
+
+  if (!state->sorted) {
+    qsort(state->vertices, state->vertex_count, sizeof(makeline_vertex_t), makeline_vertex_compare);
+  }
+
+  for (size_t offset = 0; offset < state->vertex_count; offset += 256) {
+    size_t point_count = state->vertex_count - offset < 256 ? state->vertex_count - offset : 256;
+    for (size_t i = 0; i < point_count; i++) {
+      memcpy(&coords[i * coord_size], state->vertices[offset + i].coords, coord_size * sizeof(double));
+    }
+    result = writer->coordinates(writer, &aggregate->header, point_count, coords, 0, error);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+  }
+  return SQLITE_OK;
+}
+
+static void ST_MakeLine_step(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  const spatialdb_t *spatialdb;
+  makeline_state_t *state;
+  FUNCTION_GEOM_ARG(geomblob);
+
+  FUNCTION_START_STATIC(context, 256);
+  spatialdb = (const spatialdb_t *)sqlite3_user_data(context);
+  FUNCTION_GET_GEOM_ARG_UNSAFE(context, spatialdb, geomblob, 0);
+
+  state = (makeline_state_t *)sqlite3_aggregate_context(context, sizeof(makeline_state_t));
+  if (state == NULL) {
+    FUNCTION_RESULT = SQLITE_NOMEM;
+    goto exit;
+  }
+  if (state->aggregate.failed) {
+    goto exit;
+  }
+  if (!state->aggregate.initialized) {
+    geom_consumer_init(&state->aggregate.consumer, NULL, NULL, makeline_begin_geometry, makeline_end_geometry, makeline_coordinates);
+    state->ordered = nbArgs > 1;
+    state->sorted = 1;
+  }
+
+  if (state->ordered) {
+    int key_type = sqlite3_value_type(args[1]);
+    if (key_type != SQLITE_INTEGER && key_type != SQLITE_FLOAT) {
+      error_append(FUNCTION_ERROR, "ST_MakeLine: order key must be numeric");
+      state->aggregate.failed = 1;
+      goto exit;
+    }
+    state->key = sqlite3_value_double(args[1]);
+  }
+
+  FUNCTION_RESULT = geom_aggregate_add(&state->aggregate, spatialdb, "ST_MakeLine", &FUNCTION_GEOM_ARG_STREAM(geomblob), &geomblob, FUNCTION_ERROR);
+  if (FUNCTION_RESULT != SQLITE_OK || error_count(FUNCTION_ERROR) > 0) {
+    state->aggregate.failed = 1;
+  }
+
+  FUNCTION_END(context);
+
+  FUNCTION_FREE_GEOM_ARG(geomblob);
+}
+
+static void ST_MakeLine_final(sqlite3_context *context) {
+  makeline_state_t *state = NULL;
+
+  FUNCTION_START_STATIC(context, 256);
+
+  state = (makeline_state_t *)sqlite3_aggregate_context(context, 0);
+  if (state == NULL || !state->aggregate.started || state->aggregate.failed) {
+    sqlite3_result_null(context);
+    goto exit;
+  }
+
+  if (state->ordered) {
+    FUNCTION_RESULT = makeline_write_vertices(state, FUNCTION_ERROR);
+    if (FUNCTION_RESULT != SQLITE_OK) {
+      goto exit;
+    }
+  }
+  FUNCTION_RESULT = geom_aggregate_result(context, &state->aggregate, GEOM_LINESTRING, FUNCTION_ERROR);
+
+  FUNCTION_END(context);
+
+  if (state != NULL) {
+    geom_aggregate_destroy(&state->aggregate);
+    sqlite3_free(state->vertices);
+    state->vertices = NULL;
+  }
+}
+
+static int extent_srid_row(sqlite3 *db, sqlite3_stmt *stmt, void *data) {
+  *((int32_t *)data) = sqlite3_column_int(stmt, 0);
+  return SQLITE_ABORT;
+}
+
+static int extent_blob_row(sqlite3 *db, sqlite3_stmt *stmt, void *data) {
+  sqlite3_result_value((sqlite3_context *)data, sqlite3_column_value(stmt, 0));
+  return SQLITE_ABORT;
+}
+
+/*
+ * Returns the extent of a geometry column. If the column has a spatial index, the extent is taken from the root node
+ * of the index; otherwise it is computed using ST_Extent.
+ */
+static void GPKG_TableExtent(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  const spatialdb_t *spatialdb;
+  FUNCTION_TEXT_ARG(db_name);
+  FUNCTION_TEXT_ARG(table_name);
+  FUNCTION_TEXT_ARG(geometry_column_name);
+  char *index_table = NULL;
+  int index_exists = 0;
+  int is_spatialite = 0;
+  int32_t srid = INT32_MIN;
+  geom_envelope_t envelope;
+  FUNCTION_START(context);
+
+  spatialdb = (const spatialdb_t *)sqlite3_user_data(context);
+  if (nbArgs == 3) {
+    FUNCTION_GET_TEXT_ARG(context, db_name, 0);
+    FUNCTION_GET_TEXT_ARG(context, table_name, 1);
+    FUNCTION_GET_TEXT_ARG(context, geometry_column_name, 2);
+  } else {
+    FUNCTION_SET_TEXT_ARG(db_name, "main");
+    FUNCTION_GET_TEXT_ARG(context, table_name, 0);
+    FUNCTION_GET_TEXT_ARG(context, geometry_column_name, 1);
+  }
+  if (db_name == NULL || table_name == NULL || geometry_column_name == NULL) {
+    sqlite3_result_null(context);
+    goto exit;
+  }
+
+  for (int i = 0; i < 2 && !index_exists; i++) {
+    sqlite3_free(index_table);
+    index_table = sqlite3_mprintf(i == 0 ? "rtree_%s_%s" : "idx_%s_%s", table_name, geometry_column_name);
+    if (index_table == NULL) {
+      FUNCTION_RESULT = SQLITE_NOMEM;
+      goto exit;
+    }
+    FUNCTION_RESULT = sql_check_table_exists(FUNCTION_DB_HANDLE, db_name, index_table, &index_exists);
+    if (FUNCTION_RESULT != SQLITE_OK) {
+      error_append(FUNCTION_ERROR, "Could not check spatial index %s: %s", index_table, sqlite3_errmsg(FUNCTION_DB_HANDLE));
+      goto exit;
+    }
+    is_spatialite = i == 1;
+  }
+
+  if (!index_exists) {
+    FUNCTION_RESULT = sql_exec_stmt(FUNCTION_DB_HANDLE, extent_blob_row, NULL, context, "SELECT ST_Extent(\"%w\") FROM \"%w\".\"%w\"", geometry_column_name, db_name, table_name);
+    if (FUNCTION_RESULT != SQLITE_OK) {
+      error_append(FUNCTION_ERROR, "Could not compute extent of %s.%s: %s", table_name, geometry_column_name, sqlite3_errmsg(FUNCTION_DB_HANDLE));
+    }
+    goto exit;
+  }
 
-  FUNCTION_RESULT = spatialdb->read_geometry(&FUNCTION_GEOM_ARG_STREAM(geomblob), wkt_writer_geom_consumer(&writer), FUNCTION_ERROR);
+  FUNCTION_RESULT = rtree_query_extent(FUNCTION_DB_HANDLE, db_name, index_table, &envelope, FUNCTION_ERROR);
+  if (FUNCTION_RESULT != SQLITE_OK) {
+    goto exit;
+  }
 
-  if (FUNCTION_RESULT == SQLITE_OK) {
-    sqlite3_result_text(context, wkt_writer_getwkt(&writer), (int) wkt_writer_length(&writer), SQLITE_TRANSIENT);
+  if (is_spatialite) {
+    FUNCTION_RESULT = sql_exec_stmt(FUNCTION_DB_HANDLE, extent_srid_row, NULL, &srid, "SELECT srid FROM \"%w\".geometry_columns WHERE f_table_name LIKE %Q AND f_geometry_column LIKE %Q", db_name, table_name, geometry_column_name);
+  } else {
+    FUNCTION_RESULT = sql_exec_stmt(FUNCTION_DB_HANDLE, extent_srid_row, NULL, &srid, "SELECT srs_id FROM \"%w\".gpkg_geometry_columns WHERE table_name LIKE %Q AND column_name LIKE %Q", db_name, table_name, geometry_column_name);
+  }
+  if (FUNCTION_RESULT != SQLITE_OK) {
+    error_append(FUNCTION_ERROR, "Could not read SRID of %s.%s: %s", table_name, geometry_column_name, sqlite3_errmsg(FUNCTION_DB_HANDLE));
+    goto exit;
   }
-  wkt_writer_destroy(&writer);
+
+  FUNCTION_RESULT = extent_result(context, spatialdb, &envelope, srid != INT32_MIN, srid, FUNCTION_ERROR);
 
   FUNCTION_END(context);
 
-  FUNCTION_FREE_GEOM_ARG(geomblob);
+  sqlite3_free(index_table);
+  FUNCTION_FREE_TEXT_ARG(db_name);
+  FUNCTION_FREE_TEXT_ARG(table_name);
+  FUNCTION_FREE_TEXT_ARG(geometry_column_name);
 }
 
 static int geometry_is_assignable(geom_type_t expected, geom_type_t actual, errorstream_t* error) {
@@ -257,40 +1141,44 @@ static int geometry_is_assignable(geom_type_t expected, geom_type_t actual, erro
 
 typedef int (*geometry_constructor_func)(sqlite3_context *context, void *user_data, geom_consumer_t *consumer, int nbArgs, sqlite3_value **args, errorstream_t *error);
 
-static void geometry_constructor(sqlite3_context *context, const spatialdb_t *spatialdb, geometry_constructor_func constructor, void* user_data, geom_type_t requiredType, int nbArgs, sqlite3_value **args) {
-  FUNCTION_START_STATIC(context, 256);
+static void geometry_constructor(sqlite3_context *context, const char *function_name, spatialdb_ctx_t *ctx, geometry_constructor_func constructor, void* user_data, geom_type_t requiredType, int nbArgs, sqlite3_value **args) {
+  FUNCTION_START_STATIC_NAMED(context, 256, function_name);
 
   geom_blob_auxdata *geom = (geom_blob_auxdata *)sqlite3_get_auxdata(context, 0);
 
   if (geom == NULL) {
-    geom_blob_writer_t writer;
+    geom_blob_writer_t local_writer;
+    geom_blob_writer_t *writer;
 
     if (sqlite3_value_type(args[nbArgs - 1]) == SQLITE_INTEGER) {
-      spatialdb->writer_init_srid(&writer, sqlite3_value_int(args[nbArgs - 1]));
+      writer = writer_pool_blob_acquire(&ctx->pool, &local_writer, 1, sqlite3_value_int(args[nbArgs - 1]));
       nbArgs -= 1;
     } else {
-      spatialdb->writer_init(&writer);
+      writer = writer_pool_blob_acquire(&ctx->pool, &local_writer, 0, 0);
+    }
+
+    if (writer == NULL) {
+      FUNCTION_RESULT = SQLITE_NOMEM;
+      goto exit;
     }
 
-    FUNCTION_RESULT = constructor(context, user_data, geom_blob_writer_geom_consumer(&writer), nbArgs, args, FUNCTION_ERROR);
+    FUNCTION_RESULT = constructor(context, user_data, geom_blob_writer_geom_consumer(writer), nbArgs, args, FUNCTION_ERROR);
 
-    if (FUNCTION_RESULT == SQLITE_OK) {
-      if (geometry_is_assignable(requiredType, writer.geom_type, FUNCTION_ERROR) == SQLITE_OK) {
-        uint8_t *data = geom_blob_writer_getdata(&writer);
-        int length = (int) geom_blob_writer_length(&writer);
-        sqlite3_result_blob(context, data, length, SQLITE_TRANSIENT);
-        spatialdb->writer_destroy(&writer, 0);
+    int transferred = 0;
+    if (FUNCTION_RESULT == SQLITE_OK && geometry_is_assignable(requiredType, writer->geom_type, FUNCTION_ERROR) == SQLITE_OK) {
+      uint8_t *data = geom_blob_writer_getdata(writer);
+      int length = (int) geom_blob_writer_length(writer);
+      sqlite3_result_blob(context, data, length, SQLITE_TRANSIENT);
 
-        geom = geom_blob_auxdata_malloc();
-        if (geom != NULL) {
-          geom->data = data;
-          geom->length = length;
-          sqlite3_set_auxdata(context, 0, geom, geom_blob_auxdata_free);
-        }
+      transferred = length >= WRITER_POOL_TRANSFER_SIZE;
+      geom = geom_blob_auxdata_malloc(ctx, data, length, !transferred);
+      if (geom != NULL) {
+        sqlite3_set_auxdata(context, 0, geom, geom_blob_auxdata_free);
+      } else {
+        transferred = 0;
       }
-    } else {
-      spatialdb->writer_destroy(&writer, 1);
     }
+    writer_pool_blob_release(&ctx->pool, writer, transferred);
   } else {
     sqlite3_result_blob(context, geom->data, geom->length, SQLITE_TRANSIENT);
   }
@@ -312,50 +1200,8 @@ static int geom_from_wkb(sqlite3_context *context, void *user_data, geom_consume
 }
 
 static void ST_GeomFromWKB(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
-  spatialdb_t *spatialdb = (spatialdb_t *)sqlite3_user_data(context);
-  geometry_constructor(context, spatialdb, geom_from_wkb, NULL, GEOM_GEOMETRY, nbArgs, args);
-}
-
-typedef struct {
-  volatile long ref_count;
-  const spatialdb_t *spatialdb;
-  i18n_locale_t *locale;
-} fromtext_t;
-
-static fromtext_t *fromtext_init(const spatialdb_t *spatialdb) {
-  fromtext_t *ctx = (fromtext_t *)sqlite3_malloc(sizeof(fromtext_t));
-
-  if (ctx == NULL) {
-    return NULL;
-  }
-
-  i18n_locale_t *locale = i18n_locale_init("C");
-  if (locale == NULL) {
-    sqlite3_free(ctx);
-    return NULL;
-  }
-
-  ctx->ref_count = 1;
-  ctx->locale = locale;
-  ctx->spatialdb = spatialdb;
-  return ctx;
-}
-
-static void fromtext_acquire(fromtext_t *fromtext) {
-  if (fromtext) {
-    atomic_inc_long(&fromtext->ref_count);
-  }
-}
-
-static void fromtext_release(fromtext_t *fromtext) {
-  if (fromtext) {
-    long newval = atomic_dec_long(&fromtext->ref_count);
-    if (newval == 0) {
-      i18n_locale_destroy(fromtext->locale);
-      fromtext->locale = NULL;
-      sqlite3_free(fromtext);
-    }
-  }
+  spatialdb_ctx_t *ctx = (spatialdb_ctx_t *)sqlite3_user_data(context);
+  geometry_constructor(context, __func__, ctx, geom_from_wkb, NULL, GEOM_GEOMETRY, nbArgs, args);
 }
 
 static int geom_from_wkt(sqlite3_context *context, void *user_data, geom_consumer_t* consumer, int nbArgs, sqlite3_value **args, errorstream_t *error) {
@@ -373,8 +1219,11 @@ static int geom_from_wkt(sqlite3_context *context, void *user_data, geom_consume
 }
 
 static void ST_GeomFromText(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
-  fromtext_t *fromtext = (fromtext_t *)sqlite3_user_data(context);
-  geometry_constructor(context, fromtext->spatialdb, geom_from_wkt, fromtext->locale, GEOM_GEOMETRY, nbArgs, args);
+  spatialdb_ctx_t *ctx = (spatialdb_ctx_t *)sqlite3_user_data(context);
+  i18n_locale_t *locale = spatialdb_ctx_locale(context, ctx);
+  if (locale != NULL) {
+    geometry_constructor(context, __func__, ctx, geom_from_wkt, locale, GEOM_GEOMETRY, nbArgs, args);
+  }
 }
 
 static int point_from_coords(sqlite3_context *context, void *user_data, geom_consumer_t *consumer, int nbArgs, sqlite3_value **args, errorstream_t *error) {
@@ -422,15 +1271,78 @@ static int point_from_coords(sqlite3_context *context, void *user_data, geom_con
   return result;
 }
 
+/*
+ * Encodes a point given as coordinates and an optional trailing SRID directly as a GeoPackage Binary blob. This
+ * produces the same blob as point_from_coords does through a GeoPackage Binary writer. Returns SQLITE_MISMATCH
+ * without setting a result if the arguments are not valid, so that geometry_constructor can report the error.
+ */
+static int gpb_point_from_coords(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  /* Same default as the writer_init function of the GeoPackage schemas */
+  int32_t srid = -1;
+  if (sqlite3_value_type(args[nbArgs - 1]) == SQLITE_INTEGER) {
+    srid = sqlite3_value_int(args[nbArgs - 1]);
+    nbArgs -= 1;
+  }
+
+  coord_type_t coord_type;
+  if (nbArgs == 2) {
+    coord_type = GEOM_XY;
+  } else if (nbArgs == 3) {
+    coord_type = GEOM_XYZ;
+  } else if (nbArgs == 4) {
+    coord_type = GEOM_XYZM;
+  } else {
+    return SQLITE_MISMATCH;
+  }
+
+  double coord[4];
+  for (int i = 0; i < nbArgs; i++) {
+    coord[i] = sqlite3_value_double(args[i]);
+  }
+
+  uint8_t blob[GPB_POINT_MAX_SIZE];
+  size_t length = gpb_write_point(blob, srid, coord_type, coord);
+  sqlite3_result_blob(context, blob, (int) length, SQLITE_TRANSIENT);
+  return SQLITE_OK;
+}
+
 static void ST_Point(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
-  fromtext_t *fromtext = (fromtext_t *)sqlite3_user_data(context);
+  spatialdb_ctx_t *ctx = (spatialdb_ctx_t *)sqlite3_user_data(context);
   if (sqlite3_value_type(args[0]) == SQLITE_TEXT) {
-    geometry_constructor(context, fromtext->spatialdb, geom_from_wkt, fromtext->locale, GEOM_POINT, nbArgs, args);
+    i18n_locale_t *locale = spatialdb_ctx_locale(context, ctx);
+    if (locale != NULL) {
+      geometry_constructor(context, __func__, ctx, geom_from_wkt, locale, GEOM_POINT, nbArgs, args);
+    }
   } else if (sqlite3_value_type(args[0]) == SQLITE_BLOB) {
-    geometry_constructor(context, fromtext->spatialdb, geom_from_wkb, NULL, GEOM_POINT, nbArgs, args);
+    geometry_constructor(context, __func__, ctx, geom_from_wkb, NULL, GEOM_POINT, nbArgs, args);
+  } else if (ctx->spatialdb->writer_init_srid == gpb_writer_init && gpb_point_from_coords(context, nbArgs, args) == SQLITE_OK) {
+    /* Point blobs have a fixed layout; skip the writer for GeoPackage Binary */
+  } else {
+    geometry_constructor(context, __func__, ctx, point_from_coords, NULL, GEOM_POINT, nbArgs, args);
+  }
+}
+
+static void GPKG_WriterPoolStats(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  FUNCTION_START_STATIC(context, 256);
+  spatialdb_ctx_t *ctx = (spatialdb_ctx_t *)sqlite3_user_data(context);
+  const char *counter = (const char *)sqlite3_value_text(args[0]);
+
+  writer_pool_stats_t *stats = &ctx->pool.stats;
+  if (counter == NULL) {
+    sqlite3_result_null(context);
+  } else if (sqlite3_stricmp(counter, "acquired") == 0) {
+    sqlite3_result_int64(context, stats->acquired);
+  } else if (sqlite3_stricmp(counter, "reused") == 0) {
+    sqlite3_result_int64(context, stats->reused);
+  } else if (sqlite3_stricmp(counter, "allocated") == 0) {
+    sqlite3_result_int64(context, stats->allocated);
+  } else if (sqlite3_stricmp(counter, "transferred") == 0) {
+    sqlite3_result_int64(context, stats->transferred);
   } else {
-    geometry_constructor(context, fromtext->spatialdb, point_from_coords, NULL, GEOM_POINT, nbArgs, args);
+    error_append(FUNCTION_ERROR, "Unknown writer pool counter: %s", counter);
   }
+
+  FUNCTION_END(context);
 }
 
 static void GPKG_IsAssignable(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
@@ -653,6 +1565,89 @@ static void GPKG_CreateTilesTable(sqlite3_context *context, int nbArgs, sqlite3_
   FUNCTION_FREE_TEXT_ARG(table_name);
 }
 
+static void GPKG_ImportTiles(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  spatialdb_t *spatialdb;
+  sqlite3_int64 tile_count = 0;
+  FUNCTION_TEXT_ARG(db_name);
+  FUNCTION_TEXT_ARG(table_name);
+  FUNCTION_TEXT_ARG(source);
+  FUNCTION_START(context);
+
+  spatialdb = (spatialdb_t *)sqlite3_user_data(context);
+  if (nbArgs == 3) {
+    FUNCTION_GET_TEXT_ARG(context, db_name, 0);
+    FUNCTION_GET_TEXT_ARG(context, table_name, 1);
+    FUNCTION_GET_TEXT_ARG(context, source, 2);
+  } else {
+    FUNCTION_SET_TEXT_ARG(db_name, "main");
+    FUNCTION_GET_TEXT_ARG(context, table_name, 0);
+    FUNCTION_GET_TEXT_ARG(context, source, 1);
+  }
+
+  if (table_name == NULL || source == NULL) {
+    error_append(FUNCTION_ERROR, "Table name and tile source must not be NULL");
+    goto exit;
+  }
+
+  FUNCTION_START_TRANSACTION(__import_tiles);
+  FUNCTION_RESULT = tile_import_table(FUNCTION_DB_HANDLE, spatialdb, db_name, table_name, source, &tile_count, FUNCTION_ERROR);
+  FUNCTION_END_TRANSACTION(__import_tiles);
+
+  if (FUNCTION_RESULT == SQLITE_OK) {
+    sqlite3_result_int64(context, tile_count);
+  }
+
+  FUNCTION_END(context);
+
+  FUNCTION_FREE_TEXT_ARG(db_name);
+  FUNCTION_FREE_TEXT_ARG(table_name);
+  FUNCTION_FREE_TEXT_ARG(source);
+}
+
+static void GPKG_CreateDedupTilesTable(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  spatialdb_t *spatialdb;
+  FUNCTION_TEXT_ARG(db_name);
+  FUNCTION_TEXT_ARG(table_name);
+  FUNCTION_START(context);
+
+  spatialdb = (spatialdb_t *)sqlite3_user_data(context);
+  if (nbArgs == 2) {
+    FUNCTION_GET_TEXT_ARG(context, db_name, 0);
+    FUNCTION_GET_TEXT_ARG(context, table_name, 1);
+  } else {
+    FUNCTION_SET_TEXT_ARG(db_name, "main");
+    FUNCTION_GET_TEXT_ARG(context, table_name, 0);
+  }
+
+  if (spatialdb->create_tiles_table == NULL) {
+    error_append(FUNCTION_ERROR, "Tiles tables are not supported in %s mode", spatialdb->name);
+    goto exit;
+  }
+
+  if (table_name == NULL) {
+    error_append(FUNCTION_ERROR, "Table name must not be NULL");
+    goto exit;
+  }
+
+  FUNCTION_START_TRANSACTION(__create_dedup_tiles_table);
+
+  FUNCTION_RESULT = spatialdb->init_meta(FUNCTION_DB_HANDLE, db_name, FUNCTION_ERROR);
+  if (FUNCTION_RESULT == SQLITE_OK) {
+    FUNCTION_RESULT = tile_dedup_create(FUNCTION_DB_HANDLE, db_name, table_name, FUNCTION_ERROR);
+  }
+
+  FUNCTION_END_TRANSACTION(__create_dedup_tiles_table);
+
+  if (FUNCTION_RESULT == SQLITE_OK) {
+    sqlite3_result_null(context);
+  }
+
+  FUNCTION_END(context);
+
+  FUNCTION_FREE_TEXT_ARG(db_name);
+  FUNCTION_FREE_TEXT_ARG(table_name);
+}
+
 static void GPKG_CreateSpatialIndex(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
   spatialdb_t *spatialdb;
   FUNCTION_TEXT_ARG(db_name);
@@ -700,7 +1695,85 @@ static void GPKG_CreateSpatialIndex(sqlite3_context *context, int nbArgs, sqlite
   FUNCTION_FREE_TEXT_ARG(id_column_name);
 }
 
-const spatialdb_t *spatialdb_detect_schema(sqlite3 *db) {
+static void GPKG_EnableContentsExtent(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  spatialdb_t *spatialdb;
+  FUNCTION_TEXT_ARG(db_name);
+  FUNCTION_START(context);
+
+  spatialdb = (spatialdb_t *)sqlite3_user_data(context);
+  if (nbArgs == 1) {
+    FUNCTION_GET_TEXT_ARG(context, db_name, 0);
+  } else {
+    FUNCTION_SET_TEXT_ARG(db_name, "main");
+  }
+
+  if (spatialdb->create_tiles_table == NULL) {
+    error_append(FUNCTION_ERROR, "gpkg_contents extent maintenance is not supported in %s mode", spatialdb->name);
+    goto exit;
+  }
+
+  FUNCTION_START_TRANSACTION(__enable_contents_extent);
+
+  FUNCTION_RESULT = spatialdb->init_meta(FUNCTION_DB_HANDLE, db_name, FUNCTION_ERROR);
+  if (FUNCTION_RESULT == SQLITE_OK) {
+    FUNCTION_RESULT = contents_extent_enable(FUNCTION_DB_HANDLE, db_name, FUNCTION_ERROR);
+  }
+
+  FUNCTION_END_TRANSACTION(__enable_contents_extent);
+
+  if (FUNCTION_RESULT == SQLITE_OK) {
+    sqlite3_result_null(context);
+  }
+
+  FUNCTION_END(context);
+
+  FUNCTION_FREE_TEXT_ARG(db_name);
+}
+
+/*
+ * Called from the extent maintenance triggers, so this must not start a transaction.
+ */
+static void GPKG_RefreshContentsExtent(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  spatialdb_t *spatialdb;
+  FUNCTION_TEXT_ARG(db_name);
+  FUNCTION_TEXT_ARG(table_name);
+  FUNCTION_TEXT_ARG(geometry_column_name);
+  FUNCTION_START(context);
+
+  spatialdb = (spatialdb_t *)sqlite3_user_data(context);
+  if (nbArgs == 3) {
+    FUNCTION_GET_TEXT_ARG(context, db_name, 0);
+    FUNCTION_GET_TEXT_ARG(context, table_name, 1);
+    FUNCTION_GET_TEXT_ARG(context, geometry_column_name, 2);
+  } else {
+    FUNCTION_SET_TEXT_ARG(db_name, "main");
+    FUNCTION_GET_TEXT_ARG(context, table_name, 0);
+    FUNCTION_GET_TEXT_ARG(context, geometry_column_name, 1);
+  }
+
+  if (spatialdb->create_tiles_table == NULL) {
+    error_append(FUNCTION_ERROR, "gpkg_contents extent maintenance is not supported in %s mode", spatialdb->name);
+    goto exit;
+  }
+
+  if (table_name == NULL || geometry_column_name == NULL) {
+    error_append(FUNCTION_ERROR, "Table and column name must not be NULL");
+    goto exit;
+  }
+
+  FUNCTION_RESULT = contents_extent_refresh(FUNCTION_DB_HANDLE, db_name, table_name, geometry_column_name, FUNCTION_ERROR);
+  if (FUNCTION_RESULT == SQLITE_OK) {
+    sqlite3_result_null(context);
+  }
+
+  FUNCTION_END(context);
+
+  FUNCTION_FREE_TEXT_ARG(db_name);
+  FUNCTION_FREE_TEXT_ARG(table_name);
+  FUNCTION_FREE_TEXT_ARG(geometry_column_name);
+}
+
+static const spatialdb_t *spatialdb_probe_schema(sqlite3 *db) {
   char message_buffer[256];
   errorstream_t error;
   error_init_fixed(&error, message_buffer, 256);
@@ -733,6 +1806,132 @@ const spatialdb_t *spatialdb_detect_schema(sqlite3 *db) {
   }
 }
 
+/*
+ * Schema detection probes every known schema using a series of queries. Per request connections to the same file
+ * would repeat that work every time, so detection results are cached per file. An entry is identified by the file
+ * name and, where the platform provides stable inode numbers, the device and inode of the database file. It is only
+ * valid as long as the schema cookie, application id and user version of the database are unchanged. In-memory and
+ * temporary databases have no file name and are never cached.
+ */
+#define SCHEMA_CACHE_SIZE 16
+
+typedef struct {
+  char *filename;
+  sqlite3_int64 device;
+  sqlite3_int64 inode;
+  int schema_version;
+  int application_id;
+  int user_version;
+} schema_cache_key_t;
+
+typedef struct {
+  schema_cache_key_t key;
+  const spatialdb_t *spatialdb;
+} schema_cache_entry_t;
+
+static schema_cache_entry_t schema_cache[SCHEMA_CACHE_SIZE];
+static int schema_cache_next = 0;
+static sqlite3_mutex *volatile schema_cache_mutex = NULL;
+
+static int schema_cache_key(sqlite3 *db, schema_cache_key_t *key) {
+  memset(key, 0, sizeof(schema_cache_key_t));
+
+  if (sqlite3_libversion_number() < 3007010) {
+    return SQLITE_MISUSE;
+  }
+
+  const char *filename = sqlite3_db_filename(db, "main");
+  if (filename == NULL || *filename == '\0' || strcmp(filename, ":memory:") == 0) {
+    return SQLITE_MISUSE;
+  }
+  key->filename = (char *) filename;
+
+#if defined(_WIN32) || defined(WIN32)
+  // Windows does not report inode numbers, so files are only identified by name
+#else
+  struct stat file_stat;
+  if (stat(filename, &file_stat) != 0) {
+    return SQLITE_IOERR;
+  }
+  key->device = (sqlite3_int64) file_stat.st_dev;
+  key->inode = (sqlite3_int64) file_stat.st_ino;
+#endif
+
+  int result = sql_exec_for_int(db, &key->schema_version, "PRAGMA main.schema_version");
+  if (result == SQLITE_OK) {
+    result = sql_exec_for_int(db, &key->application_id, "PRAGMA main.application_id");
+  }
+  if (result == SQLITE_OK) {
+    result = sql_exec_for_int(db, &key->user_version, "PRAGMA main.user_version");
+  }
+  return result;
+}
+
+static int schema_cache_key_equals(const schema_cache_key_t *a, const schema_cache_key_t *b) {
+  return a->device == b->device && a->inode == b->inode && a->schema_version == b->schema_version &&
+         a->application_id == b->application_id && a->user_version == b->user_version && strcmp(a->filename, b->filename) == 0;
+}
+
+static const spatialdb_t *schema_cache_get(const schema_cache_key_t *key) {
+  const spatialdb_t *spatialdb = NULL;
+  sqlite3_mutex *mutex = sql_mutex_once(&schema_cache_mutex);
+
+  sqlite3_mutex_enter(mutex);
+  for (int i = 0; i < SCHEMA_CACHE_SIZE; i++) {
+    schema_cache_entry_t *entry = &schema_cache[i];
+    if (entry->key.filename != NULL && schema_cache_key_equals(&entry->key, key)) {
+      spatialdb = entry->spatialdb;
+      break;
+    }
+  }
+  sqlite3_mutex_leave(mutex);
+
+  return spatialdb;
+}
+
+static void schema_cache_put(const schema_cache_key_t *key, const spatialdb_t *spatialdb) {
+  sqlite3_mutex *mutex = sql_mutex_once(&schema_cache_mutex);
+  schema_cache_entry_t *entry = NULL;
+
+  char *filename_copy = sqlite3_mprintf("%s", key->filename);
+  if (filename_copy == NULL) {
+    return;
+  }
+
+  sqlite3_mutex_enter(mutex);
+  for (int i = 0; i < SCHEMA_CACHE_SIZE; i++) {
+    if (schema_cache[i].key.filename != NULL && strcmp(schema_cache[i].key.filename, key->filename) == 0) {
+      entry = &schema_cache[i];
+      break;
+    }
+  }
+  if (entry == NULL) {
+    entry = &schema_cache[schema_cache_next];
+    schema_cache_next = (schema_cache_next + 1) % SCHEMA_CACHE_SIZE;
+  }
+
+  sqlite3_free(entry->key.filename);
+  entry->key = *key;
+  entry->key.filename = filename_copy;
+  entry->spatialdb = spatialdb;
+  sqlite3_mutex_leave(mutex);
+}
+
+const spatialdb_t *spatialdb_detect_schema(sqlite3 *db) {
+  schema_cache_key_t key;
+
+  if (schema_cache_key(db, &key) != SQLITE_OK) {
+    return spatialdb_probe_schema(db);
+  }
+
+  const spatialdb_t *spatialdb = schema_cache_get(&key);
+  if (spatialdb == NULL) {
+    spatialdb = spatialdb_probe_schema(db);
+    schema_cache_put(&key, spatialdb);
+  }
+  return spatialdb;
+}
+
 #define STR(x) #x
 
 #define SPATIALDB_FUNCTION(db, pre, name, args, flags, spatialdb, err)                                                 \
@@ -747,20 +1946,26 @@ const spatialdb_t *spatialdb_detect_schema(sqlite3 *db) {
     sql_create_function(db, STR(pre##_##name), pre##_##func, args, flags, (void*)spatialdb, NULL, err);                \
   } while (0)
 
-#define FROMTEXT_FUNCTION(db, pre, name, args, flags, ft, err)                                                         \
+#define SPATIALDB_AGGREGATE(db, pre, name, args, flags, spatialdb, err)                                                \
+  do {                                                                                                                 \
+    sql_create_aggregate(db, STR(name), pre##_##name##_step, pre##_##name##_final, args, flags, (void*)spatialdb, NULL, err); \
+    sql_create_aggregate(db, STR(pre##_##name), pre##_##name##_step, pre##_##name##_final, args, flags, (void*)spatialdb, NULL, err); \
+  } while (0)
+
+#define CTX_FUNCTION(db, pre, name, args, flags, ctx, err)                                                             \
   do {                                                                                                                 \
-    fromtext_acquire(fromtext);                                                                                        \
-    sql_create_function(db, STR(name), pre##_##name, args, flags, ft, (void(*)(void*))fromtext_release, err);          \
-    fromtext_acquire(fromtext);                                                                                        \
-    sql_create_function(db, STR(pre##_##name), pre##_##name, args, flags, ft, (void(*)(void*))fromtext_release, err);  \
+    spatialdb_ctx_acquire(ctx);                                                                                        \
+    sql_create_function(db, STR(name), pre##_##name, args, flags, ctx, (void(*)(void*))spatialdb_ctx_release, err);    \
+    spatialdb_ctx_acquire(ctx);                                                                                        \
+    sql_create_function(db, STR(pre##_##name), pre##_##name, args, flags, ctx, (void(*)(void*))spatialdb_ctx_release, err); \
   } while (0)
 
-#define FROMTEXT_ALIAS(db, pre, name, func, args, flags, ft, err)                                                      \
+#define CTX_ALIAS(db, pre, name, func, args, flags, ctx, err)                                                          \
   do {                                                                                                                 \
-    fromtext_acquire(fromtext);                                                                                        \
-    sql_create_function(db, STR(name), pre##_##func, args, flags, (void*)ft, (void(*)(void*))fromtext_release, err);   \
-    fromtext_acquire(fromtext);                                                                                        \
-    sql_create_function(db, STR(pre##_##name), pre##_##func, args, flags, (void*)ft, (void(*)(void*))fromtext_release, err);  \
+    spatialdb_ctx_acquire(ctx);                                                                                        \
+    sql_create_function(db, STR(name), pre##_##func, args, flags, (void*)ctx, (void(*)(void*))spatialdb_ctx_release, err); \
+    spatialdb_ctx_acquire(ctx);                                                                                        \
+    sql_create_function(db, STR(pre##_##name), pre##_##func, args, flags, (void*)ctx, (void(*)(void*))spatialdb_ctx_release, err); \
   } while (0)
 
 SQLITE_EXTENSION_INIT1
@@ -840,6 +2045,9 @@ int spatialdb_init(sqlite3 *db, const char **pzErrMsg, const sqlite3_api_routine
   SPATIALDB_FUNCTION(db, ST, MaxZ, 1, SQL_DETERMINISTIC, spatialdb, &error);
   SPATIALDB_FUNCTION(db, ST, MinM, 1, SQL_DETERMINISTIC, spatialdb, &error);
   SPATIALDB_FUNCTION(db, ST, MaxM, 1, SQL_DETERMINISTIC, spatialdb, &error);
+  SPATIALDB_FUNCTION(db, ST, EnvIntersects, 2, SQL_DETERMINISTIC, spatialdb, &error);
+  SPATIALDB_FUNCTION(db, ST, EnvContains, 2, SQL_DETERMINISTIC, spatialdb, &error);
+  SPATIALDB_FUNCTION(db, ST, EnvWithin, 2, SQL_DETERMINISTIC, spatialdb, &error);
   SPATIALDB_FUNCTION(db, ST, SRID, 1, SQL_DETERMINISTIC, spatialdb, &error);
   SPATIALDB_FUNCTION(db, ST, SRID, 2, SQL_DETERMINISTIC, spatialdb, &error);
   SPATIALDB_FUNCTION(db, ST, Is3d, 1, SQL_DETERMINISTIC, spatialdb, &error);
@@ -847,34 +2055,45 @@ int spatialdb_init(sqlite3 *db, const char **pzErrMsg, const sqlite3_api_routine
   SPATIALDB_FUNCTION(db, ST, IsMeasured, 1, SQL_DETERMINISTIC, spatialdb, &error);
   SPATIALDB_FUNCTION(db, ST, CoordDim, 1, SQL_DETERMINISTIC, spatialdb, &error);
   SPATIALDB_FUNCTION(db, ST, GeometryType, 1, SQL_DETERMINISTIC, spatialdb, &error);
-  SPATIALDB_FUNCTION(db, ST, AsBinary, 1, SQL_DETERMINISTIC, spatialdb, &error);
-  SPATIALDB_FUNCTION(db, ST, GeomFromWKB, 1, SQL_DETERMINISTIC, spatialdb, &error);
-  SPATIALDB_FUNCTION(db, ST, GeomFromWKB, 2, SQL_DETERMINISTIC, spatialdb, &error);
-  SPATIALDB_ALIAS(db, ST, WKBToSQL, GeomFromWKB, 1, SQL_DETERMINISTIC, spatialdb, &error);
-  SPATIALDB_ALIAS(db, ST, WKBToSQL, GeomFromWKB, 2, SQL_DETERMINISTIC, spatialdb, &error);
-  SPATIALDB_FUNCTION(db, ST, AsText, 1, SQL_DETERMINISTIC, spatialdb, &error);
-
-  fromtext_t *fromtext = fromtext_init(spatialdb);
-  if (fromtext != NULL) {
-    FROMTEXT_FUNCTION(db, ST, GeomFromText, 1, SQL_DETERMINISTIC, fromtext, &error);
-    FROMTEXT_FUNCTION(db, ST, GeomFromText, 2, SQL_DETERMINISTIC, fromtext, &error);
-    FROMTEXT_ALIAS(db, ST, WKTToSQL, GeomFromText, 1, SQL_DETERMINISTIC, fromtext, &error);
-    FROMTEXT_ALIAS(db, ST, WKTToSQL, GeomFromText, 2, SQL_DETERMINISTIC, fromtext, &error);
-
-    FROMTEXT_FUNCTION(db, ST, Point, 1, SQL_DETERMINISTIC, fromtext, &error);
-    FROMTEXT_ALIAS(db, ST, MakePoint, Point, 1, SQL_DETERMINISTIC, fromtext, &error);
-    FROMTEXT_FUNCTION(db, ST, Point, 2, SQL_DETERMINISTIC, fromtext, &error);
-    FROMTEXT_ALIAS(db, ST, MakePoint, Point, 2, SQL_DETERMINISTIC, fromtext, &error);
-    FROMTEXT_FUNCTION(db, ST, Point, 3, SQL_DETERMINISTIC, fromtext, &error);
-    FROMTEXT_ALIAS(db, ST, MakePoint, Point, 3, SQL_DETERMINISTIC, fromtext, &error);
-    FROMTEXT_FUNCTION(db, ST, Point, 4, SQL_DETERMINISTIC, fromtext, &error);
-    FROMTEXT_ALIAS(db, ST, MakePoint, Point, 4, SQL_DETERMINISTIC, fromtext, &error);
-    FROMTEXT_FUNCTION(db, ST, Point, 5, SQL_DETERMINISTIC, fromtext, &error);
-    FROMTEXT_ALIAS(db, ST, MakePoint, Point, 5, SQL_DETERMINISTIC, fromtext, &error);
-
-    fromtext_release(fromtext);
+  SPATIALDB_AGGREGATE(db, ST, Extent, 1, SQL_DETERMINISTIC, spatialdb, &error);
+  SPATIALDB_AGGREGATE(db, ST, Collect, 1, SQL_DETERMINISTIC, spatialdb, &error);
+  SPATIALDB_AGGREGATE(db, ST, MakeLine, 1, SQL_DETERMINISTIC, spatialdb, &error);
+  SPATIALDB_AGGREGATE(db, ST, MakeLine, 2, SQL_DETERMINISTIC, spatialdb, &error);
+  sql_create_function(db, "gpkg_table_extent", GPKG_TableExtent, 2, 0, (void *)spatialdb, NULL, &error);
+  sql_create_function(db, "gpkg_table_extent", GPKG_TableExtent, 3, 0, (void *)spatialdb, NULL, &error);
+  spatialdb_ctx_t *ctx = spatialdb_ctx_init(spatialdb);
+  if (ctx != NULL) {
+    CTX_FUNCTION(db, ST, AsBinary, 1, SQL_DETERMINISTIC, ctx, &error);
+    CTX_FUNCTION(db, ST, AsText, 1, SQL_DETERMINISTIC, ctx, &error);
+    CTX_FUNCTION(db, ST, Envelope, 1, SQL_DETERMINISTIC, ctx, &error);
+    CTX_FUNCTION(db, ST, Simplify, 2, SQL_DETERMINISTIC, ctx, &error);
+
+    CTX_FUNCTION(db, ST, GeomFromWKB, 1, SQL_DETERMINISTIC, ctx, &error);
+    CTX_FUNCTION(db, ST, GeomFromWKB, 2, SQL_DETERMINISTIC, ctx, &error);
+    CTX_ALIAS(db, ST, WKBToSQL, GeomFromWKB, 1, SQL_DETERMINISTIC, ctx, &error);
+    CTX_ALIAS(db, ST, WKBToSQL, GeomFromWKB, 2, SQL_DETERMINISTIC, ctx, &error);
+
+    CTX_FUNCTION(db, ST, GeomFromText, 1, SQL_DETERMINISTIC, ctx, &error);
+    CTX_FUNCTION(db, ST, GeomFromText, 2, SQL_DETERMINISTIC, ctx, &error);
+    CTX_ALIAS(db, ST, WKTToSQL, GeomFromText, 1, SQL_DETERMINISTIC, ctx, &error);
+    CTX_ALIAS(db, ST, WKTToSQL, GeomFromText, 2, SQL_DETERMINISTIC, ctx, &error);
+
+    CTX_FUNCTION(db, ST, Point, 1, SQL_DETERMINISTIC, ctx, &error);
+    CTX_ALIAS(db, ST, MakePoint, Point, 1, SQL_DETERMINISTIC, ctx, &error);
+    CTX_FUNCTION(db, ST, Point, 2, SQL_DETERMINISTIC, ctx, &error);
+    CTX_ALIAS(db, ST, MakePoint, Point, 2, SQL_DETERMINISTIC, ctx, &error);
+    CTX_FUNCTION(db, ST, Point, 3, SQL_DETERMINISTIC, ctx, &error);
+    CTX_ALIAS(db, ST, MakePoint, Point, 3, SQL_DETERMINISTIC, ctx, &error);
+    CTX_FUNCTION(db, ST, Point, 4, SQL_DETERMINISTIC, ctx, &error);
+    CTX_ALIAS(db, ST, MakePoint, Point, 4, SQL_DETERMINISTIC, ctx, &error);
+    CTX_FUNCTION(db, ST, Point, 5, SQL_DETERMINISTIC, ctx, &error);
+    CTX_ALIAS(db, ST, MakePoint, Point, 5, SQL_DETERMINISTIC, ctx, &error);
+
+    CTX_FUNCTION(db, GPKG, WriterPoolStats, 1, 0, ctx, &error);
+
+    spatialdb_ctx_release(ctx);
   } else {
-    error_append(&error, "Could not create fromtext function context");
+    error_append(&error, "Could not create spatial function context");
   }
 
   SPATIALDB_FUNCTION(db, GPKG, IsAssignable, 2, SQL_DETERMINISTIC, spatialdb, &error);
@@ -889,15 +2108,37 @@ int spatialdb_init(sqlite3 *db, const char **pzErrMsg, const sqlite3_api_routine
   SPATIALDB_FUNCTION(db, GPKG, AddGeometryColumn, 7, 0, spatialdb, &error);
   SPATIALDB_FUNCTION(db, GPKG, CreateTilesTable, 1, 0, spatialdb, &error);
   SPATIALDB_FUNCTION(db, GPKG, CreateTilesTable, 2, 0, spatialdb, &error);
+  /*
+   * ImportTiles reads arbitrary local files, so it must not be reachable from views or triggers of untrusted databases.
+   * Without direct only function support it is only available through gpkg_import_tiles().
+   */
+  if (sql_direct_only_supported()) {
+    SPATIALDB_FUNCTION(db, GPKG, ImportTiles, 2, SQL_DIRECT_ONLY, spatialdb, &error);
+    SPATIALDB_FUNCTION(db, GPKG, ImportTiles, 3, SQL_DIRECT_ONLY, spatialdb, &error);
+  }
+  SPATIALDB_FUNCTION(db, GPKG, CreateDedupTilesTable, 1, 0, spatialdb, &error);
+  SPATIALDB_FUNCTION(db, GPKG, CreateDedupTilesTable, 2, 0, spatialdb, &error);
   SPATIALDB_FUNCTION(db, GPKG, CreateSpatialIndex, 3, 0, spatialdb, &error);
   SPATIALDB_FUNCTION(db, GPKG, CreateSpatialIndex, 4, 0, spatialdb, &error);
+  SPATIALDB_FUNCTION(db, GPKG, EnableContentsExtent, 0, 0, spatialdb, &error);
+  SPATIALDB_FUNCTION(db, GPKG, EnableContentsExtent, 1, 0, spatialdb, &error);
+  SPATIALDB_FUNCTION(db, GPKG, RefreshContentsExtent, 2, 0, spatialdb, &error);
+  SPATIALDB_FUNCTION(db, GPKG, RefreshContentsExtent, 3, 0, spatialdb, &error);
   SPATIALDB_FUNCTION(db, GPKG, SpatialDBType, 0, 0, spatialdb, &error);
 
+  spatial_vtab_init(db, spatialdb, &error);
+  rtree_query_init(db, spatialdb, &error);
+  tile_matrix_init(db, spatialdb, &error);
+
 
 #ifdef GPKG_GEOM_FUNC
   geom_func_init(db, spatialdb, &error);
 #endif
 
+#ifdef GPKG_STATS
+  stats_init(db, &error);
+#endif
+
   int result;
   if (error_count(&error) == 0) {
     result = SQLITE_OK;
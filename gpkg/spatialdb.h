@@ -127,6 +127,13 @@ const spatialdb_t *spatialdb_spatialite3_schema();
  */
 const spatialdb_t *spatialdb_spatialite4_schema();
 
+/**
+ * Determines the spatial database schema of the main database of the given connection. If the schema cannot be
+ * determined the GeoPackage schema is returned. Results for database files are cached for the lifetime of the process
+ * and reused until the schema of the file changes.
+ */
+const spatialdb_t *spatialdb_detect_schema(sqlite3 *db);
+
 /**
  * Initializes the given sqlite database with a specific spatial database schema. If the schema is set to NULL,
  * this function will attempt to autodetect the applicable schema.
@@ -17,13 +17,21 @@
 #define GPKG_SPATIALDB_INTERNAL_H
 
 #include "spatialdb.h"
+#include "stats.h"
 
 #define FUNCTION_NOOP do {} while(0)
 #define FUNCTION_RESULT _result
 #define FUNCTION_DB_HANDLE _db_handle
 #define FUNCTION_ERROR _error_ptr
 
-#define FUNCTION_START(context)                                                                                        \
+#define FUNCTION_START(context) FUNCTION_START_NAMED(context, __func__)
+
+/*
+ * Variant of FUNCTION_START for implementations that are shared by several SQL functions or whose C name differs
+ * from their SQL name. The name is used for the gpkg_stats counters and must have static storage duration.
+ */
+#define FUNCTION_START_NAMED(context, name)                                                                            \
+    STATS_START(name);                                                                                                 \
     int FUNCTION_RESULT = SQLITE_OK;                                                                                   \
     errorstream_t _error;                                                                                                    \
     errorstream_t* FUNCTION_ERROR = &_error;                                                                                 \
@@ -33,7 +41,10 @@
     };                                                                                                                 \
     sqlite3 *FUNCTION_DB_HANDLE = sqlite3_context_db_handle(context)
 
-#define FUNCTION_START_STATIC(context, error_buf_size)                                                                 \
+#define FUNCTION_START_STATIC(context, error_buf_size) FUNCTION_START_STATIC_NAMED(context, error_buf_size, __func__)
+
+#define FUNCTION_START_STATIC_NAMED(context, error_buf_size, name)                                                     \
+    STATS_START(name);                                                                                                 \
     int FUNCTION_RESULT = SQLITE_OK;                                                                                   \
     char error_buffer[error_buf_size];                                                                                 \
     errorstream_t _error;                                                                                                    \
@@ -64,6 +75,7 @@
       }                                                                                                                \
       sqlite3_result_error(context, error_message(FUNCTION_ERROR), -1);                                                \
     }                                                                                                                  \
+    STATS_END(FUNCTION_RESULT != SQLITE_OK || error_count(FUNCTION_ERROR) > 0);                                        \
     error_destroy(FUNCTION_ERROR)
 
 #define FUNCTION_END_NESTED(context)                                                                                   \
@@ -134,6 +146,7 @@
             sqlite3_result_null(context);                                                                              \
             goto exit;                                                                                                 \
         }                                                                                                              \
+        STATS_BYTES(arg##_length);                                                                                     \
     } while (0)
 #define FUNCTION_FREE_BLOB_ARG(arg) FUNCTION_NOOP
 
@@ -589,7 +589,7 @@ static void spl_geometry_constraints(sqlite3_context *context, int nbArgs, sqlit
   FUNCTION_TEXT_ARG(expected_dimension_text);
   geom_header_t expected;
 
-  FUNCTION_START_STATIC(context, 256);
+  FUNCTION_START_STATIC_NAMED(context, 256, "GeometryConstraints");
   spatialdb = (const spatialdb_t *)sqlite3_user_data(context);
 
   if (nbArgs == 3) {
@@ -830,7 +830,7 @@ static void spl_rtree_align(sqlite3_context *context, int nbArgs, sqlite3_value
   FUNCTION_TEXT_ARG(row_id);
   FUNCTION_GEOM_ARG(geom);
 
-  FUNCTION_START_STATIC(context, 256);
+  FUNCTION_START_STATIC_NAMED(context, 256, "RTreeAlign");
   spatialdb = (const spatialdb_t *)sqlite3_user_data(context);
   FUNCTION_GET_TEXT_ARG(context, index_table_name, 0);
   FUNCTION_GET_TEXT_ARG(context, row_id, 1);
@@ -15,6 +15,7 @@
  */
 #include <stdarg.h>
 #include <stdlib.h>
+#include "atomic_ops.h"
 #include "sqlite.h"
 #include "sql.h"
 
@@ -969,6 +970,36 @@ int sql_check_integrity(sqlite3 *db, const char *db_name, errorstream_t *error)
   return result;
 }
 
+sqlite3_mutex *sql_mutex_once(sqlite3_mutex *volatile *mutex) {
+  sqlite3_mutex *current = *mutex;
+  if (current != NULL) {
+    return current;
+  }
+
+  sqlite3_mutex *allocated = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+  if (allocated == NULL) {
+    return NULL;
+  }
+
+  if (!atomic_cas_pointer((void *volatile *) mutex, NULL, allocated)) {
+    // Another thread allocated the mutex first
+    sqlite3_mutex_free(allocated);
+  }
+  return *mutex;
+}
+
+/*
+ * SQLITE_DIRECTONLY is part of the stable function flag ABI, so it can be passed to newer libraries even when building
+ * against older headers.
+ */
+#ifndef SQLITE_DIRECTONLY
+#define SQLITE_DIRECTONLY 0x000080000
+#endif
+
+int sql_direct_only_supported() {
+  return sqlite3_libversion_number() >= 3030000;
+}
+
 int sql_create_function(sqlite3 *db, const char *name, void (*function)(sqlite3_context *, int, sqlite3_value **), int args, int flags, void *user_data, void (*destroy)(void *), errorstream_t *error) {
   int function_flags = SQLITE_UTF8;
 
@@ -978,6 +1009,14 @@ int sql_create_function(sqlite3 *db, const char *name, void (*function)(sqlite3_
   }
 #endif
 
+  if ((flags & SQL_DIRECT_ONLY) != 0) {
+    if (!sql_direct_only_supported()) {
+      error_append(error, "Error registering function %s/%d: direct only functions require SQLite 3.30.0 or later", name, args);
+      return SQLITE_MISUSE;
+    }
+    function_flags |= SQLITE_DIRECTONLY;
+  }
+
   int result = sqlite3_create_function_v2(
                  db, name, args, function_flags, user_data, function, NULL, NULL, destroy
                );
@@ -988,6 +1027,25 @@ int sql_create_function(sqlite3 *db, const char *name, void (*function)(sqlite3_
   return result;
 }
 
+int sql_create_aggregate(sqlite3 *db, const char *name, void (*step)(sqlite3_context *, int, sqlite3_value **), void (*final)(sqlite3_context *), int args, int flags, void *user_data, void (*destroy)(void *), errorstream_t *error) {
+  int function_flags = SQLITE_UTF8;
+
+#if SQLITE_VERSION_NUMBER >= 3008003
+  if (((flags & SQL_DETERMINISTIC) != 0) && sqlite3_libversion_number() >= 3008003) {
+    function_flags |= SQLITE_DETERMINISTIC;
+  }
+#endif
+
+  int result = sqlite3_create_function_v2(
+                 db, name, args, function_flags, user_data, NULL, step, final, destroy
+               );
+  if (result != SQLITE_OK) {
+    error_append(error, "Error registering aggregate function %s/%d: %s", name, args, sqlite3_errmsg(db));
+  }
+
+  return result;
+}
+
 int sql_get_application_id(sqlite3 *db, const char *db_name, int *out, errorstream_t *error) {
   int result = sql_exec_for_int(db, out, "PRAGMA %w.application_id", db_name);
   if (result != SQLITE_OK) {
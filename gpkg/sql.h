@@ -361,12 +361,38 @@ int sql_init_table(sqlite3 *db, const char *db_name, const table_info_t *table_i
 
 int sql_init_stmt(sqlite3_stmt **stmt, sqlite3 *db, char *sql);
 
+/**
+ * Returns a process wide mutex that is private to the caller, allocating it the first time. The mutex is stored in
+ * the given location, which should be a static variable initialized to NULL. Concurrent first calls all return the
+ * same mutex. Returns NULL, which the sqlite3_mutex functions accept as a no-op mutex, if SQLite is built without
+ * mutexes or the mutex could not be allocated.
+ * @param mutex the location where the mutex is stored
+ * @return the mutex
+ */
+sqlite3_mutex *sql_mutex_once(sqlite3_mutex *volatile *mutex);
+
 typedef void(sql_function)(sqlite3_context *, int, sqlite3_value **);
 
 #define SQL_DETERMINISTIC 1
 
+/**
+ * Restricts a function to top level SQL. Functions registered with this flag cannot be invoked from views, triggers,
+ * CHECK constraints or other schema objects. Requires SQLite 3.30.0 or later; see sql_direct_only_supported().
+ */
+#define SQL_DIRECT_ONLY 2
+
+/**
+ * Checks whether the SQLite library in use supports functions registered with SQL_DIRECT_ONLY.
+ * @return 1 if SQL_DIRECT_ONLY is supported, 0 otherwise
+ */
+int sql_direct_only_supported();
+
 int sql_create_function(sqlite3 *db, const char *name, sql_function *function, int args, int flags, void *user_data, void (*destroy)(void *), errorstream_t *error);
 
+typedef void(sql_final)(sqlite3_context *);
+
+int sql_create_aggregate(sqlite3 *db, const char *name, sql_function *step, sql_final *final, int args, int flags, void *user_data, void (*destroy)(void *), errorstream_t *error);
+
 int sql_set_application_id(sqlite3 *db, const char *db_name, int application_id, errorstream_t *error);
 
 int sql_get_application_id(sqlite3 *db, const char *db_name, int *application_id, errorstream_t *error);
@@ -0,0 +1,504 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#include "atomic_ops.h"
+#include "sql.h"
+#include "stats.h"
+#include "tls.h"
+
+#ifdef GPKG_STATS
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__MACH__) || defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+/*
+ * Each thread owns a fixed size hash table of function counters, keyed by the address of the function name. Only the
+ * owning thread writes to its table. Readers may observe slightly stale values, which is acceptable for statistics.
+ * Tables are linked into a global list when they are created and live until the process exits, since readers walk
+ * the list without locking. On POSIX systems a table is released when its thread exits and is then taken over, with
+ * its counters, by the next thread that needs one, so the number of tables is bounded by the peak number of threads
+ * calling libgpkg functions concurrently. Elsewhere it is bounded by the number of threads that ever did, at about
+ * 48KB per table.
+ */
+#define STATS_FUNCTIONS 128
+#define STATS_BUCKETS 40
+
+typedef struct {
+  const char *volatile name;
+  sqlite3_int64 calls;
+  sqlite3_int64 errors;
+  sqlite3_int64 total_ns;
+  sqlite3_int64 max_ns;
+  sqlite3_int64 bytes;
+  sqlite3_int64 histogram[STATS_BUCKETS];
+} stats_counter_t;
+
+typedef struct stats_table {
+  struct stats_table *next;
+  volatile long owned;
+  volatile long epoch;
+  sqlite3_int64 bytes;
+  stats_counter_t counters[STATS_FUNCTIONS];
+} stats_table_t;
+
+static void *volatile stats_tables = NULL;
+static volatile long stats_epoch = 0;
+
+GPKG_TLS_KEY(stats_table_key)
+
+#if !defined(_WIN32)
+#include <pthread.h>
+
+static pthread_key_t stats_exit_key;
+static pthread_once_t stats_exit_once = PTHREAD_ONCE_INIT;
+
+static void stats_thread_exit(void *table) {
+  atomic_dec_long(&((stats_table_t *) table)->owned);
+}
+
+static void stats_exit_key_init() {
+  pthread_key_create(&stats_exit_key, stats_thread_exit);
+}
+#endif
+
+static sqlite3_int64 stats_now() {
+#if defined(_WIN32)
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+  if (frequency.QuadPart == 0) {
+    QueryPerformanceFrequency(&frequency);
+  }
+  QueryPerformanceCounter(&counter);
+  return (sqlite3_int64) ((double) counter.QuadPart * 1e9 / (double) frequency.QuadPart);
+#elif defined(__MACH__) || defined(__APPLE__)
+  static mach_timebase_info_data_t timebase;
+  if (timebase.denom == 0) {
+    mach_timebase_info(&timebase);
+  }
+  return (sqlite3_int64) (mach_absolute_time() * timebase.numer / timebase.denom);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (sqlite3_int64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static stats_table_t *stats_table(int create) {
+  GPKG_TLS_KEY_CREATE(stats_table_key);
+  stats_table_t *table = (stats_table_t *) GPKG_TLS_GET(stats_table_key);
+
+  if (table == NULL) {
+    if (!create) {
+      return NULL;
+    }
+
+    // Take over the table of a thread that has exited
+    for (table = (stats_table_t *) stats_tables; table != NULL; table = table->next) {
+      if (table->owned == 0) {
+        if (atomic_inc_long(&table->owned) == 1) {
+          break;
+        }
+        atomic_dec_long(&table->owned);
+      }
+    }
+
+    if (table == NULL) {
+      table = (stats_table_t *) sqlite3_malloc(sizeof(stats_table_t));
+      if (table == NULL) {
+        return NULL;
+      }
+      memset(table, 0, sizeof(stats_table_t));
+      table->owned = 1;
+      table->epoch = stats_epoch;
+
+      do {
+        table->next = (stats_table_t *) stats_tables;
+      } while (!atomic_cas_pointer(&stats_tables, table->next, table));
+    }
+
+#if !defined(_WIN32)
+    pthread_once(&stats_exit_once, stats_exit_key_init);
+    pthread_setspecific(stats_exit_key, table);
+#endif
+    GPKG_TLS_SET(stats_table_key, table);
+  }
+
+  long epoch = stats_epoch;
+  if (table->epoch != epoch) {
+    memset(table->counters, 0, sizeof(table->counters));
+    table->epoch = epoch;
+  }
+
+  return table;
+}
+
+static stats_counter_t *stats_counter(stats_table_t *table, const char *name) {
+  size_t slot = (size_t) (((uintptr_t) name >> 3) % STATS_FUNCTIONS);
+
+  for (int i = 0; i < STATS_FUNCTIONS; i++) {
+    stats_counter_t *counter = &table->counters[slot];
+    if (counter->name == name) {
+      return counter;
+    } else if (counter->name == NULL) {
+      counter->name = name;
+      return counter;
+    }
+    slot = (slot + 1) % STATS_FUNCTIONS;
+  }
+
+  return NULL;
+}
+
+static int stats_bucket(sqlite3_int64 ns) {
+  int bucket = 0;
+  while (ns > 1 && bucket < STATS_BUCKETS - 1) {
+    ns >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+void stats_begin(stats_timer_t *timer, const char *name) {
+  stats_table_t *table = stats_table(1);
+  timer->name = name;
+  timer->bytes = table != NULL ? table->bytes : 0;
+  timer->start = stats_now();
+}
+
+void stats_end(stats_timer_t *timer, int failed) {
+  sqlite3_int64 elapsed = stats_now() - timer->start;
+  stats_table_t *table = stats_table(1);
+  if (table == NULL) {
+    return;
+  }
+
+  stats_counter_t *counter = stats_counter(table, timer->name);
+  if (counter == NULL) {
+    return;
+  }
+
+  if (elapsed < 0) {
+    elapsed = 0;
+  }
+
+  counter->calls++;
+  if (failed) {
+    counter->errors++;
+  }
+  counter->total_ns += elapsed;
+  if (elapsed > counter->max_ns) {
+    counter->max_ns = elapsed;
+  }
+  if (table->bytes > timer->bytes) {
+    counter->bytes += table->bytes - timer->bytes;
+  }
+  counter->histogram[stats_bucket(elapsed)]++;
+}
+
+void stats_add_bytes(size_t bytes) {
+  stats_table_t *table = stats_table(0);
+  if (table != NULL) {
+    table->bytes += (sqlite3_int64) bytes;
+  }
+}
+
+/*
+ * Virtual table
+ */
+
+typedef struct {
+  const char *name;
+  sqlite3_int64 calls;
+  sqlite3_int64 errors;
+  sqlite3_int64 total_ns;
+  sqlite3_int64 max_ns;
+  sqlite3_int64 bytes;
+  sqlite3_int64 histogram[STATS_BUCKETS];
+} stats_row_t;
+
+typedef struct {
+  sqlite3_vtab_cursor base;
+  stats_row_t *rows;
+  int row_count;
+  int row;
+} stats_cursor_t;
+
+enum {
+  STATS_COL_NAME,
+  STATS_COL_CALLS,
+  STATS_COL_ERRORS,
+  STATS_COL_TOTAL,
+  STATS_COL_MEAN,
+  STATS_COL_P50,
+  STATS_COL_P90,
+  STATS_COL_P99,
+  STATS_COL_MAX,
+  STATS_COL_BYTES
+};
+
+static int stats_connect(sqlite3 *db, void *aux, int argc, const char *const *argv, sqlite3_vtab **vtab, char **err) {
+  int result = sqlite3_declare_vtab(
+    db,
+    "CREATE TABLE x(name TEXT, calls INTEGER, errors INTEGER, total_us REAL, mean_us REAL, p50_us REAL, p90_us REAL, p99_us REAL, max_us REAL, bytes INTEGER)"
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  *vtab = (sqlite3_vtab *) sqlite3_malloc(sizeof(sqlite3_vtab));
+  if (*vtab == NULL) {
+    return SQLITE_NOMEM;
+  }
+  memset(*vtab, 0, sizeof(sqlite3_vtab));
+  return SQLITE_OK;
+}
+
+static int stats_disconnect(sqlite3_vtab *vtab) {
+  sqlite3_free(vtab);
+  return SQLITE_OK;
+}
+
+static int stats_best_index(sqlite3_vtab *vtab, sqlite3_index_info *info) {
+  info->estimatedCost = STATS_FUNCTIONS;
+  return SQLITE_OK;
+}
+
+static int stats_open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **cursor) {
+  stats_cursor_t *c = (stats_cursor_t *) sqlite3_malloc(sizeof(stats_cursor_t));
+  if (c == NULL) {
+    return SQLITE_NOMEM;
+  }
+  memset(c, 0, sizeof(stats_cursor_t));
+  *cursor = &c->base;
+  return SQLITE_OK;
+}
+
+static int stats_close(sqlite3_vtab_cursor *cursor) {
+  stats_cursor_t *c = (stats_cursor_t *) cursor;
+  sqlite3_free(c->rows);
+  sqlite3_free(c);
+  return SQLITE_OK;
+}
+
+static stats_row_t *stats_row(stats_cursor_t *c, int *capacity, const char *name) {
+  for (int i = 0; i < c->row_count; i++) {
+    if (c->rows[i].name == name || strcmp(c->rows[i].name, name) == 0) {
+      return &c->rows[i];
+    }
+  }
+
+  if (c->row_count == *capacity) {
+    int new_capacity = *capacity == 0 ? STATS_FUNCTIONS : *capacity * 2;
+    stats_row_t *rows = (stats_row_t *) sqlite3_realloc(c->rows, new_capacity * (int) sizeof(stats_row_t));
+    if (rows == NULL) {
+      return NULL;
+    }
+    c->rows = rows;
+    *capacity = new_capacity;
+  }
+
+  stats_row_t *row = &c->rows[c->row_count++];
+  memset(row, 0, sizeof(stats_row_t));
+  row->name = name;
+  return row;
+}
+
+static int stats_filter(sqlite3_vtab_cursor *cursor, int idx_num, const char *idx_str, int argc, sqlite3_value **argv) {
+  stats_cursor_t *c = (stats_cursor_t *) cursor;
+  int capacity = 0;
+  long epoch = stats_epoch;
+
+  sqlite3_free(c->rows);
+  c->rows = NULL;
+  c->row_count = 0;
+  c->row = 0;
+
+  for (stats_table_t *table = (stats_table_t *) stats_tables; table != NULL; table = table->next) {
+    if (table->epoch != epoch) {
+      continue;
+    }
+
+    for (int i = 0; i < STATS_FUNCTIONS; i++) {
+      stats_counter_t *counter = &table->counters[i];
+      const char *name = counter->name;
+      if (name == NULL || counter->calls == 0) {
+        continue;
+      }
+
+      stats_row_t *row = stats_row(c, &capacity, name);
+      if (row == NULL) {
+        return SQLITE_NOMEM;
+      }
+      row->calls += counter->calls;
+      row->errors += counter->errors;
+      row->total_ns += counter->total_ns;
+      row->bytes += counter->bytes;
+      if (counter->max_ns > row->max_ns) {
+        row->max_ns = counter->max_ns;
+      }
+      for (int b = 0; b < STATS_BUCKETS; b++) {
+        row->histogram[b] += counter->histogram[b];
+      }
+    }
+  }
+
+  return SQLITE_OK;
+}
+
+static int stats_next(sqlite3_vtab_cursor *cursor) {
+  stats_cursor_t *c = (stats_cursor_t *) cursor;
+  c->row++;
+  return SQLITE_OK;
+}
+
+static int stats_eof(sqlite3_vtab_cursor *cursor) {
+  stats_cursor_t *c = (stats_cursor_t *) cursor;
+  return c->row >= c->row_count;
+}
+
+/*
+ * Estimates a latency percentile from the log2 histogram by interpolating linearly within the bucket that contains
+ * the requested rank.
+ */
+static double stats_percentile(stats_row_t *row, double percentile) {
+  sqlite3_int64 total = 0;
+  for (int b = 0; b < STATS_BUCKETS; b++) {
+    total += row->histogram[b];
+  }
+  if (total == 0) {
+    return 0.0;
+  }
+
+  double rank = percentile * (double) total;
+  sqlite3_int64 seen = 0;
+  for (int b = 0; b < STATS_BUCKETS; b++) {
+    sqlite3_int64 count = row->histogram[b];
+    if (count > 0 && (double) (seen + count) >= rank) {
+      double low = b == 0 ? 0.0 : (double) ((sqlite3_int64) 1 << b);
+      double high = (double) ((sqlite3_int64) 1 << (b + 1));
+      double value = low + (high - low) * ((rank - (double) seen) / (double) count);
+      if (value > (double) row->max_ns) {
+        value = (double) row->max_ns;
+      }
+      return value / 1000.0;
+    }
+    seen += count;
+  }
+
+  return (double) row->max_ns / 1000.0;
+}
+
+static int stats_column(sqlite3_vtab_cursor *cursor, sqlite3_context *context, int column) {
+  stats_cursor_t *c = (stats_cursor_t *) cursor;
+  stats_row_t *row = &c->rows[c->row];
+
+  switch (column) {
+    case STATS_COL_NAME:
+      sqlite3_result_text(context, row->name, -1, SQLITE_STATIC);
+      break;
+    case STATS_COL_CALLS:
+      sqlite3_result_int64(context, row->calls);
+      break;
+    case STATS_COL_ERRORS:
+      sqlite3_result_int64(context, row->errors);
+      break;
+    case STATS_COL_TOTAL:
+      sqlite3_result_double(context, (double) row->total_ns / 1000.0);
+      break;
+    case STATS_COL_MEAN:
+      sqlite3_result_double(context, row->calls > 0 ? (double) row->total_ns / 1000.0 / (double) row->calls : 0.0);
+      break;
+    case STATS_COL_P50:
+      sqlite3_result_double(context, stats_percentile(row, 0.50));
+      break;
+    case STATS_COL_P90:
+      sqlite3_result_double(context, stats_percentile(row, 0.90));
+      break;
+    case STATS_COL_P99:
+      sqlite3_result_double(context, stats_percentile(row, 0.99));
+      break;
+    case STATS_COL_MAX:
+      sqlite3_result_double(context, (double) row->max_ns / 1000.0);
+      break;
+    case STATS_COL_BYTES:
+      sqlite3_result_int64(context, row->bytes);
+      break;
+    default:
+      break;
+  }
+
+  return SQLITE_OK;
+}
+
+static int stats_rowid(sqlite3_vtab_cursor *cursor, sqlite3_int64 *rowid) {
+  stats_cursor_t *c = (stats_cursor_t *) cursor;
+  *rowid = c->row;
+  return SQLITE_OK;
+}
+
+static sqlite3_module stats_module = {
+  0,                /* iVersion */
+  stats_connect,    /* xCreate */
+  stats_connect,    /* xConnect */
+  stats_best_index, /* xBestIndex */
+  stats_disconnect, /* xDisconnect */
+  stats_disconnect, /* xDestroy */
+  stats_open,       /* xOpen */
+  stats_close,      /* xClose */
+  stats_filter,     /* xFilter */
+  stats_next,       /* xNext */
+  stats_eof,        /* xEof */
+  stats_column,     /* xColumn */
+  stats_rowid,      /* xRowid */
+  NULL,             /* xUpdate */
+  NULL,             /* xBegin */
+  NULL,             /* xSync */
+  NULL,             /* xCommit */
+  NULL,             /* xRollback */
+  NULL,             /* xFindFunction */
+  NULL              /* xRename */
+};
+
+static void GPKG_ResetStats(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  atomic_inc_long(&stats_epoch);
+  sqlite3_result_null(context);
+}
+
+void stats_init(sqlite3 *db, errorstream_t *error) {
+  /*
+   * The module can be used as an eponymous virtual table with SQLite 3.9.0 or later. With older versions a table
+   * has to be created explicitly using 'CREATE VIRTUAL TABLE temp.gpkg_stats USING gpkg_stats'.
+   */
+  int result = sqlite3_create_module(db, "gpkg_stats", &stats_module, NULL);
+  if (result != SQLITE_OK) {
+    error_append(error, "Error registering module gpkg_stats: %s", sqlite3_errmsg(db));
+  }
+
+  sql_create_function(db, "ResetStats", GPKG_ResetStats, 0, 0, NULL, NULL, error);
+  sql_create_function(db, "GPKG_ResetStats", GPKG_ResetStats, 0, 0, NULL, NULL, error);
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GPKG_STATS_H
+#define GPKG_STATS_H
+
+#ifdef GPKG_HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stddef.h>
+#include "error.h"
+#include "sqlite.h"
+
+/**
+ * \addtogroup stats Function performance counters
+ *
+ * When libgpkg is compiled with GPKG_STATS defined, every SQL function records its call count, error count, latency
+ * and the number of geometry bytes it decoded. Counters are kept per thread so recording never takes a lock; they are
+ * only aggregated when the gpkg_stats virtual table is queried.
+ *
+ * When GPKG_STATS is not defined the STATS_* macros expand to nothing.
+ * @{
+ */
+
+#ifdef GPKG_STATS
+
+/**
+ * Measures a single function invocation.
+ */
+typedef struct {
+  /** @private */
+  const char *name;
+  /** @private */
+  sqlite3_int64 start;
+  /** @private */
+  sqlite3_int64 bytes;
+} stats_timer_t;
+
+/**
+ * Starts measuring a function invocation.
+ * @param timer the timer to start
+ * @param name the function name. Must be a string with static storage duration.
+ */
+void stats_begin(stats_timer_t *timer, const char *name);
+
+/**
+ * Stops measuring a function invocation and records the result in the counters of the calling thread.
+ * @param timer a timer started using stats_begin()
+ * @param failed non-zero if the invocation failed
+ */
+void stats_end(stats_timer_t *timer, int failed);
+
+/**
+ * Records that the calling thread decoded the given number of geometry bytes.
+ * @param bytes the number of bytes
+ */
+void stats_add_bytes(size_t bytes);
+
+/**
+ * Registers the gpkg_stats virtual table and the GPKG_ResetStats function with a database connection.
+ * @param db the database connection
+ * @param error the error stream to write errors to
+ */
+void stats_init(sqlite3 *db, errorstream_t *error);
+
+#define STATS_START(name) stats_timer_t _stats_timer; stats_begin(&_stats_timer, name)
+#define STATS_END(failed) stats_end(&_stats_timer, failed)
+#define STATS_BYTES(bytes) stats_add_bytes(bytes)
+
+#else
+
+#define STATS_START(name) do {} while(0)
+#define STATS_END(failed) do {} while(0)
+#define STATS_BYTES(bytes) do {} while(0)
+
+#endif
+
+/** @} */
+
+#endif
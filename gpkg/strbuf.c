@@ -89,7 +89,29 @@ int strbuf_append(strbuf_t *buffer, const char *msg, ...) {
 
 int strbuf_vappend(strbuf_t *buffer, const char *msg, va_list args) {
   int result = SQLITE_OK;
-  char *formatted = sqlite3_vmprintf(msg, args);
+  char *formatted = NULL;
+
+  /*
+   * Try to format directly into the free space at the end of the buffer first. If the formatted string fills the
+   * available space completely it may have been truncated; in that case fall back to formatting into a temporary
+   * string and growing the buffer.
+   */
+  size_t free_space = buffer->capacity - buffer->length;
+  if (free_space > 1 && free_space <= 0x7FFFFFFF) {
+    va_list args_copy;
+    va_copy(args_copy, args);
+    sqlite3_vsnprintf((int) free_space, buffer->buffer + buffer->length, msg, args_copy);
+    va_end(args_copy);
+
+    size_t written = strlen(buffer->buffer + buffer->length);
+    if (written < free_space - 1) {
+      buffer->length += written;
+      goto exit;
+    }
+    buffer->buffer[buffer->length] = 0;
+  }
+
+  formatted = sqlite3_vmprintf(msg, args);
 
   if (formatted == NULL) {
     result = SQLITE_NOMEM;
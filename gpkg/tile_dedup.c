@@ -0,0 +1,560 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdarg.h>
+#include <string.h>
+#include "sql.h"
+#include "strbuf.h"
+#include "tile_dedup.h"
+
+#define DEDUP_EXTENSION_NAME "libgpkg_tile_dedup"
+#define DEDUP_EXTENSION_DEFINITION "libgpkg deduplicated tile storage"
+#define DEDUP_REFS_TABLE "dedup_%s_refs"
+
+/*
+ * Blobs are looked up by their length and 16 bytes from their middle, which an expression index on the blob table
+ * covers. Only built-in SQLite functions are used, so any SQLite client can write through the view triggers. Tile
+ * headers are similar for all tiles of a pyramid, but the middle of compressed image data rarely is.
+ */
+#define DEDUP_KEY_MATCH(blob, value)                                                                                   \
+  "length(" blob ") = length(" value ") AND "                                                                          \
+  "substr(" blob ", 1 + length(" blob ") / 2, 16) = substr(" value ", 1 + length(" value ") / 2, 16)"
+
+int tile_dedup_enabled(sqlite3 *db, const char *db_name, const char *table_name, int *enabled) {
+  int count = 0;
+  char *tiles_table = sqlite3_mprintf(TILE_DEDUP_TILES_TABLE, table_name);
+  if (tiles_table == NULL) {
+    *enabled = 0;
+    return SQLITE_NOMEM;
+  }
+
+  int result = sql_exec_for_int(
+                 db, &count,
+                 "SELECT count(*) FROM \"%w\".sqlite_master WHERE (type = 'view' AND name = %Q COLLATE NOCASE) OR (type = 'table' AND name = %Q COLLATE NOCASE)",
+                 db_name, table_name, tiles_table
+               );
+  sqlite3_free(tiles_table);
+
+  *enabled = result == SQLITE_OK && count == 2;
+  return result;
+}
+
+/*
+ * Appends statements to a trigger body that insert NEW.tile_data into the blob table unless an identical blob is
+ * already present. A new blob gets a reference count of zero; every blob that has been committed has a reference count
+ * row, so a blob with the key of the new tile but without one can only be the blob that was just inserted.
+ */
+static int dedup_append_add_blob(strbuf_t *sql, const char *blobs, const char *refs) {
+  return strbuf_append(
+           sql,
+           "  INSERT INTO %s (tile_data)\n"
+           "    SELECT NEW.tile_data\n"
+           "    WHERE NOT EXISTS (SELECT 1 FROM %s WHERE " DEDUP_KEY_MATCH("tile_data", "NEW.tile_data") " AND tile_data = NEW.tile_data);\n"
+           "  INSERT INTO %s (id, ref_count)\n"
+           "    SELECT b.id, 0 FROM %s AS b\n"
+           "    WHERE " DEDUP_KEY_MATCH("b.tile_data", "NEW.tile_data") " AND NOT EXISTS (SELECT 1 FROM %s AS r WHERE r.id = b.id);\n",
+           blobs, blobs, refs, blobs, refs
+         );
+}
+
+/*
+ * Appends a statement to a trigger body that adds or subtracts, for each blob, the number of tile rows matching the
+ * given condition that refer to it. A trigger subtracts the references of all rows its statement may replace or
+ * remove, modifies the tile rows and then adds the references of the rows matching the same condition again. This
+ * keeps the reference counts exact whichever conflict resolution the statement that fired the trigger uses.
+ */
+static int dedup_append_adjust_refs(strbuf_t *sql, const char *refs, const char *tiles, char sign, const char *condition) {
+  return strbuf_append(
+           sql,
+           "  UPDATE %s SET ref_count = ref_count %c (SELECT count(*) FROM %s AS m WHERE m.blob_id = %s.id AND (%s))\n"
+           "    WHERE id IN (SELECT m.blob_id FROM %s AS m WHERE %s);\n",
+           refs, sign, tiles, refs, condition, tiles, condition
+         );
+}
+
+static int dedup_append_find_blob(strbuf_t *sql, const char *blobs) {
+  return strbuf_append(sql, "(SELECT id FROM %s WHERE " DEDUP_KEY_MATCH("tile_data", "NEW.tile_data") " AND tile_data = NEW.tile_data)", blobs);
+}
+
+static int dedup_append_remove_unused(strbuf_t *sql, const char *blobs, const char *refs) {
+  return strbuf_append(
+           sql,
+           "  DELETE FROM %s WHERE id IN (SELECT id FROM %s WHERE ref_count = 0);\n"
+           "  DELETE FROM %s WHERE ref_count = 0;\n"
+           "END",
+           blobs, refs, refs
+         );
+}
+
+static int dedup_create_triggers(sqlite3 *db, const char *db_name, const char *table_name, const char *view, const char *tiles, const char *blobs, const char *refs, errorstream_t *error) {
+  static const char *insert_condition =
+    "m.id = NEW.id OR (m.zoom_level = NEW.zoom_level AND m.tile_column = NEW.tile_column AND m.tile_row = NEW.tile_row)";
+  static const char *update_condition =
+    "m.id = NEW.id OR m.id = OLD.id OR (m.zoom_level = NEW.zoom_level AND m.tile_column = NEW.tile_column AND m.tile_row = NEW.tile_row)";
+  strbuf_t sql;
+
+  int result = strbuf_init(&sql, 4096);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  // Insert
+  {
+    char *trigger = sqlite3_mprintf("\"%w\".\"dedup_%w_insert\"", db_name, table_name);
+    result = trigger == NULL ? SQLITE_NOMEM : strbuf_append(&sql, "CREATE TRIGGER %s INSTEAD OF INSERT ON %s\nBEGIN\n", trigger, view);
+    sqlite3_free(trigger);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_append_add_blob(&sql, blobs, refs);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_append_adjust_refs(&sql, refs, tiles, '-', insert_condition);
+  }
+  if (result == SQLITE_OK) {
+    result = strbuf_append(&sql, "  INSERT INTO %s (id, zoom_level, tile_column, tile_row, blob_id)\n    VALUES (NEW.id, NEW.zoom_level, NEW.tile_column, NEW.tile_row, ", tiles);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_append_find_blob(&sql, blobs);
+  }
+  if (result == SQLITE_OK) {
+    result = strbuf_append(&sql, ");\n");
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_append_adjust_refs(&sql, refs, tiles, '+', insert_condition);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_append_remove_unused(&sql, blobs, refs);
+  }
+  if (result == SQLITE_OK) {
+    result = sql_exec(db, "%s", strbuf_data_pointer(&sql));
+    if (result != SQLITE_OK) {
+      error_append(error, "Could not create tile insert trigger: %s", sqlite3_errmsg(db));
+    }
+  }
+
+  // Update
+  if (result == SQLITE_OK) {
+    result = strbuf_reset(&sql);
+  }
+  if (result == SQLITE_OK) {
+    char *trigger = sqlite3_mprintf("\"%w\".\"dedup_%w_update\"", db_name, table_name);
+    result = trigger == NULL ? SQLITE_NOMEM : strbuf_append(&sql, "CREATE TRIGGER %s INSTEAD OF UPDATE ON %s\nBEGIN\n", trigger, view);
+    sqlite3_free(trigger);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_append_add_blob(&sql, blobs, refs);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_append_adjust_refs(&sql, refs, tiles, '-', update_condition);
+  }
+  if (result == SQLITE_OK) {
+    result = strbuf_append(&sql, "  UPDATE %s SET id = NEW.id, zoom_level = NEW.zoom_level, tile_column = NEW.tile_column, tile_row = NEW.tile_row, blob_id = ", tiles);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_append_find_blob(&sql, blobs);
+  }
+  if (result == SQLITE_OK) {
+    result = strbuf_append(&sql, "\n    WHERE id = OLD.id;\n");
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_append_adjust_refs(&sql, refs, tiles, '+', update_condition);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_append_remove_unused(&sql, blobs, refs);
+  }
+  if (result == SQLITE_OK) {
+    result = sql_exec(db, "%s", strbuf_data_pointer(&sql));
+    if (result != SQLITE_OK) {
+      error_append(error, "Could not create tile update trigger: %s", sqlite3_errmsg(db));
+    }
+  }
+
+  // Delete
+  if (result == SQLITE_OK) {
+    result = strbuf_reset(&sql);
+  }
+  if (result == SQLITE_OK) {
+    char *trigger = sqlite3_mprintf("\"%w\".\"dedup_%w_delete\"", db_name, table_name);
+    result = trigger == NULL ? SQLITE_NOMEM : strbuf_append(
+               &sql,
+               "CREATE TRIGGER %s INSTEAD OF DELETE ON %s\n"
+               "BEGIN\n"
+               "  UPDATE %s SET ref_count = ref_count - 1 WHERE id = (SELECT blob_id FROM %s WHERE id = OLD.id);\n"
+               "  DELETE FROM %s WHERE id = OLD.id;\n",
+               trigger, view, refs, tiles, tiles
+             );
+    sqlite3_free(trigger);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_append_remove_unused(&sql, blobs, refs);
+  }
+  if (result == SQLITE_OK) {
+    result = sql_exec(db, "%s", strbuf_data_pointer(&sql));
+    if (result != SQLITE_OK) {
+      error_append(error, "Could not create tile delete trigger: %s", sqlite3_errmsg(db));
+    }
+  }
+
+  strbuf_destroy(&sql);
+  return result;
+}
+
+int tile_dedup_create(sqlite3 *db, const char *db_name, const char *table_name, errorstream_t *error) {
+  int result = SQLITE_OK;
+  int exists = 0;
+  int is_table = 0;
+  char *tiles_table = NULL;
+  char *blobs_table = NULL;
+  char *refs_table = NULL;
+  char *moved_table = NULL;
+  char *view = NULL;
+  char *tiles = NULL;
+  char *blobs = NULL;
+  char *refs = NULL;
+
+  result = tile_dedup_enabled(db, db_name, table_name, &exists);
+  if (result != SQLITE_OK) {
+    error_append(error, "Could not check if table %s.%s exists: %s", db_name, table_name, sqlite3_errmsg(db));
+    goto exit;
+  }
+
+  if (exists) {
+    error_append(error, "Table %s.%s already uses deduplicated tile storage", db_name, table_name);
+    goto exit;
+  }
+
+  result = sql_check_table_exists(db, db_name, table_name, &exists);
+  if (result == SQLITE_OK && exists) {
+    result = sql_exec_for_int(db, &is_table, "SELECT count(*) FROM \"%w\".sqlite_master WHERE type = 'table' AND name = %Q COLLATE NOCASE", db_name, table_name);
+  }
+  if (result != SQLITE_OK) {
+    error_append(error, "Could not check if table %s.%s exists: %s", db_name, table_name, sqlite3_errmsg(db));
+    goto exit;
+  }
+
+  if (exists && !is_table) {
+    error_append(error, "%s.%s is not a tiles table", db_name, table_name);
+    goto exit;
+  }
+
+  tiles_table = sqlite3_mprintf(TILE_DEDUP_TILES_TABLE, table_name);
+  blobs_table = sqlite3_mprintf(TILE_DEDUP_BLOBS_TABLE, table_name);
+  refs_table = sqlite3_mprintf(DEDUP_REFS_TABLE, table_name);
+  moved_table = sqlite3_mprintf("dedup_%s_moved", table_name);
+  view = sqlite3_mprintf("\"%w\"", table_name);
+  tiles = sqlite3_mprintf("\"%w\"", tiles_table);
+  blobs = sqlite3_mprintf("\"%w\"", blobs_table);
+  refs = sqlite3_mprintf("\"%w\"", refs_table);
+  if (tiles_table == NULL || blobs_table == NULL || refs_table == NULL || moved_table == NULL || view == NULL || tiles == NULL || blobs == NULL || refs == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  if (is_table) {
+    result = sql_exec(db, "ALTER TABLE \"%w\".\"%w\" RENAME TO \"%w\"", db_name, table_name, moved_table);
+    if (result != SQLITE_OK) {
+      error_append(error, "Could not rename table %s.%s: %s", db_name, table_name, sqlite3_errmsg(db));
+      goto exit;
+    }
+  }
+
+  result = sql_exec(db, "CREATE TABLE \"%w\".\"%w\" (id INTEGER PRIMARY KEY, tile_data BLOB NOT NULL)", db_name, blobs_table);
+  if (result == SQLITE_OK) {
+    result = sql_exec(
+               db,
+               "CREATE INDEX \"%w\".\"%w_key\" ON \"%w\" (length(tile_data), substr(tile_data, 1 + length(tile_data) / 2, 16))",
+               db_name, blobs_table, blobs_table
+             );
+  }
+  if (result == SQLITE_OK) {
+    // SQLite rewrites a complete record on update, so the reference counts are kept apart from the tile data
+    result = sql_exec(db, "CREATE TABLE \"%w\".\"%w\" (id INTEGER PRIMARY KEY, ref_count INTEGER NOT NULL)", db_name, refs_table);
+  }
+  if (result == SQLITE_OK) {
+    // Partial index so that unreferenced blobs can be found without scanning the table
+    result = sql_exec(db, "CREATE INDEX \"%w\".\"%w_unused\" ON \"%w\" (id) WHERE ref_count = 0", db_name, refs_table, refs_table);
+  }
+  if (result == SQLITE_OK) {
+    result = sql_exec(
+               db,
+               "CREATE TABLE \"%w\".\"%w\" (id INTEGER PRIMARY KEY AUTOINCREMENT, zoom_level INTEGER NOT NULL, tile_column INTEGER NOT NULL, tile_row INTEGER NOT NULL, blob_id INTEGER NOT NULL, UNIQUE (zoom_level, tile_column, tile_row))",
+               db_name, tiles_table
+             );
+  }
+  if (result == SQLITE_OK) {
+    result = sql_exec(db, "CREATE INDEX \"%w\".\"%w_blob_id\" ON \"%w\" (blob_id)", db_name, tiles_table, tiles_table);
+  }
+  if (result != SQLITE_OK) {
+    error_append(error, "Could not create tile storage tables for %s.%s: %s", db_name, table_name, sqlite3_errmsg(db));
+    goto exit;
+  }
+
+  result = sql_exec(
+             db,
+             "CREATE VIEW \"%w\".\"%w\" AS SELECT m.id AS id, m.zoom_level AS zoom_level, m.tile_column AS tile_column, m.tile_row AS tile_row, b.tile_data AS tile_data "
+             "FROM \"%w\" AS m JOIN \"%w\" AS b ON b.id = m.blob_id",
+             db_name, table_name, tiles_table, blobs_table
+           );
+  if (result != SQLITE_OK) {
+    error_append(error, "Could not create tiles view %s.%s: %s", db_name, table_name, sqlite3_errmsg(db));
+    goto exit;
+  }
+
+  result = dedup_create_triggers(db, db_name, table_name, view, tiles, blobs, refs, error);
+  if (result != SQLITE_OK) {
+    goto exit;
+  }
+
+  if (is_table) {
+    result = sql_exec(
+               db,
+               "INSERT INTO \"%w\".\"%w\" (id, zoom_level, tile_column, tile_row, tile_data) "
+               "SELECT id, zoom_level, tile_column, tile_row, tile_data FROM \"%w\".\"%w\" ORDER BY zoom_level, tile_column, tile_row",
+               db_name, table_name, db_name, moved_table
+             );
+    if (result == SQLITE_OK) {
+      result = sql_exec(db, "DROP TABLE \"%w\".\"%w\"", db_name, moved_table);
+    }
+    if (result != SQLITE_OK) {
+      error_append(error, "Could not move tiles of %s.%s: %s", db_name, table_name, sqlite3_errmsg(db));
+      goto exit;
+    }
+  }
+
+  result = sql_exec(
+             db,
+             "INSERT OR REPLACE INTO \"%w\".\"gpkg_extensions\" (table_name, column_name, extension_name, definition, scope) VALUES (%Q, %Q, %Q, %Q, %Q)",
+             db_name, table_name, "tile_data", DEDUP_EXTENSION_NAME, DEDUP_EXTENSION_DEFINITION, "read-write"
+           );
+  if (result != SQLITE_OK) {
+    error_append(error, "Could not register tile deduplication in gpkg_extensions: %s", sqlite3_errmsg(db));
+    goto exit;
+  }
+
+exit:
+  sqlite3_free(tiles_table);
+  sqlite3_free(blobs_table);
+  sqlite3_free(refs_table);
+  sqlite3_free(moved_table);
+  sqlite3_free(view);
+  sqlite3_free(tiles);
+  sqlite3_free(blobs);
+  sqlite3_free(refs);
+  return result;
+}
+
+static int dedup_prepare(sqlite3 *db, sqlite3_stmt **stmt, errorstream_t *error, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  char *sql = sqlite3_vmprintf(fmt, args);
+  va_end(args);
+
+  if (sql == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  int result = sqlite3_prepare_v2(db, sql, -1, stmt, NULL);
+  if (result != SQLITE_OK) {
+    error_append(error, "%s", sqlite3_errmsg(db));
+  }
+  sqlite3_free(sql);
+  return result;
+}
+
+int tile_dedup_writer_init(tile_dedup_writer_t *writer, sqlite3 *db, const char *db_name, const char *table_name, errorstream_t *error) {
+  int result = SQLITE_OK;
+  char *tiles_table = sqlite3_mprintf(TILE_DEDUP_TILES_TABLE, table_name);
+  char *blobs_table = sqlite3_mprintf(TILE_DEDUP_BLOBS_TABLE, table_name);
+  char *refs_table = sqlite3_mprintf(DEDUP_REFS_TABLE, table_name);
+
+  memset(writer, 0, sizeof(tile_dedup_writer_t));
+  writer->db = db;
+
+  if (tiles_table == NULL || blobs_table == NULL || refs_table == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  result = dedup_prepare(
+             db, &writer->find_blob_stmt, error,
+             "SELECT id FROM \"%w\".\"%w\" WHERE " DEDUP_KEY_MATCH("tile_data", "?1") " AND tile_data = ?1",
+             db_name, blobs_table
+           );
+  if (result == SQLITE_OK) {
+    result = dedup_prepare(db, &writer->insert_blob_stmt, error, "INSERT INTO \"%w\".\"%w\" (tile_data) VALUES (?1)", db_name, blobs_table);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_prepare(db, &writer->delete_blob_stmt, error, "DELETE FROM \"%w\".\"%w\" WHERE id = ?1", db_name, blobs_table);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_prepare(db, &writer->insert_ref_stmt, error, "INSERT INTO \"%w\".\"%w\" (id, ref_count) VALUES (?1, 1)", db_name, refs_table);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_prepare(db, &writer->update_ref_stmt, error, "UPDATE \"%w\".\"%w\" SET ref_count = ref_count + ?2 WHERE id = ?1", db_name, refs_table);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_prepare(db, &writer->delete_ref_stmt, error, "DELETE FROM \"%w\".\"%w\" WHERE id = ?1 AND ref_count = 0", db_name, refs_table);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_prepare(db, &writer->find_tile_stmt, error, "SELECT id, blob_id FROM \"%w\".\"%w\" WHERE zoom_level = ?1 AND tile_column = ?2 AND tile_row = ?3", db_name, tiles_table);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_prepare(db, &writer->insert_tile_stmt, error, "INSERT INTO \"%w\".\"%w\" (zoom_level, tile_column, tile_row, blob_id) VALUES (?1, ?2, ?3, ?4)", db_name, tiles_table);
+  }
+  if (result == SQLITE_OK) {
+    result = dedup_prepare(db, &writer->update_tile_stmt, error, "UPDATE \"%w\".\"%w\" SET blob_id = ?2 WHERE id = ?1", db_name, tiles_table);
+  }
+
+exit:
+  sqlite3_free(tiles_table);
+  sqlite3_free(blobs_table);
+  sqlite3_free(refs_table);
+  return result;
+}
+
+static int dedup_step(tile_dedup_writer_t *writer, sqlite3_stmt *stmt, errorstream_t *error) {
+  int result = sqlite3_step(stmt);
+  sqlite3_reset(stmt);
+  if (result != SQLITE_DONE) {
+    error_append(error, "%s", sqlite3_errmsg(writer->db));
+    return result;
+  }
+  return SQLITE_OK;
+}
+
+/*
+ * Looks up the blob with the given data, or inserts it with a reference count of one if it is not present yet.
+ */
+static int dedup_acquire_blob(tile_dedup_writer_t *writer, const void *data, int length, sqlite3_int64 *blob_id, int *inserted, errorstream_t *error) {
+  int result;
+
+  *inserted = 0;
+  *blob_id = 0;
+
+  sqlite3_bind_blob(writer->find_blob_stmt, 1, length > 0 ? data : "", length, SQLITE_STATIC);
+  result = sqlite3_step(writer->find_blob_stmt);
+  if (result == SQLITE_ROW) {
+    *blob_id = sqlite3_column_int64(writer->find_blob_stmt, 0);
+    result = SQLITE_DONE;
+  }
+  sqlite3_reset(writer->find_blob_stmt);
+  if (result != SQLITE_DONE) {
+    error_append(error, "%s", sqlite3_errmsg(writer->db));
+    return result;
+  }
+
+  if (*blob_id != 0) {
+    return SQLITE_OK;
+  }
+
+  sqlite3_bind_blob(writer->insert_blob_stmt, 1, length > 0 ? data : "", length, SQLITE_STATIC);
+  result = dedup_step(writer, writer->insert_blob_stmt, error);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+  *blob_id = sqlite3_last_insert_rowid(writer->db);
+
+  sqlite3_bind_int64(writer->insert_ref_stmt, 1, *blob_id);
+  result = dedup_step(writer, writer->insert_ref_stmt, error);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  *inserted = 1;
+  return SQLITE_OK;
+}
+
+static int dedup_update_ref(tile_dedup_writer_t *writer, sqlite3_int64 blob_id, int delta, errorstream_t *error) {
+  sqlite3_bind_int64(writer->update_ref_stmt, 1, blob_id);
+  sqlite3_bind_int(writer->update_ref_stmt, 2, delta);
+  int result = dedup_step(writer, writer->update_ref_stmt, error);
+  if (result != SQLITE_OK || delta > 0) {
+    return result;
+  }
+
+  sqlite3_bind_int64(writer->delete_ref_stmt, 1, blob_id);
+  result = dedup_step(writer, writer->delete_ref_stmt, error);
+  if (result != SQLITE_OK || sqlite3_changes(writer->db) == 0) {
+    return result;
+  }
+
+  sqlite3_bind_int64(writer->delete_blob_stmt, 1, blob_id);
+  return dedup_step(writer, writer->delete_blob_stmt, error);
+}
+
+int tile_dedup_writer_write(tile_dedup_writer_t *writer, int zoom_level, int tile_column, int tile_row, const void *data, int length, errorstream_t *error) {
+  sqlite3_int64 blob_id;
+  sqlite3_int64 tile_id = 0;
+  sqlite3_int64 old_blob_id = 0;
+  int inserted;
+
+  int result = dedup_acquire_blob(writer, data, length, &blob_id, &inserted, error);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  sqlite3_bind_int(writer->find_tile_stmt, 1, zoom_level);
+  sqlite3_bind_int(writer->find_tile_stmt, 2, tile_column);
+  sqlite3_bind_int(writer->find_tile_stmt, 3, tile_row);
+  result = sqlite3_step(writer->find_tile_stmt);
+  if (result == SQLITE_ROW) {
+    tile_id = sqlite3_column_int64(writer->find_tile_stmt, 0);
+    old_blob_id = sqlite3_column_int64(writer->find_tile_stmt, 1);
+    result = SQLITE_DONE;
+  }
+  sqlite3_reset(writer->find_tile_stmt);
+  if (result != SQLITE_DONE) {
+    error_append(error, "%s", sqlite3_errmsg(writer->db));
+    return result;
+  }
+
+  if (tile_id != 0 && old_blob_id == blob_id) {
+    return SQLITE_OK;
+  }
+
+  if (tile_id != 0) {
+    sqlite3_bind_int64(writer->update_tile_stmt, 1, tile_id);
+    sqlite3_bind_int64(writer->update_tile_stmt, 2, blob_id);
+    result = dedup_step(writer, writer->update_tile_stmt, error);
+  } else {
+    sqlite3_bind_int(writer->insert_tile_stmt, 1, zoom_level);
+    sqlite3_bind_int(writer->insert_tile_stmt, 2, tile_column);
+    sqlite3_bind_int(writer->insert_tile_stmt, 3, tile_row);
+    sqlite3_bind_int64(writer->insert_tile_stmt, 4, blob_id);
+    result = dedup_step(writer, writer->insert_tile_stmt, error);
+  }
+
+  // A newly inserted blob already starts with the reference of this tile
+  if (result == SQLITE_OK && !inserted) {
+    result = dedup_update_ref(writer, blob_id, 1, error);
+  }
+  if (result == SQLITE_OK && tile_id != 0) {
+    result = dedup_update_ref(writer, old_blob_id, -1, error);
+  }
+  return result;
+}
+
+void tile_dedup_writer_destroy(tile_dedup_writer_t *writer) {
+  sqlite3_finalize(writer->find_blob_stmt);
+  sqlite3_finalize(writer->insert_blob_stmt);
+  sqlite3_finalize(writer->delete_blob_stmt);
+  sqlite3_finalize(writer->insert_ref_stmt);
+  sqlite3_finalize(writer->update_ref_stmt);
+  sqlite3_finalize(writer->delete_ref_stmt);
+  sqlite3_finalize(writer->find_tile_stmt);
+  sqlite3_finalize(writer->insert_tile_stmt);
+  sqlite3_finalize(writer->update_tile_stmt);
+  memset(writer, 0, sizeof(tile_dedup_writer_t));
+}
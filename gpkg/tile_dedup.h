@@ -0,0 +1,126 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GPKG_TILE_DEDUP_H
+#define GPKG_TILE_DEDUP_H
+
+#include "error.h"
+#include "sqlite.h"
+
+/**
+ * \addtogroup tile_dedup Deduplicated tile storage
+ *
+ * Tiles tables can optionally store each distinct tile blob only once. The tile coordinates are then kept in
+ * dedup_<table>_tiles, which refers to the tile data in dedup_<table>_blobs, and the tiles table itself is replaced by
+ * a view with the standard tiles table columns. Inserts, updates and deletes on the view are redirected by triggers,
+ * which look up existing blobs through an index on their length and a slice of their content and keep a reference
+ * count per blob in dedup_<table>_refs so that unused blobs are removed. The triggers only use built-in SQLite
+ * functions, so other SQLite based clients can write to the view as well. The storage mode is registered in gpkg_extensions as libgpkg_tile_dedup.
+ * @{
+ */
+
+/**
+ * The name of the table mapping tile coordinates to blobs, as a printf style pattern taking the tiles table name.
+ */
+#define TILE_DEDUP_TILES_TABLE "dedup_%s_tiles"
+
+/**
+ * The name of the table containing the distinct tile blobs, as a printf style pattern taking the tiles table name.
+ */
+#define TILE_DEDUP_BLOBS_TABLE "dedup_%s_blobs"
+
+/**
+ * Writes tiles directly to the tables of a deduplicated tiles table. This has the same effect as INSERT OR REPLACE
+ * statements on the tiles view, but looks up blobs using a single prepared statement per tile and only executes
+ * single row statements, which unlike the view triggers do not need a statement journal.
+ */
+typedef struct {
+  /** @private */
+  sqlite3 *db;
+  /** @private */
+  sqlite3_stmt *find_blob_stmt;
+  /** @private */
+  sqlite3_stmt *insert_blob_stmt;
+  /** @private */
+  sqlite3_stmt *delete_blob_stmt;
+  /** @private */
+  sqlite3_stmt *insert_ref_stmt;
+  /** @private */
+  sqlite3_stmt *update_ref_stmt;
+  /** @private */
+  sqlite3_stmt *delete_ref_stmt;
+  /** @private */
+  sqlite3_stmt *find_tile_stmt;
+  /** @private */
+  sqlite3_stmt *insert_tile_stmt;
+  /** @private */
+  sqlite3_stmt *update_tile_stmt;
+} tile_dedup_writer_t;
+
+/**
+ * Creates a deduplicated tiles table. If a regular tiles table with the given name already exists, its tiles are
+ * moved to the deduplicated storage.
+ * @param db the database handle
+ * @param db_name the database name (e.g. "main")
+ * @param table_name the name of the tiles table
+ * @param error the error stream to write errors to
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+int tile_dedup_create(sqlite3 *db, const char *db_name, const char *table_name, errorstream_t *error);
+
+/**
+ * Checks whether a tiles table uses deduplicated storage.
+ * @param db the database handle
+ * @param db_name the database name (e.g. "main")
+ * @param table_name the name of the tiles table
+ * @param[out] enabled set to 1 if the table uses deduplicated storage and 0 otherwise
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+int tile_dedup_enabled(sqlite3 *db, const char *db_name, const char *table_name, int *enabled);
+
+/**
+ * Initializes a tile writer for a deduplicated tiles table.
+ * @param writer the writer to initialize
+ * @param db the database handle
+ * @param db_name the database name (e.g. "main")
+ * @param table_name the name of the tiles table
+ * @param error the error stream to write errors to
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+int tile_dedup_writer_init(tile_dedup_writer_t *writer, sqlite3 *db, const char *db_name, const char *table_name, errorstream_t *error);
+
+/**
+ * Stores a tile, replacing the existing tile with the same coordinates if there is one.
+ * @param writer the writer
+ * @param zoom_level the zoom level of the tile
+ * @param tile_column the column of the tile
+ * @param tile_row the row of the tile
+ * @param data the tile data
+ * @param length the length of data in bytes
+ * @param error the error stream to write errors to
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+int tile_dedup_writer_write(tile_dedup_writer_t *writer, int zoom_level, int tile_column, int tile_row, const void *data, int length, errorstream_t *error);
+
+/**
+ * Releases the resources of a tile writer. This function can be called on writers for which tile_dedup_writer_init
+ * failed.
+ * @param writer the writer
+ */
+void tile_dedup_writer_destroy(tile_dedup_writer_t *writer);
+
+/** @} */
+
+#endif
@@ -0,0 +1,1080 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "atomic_ops.h"
+#include "gpkg.h"
+#include "spatialdb.h"
+#include "sql.h"
+#include "tile_dedup.h"
+#include "tile_import.h"
+
+#if defined(_WIN32) || defined(WIN32) || defined(__MINGW32__)
+#define IMPORT_WINDOWS
+#include <Windows.h>
+#include <process.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define IMPORT_BATCH_SIZE 1024
+#define IMPORT_THREADS 4
+#define IMPORT_TILES_PER_THREAD 64
+#define IMPORT_MAX_ZOOM 30
+#define IMPORT_SRS_ID 3857
+#define IMPORT_EXTENT 20037508.342789244
+#define IMPORT_DEFAULT_TILE_SIZE 256
+#define IMPORT_MMAP_THRESHOLD 65536
+#define IMPORT_MMAP_SIZE "2147418112"
+
+#define IMPORT_WKT_3857 \
+  "PROJCS[\"WGS 84 / Pseudo-Mercator\",GEOGCS[\"WGS 84\",DATUM[\"WGS_1984\",SPHEROID[\"WGS 84\",6378137,298.257223563," \
+  "AUTHORITY[\"EPSG\",\"7030\"]],AUTHORITY[\"EPSG\",\"6326\"]],PRIMEM[\"Greenwich\",0,AUTHORITY[\"EPSG\",\"8901\"]]," \
+  "UNIT[\"degree\",0.0174532925199433,AUTHORITY[\"EPSG\",\"9122\"]],AUTHORITY[\"EPSG\",\"4326\"]]," \
+  "PROJECTION[\"Mercator_1SP\"],PARAMETER[\"central_meridian\",0],PARAMETER[\"scale_factor\",1]," \
+  "PARAMETER[\"false_easting\",0],PARAMETER[\"false_northing\",0],UNIT[\"metre\",1,AUTHORITY[\"EPSG\",\"9001\"]]," \
+  "AXIS[\"X\",EAST],AXIS[\"Y\",NORTH],AUTHORITY[\"EPSG\",\"3857\"]]"
+
+typedef struct {
+  int zoom_level;
+  int tile_column;
+  int tile_row;
+  char *path;
+  const uint8_t *data;
+  size_t length;
+  void *mapping;
+  void *buffer;
+  int status;
+} import_tile_t;
+
+typedef struct {
+  import_tile_t tiles[IMPORT_BATCH_SIZE];
+  size_t count;
+  volatile long next;
+  int started;
+  int thread_count;
+#ifdef IMPORT_WINDOWS
+  HANDLE threads[IMPORT_THREADS];
+#else
+  pthread_t threads[IMPORT_THREADS];
+#endif
+} import_batch_t;
+
+typedef struct {
+  int present;
+  int tile_width;
+  int tile_height;
+  int min_column;
+  int max_column;
+  int min_row;
+  int max_row;
+} import_zoom_t;
+
+typedef struct {
+  sqlite3 *db;
+  sqlite3_stmt *insert_stmt;
+  int dedup;
+  tile_dedup_writer_t dedup_writer;
+  import_batch_t *batches;
+  int filling;
+  int pending;
+  import_zoom_t zooms[IMPORT_MAX_ZOOM + 1];
+  sqlite3_int64 tile_count;
+  errorstream_t *error;
+} importer_t;
+
+typedef struct {
+  long value;
+  char *name;
+} import_entry_t;
+
+static uint32_t read_be16(const uint8_t *p) {
+  return ((uint32_t) p[0] << 8) | p[1];
+}
+
+static uint32_t read_be32(const uint8_t *p) {
+  return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static uint32_t read_le16(const uint8_t *p) {
+  return ((uint32_t) p[1] << 8) | p[0];
+}
+
+static uint32_t read_le24(const uint8_t *p) {
+  return ((uint32_t) p[2] << 16) | ((uint32_t) p[1] << 8) | p[0];
+}
+
+static uint32_t read_le32(const uint8_t *p) {
+  return ((uint32_t) p[3] << 24) | read_le24(p);
+}
+
+/*
+ * Determines the pixel size of a PNG, JPEG or WebP image from its header. Returns 0 if the format is not recognized.
+ */
+static int import_image_size(const uint8_t *data, size_t length, uint32_t *width, uint32_t *height) {
+  if (length >= 24 && memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0 && memcmp(data + 12, "IHDR", 4) == 0) {
+    *width = read_be32(data + 16);
+    *height = read_be32(data + 20);
+    return 1;
+  }
+
+  if (length >= 4 && data[0] == 0xFF && data[1] == 0xD8) {
+    size_t offset = 2;
+    while (offset + 9 <= length && data[offset] == 0xFF) {
+      uint8_t marker = data[offset + 1];
+      if (marker == 0xFF) {
+        offset++;
+      } else if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+        *height = read_be16(data + offset + 5);
+        *width = read_be16(data + offset + 7);
+        return 1;
+      } else if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+        offset += 2;
+      } else {
+        offset += 2 + read_be16(data + offset + 2);
+      }
+    }
+    return 0;
+  }
+
+  if (length >= 30 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WEBP", 4) == 0) {
+    if (memcmp(data + 12, "VP8X", 4) == 0) {
+      *width = 1 + read_le24(data + 24);
+      *height = 1 + read_le24(data + 27);
+      return 1;
+    } else if (memcmp(data + 12, "VP8L", 4) == 0 && data[20] == 0x2F) {
+      uint32_t bits = read_le32(data + 21);
+      *width = 1 + (bits & 0x3FFF);
+      *height = 1 + ((bits >> 14) & 0x3FFF);
+      return 1;
+    } else if (memcmp(data + 12, "VP8 ", 4) == 0) {
+      *width = read_le16(data + 26) & 0x3FFF;
+      *height = read_le16(data + 28) & 0x3FFF;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Tile files are loaded by worker threads, which must not depend on the SQLite memory allocator being thread safe.
+ * They therefore use malloc and free directly.
+ */
+#ifdef IMPORT_WINDOWS
+static void import_load_tile(import_tile_t *tile) {
+  FILE *file = fopen(tile->path, "rb");
+  if (file == NULL) {
+    tile->status = SQLITE_CANTOPEN;
+    return;
+  }
+
+  size_t capacity = 16384;
+  size_t length = 0;
+  uint8_t *buffer = (uint8_t *) malloc(capacity);
+  while (buffer != NULL) {
+    length += fread(buffer + length, 1, capacity - length, file);
+    if (length < capacity) {
+      break;
+    }
+
+    uint8_t *new_buffer = (uint8_t *) realloc(buffer, capacity * 2);
+    if (new_buffer == NULL) {
+      free(buffer);
+    }
+    buffer = new_buffer;
+    capacity *= 2;
+  }
+
+  if (buffer == NULL) {
+    tile->status = SQLITE_NOMEM;
+  } else if (ferror(file)) {
+    free(buffer);
+    tile->status = SQLITE_IOERR;
+  } else {
+    tile->buffer = buffer;
+    tile->data = buffer;
+    tile->length = length;
+  }
+  fclose(file);
+}
+#else
+/*
+ * Large files are memory mapped. The pages are faulted in on the worker thread so the inserting thread does not wait
+ * for I/O. Small files are read into a buffer instead, since mapping and unmapping them costs more system calls than
+ * reading them.
+ */
+static void import_load_tile(import_tile_t *tile) {
+  struct stat st;
+  int fd = open(tile->path, O_RDONLY);
+  if (fd < 0) {
+    tile->status = SQLITE_CANTOPEN;
+    return;
+  }
+
+  if (fstat(fd, &st) != 0) {
+    tile->status = SQLITE_IOERR;
+    goto exit;
+  }
+
+  size_t length = (size_t) st.st_size;
+  if (length == 0) {
+    goto exit;
+  }
+
+  if (length >= IMPORT_MMAP_THRESHOLD) {
+#ifdef MAP_POPULATE
+    void *mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+#else
+    void *mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+#endif
+    if (mapping != MAP_FAILED) {
+#ifndef MAP_POPULATE
+      volatile uint8_t sink = 0;
+      for (size_t offset = 0; offset < length; offset += 4096) {
+        sink ^= ((const uint8_t *) mapping)[offset];
+      }
+      (void) sink;
+#endif
+      tile->mapping = mapping;
+      tile->data = (const uint8_t *) mapping;
+      tile->length = length;
+      goto exit;
+    }
+  }
+
+  uint8_t *buffer = (uint8_t *) malloc(length);
+  if (buffer == NULL) {
+    tile->status = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  size_t offset = 0;
+  while (offset < length) {
+    ssize_t n = read(fd, buffer + offset, length - offset);
+    if (n <= 0) {
+      break;
+    }
+    offset += (size_t) n;
+  }
+
+  if (offset < length) {
+    free(buffer);
+    tile->status = SQLITE_IOERR;
+  } else {
+    tile->buffer = buffer;
+    tile->data = buffer;
+    tile->length = length;
+  }
+
+exit:
+  close(fd);
+}
+#endif
+
+static void import_batch_load(import_batch_t *batch) {
+  long count = (long) batch->count;
+  long i;
+  while ((i = atomic_inc_long(&batch->next) - 1) < count) {
+    import_load_tile(&batch->tiles[i]);
+  }
+}
+
+#ifdef IMPORT_WINDOWS
+static unsigned __stdcall import_worker(void *data) {
+  import_batch_load((import_batch_t *) data);
+  return 0;
+}
+#else
+static void *import_worker(void *data) {
+  import_batch_load((import_batch_t *) data);
+  return NULL;
+}
+#endif
+
+/*
+ * Starts loading the tiles of a batch on worker threads. If no threads can be started the tiles are loaded by
+ * import_batch_finish instead.
+ */
+static void import_batch_start(import_batch_t *batch) {
+  int threads = (int) (batch->count / IMPORT_TILES_PER_THREAD) + 1;
+  if (threads > IMPORT_THREADS) {
+    threads = IMPORT_THREADS;
+  }
+
+  batch->next = 0;
+  batch->thread_count = 0;
+  batch->started = 1;
+  for (int i = 0; i < threads; i++) {
+#ifdef IMPORT_WINDOWS
+    uintptr_t handle = _beginthreadex(NULL, 0, import_worker, batch, 0, NULL);
+    if (handle == 0) {
+      break;
+    }
+    batch->threads[batch->thread_count++] = (HANDLE) handle;
+#else
+    if (pthread_create(&batch->threads[batch->thread_count], NULL, import_worker, batch) != 0) {
+      break;
+    }
+    batch->thread_count++;
+#endif
+  }
+}
+
+static void import_batch_join(import_batch_t *batch) {
+  for (int i = 0; i < batch->thread_count; i++) {
+#ifdef IMPORT_WINDOWS
+    WaitForSingleObject(batch->threads[i], INFINITE);
+    CloseHandle(batch->threads[i]);
+#else
+    pthread_join(batch->threads[i], NULL);
+#endif
+  }
+  batch->thread_count = 0;
+}
+
+static void import_batch_finish(import_batch_t *batch) {
+  import_batch_join(batch);
+  import_batch_load(batch);
+}
+
+static void import_batch_release(import_batch_t *batch) {
+  for (size_t i = 0; i < batch->count; i++) {
+    import_tile_t *tile = &batch->tiles[i];
+#ifndef IMPORT_WINDOWS
+    if (tile->mapping != NULL) {
+      munmap(tile->mapping, tile->length);
+    }
+#endif
+    free(tile->buffer);
+    sqlite3_free(tile->path);
+  }
+  batch->count = 0;
+  batch->started = 0;
+}
+
+static int importer_insert(importer_t *importer, int zoom_level, int tile_column, int tile_row, const void *data, size_t length) {
+  sqlite3_stmt *stmt = importer->insert_stmt;
+
+  if (length > 0x7FFFFFFF) {
+    error_append(importer->error, "Tile %d/%d/%d is too large", zoom_level, tile_column, tile_row);
+    return SQLITE_TOOBIG;
+  }
+
+  if (importer->dedup) {
+    int result = tile_dedup_writer_write(&importer->dedup_writer, zoom_level, tile_column, tile_row, data, (int) length, importer->error);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+  } else {
+    sqlite3_bind_int(stmt, 1, zoom_level);
+    sqlite3_bind_int(stmt, 2, tile_column);
+    sqlite3_bind_int(stmt, 3, tile_row);
+    sqlite3_bind_blob(stmt, 4, data != NULL ? data : "", (int) length, SQLITE_STATIC);
+    int result = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (result != SQLITE_DONE) {
+      error_append(importer->error, "%s", sqlite3_errmsg(importer->db));
+      return result;
+    }
+  }
+
+  import_zoom_t *zoom = &importer->zooms[zoom_level];
+  if (!zoom->present) {
+    uint32_t width, height;
+    if (data != NULL && import_image_size((const uint8_t *) data, length, &width, &height) && width > 0 && height > 0 && width <= 65536 && height <= 65536) {
+      zoom->tile_width = (int) width;
+      zoom->tile_height = (int) height;
+    } else {
+      zoom->tile_width = IMPORT_DEFAULT_TILE_SIZE;
+      zoom->tile_height = IMPORT_DEFAULT_TILE_SIZE;
+    }
+    zoom->present = 1;
+    zoom->min_column = zoom->max_column = tile_column;
+    zoom->min_row = zoom->max_row = tile_row;
+  } else {
+    if (tile_column < zoom->min_column) {
+      zoom->min_column = tile_column;
+    }
+    if (tile_column > zoom->max_column) {
+      zoom->max_column = tile_column;
+    }
+    if (tile_row < zoom->min_row) {
+      zoom->min_row = tile_row;
+    }
+    if (tile_row > zoom->max_row) {
+      zoom->max_row = tile_row;
+    }
+  }
+
+  importer->tile_count++;
+  return SQLITE_OK;
+}
+
+static int importer_insert_batch(importer_t *importer, import_batch_t *batch) {
+  for (size_t i = 0; i < batch->count; i++) {
+    import_tile_t *tile = &batch->tiles[i];
+    if (tile->status != SQLITE_OK) {
+      error_append(importer->error, "Could not read tile file %s", tile->path);
+      return tile->status;
+    }
+
+    int result = importer_insert(importer, tile->zoom_level, tile->tile_column, tile->tile_row, tile->data, tile->length);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+  }
+  return SQLITE_OK;
+}
+
+/*
+ * Submits the batch that is being filled for loading and inserts the previously submitted batch, so that files are
+ * read while the previous batch is being inserted. Calling this function with an empty batch only inserts the
+ * previous batch.
+ */
+static int importer_flush(importer_t *importer) {
+  int result = SQLITE_OK;
+  import_batch_t *batch = &importer->batches[importer->filling];
+
+  if (batch->count > 0) {
+    import_batch_start(batch);
+  }
+
+  if (importer->pending) {
+    import_batch_t *previous = &importer->batches[1 - importer->filling];
+    import_batch_finish(previous);
+    result = importer_insert_batch(importer, previous);
+    import_batch_release(previous);
+    importer->pending = 0;
+  }
+
+  if (batch->count > 0) {
+    importer->pending = 1;
+    importer->filling = 1 - importer->filling;
+  }
+
+  return result;
+}
+
+static int importer_check_tile(importer_t *importer, long zoom_level, long tile_column, long tile_row) {
+  if (zoom_level < 0 || zoom_level > IMPORT_MAX_ZOOM) {
+    error_append(importer->error, "Zoom level %ld is out of range", zoom_level);
+    return SQLITE_RANGE;
+  }
+
+  long matrix_size = 1L << zoom_level;
+  if (tile_column < 0 || tile_column >= matrix_size || tile_row < 0 || tile_row >= matrix_size) {
+    error_append(importer->error, "Tile %ld/%ld/%ld is outside the tile matrix", zoom_level, tile_column, tile_row);
+    return SQLITE_RANGE;
+  }
+
+  return SQLITE_OK;
+}
+
+static int importer_add(importer_t *importer, int zoom_level, int tile_column, int tile_row, char *path) {
+  import_batch_t *batch = &importer->batches[importer->filling];
+  import_tile_t *tile = &batch->tiles[batch->count++];
+
+  memset(tile, 0, sizeof(import_tile_t));
+  tile->zoom_level = zoom_level;
+  tile->tile_column = tile_column;
+  tile->tile_row = tile_row;
+  tile->path = path;
+  tile->status = SQLITE_OK;
+
+  if (batch->count == IMPORT_BATCH_SIZE) {
+    return importer_flush(importer);
+  } else {
+    return SQLITE_OK;
+  }
+}
+
+static int import_entry_compare(const void *a, const void *b) {
+  long va = ((const import_entry_t *) a)->value;
+  long vb = ((const import_entry_t *) b)->value;
+  return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+/*
+ * Parses a directory entry name of the form 'digits' or, if allow_extension is set, 'digits.extension'.
+ */
+static int import_parse_name(const char *name, int allow_extension, long *value) {
+  long v = 0;
+  int digits = 0;
+  while (*name >= '0' && *name <= '9') {
+    if (++digits > 9) {
+      return 0;
+    }
+    v = v * 10 + (*name - '0');
+    name++;
+  }
+
+  if (digits == 0 || (*name != 0 && !(allow_extension && *name == '.'))) {
+    return 0;
+  }
+
+  *value = v;
+  return 1;
+}
+
+static void import_free_entries(import_entry_t *entries, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    sqlite3_free(entries[i].name);
+  }
+  sqlite3_free(entries);
+}
+
+static int import_append_entry(import_entry_t **entries, size_t *count, size_t *capacity, const char *name, int allow_extension) {
+  long value;
+  if (!import_parse_name(name, allow_extension, &value)) {
+    return SQLITE_OK;
+  }
+
+  if (*count == *capacity) {
+    size_t new_capacity = *capacity == 0 ? 64 : *capacity * 2;
+    if (new_capacity * sizeof(import_entry_t) > 0x7FFFFFFF) {
+      return SQLITE_NOMEM;
+    }
+    import_entry_t *new_entries = (import_entry_t *) sqlite3_realloc(*entries, (int) (new_capacity * sizeof(import_entry_t)));
+    if (new_entries == NULL) {
+      return SQLITE_NOMEM;
+    }
+    *entries = new_entries;
+    *capacity = new_capacity;
+  }
+
+  char *copy = sqlite3_mprintf("%s", name);
+  if (copy == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  (*entries)[*count].value = value;
+  (*entries)[*count].name = copy;
+  (*count)++;
+  return SQLITE_OK;
+}
+
+/*
+ * Lists the entries of a directory whose names are numbers, sorted by that number. Returns SQLITE_NOTFOUND if path
+ * is not a directory and SQLITE_CONSTRAINT if two entries have the same number, e.g. 0.png and 0.jpg.
+ */
+static int import_list_directory(const char *path, int allow_extension, import_entry_t **entries_out, size_t *count_out, errorstream_t *error) {
+  int result = SQLITE_OK;
+  import_entry_t *entries = NULL;
+  size_t count = 0;
+  size_t capacity = 0;
+
+#ifdef IMPORT_WINDOWS
+  WIN32_FIND_DATAA find_data;
+  char *pattern = sqlite3_mprintf("%s\\*", path);
+  if (pattern == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  HANDLE find = FindFirstFileA(pattern, &find_data);
+  sqlite3_free(pattern);
+  if (find == INVALID_HANDLE_VALUE) {
+    return SQLITE_NOTFOUND;
+  }
+
+  do {
+    result = import_append_entry(&entries, &count, &capacity, find_data.cFileName, allow_extension);
+  } while (result == SQLITE_OK && FindNextFileA(find, &find_data));
+  FindClose(find);
+#else
+  DIR *dir = opendir(path);
+  if (dir == NULL) {
+    return SQLITE_NOTFOUND;
+  }
+
+  struct dirent *entry;
+  while (result == SQLITE_OK && (entry = readdir(dir)) != NULL) {
+    result = import_append_entry(&entries, &count, &capacity, entry->d_name, allow_extension);
+  }
+  closedir(dir);
+#endif
+
+  if (result != SQLITE_OK) {
+    import_free_entries(entries, count);
+    return result;
+  }
+
+  qsort(entries, count, sizeof(import_entry_t), import_entry_compare);
+  for (size_t i = 1; i < count; i++) {
+    if (entries[i].value == entries[i - 1].value) {
+      error_append(error, "Directory %s contains both %s and %s", path, entries[i - 1].name, entries[i].name);
+      import_free_entries(entries, count);
+      return SQLITE_CONSTRAINT;
+    }
+  }
+
+  *entries_out = entries;
+  *count_out = count;
+  return SQLITE_OK;
+}
+
+static int import_is_file(const char *path) {
+  struct stat st;
+  return stat(path, &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG;
+}
+
+static int import_column_directory(importer_t *importer, const char *path, long zoom_level, long tile_column, int tms) {
+  import_entry_t *rows = NULL;
+  size_t row_count = 0;
+
+  int result = import_list_directory(path, 1, &rows, &row_count, importer->error);
+  if (result == SQLITE_NOTFOUND) {
+    return SQLITE_OK;
+  } else if (result != SQLITE_OK) {
+    return result;
+  }
+
+  /* TMS rows are flipped; walk them in reverse so GeoPackage rows are still inserted in ascending order */
+  for (size_t i = 0; i < row_count && result == SQLITE_OK; i++) {
+    import_entry_t *row = &rows[tms ? row_count - 1 - i : i];
+    long tile_row = tms ? (1L << zoom_level) - 1 - row->value : row->value;
+
+    result = importer_check_tile(importer, zoom_level, tile_column, tile_row);
+    if (result == SQLITE_OK) {
+      char *tile_path = sqlite3_mprintf("%s/%s", path, row->name);
+      if (tile_path == NULL) {
+        result = SQLITE_NOMEM;
+      } else {
+        result = importer_add(importer, (int) zoom_level, (int) tile_column, (int) tile_row, tile_path);
+      }
+    }
+  }
+
+  import_free_entries(rows, row_count);
+  return result;
+}
+
+static int import_directory(importer_t *importer, const char *source) {
+  import_entry_t *zooms = NULL;
+  size_t zoom_count = 0;
+
+  char *tms_path = sqlite3_mprintf("%s/tilemapresource.xml", source);
+  if (tms_path == NULL) {
+    return SQLITE_NOMEM;
+  }
+  int tms = import_is_file(tms_path);
+  sqlite3_free(tms_path);
+
+  int result = import_list_directory(source, 0, &zooms, &zoom_count, importer->error);
+  if (result == SQLITE_NOTFOUND) {
+    error_append(importer->error, "Could not read directory %s", source);
+    return SQLITE_CANTOPEN;
+  } else if (result != SQLITE_OK) {
+    return result;
+  }
+
+  for (size_t z = 0; z < zoom_count && result == SQLITE_OK; z++) {
+    import_entry_t *columns = NULL;
+    size_t column_count = 0;
+
+    char *zoom_path = sqlite3_mprintf("%s/%s", source, zooms[z].name);
+    if (zoom_path == NULL) {
+      result = SQLITE_NOMEM;
+      break;
+    }
+
+    result = import_list_directory(zoom_path, 0, &columns, &column_count, importer->error);
+    if (result == SQLITE_NOTFOUND) {
+      result = SQLITE_OK;
+    }
+
+    for (size_t x = 0; x < column_count && result == SQLITE_OK; x++) {
+      char *column_path = sqlite3_mprintf("%s/%s", zoom_path, columns[x].name);
+      if (column_path == NULL) {
+        result = SQLITE_NOMEM;
+      } else {
+        result = import_column_directory(importer, column_path, zooms[z].value, columns[x].value, tms);
+        sqlite3_free(column_path);
+      }
+    }
+
+    import_free_entries(columns, column_count);
+    sqlite3_free(zoom_path);
+  }
+
+  import_free_entries(zooms, zoom_count);
+
+  /* Insert the last partially filled batch, then the batch that is still being loaded */
+  if (result == SQLITE_OK) {
+    result = importer_flush(importer);
+  }
+  if (result == SQLITE_OK) {
+    result = importer_flush(importer);
+  }
+  return result;
+}
+
+/*
+ * MBTiles files are read sequentially through a separate read only connection. The file is memory mapped by SQLite,
+ * and tile data is bound to the insert statement without being copied.
+ */
+static int import_mbtiles(importer_t *importer, const char *source) {
+  sqlite3 *mbtiles = NULL;
+  sqlite3_stmt *stmt = NULL;
+
+  int result = sqlite3_open_v2(source, &mbtiles, SQLITE_OPEN_READONLY, NULL);
+  if (result == SQLITE_OK) {
+    sqlite3_exec(mbtiles, "PRAGMA mmap_size = " IMPORT_MMAP_SIZE, NULL, NULL, NULL);
+    result = sqlite3_prepare_v2(mbtiles, "SELECT zoom_level, tile_column, tile_row, tile_data FROM tiles ORDER BY zoom_level, tile_column, tile_row", -1, &stmt, NULL);
+  }
+  if (result != SQLITE_OK) {
+    error_append(importer->error, "Could not read MBTiles file %s: %s", source, mbtiles != NULL ? sqlite3_errmsg(mbtiles) : "out of memory");
+    goto exit;
+  }
+
+  while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+    sqlite3_int64 zoom_level = sqlite3_column_int64(stmt, 0);
+    sqlite3_int64 tile_column = sqlite3_column_int64(stmt, 1);
+    sqlite3_int64 tile_row = sqlite3_column_int64(stmt, 2);
+
+    if (zoom_level < 0 || zoom_level > IMPORT_MAX_ZOOM) {
+      error_append(importer->error, "Zoom level %lld is out of range", zoom_level);
+      result = SQLITE_RANGE;
+      goto exit;
+    }
+    tile_row = (1LL << zoom_level) - 1 - tile_row;
+
+    result = importer_check_tile(importer, (long) zoom_level, (long) tile_column, (long) tile_row);
+    if (result != SQLITE_OK) {
+      goto exit;
+    }
+
+    const void *data = sqlite3_column_blob(stmt, 3);
+    size_t length = (size_t) sqlite3_column_bytes(stmt, 3);
+    result = importer_insert(importer, (int) zoom_level, (int) tile_column, (int) tile_row, data, length);
+    if (result != SQLITE_OK) {
+      goto exit;
+    }
+  }
+
+  if (result == SQLITE_DONE) {
+    result = SQLITE_OK;
+  } else {
+    error_append(importer->error, "Could not read MBTiles file %s: %s", source, sqlite3_errmsg(mbtiles));
+  }
+
+exit:
+  sqlite3_finalize(stmt);
+  sqlite3_close(mbtiles);
+  return result;
+}
+
+static int import_prepare_metadata(sqlite3 *db, const char *db_name, const char *table_name, errorstream_t *error) {
+  int count;
+
+  int result = sql_exec(
+                 db,
+                 "INSERT OR IGNORE INTO \"%w\".gpkg_spatial_ref_sys (srs_name, srs_id, organization, organization_coordsys_id, definition) VALUES ('WGS 84 / Pseudo-Mercator', %d, 'EPSG', %d, %Q)",
+                 db_name, IMPORT_SRS_ID, IMPORT_SRS_ID, IMPORT_WKT_3857
+               );
+  if (result != SQLITE_OK) {
+    goto exit;
+  }
+
+  result = sql_exec_for_int(db, &count, "SELECT count(*) FROM \"%w\".gpkg_contents WHERE table_name = %Q", db_name, table_name);
+  if (result != SQLITE_OK) {
+    goto exit;
+  }
+  if (count == 0) {
+    result = sql_exec(
+               db,
+               "INSERT INTO \"%w\".gpkg_contents (table_name, data_type, identifier, srs_id) VALUES (%Q, 'tiles', %Q, %d)",
+               db_name, table_name, table_name, IMPORT_SRS_ID
+             );
+    if (result != SQLITE_OK) {
+      goto exit;
+    }
+  } else {
+    result = sql_exec_for_int(db, &count, "SELECT count(*) FROM \"%w\".gpkg_contents WHERE table_name = %Q AND data_type = 'tiles'", db_name, table_name);
+    if (result != SQLITE_OK) {
+      goto exit;
+    }
+    if (count == 0) {
+      error_append(error, "Table %s is not registered as a tiles table in gpkg_contents", table_name);
+      return SQLITE_ERROR;
+    }
+  }
+
+  result = sql_exec_for_int(db, &count, "SELECT count(*) FROM \"%w\".gpkg_tile_matrix_set WHERE table_name = %Q", db_name, table_name);
+  if (result != SQLITE_OK) {
+    goto exit;
+  }
+  if (count == 0) {
+    result = sql_exec(
+               db,
+               "INSERT INTO \"%w\".gpkg_tile_matrix_set (table_name, srs_id, min_x, min_y, max_x, max_y) VALUES (%Q, %d, %!.17g, %!.17g, %!.17g, %!.17g)",
+               db_name, table_name, IMPORT_SRS_ID, -IMPORT_EXTENT, -IMPORT_EXTENT, IMPORT_EXTENT, IMPORT_EXTENT
+             );
+  } else {
+    result = sql_exec_for_int(
+               db, &count,
+               "SELECT count(*) FROM \"%w\".gpkg_tile_matrix_set WHERE table_name = %Q AND srs_id = %d AND abs(min_x + %!.17g) < 0.01 AND abs(min_y + %!.17g) < 0.01 AND abs(max_x - %!.17g) < 0.01 AND abs(max_y - %!.17g) < 0.01",
+               db_name, table_name, IMPORT_SRS_ID, IMPORT_EXTENT, IMPORT_EXTENT, IMPORT_EXTENT, IMPORT_EXTENT
+             );
+    if (result == SQLITE_OK && count == 0) {
+      error_append(error, "The tile matrix set of %s is not the EPSG:%d world grid used by the tile source", table_name, IMPORT_SRS_ID);
+      return SQLITE_ERROR;
+    }
+  }
+
+exit:
+  if (result != SQLITE_OK) {
+    error_append(error, "%s", sqlite3_errmsg(db));
+  }
+  return result;
+}
+
+static int import_finish_metadata(importer_t *importer, const char *db_name, const char *table_name) {
+  sqlite3 *db = importer->db;
+  int result = SQLITE_OK;
+  int has_bounds = 0;
+  double min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+
+  for (int z = 0; z <= IMPORT_MAX_ZOOM && result == SQLITE_OK; z++) {
+    import_zoom_t *zoom = &importer->zooms[z];
+    if (!zoom->present) {
+      continue;
+    }
+
+    int matrix_size = 1 << z;
+    double tile_span = 2 * IMPORT_EXTENT / matrix_size;
+    double zoom_min_x = -IMPORT_EXTENT + zoom->min_column * tile_span;
+    double zoom_max_x = -IMPORT_EXTENT + (zoom->max_column + 1) * tile_span;
+    double zoom_min_y = IMPORT_EXTENT - (zoom->max_row + 1) * tile_span;
+    double zoom_max_y = IMPORT_EXTENT - zoom->min_row * tile_span;
+    if (!has_bounds) {
+      min_x = zoom_min_x;
+      min_y = zoom_min_y;
+      max_x = zoom_max_x;
+      max_y = zoom_max_y;
+      has_bounds = 1;
+    } else {
+      min_x = zoom_min_x < min_x ? zoom_min_x : min_x;
+      min_y = zoom_min_y < min_y ? zoom_min_y : min_y;
+      max_x = zoom_max_x > max_x ? zoom_max_x : max_x;
+      max_y = zoom_max_y > max_y ? zoom_max_y : max_y;
+    }
+
+    int count;
+    result = sql_exec_for_int(db, &count, "SELECT count(*) FROM \"%w\".gpkg_tile_matrix WHERE table_name = %Q AND zoom_level = %d", db_name, table_name, z);
+    if (result != SQLITE_OK) {
+      break;
+    }
+
+    if (count == 0) {
+      result = sql_exec(
+                 db,
+                 "INSERT INTO \"%w\".gpkg_tile_matrix (table_name, zoom_level, matrix_width, matrix_height, tile_width, tile_height, pixel_x_size, pixel_y_size) VALUES (%Q, %d, %d, %d, %d, %d, %!.17g, %!.17g)",
+                 db_name, table_name, z, matrix_size, matrix_size, zoom->tile_width, zoom->tile_height, tile_span / zoom->tile_width, tile_span / zoom->tile_height
+               );
+    } else {
+      result = sql_exec_for_int(
+                 db, &count,
+                 "SELECT count(*) FROM \"%w\".gpkg_tile_matrix WHERE table_name = %Q AND zoom_level = %d AND matrix_width = %d AND matrix_height = %d",
+                 db_name, table_name, z, matrix_size, matrix_size
+               );
+      if (result == SQLITE_OK && count == 0) {
+        error_append(importer->error, "The tile matrix of %s at zoom level %d does not match the tile source", table_name, z);
+        return SQLITE_ERROR;
+      }
+    }
+  }
+
+  if (result == SQLITE_OK && has_bounds) {
+    result = sql_exec(
+               db,
+               "UPDATE \"%w\".gpkg_contents SET min_x = min(coalesce(min_x, %!.17g), %!.17g), min_y = min(coalesce(min_y, %!.17g), %!.17g), max_x = max(coalesce(max_x, %!.17g), %!.17g), max_y = max(coalesce(max_y, %!.17g), %!.17g), last_change = strftime('%%Y-%%m-%%dT%%H:%%M:%%fZ', CURRENT_TIMESTAMP) WHERE table_name = %Q AND srs_id = %d",
+               db_name, min_x, min_x, min_y, min_y, max_x, max_x, max_y, max_y, table_name, IMPORT_SRS_ID
+             );
+  }
+
+  if (result != SQLITE_OK) {
+    error_append(importer->error, "%s", sqlite3_errmsg(db));
+  }
+  return result;
+}
+
+int tile_import(sqlite3 *db, const char *db_name, const char *table_name, const char *source, sqlite3_int64 *tile_count, errorstream_t *error) {
+  int result = SQLITE_OK;
+  char *sql = NULL;
+  importer_t importer;
+  struct stat st;
+
+  *tile_count = 0;
+  memset(&importer, 0, sizeof(importer_t));
+  importer.db = db;
+  importer.error = error;
+
+  if (stat(source, &st) != 0) {
+    error_append(error, "Could not open tile source %s", source);
+    return SQLITE_CANTOPEN;
+  }
+
+  result = import_prepare_metadata(db, db_name, table_name, error);
+  if (result != SQLITE_OK) {
+    goto exit;
+  }
+
+  result = tile_dedup_enabled(db, db_name, table_name, &importer.dedup);
+  if (result != SQLITE_OK) {
+    error_append(error, "%s", sqlite3_errmsg(db));
+    goto exit;
+  }
+
+  if (importer.dedup) {
+    // Bypasses the triggers of the tiles view
+    result = tile_dedup_writer_init(&importer.dedup_writer, db, db_name, table_name, error);
+    if (result != SQLITE_OK) {
+      goto exit;
+    }
+  } else {
+    sql = sqlite3_mprintf("INSERT OR REPLACE INTO \"%w\".\"%w\" (zoom_level, tile_column, tile_row, tile_data) VALUES (?1, ?2, ?3, ?4)", db_name, table_name);
+    if (sql == NULL) {
+      result = SQLITE_NOMEM;
+      goto exit;
+    }
+
+    result = sqlite3_prepare_v2(db, sql, -1, &importer.insert_stmt, NULL);
+    if (result != SQLITE_OK) {
+      error_append(error, "%s", sqlite3_errmsg(db));
+      goto exit;
+    }
+  }
+
+  if ((st.st_mode & S_IFMT) == S_IFDIR) {
+    importer.batches = (import_batch_t *) sqlite3_malloc(2 * sizeof(import_batch_t));
+    if (importer.batches == NULL) {
+      result = SQLITE_NOMEM;
+      goto exit;
+    }
+    memset(importer.batches, 0, 2 * sizeof(import_batch_t));
+    result = import_directory(&importer, source);
+  } else {
+    result = import_mbtiles(&importer, source);
+  }
+
+  if (result == SQLITE_OK) {
+    result = import_finish_metadata(&importer, db_name, table_name);
+  }
+
+exit:
+  if (importer.batches != NULL) {
+    for (int i = 0; i < 2; i++) {
+      if (importer.batches[i].started) {
+        import_batch_join(&importer.batches[i]);
+      }
+      import_batch_release(&importer.batches[i]);
+    }
+    sqlite3_free(importer.batches);
+  }
+  sqlite3_finalize(importer.insert_stmt);
+  tile_dedup_writer_destroy(&importer.dedup_writer);
+  sqlite3_free(sql);
+
+  if (result == SQLITE_NOMEM && error_count(error) == 0) {
+    error_append(error, "Out of memory");
+  }
+  *tile_count = importer.tile_count;
+  return result;
+}
+
+int tile_import_table(sqlite3 *db, const spatialdb_t *spatialdb, const char *db_name, const char *table_name, const char *source, sqlite3_int64 *tile_count, errorstream_t *error) {
+  int exists = 0;
+
+  *tile_count = 0;
+  if (spatialdb->create_tiles_table == NULL) {
+    error_append(error, "Tiles tables are not supported in %s mode", spatialdb->name);
+    return SQLITE_ERROR;
+  }
+
+  int result = spatialdb->init_meta(db, db_name, error);
+  if (result == SQLITE_OK) {
+    result = sql_check_table_exists(db, db_name, table_name, &exists);
+  }
+  if (result == SQLITE_OK && !exists) {
+    result = spatialdb->create_tiles_table(db, db_name, table_name, error);
+  }
+  if (result == SQLITE_OK) {
+    result = tile_import(db, db_name, table_name, source, tile_count, error);
+  }
+  return result;
+}
+
+GPKG_EXPORT int GPKG_CALL gpkg_import_tiles(sqlite3 *db, const char *db_name, const char *table_name, const char *source, sqlite3_int64 *tile_count, char **errmsg) {
+  errorstream_t error;
+  sqlite3_int64 count = 0;
+
+  if (errmsg != NULL) {
+    *errmsg = NULL;
+  }
+  if (tile_count != NULL) {
+    *tile_count = 0;
+  }
+  if (db == NULL || table_name == NULL || source == NULL) {
+    return SQLITE_MISUSE;
+  }
+  if (db_name == NULL) {
+    db_name = "main";
+  }
+
+  int result = error_init(&error);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = sql_begin(db, "gpkg_import_tiles");
+  if (result == SQLITE_OK) {
+    result = tile_import_table(db, spatialdb_detect_schema(db), db_name, table_name, source, &count, &error);
+    if (result == SQLITE_OK && error_count(&error) == 0) {
+      result = sql_commit(db, "gpkg_import_tiles");
+    } else {
+      sql_rollback(db, "gpkg_import_tiles");
+      sql_commit(db, "gpkg_import_tiles");
+    }
+  } else {
+    error_append(&error, "%s", sqlite3_errmsg(db));
+  }
+
+  if (result == SQLITE_OK && error_count(&error) > 0) {
+    result = SQLITE_ERROR;
+  }
+  if (result == SQLITE_OK) {
+    if (tile_count != NULL) {
+      *tile_count = count;
+    }
+  } else if (errmsg != NULL) {
+    *errmsg = sqlite3_mprintf("%s", error_count(&error) > 0 ? error_message(&error) : sqlite3_errstr(result));
+  }
+
+  error_destroy(&error);
+  return result;
+}
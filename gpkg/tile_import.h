@@ -0,0 +1,74 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GPKG_TILE_IMPORT_H
+#define GPKG_TILE_IMPORT_H
+
+#include "error.h"
+#include "spatialdb.h"
+#include "sqlite.h"
+
+/**
+ * \addtogroup tile_import Tile pyramid import
+ * @{
+ */
+
+/**
+ * Imports a tile pyramid in the spherical mercator (EPSG:3857) world grid into an existing tiles table.
+ *
+ * The source is either a directory tree laid out as zoom/column/row.ext, or an MBTiles file. Rows of MBTiles files
+ * and of directory trees that contain a tilemapresource.xml file are interpreted using the TMS convention (row 0 at
+ * the bottom) and are converted to GeoPackage rows (row 0 at the top). Other directory trees are interpreted using the
+ * XYZ convention, which matches GeoPackage.
+ *
+ * A directory whose entries map to the same tile, such as 0.png and 0.jpg, or to the same zoom level or column, such as
+ * 1 and 01, is rejected with SQLITE_CONSTRAINT rather than having one of the files win.
+ *
+ * Tiles are inserted ordered by zoom level, column and row. Files of directory trees are read, or memory mapped if they
+ * are large, by worker threads while the previous batch of tiles is being inserted. Existing tiles with the same
+ * coordinates are replaced.
+ *
+ * The gpkg_tile_matrix_set, gpkg_tile_matrix and gpkg_contents rows for the table are created if they do not exist
+ * yet. The tile size of each zoom level is taken from the image header of its first tile. The caller is expected to
+ * run this function inside a transaction.
+ *
+ * @param db the database handle
+ * @param db_name the database name (e.g. "main")
+ * @param table_name the name of the tiles table
+ * @param source the path of the directory tree or MBTiles file
+ * @param[out] tile_count receives the number of imported tiles
+ * @param error the error stream to write errors to
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+int tile_import(sqlite3 *db, const char *db_name, const char *table_name, const char *source, sqlite3_int64 *tile_count, errorstream_t *error);
+
+/**
+ * Initializes the spatial metadata tables, creates the tiles table if it does not exist yet and imports a tile pyramid
+ * into it using tile_import(). The caller is expected to run this function inside a transaction.
+ *
+ * @param db the database handle
+ * @param spatialdb the spatial database schema to use
+ * @param db_name the database name (e.g. "main")
+ * @param table_name the name of the tiles table
+ * @param source the path of the directory tree or MBTiles file
+ * @param[out] tile_count receives the number of imported tiles
+ * @param error the error stream to write errors to
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+int tile_import_table(sqlite3 *db, const spatialdb_t *spatialdb, const char *db_name, const char *table_name, const char *source, sqlite3_int64 *tile_count, errorstream_t *error);
+
+/** @} */
+
+#endif
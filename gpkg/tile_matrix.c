@@ -0,0 +1,667 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <math.h>
+#include <string.h>
+#include "atomic_ops.h"
+#include "binstream.h"
+#include "blobio.h"
+#include "geomio.h"
+#include "spatialdb_internal.h"
+#include "sql.h"
+#include "tile_matrix.h"
+
+#if SQLITE_VERSION_NUMBER >= 3009000
+#define TILE_MATRIX_HAVE_TABLE_FUNCTIONS 1
+#endif
+
+#define TILE_MATRIX_CACHE_SIZE 16
+
+/*
+ * The parameters of a single zoom level of a tiles table. Tile sizes are in units of the tile matrix set's
+ * coordinate reference system; column 0 starts at min_x and row 0 starts at max_y.
+ */
+typedef struct {
+  int32_t srs_id;
+  double min_x;
+  double max_y;
+  double tile_width;
+  double tile_height;
+  int matrix_width;
+  int matrix_height;
+} tile_matrix_t;
+
+typedef struct {
+  char *table_name;
+  int zoom_level;
+  tile_matrix_t matrix;
+} tile_matrix_entry_t;
+
+/*
+ * The tile matrix parameters that were looked up through a connection. The cache is shared by the functions and the
+ * module registered on that connection and is freed once all of them are unregistered. It is cleared whenever the
+ * database may have been modified: changes made through the connection itself are detected using the total change
+ * count and changes committed by other connections using the data version of the main database.
+ */
+typedef struct {
+  volatile long ref_count;
+  const spatialdb_t *spatialdb;
+  int total_changes;
+  int has_data_version;
+  unsigned int data_version;
+  int next_entry;
+  tile_matrix_entry_t entries[TILE_MATRIX_CACHE_SIZE];
+} tile_matrix_cache_t;
+
+static void tile_matrix_cache_clear(tile_matrix_cache_t *cache) {
+  for (int i = 0; i < TILE_MATRIX_CACHE_SIZE; i++) {
+    sqlite3_free(cache->entries[i].table_name);
+    cache->entries[i].table_name = NULL;
+  }
+  cache->next_entry = 0;
+}
+
+static void tile_matrix_cache_acquire(tile_matrix_cache_t *cache) {
+  atomic_inc_long(&cache->ref_count);
+}
+
+static void tile_matrix_cache_release(void *data) {
+  tile_matrix_cache_t *cache = (tile_matrix_cache_t *) data;
+  if (cache != NULL && atomic_dec_long(&cache->ref_count) == 0) {
+    tile_matrix_cache_clear(cache);
+    sqlite3_free(cache);
+  }
+}
+
+static void tile_matrix_cache_check(tile_matrix_cache_t *cache, sqlite3 *db) {
+  int total_changes = sqlite3_total_changes(db);
+  unsigned int data_version = 0;
+  int has_data_version = 0;
+
+#ifdef SQLITE_FCNTL_DATA_VERSION
+  has_data_version = sqlite3_file_control(db, "main", SQLITE_FCNTL_DATA_VERSION, &data_version) == SQLITE_OK;
+#endif
+
+  /* Without a data version, changes made by other connections cannot be detected so nothing is kept */
+  if (!has_data_version || !cache->has_data_version || data_version != cache->data_version || total_changes != cache->total_changes) {
+    tile_matrix_cache_clear(cache);
+  }
+  cache->total_changes = total_changes;
+  cache->has_data_version = has_data_version;
+  cache->data_version = data_version;
+}
+
+static int tile_matrix_row(sqlite3 *db, sqlite3_stmt *stmt, void *data) {
+  tile_matrix_t *matrix = (tile_matrix_t *) data;
+  matrix->srs_id = sqlite3_column_int(stmt, 0);
+  matrix->min_x = sqlite3_column_double(stmt, 1);
+  matrix->max_y = sqlite3_column_double(stmt, 2);
+  matrix->matrix_width = sqlite3_column_int(stmt, 3);
+  matrix->matrix_height = sqlite3_column_int(stmt, 4);
+  matrix->tile_width = sqlite3_column_double(stmt, 5);
+  matrix->tile_height = sqlite3_column_double(stmt, 6);
+  return SQLITE_OK;
+}
+
+/*
+ * Looks up the tile matrix of a zoom level of a tiles table in the main database. Sets found to 0 if the table has no
+ * tile matrix for that zoom level.
+ */
+static int tile_matrix_lookup(tile_matrix_cache_t *cache, sqlite3 *db, const char *table_name, int zoom_level, tile_matrix_t *matrix, int *found, errorstream_t *error) {
+  tile_matrix_cache_check(cache, db);
+
+  for (int i = 0; i < TILE_MATRIX_CACHE_SIZE; i++) {
+    tile_matrix_entry_t *entry = &cache->entries[i];
+    if (entry->table_name != NULL && entry->zoom_level == zoom_level && strcmp(entry->table_name, table_name) == 0) {
+      *matrix = entry->matrix;
+      *found = 1;
+      return SQLITE_OK;
+    }
+  }
+
+  matrix->matrix_width = 0;
+  int result = sql_exec_stmt(
+                 db, tile_matrix_row, NULL, matrix,
+                 "SELECT s.srs_id, s.min_x, s.max_y, m.matrix_width, m.matrix_height, m.tile_width * m.pixel_x_size, m.tile_height * m.pixel_y_size "
+                 "FROM main.gpkg_tile_matrix_set AS s JOIN main.gpkg_tile_matrix AS m ON m.table_name = s.table_name "
+                 "WHERE s.table_name = %Q AND m.zoom_level = %d",
+                 table_name, zoom_level
+               );
+  if (result != SQLITE_OK) {
+    error_append(error, "Could not read tile matrix of %s: %s", table_name, sqlite3_errmsg(db));
+    return result;
+  }
+
+  *found = matrix->matrix_width > 0 && matrix->matrix_height > 0 && matrix->tile_width > 0 && matrix->tile_height > 0;
+  if (!*found) {
+    return SQLITE_OK;
+  }
+
+  tile_matrix_entry_t *entry = &cache->entries[cache->next_entry];
+  sqlite3_free(entry->table_name);
+  entry->table_name = sqlite3_mprintf("%s", table_name);
+  entry->zoom_level = zoom_level;
+  entry->matrix = *matrix;
+  cache->next_entry = (cache->next_entry + 1) % TILE_MATRIX_CACHE_SIZE;
+  return SQLITE_OK;
+}
+
+static void tile_matrix_tile_envelope(const tile_matrix_t *matrix, int tile_column, int tile_row, geom_envelope_t *envelope) {
+  geom_envelope_init(envelope);
+  envelope->has_env_x = 1;
+  envelope->min_x = matrix->min_x + tile_column * matrix->tile_width;
+  envelope->max_x = envelope->min_x + matrix->tile_width;
+  envelope->has_env_y = 1;
+  envelope->max_y = matrix->max_y - tile_row * matrix->tile_height;
+  envelope->min_y = envelope->max_y - matrix->tile_height;
+}
+
+static void GPKG_TileBBox(sqlite3_context *context, int nbArgs, sqlite3_value **args) {
+  const char *table_name;
+  FUNCTION_INT_ARG(zoom_level);
+  FUNCTION_INT_ARG(tile_column);
+  FUNCTION_INT_ARG(tile_row);
+  tile_matrix_cache_t *cache;
+  tile_matrix_t matrix;
+  geom_envelope_t envelope;
+  geom_blob_writer_t writer;
+  int found = 0;
+
+  FUNCTION_START_STATIC(context, 256);
+  cache = (tile_matrix_cache_t *) sqlite3_user_data(context);
+
+  for (int i = 0; i < nbArgs; i++) {
+    if (sqlite3_value_type(args[i]) == SQLITE_NULL) {
+      sqlite3_result_null(context);
+      goto exit;
+    }
+  }
+  table_name = (const char *) sqlite3_value_text(args[0]);
+  FUNCTION_GET_INT_ARG(zoom_level, 1);
+  FUNCTION_GET_INT_ARG(tile_column, 2);
+  FUNCTION_GET_INT_ARG(tile_row, 3);
+
+  FUNCTION_RESULT = tile_matrix_lookup(cache, FUNCTION_DB_HANDLE, table_name, zoom_level, &matrix, &found, FUNCTION_ERROR);
+  if (FUNCTION_RESULT != SQLITE_OK) {
+    goto exit;
+  }
+  if (!found) {
+    error_append(FUNCTION_ERROR, "No tile matrix for zoom level %d of tiles table %s", zoom_level, table_name);
+    goto exit;
+  }
+
+  if (tile_column < 0 || tile_column >= matrix.matrix_width || tile_row < 0 || tile_row >= matrix.matrix_height) {
+    sqlite3_result_null(context);
+    goto exit;
+  }
+
+  tile_matrix_tile_envelope(&matrix, tile_column, tile_row, &envelope);
+  FUNCTION_RESULT = cache->spatialdb->writer_init_srid(&writer, matrix.srs_id);
+  if (FUNCTION_RESULT != SQLITE_OK) {
+    goto exit;
+  }
+  FUNCTION_RESULT = geom_envelope_write(&envelope, geom_blob_writer_geom_consumer(&writer), FUNCTION_ERROR);
+  if (FUNCTION_RESULT == SQLITE_OK) {
+    sqlite3_result_blob(context, geom_blob_writer_getdata(&writer), (int) geom_blob_writer_length(&writer), sqlite3_free);
+  }
+  cache->spatialdb->writer_destroy(&writer, FUNCTION_RESULT != SQLITE_OK);
+
+  FUNCTION_END(context);
+
+  FUNCTION_FREE_INT_ARG(zoom_level);
+  FUNCTION_FREE_INT_ARG(tile_column);
+  FUNCTION_FREE_INT_ARG(tile_row);
+}
+
+#ifdef TILE_MATRIX_HAVE_TABLE_FUNCTIONS
+
+#define COVERING_COLUMN_ZOOM_LEVEL 0
+#define COVERING_COLUMN_TILE_COLUMN 1
+#define COVERING_COLUMN_TILE_ROW 2
+#define COVERING_COLUMN_TILE_DATA 3
+#define COVERING_COLUMN_MIN_X 4
+#define COVERING_COLUMN_MIN_Y 5
+#define COVERING_COLUMN_MAX_X 6
+#define COVERING_COLUMN_MAX_Y 7
+#define COVERING_COLUMN_TABLE_NAME 8
+#define COVERING_COLUMN_ZOOM 9
+#define COVERING_COLUMN_GEOM 10
+
+#define COVERING_ARGS_ALL 7
+
+typedef struct {
+  sqlite3_vtab base;
+  sqlite3 *db;
+  tile_matrix_cache_t *cache;
+} covering_vtab_t;
+
+/*
+ * The cursor walks the tile columns intersecting the search area. next_stmt finds the next column that contains any
+ * tile of the zoom level, after which tiles_stmt returns the tiles of that column within the row range.
+ */
+typedef struct {
+  sqlite3_vtab_cursor base;
+  char *table_name;
+  sqlite3_stmt *next_stmt;
+  sqlite3_stmt *tiles_stmt;
+  sqlite3_value *geom;
+  tile_matrix_t matrix;
+  int zoom_level;
+  int tile_column;
+  int max_column;
+  int min_row;
+  int max_row;
+  int in_column;
+  int eof;
+} covering_cursor_t;
+
+static int covering_connect(sqlite3 *db, void *aux, int argc, const char *const *argv, sqlite3_vtab **vtab_out, char **err) {
+  int result = sqlite3_declare_vtab(
+                 db,
+                 "CREATE TABLE x(zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_data BLOB, "
+                 "min_x DOUBLE, min_y DOUBLE, max_x DOUBLE, max_y DOUBLE, "
+                 "table_name HIDDEN, zoom HIDDEN, geom HIDDEN)"
+               );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  covering_vtab_t *vtab = (covering_vtab_t *) sqlite3_malloc(sizeof(covering_vtab_t));
+  if (vtab == NULL) {
+    return SQLITE_NOMEM;
+  }
+  memset(vtab, 0, sizeof(covering_vtab_t));
+  vtab->db = db;
+  vtab->cache = (tile_matrix_cache_t *) aux;
+  *vtab_out = (sqlite3_vtab *) vtab;
+  return SQLITE_OK;
+}
+
+static int covering_disconnect(sqlite3_vtab *vtab) {
+  sqlite3_free(vtab);
+  return SQLITE_OK;
+}
+
+/*
+ * The table name, zoom level and geometry are passed to xFilter as arguments 1 to 3, so they are only used if all
+ * three are available. Constraints that depend on a table that has not been visited yet are not usable; returning
+ * SQLITE_CONSTRAINT makes SQLite try a different join order. Further equality constraints on the same column are left
+ * to SQLite, which checks them against the value returned by covering_column.
+ */
+static int covering_best_index(sqlite3_vtab *vtab, sqlite3_index_info *info) {
+  int usable[3] = {-1, -1, -1};
+  int unusable = 0;
+
+  for (int i = 0; i < info->nConstraint; i++) {
+    const struct sqlite3_index_constraint *constraint = &info->aConstraint[i];
+    if (constraint->op != SQLITE_INDEX_CONSTRAINT_EQ || constraint->iColumn < COVERING_COLUMN_TABLE_NAME) {
+      continue;
+    }
+    int arg = constraint->iColumn - COVERING_COLUMN_TABLE_NAME;
+    if (!constraint->usable) {
+      unusable |= 1 << arg;
+    } else if (usable[arg] < 0) {
+      usable[arg] = i;
+    }
+  }
+
+  if (usable[0] >= 0 && usable[1] >= 0 && usable[2] >= 0) {
+    for (int arg = 0; arg < 3; arg++) {
+      info->aConstraintUsage[usable[arg]].argvIndex = arg + 1;
+      info->aConstraintUsage[usable[arg]].omit = 1;
+    }
+    info->idxNum = COVERING_ARGS_ALL;
+    info->estimatedCost = 100.0;
+    return SQLITE_OK;
+  }
+
+  /* SQLITE_CONSTRAINT is accepted as 'no usable plan' since SQLite 3.21.0 */
+  if (unusable != 0 && sqlite3_libversion_number() >= 3021000) {
+    return SQLITE_CONSTRAINT;
+  }
+
+  /* Missing arguments are reported by covering_filter */
+  info->idxNum = 0;
+  info->estimatedCost = 1e99;
+  return SQLITE_OK;
+}
+
+static int covering_open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **cursor) {
+  covering_cursor_t *c = (covering_cursor_t *) sqlite3_malloc(sizeof(covering_cursor_t));
+  if (c == NULL) {
+    return SQLITE_NOMEM;
+  }
+  memset(c, 0, sizeof(covering_cursor_t));
+  c->eof = 1;
+  *cursor = (sqlite3_vtab_cursor *) c;
+  return SQLITE_OK;
+}
+
+static void covering_finalize(covering_cursor_t *c) {
+  sqlite3_finalize(c->next_stmt);
+  c->next_stmt = NULL;
+  sqlite3_finalize(c->tiles_stmt);
+  c->tiles_stmt = NULL;
+  sqlite3_free(c->table_name);
+  c->table_name = NULL;
+}
+
+static int covering_close(sqlite3_vtab_cursor *cursor) {
+  covering_cursor_t *c = (covering_cursor_t *) cursor;
+  covering_finalize(c);
+  sqlite3_value_free(c->geom);
+  sqlite3_free(c);
+  return SQLITE_OK;
+}
+
+static int covering_error(covering_vtab_t *vtab, int result, const char *message) {
+  sqlite3_free(vtab->base.zErrMsg);
+  vtab->base.zErrMsg = sqlite3_mprintf("%s", message);
+  return result;
+}
+
+static int covering_prepare(covering_cursor_t *c, covering_vtab_t *vtab, const char *table_name) {
+  if (c->table_name != NULL && strcmp(c->table_name, table_name) == 0) {
+    sqlite3_reset(c->next_stmt);
+    sqlite3_reset(c->tiles_stmt);
+    return SQLITE_OK;
+  }
+
+  covering_finalize(c);
+  c->table_name = sqlite3_mprintf("%s", table_name);
+  char *next_sql = sqlite3_mprintf(
+                     "SELECT tile_column FROM main.\"%w\" WHERE zoom_level = ?1 AND tile_column >= ?2 AND tile_column <= ?3 ORDER BY tile_column LIMIT 1",
+                     table_name
+                   );
+  char *tiles_sql = sqlite3_mprintf(
+                      "SELECT id, tile_row, tile_data FROM main.\"%w\" WHERE zoom_level = ?1 AND tile_column = ?2 AND tile_row >= ?3 AND tile_row <= ?4 ORDER BY tile_row",
+                      table_name
+                    );
+
+  int result = SQLITE_OK;
+  if (c->table_name == NULL || next_sql == NULL || tiles_sql == NULL) {
+    result = SQLITE_NOMEM;
+  }
+  if (result == SQLITE_OK) {
+    result = sqlite3_prepare_v2(vtab->db, next_sql, -1, &c->next_stmt, NULL);
+  }
+  if (result == SQLITE_OK) {
+    result = sqlite3_prepare_v2(vtab->db, tiles_sql, -1, &c->tiles_stmt, NULL);
+  }
+  if (result != SQLITE_OK && result != SQLITE_NOMEM) {
+    result = covering_error(vtab, result, sqlite3_errmsg(vtab->db));
+  }
+  sqlite3_free(next_sql);
+  sqlite3_free(tiles_sql);
+  if (result != SQLITE_OK) {
+    covering_finalize(c);
+  }
+  return result;
+}
+
+/*
+ * Advances to the next tile. Columns are only visited if next_stmt reports that they contain tiles, so sparse zoom
+ * levels do not cost a lookup for every column of the search area.
+ */
+static int covering_next(sqlite3_vtab_cursor *cursor) {
+  covering_cursor_t *c = (covering_cursor_t *) cursor;
+  covering_vtab_t *vtab = (covering_vtab_t *) cursor->pVtab;
+  int result;
+
+  while (!c->eof) {
+    if (c->in_column) {
+      result = sqlite3_step(c->tiles_stmt);
+      if (result == SQLITE_ROW) {
+        return SQLITE_OK;
+      }
+      sqlite3_reset(c->tiles_stmt);
+      c->in_column = 0;
+      if (result != SQLITE_DONE) {
+        c->eof = 1;
+        return covering_error(vtab, result, sqlite3_errmsg(vtab->db));
+      }
+      if (c->tile_column >= c->max_column) {
+        c->eof = 1;
+        break;
+      }
+      c->tile_column++;
+    }
+
+    sqlite3_bind_int(c->next_stmt, 1, c->zoom_level);
+    sqlite3_bind_int(c->next_stmt, 2, c->tile_column);
+    sqlite3_bind_int(c->next_stmt, 3, c->max_column);
+    result = sqlite3_step(c->next_stmt);
+    if (result == SQLITE_ROW) {
+      c->tile_column = sqlite3_column_int(c->next_stmt, 0);
+    }
+    sqlite3_reset(c->next_stmt);
+    if (result == SQLITE_DONE) {
+      c->eof = 1;
+    } else if (result != SQLITE_ROW) {
+      c->eof = 1;
+      return covering_error(vtab, result, sqlite3_errmsg(vtab->db));
+    } else {
+      sqlite3_bind_int(c->tiles_stmt, 1, c->zoom_level);
+      sqlite3_bind_int(c->tiles_stmt, 2, c->tile_column);
+      sqlite3_bind_int(c->tiles_stmt, 3, c->min_row);
+      sqlite3_bind_int(c->tiles_stmt, 4, c->max_row);
+      c->in_column = 1;
+    }
+  }
+  return SQLITE_OK;
+}
+
+/*
+ * Converts a coordinate range to the range of tile indices whose tiles intersect it. A range ending exactly on a tile
+ * boundary does not include the next tile, unless the range is a single value. A single value on the far edge of the
+ * matrix belongs to the last tile, just like one on the near edge belongs to the first.
+ */
+static int covering_range(double min, double max, double tile_size, int count, int *first, int *last) {
+  double first_index = floor(min / tile_size);
+  double last_index = ceil(max / tile_size) - 1;
+  if (min == max && min == count * tile_size) {
+    first_index = count - 1;
+  }
+  if (last_index < first_index) {
+    last_index = first_index;
+  }
+  if (last_index < 0 || first_index >= count) {
+    return 0;
+  }
+  *first = first_index < 0 ? 0 : (int) first_index;
+  *last = last_index >= count ? count - 1 : (int) last_index;
+  return 1;
+}
+
+static int covering_filter(sqlite3_vtab_cursor *cursor, int idx_num, const char *idx_str, int argc, sqlite3_value **argv) {
+  covering_cursor_t *c = (covering_cursor_t *) cursor;
+  covering_vtab_t *vtab = (covering_vtab_t *) cursor->pVtab;
+  char error_buffer[256];
+  errorstream_t error;
+  geom_blob_header_t header;
+  binstream_t stream;
+  int found = 0;
+  int result;
+
+  c->eof = 1;
+  c->in_column = 0;
+  sqlite3_value_free(c->geom);
+  c->geom = NULL;
+  if (idx_num != COVERING_ARGS_ALL || argc != 3) {
+    return covering_error(vtab, SQLITE_ERROR, "gpkg_tiles_covering requires a tiles table name, a zoom level and a geometry");
+  }
+
+  const char *table_name = (const char *) sqlite3_value_text(argv[0]);
+  const uint8_t *blob = (const uint8_t *) sqlite3_value_blob(argv[2]);
+  size_t length = (size_t) sqlite3_value_bytes(argv[2]);
+  if (table_name == NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL || blob == NULL || length == 0) {
+    return SQLITE_OK;
+  }
+  c->zoom_level = sqlite3_value_int(argv[1]);
+
+  error_init_fixed(&error, error_buffer, 256);
+  result = tile_matrix_lookup(vtab->cache, vtab->db, table_name, c->zoom_level, &c->matrix, &found, &error);
+  if (result == SQLITE_OK && !found) {
+    error_append(&error, "No tile matrix for zoom level %d of tiles table %s", c->zoom_level, table_name);
+    result = SQLITE_ERROR;
+  }
+  if (result == SQLITE_OK) {
+    binstream_init(&stream, (uint8_t *) blob, length);
+    result = vtab->cache->spatialdb->read_blob_header(&stream, &header, &error);
+    if (result == SQLITE_OK && !header.envelope.has_env_x) {
+      result = vtab->cache->spatialdb->fill_envelope(&stream, &header.envelope, &error);
+    }
+    binstream_destroy(&stream, 0);
+  }
+  if (result != SQLITE_OK) {
+    return covering_error(vtab, result, error_count(&error) > 0 ? error_message(&error) : "Invalid geometry blob header");
+  }
+
+  const geom_envelope_t *envelope = &header.envelope;
+  if (!envelope->has_env_x || !envelope->has_env_y) {
+    return SQLITE_OK;
+  }
+
+  const tile_matrix_t *matrix = &c->matrix;
+  if (!covering_range(envelope->min_x - matrix->min_x, envelope->max_x - matrix->min_x, matrix->tile_width, matrix->matrix_width, &c->tile_column, &c->max_column)
+      || !covering_range(matrix->max_y - envelope->max_y, matrix->max_y - envelope->min_y, matrix->tile_height, matrix->matrix_height, &c->min_row, &c->max_row)) {
+    return SQLITE_OK;
+  }
+
+  result = covering_prepare(c, vtab, table_name);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  c->geom = sqlite3_value_dup(argv[2]);
+  if (c->geom == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  c->eof = 0;
+  return covering_next(cursor);
+}
+
+static int covering_eof(sqlite3_vtab_cursor *cursor) {
+  covering_cursor_t *c = (covering_cursor_t *) cursor;
+  return c->eof;
+}
+
+static int covering_column(sqlite3_vtab_cursor *cursor, sqlite3_context *context, int column) {
+  covering_cursor_t *c = (covering_cursor_t *) cursor;
+  int tile_row = sqlite3_column_int(c->tiles_stmt, 1);
+  geom_envelope_t envelope;
+
+  switch (column) {
+    case COVERING_COLUMN_ZOOM_LEVEL:
+      sqlite3_result_int(context, c->zoom_level);
+      break;
+    case COVERING_COLUMN_TILE_COLUMN:
+      sqlite3_result_int(context, c->tile_column);
+      break;
+    case COVERING_COLUMN_TILE_ROW:
+      sqlite3_result_int(context, tile_row);
+      break;
+    case COVERING_COLUMN_TILE_DATA:
+      sqlite3_result_value(context, sqlite3_column_value(c->tiles_stmt, 2));
+      break;
+    case COVERING_COLUMN_MIN_X:
+    case COVERING_COLUMN_MIN_Y:
+    case COVERING_COLUMN_MAX_X:
+    case COVERING_COLUMN_MAX_Y:
+      tile_matrix_tile_envelope(&c->matrix, c->tile_column, tile_row, &envelope);
+      if (column == COVERING_COLUMN_MIN_X) {
+        sqlite3_result_double(context, envelope.min_x);
+      } else if (column == COVERING_COLUMN_MIN_Y) {
+        sqlite3_result_double(context, envelope.min_y);
+      } else if (column == COVERING_COLUMN_MAX_X) {
+        sqlite3_result_double(context, envelope.max_x);
+      } else {
+        sqlite3_result_double(context, envelope.max_y);
+      }
+      break;
+    case COVERING_COLUMN_TABLE_NAME:
+      sqlite3_result_text(context, c->table_name, -1, SQLITE_TRANSIENT);
+      break;
+    case COVERING_COLUMN_ZOOM:
+      sqlite3_result_int(context, c->zoom_level);
+      break;
+    case COVERING_COLUMN_GEOM:
+      sqlite3_result_value(context, c->geom);
+      break;
+    default:
+      sqlite3_result_null(context);
+      break;
+  }
+  return SQLITE_OK;
+}
+
+static int covering_rowid(sqlite3_vtab_cursor *cursor, sqlite3_int64 *rowid) {
+  covering_cursor_t *c = (covering_cursor_t *) cursor;
+  *rowid = sqlite3_column_int64(c->tiles_stmt, 0);
+  return SQLITE_OK;
+}
+
+static sqlite3_module covering_module = {
+  0,                   /* iVersion */
+  NULL,                /* xCreate */
+  covering_connect,    /* xConnect */
+  covering_best_index, /* xBestIndex */
+  covering_disconnect, /* xDisconnect */
+  NULL,                /* xDestroy */
+  covering_open,       /* xOpen */
+  covering_close,      /* xClose */
+  covering_filter,     /* xFilter */
+  covering_next,       /* xNext */
+  covering_eof,        /* xEof */
+  covering_column,     /* xColumn */
+  covering_rowid,      /* xRowid */
+  NULL,                /* xUpdate */
+  NULL,                /* xBegin */
+  NULL,                /* xSync */
+  NULL,                /* xCommit */
+  NULL,                /* xRollback */
+  NULL,                /* xFindFunction */
+  NULL                 /* xRename */
+};
+
+#endif
+
+void tile_matrix_init(sqlite3 *db, const spatialdb_t *spatialdb, errorstream_t *error) {
+  tile_matrix_cache_t *cache = (tile_matrix_cache_t *) sqlite3_malloc(sizeof(tile_matrix_cache_t));
+  if (cache == NULL) {
+    error_append(error, "Error registering tile matrix functions: out of memory");
+    return;
+  }
+  memset(cache, 0, sizeof(tile_matrix_cache_t));
+  cache->ref_count = 1;
+  cache->spatialdb = spatialdb;
+
+  /* SQLite calls the destructor if registration fails, so the cache is gone in that case */
+  if (sql_create_function(db, "gpkg_tile_bbox", GPKG_TileBBox, 4, 0, cache, tile_matrix_cache_release, error) != SQLITE_OK) {
+    return;
+  }
+
+#ifdef TILE_MATRIX_HAVE_TABLE_FUNCTIONS
+  /* Modules without xCreate are only usable as eponymous virtual tables, which were added in 3.9.0 */
+  if (sqlite3_libversion_number() >= 3009000) {
+    tile_matrix_cache_acquire(cache);
+    int result = sqlite3_create_module_v2(db, "gpkg_tiles_covering", &covering_module, cache, tile_matrix_cache_release);
+    if (result != SQLITE_OK) {
+      error_append(error, "Error registering module gpkg_tiles_covering: %s", sqlite3_errmsg(db));
+    }
+  }
+#endif
+}
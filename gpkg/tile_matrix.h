@@ -0,0 +1,53 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GPKG_TILE_MATRIX_H
+#define GPKG_TILE_MATRIX_H
+
+#include "error.h"
+#include "spatialdb.h"
+#include "sqlite.h"
+
+/**
+ * \addtogroup tile_matrix Tile matrix functions
+ *
+ * Functions that map between tile coordinates and the coordinate reference system of a tiles table in the main
+ * database, using its gpkg_tile_matrix_set and gpkg_tile_matrix rows.
+ *
+ * - gpkg_tile_bbox(table, zoom, column, row): the bounding box of a tile as a polygon, or NULL if the tile lies
+ *   outside the tile matrix
+ * - gpkg_tiles_covering(table, zoom, geom): a table valued function returning the existing tiles of a zoom level
+ *   that intersect the bounding box of geom, with columns zoom_level, tile_column, tile_row, tile_data, min_x, min_y,
+ *   max_x and max_y. Only tiles that are present in the tiles table are returned; they are looked up one tile column
+ *   at a time using the unique index on the tile coordinates, skipping columns without tiles.
+ *
+ * Example: SELECT tile_data, min_x, max_y FROM gpkg_tiles_covering('tiles', 12, ST_GeomFromText(:viewport, 3857))
+ *
+ * The tile matrix parameters are cached per connection until the database is modified. The table valued function
+ * is only available if SQLite is version 3.9.0 or later.
+ * @{
+ */
+
+/**
+ * Registers the tile matrix functions with a database connection.
+ * @param db the database connection
+ * @param spatialdb the spatial database schema used to read and write geometry blobs
+ * @param error the error stream to write errors to
+ */
+void tile_matrix_init(sqlite3 *db, const spatialdb_t *spatialdb, errorstream_t *error);
+
+/** @} */
+
+#endif
@@ -0,0 +1,553 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "error.h"
+#include "sqlite.h"
+#include "tile_dedup.h"
+#include "tile_reader.h"
+
+#define READER_ERROR_BUFFER_SIZE 256
+#define READER_MIN_BUCKETS 64
+
+typedef struct tile_entry_t {
+  /** @private */
+  struct tile_entry_t *next_in_bucket;
+  /** @private */
+  struct tile_entry_t *newer;
+  /** @private */
+  struct tile_entry_t *older;
+  /** @private */
+  unsigned int hash;
+  /** @private */
+  int zoom_level;
+  /** @private */
+  int tile_column;
+  /** @private */
+  int tile_row;
+  /** @private */
+  int missing;
+  /** @private */
+  size_t length;
+} tile_entry_t;
+
+#define ENTRY_DATA(entry) ((uint8_t *) ((entry) + 1))
+#define ENTRY_SIZE(length) (sizeof(tile_entry_t) + (length))
+
+struct gpkg_tile_reader_t {
+  /** @private */
+  sqlite3 *db;
+  /** @private */
+  char *db_name;
+  /** @private */
+  char *blob_table_name;
+  /** @private */
+  sqlite3_stmt *lookup_stmt;
+  /** @private */
+  sqlite3_stmt *version_stmt;
+  /** @private */
+  sqlite3_blob *blob;
+  /** @private */
+  uint8_t *buffer;
+  /** @private */
+  size_t buffer_capacity;
+  /** @private */
+  tile_entry_t **buckets;
+  /** @private */
+  size_t bucket_count;
+  /** @private */
+  size_t entry_count;
+  /** @private */
+  tile_entry_t *newest;
+  /** @private */
+  tile_entry_t *oldest;
+  /** @private */
+  size_t cache_bytes;
+  /** @private */
+  size_t cache_capacity;
+  /** @private */
+  int has_data_version;
+  /** @private */
+  sqlite3_int64 data_version;
+  /** @private */
+  int total_changes;
+  /** @private */
+  errorstream_t error;
+  /** @private */
+  char error_buffer[READER_ERROR_BUFFER_SIZE];
+};
+
+static unsigned int cache_hash(int zoom_level, int tile_column, int tile_row) {
+  uint32_t h = (uint32_t) zoom_level * 0x9E3779B1u;
+  h ^= (uint32_t) tile_column + 0x7F4A7C15u + (h << 6) + (h >> 2);
+  h ^= (uint32_t) tile_row + 0x7F4A7C15u + (h << 6) + (h >> 2);
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  h ^= h >> 13;
+  return h;
+}
+
+static void cache_unlink_lru(gpkg_tile_reader_t *reader, tile_entry_t *entry) {
+  if (entry->newer != NULL) {
+    entry->newer->older = entry->older;
+  } else {
+    reader->newest = entry->older;
+  }
+  if (entry->older != NULL) {
+    entry->older->newer = entry->newer;
+  } else {
+    reader->oldest = entry->newer;
+  }
+  entry->newer = NULL;
+  entry->older = NULL;
+}
+
+static void cache_link_newest(gpkg_tile_reader_t *reader, tile_entry_t *entry) {
+  entry->newer = NULL;
+  entry->older = reader->newest;
+  if (reader->newest != NULL) {
+    reader->newest->newer = entry;
+  } else {
+    reader->oldest = entry;
+  }
+  reader->newest = entry;
+}
+
+static void cache_clear(gpkg_tile_reader_t *reader) {
+  tile_entry_t *entry = reader->newest;
+  while (entry != NULL) {
+    tile_entry_t *older = entry->older;
+    sqlite3_free(entry);
+    entry = older;
+  }
+
+  if (reader->buckets != NULL) {
+    memset(reader->buckets, 0, reader->bucket_count * sizeof(tile_entry_t *));
+  }
+  reader->newest = NULL;
+  reader->oldest = NULL;
+  reader->entry_count = 0;
+  reader->cache_bytes = 0;
+}
+
+static tile_entry_t *cache_find(gpkg_tile_reader_t *reader, int zoom_level, int tile_column, int tile_row) {
+  if (reader->entry_count == 0) {
+    return NULL;
+  }
+
+  unsigned int hash = cache_hash(zoom_level, tile_column, tile_row);
+  tile_entry_t *entry = reader->buckets[hash & (reader->bucket_count - 1)];
+  while (entry != NULL) {
+    if (entry->hash == hash && entry->zoom_level == zoom_level && entry->tile_column == tile_column && entry->tile_row == tile_row) {
+      return entry;
+    }
+    entry = entry->next_in_bucket;
+  }
+  return NULL;
+}
+
+static void cache_remove(gpkg_tile_reader_t *reader, tile_entry_t *entry) {
+  tile_entry_t **link = &reader->buckets[entry->hash & (reader->bucket_count - 1)];
+  while (*link != entry) {
+    link = &(*link)->next_in_bucket;
+  }
+  *link = entry->next_in_bucket;
+
+  cache_unlink_lru(reader, entry);
+  reader->entry_count--;
+  reader->cache_bytes -= ENTRY_SIZE(entry->length);
+  sqlite3_free(entry);
+}
+
+static int cache_rehash(gpkg_tile_reader_t *reader) {
+  size_t bucket_count = reader->bucket_count == 0 ? READER_MIN_BUCKETS : reader->bucket_count * 2;
+  if (bucket_count * sizeof(tile_entry_t *) > 0x7FFFFFFF) {
+    return SQLITE_NOMEM;
+  }
+
+  tile_entry_t **buckets = (tile_entry_t **) sqlite3_malloc((int) (bucket_count * sizeof(tile_entry_t *)));
+  if (buckets == NULL) {
+    return SQLITE_NOMEM;
+  }
+  memset(buckets, 0, bucket_count * sizeof(tile_entry_t *));
+
+  for (tile_entry_t *entry = reader->newest; entry != NULL; entry = entry->older) {
+    size_t bucket = entry->hash & (bucket_count - 1);
+    entry->next_in_bucket = buckets[bucket];
+    buckets[bucket] = entry;
+  }
+
+  sqlite3_free(reader->buckets);
+  reader->buckets = buckets;
+  reader->bucket_count = bucket_count;
+  return SQLITE_OK;
+}
+
+/*
+ * Allocates a cache entry with room for length bytes of tile data and links it into the cache, evicting the least
+ * recently used entries to make room. Returns NULL if the tile is too large to be cached or if memory is exhausted;
+ * neither is an error since the tile can still be read into the reader buffer.
+ */
+static tile_entry_t *cache_insert(gpkg_tile_reader_t *reader, int zoom_level, int tile_column, int tile_row, size_t length) {
+  size_t size = ENTRY_SIZE(length);
+  if (size > reader->cache_capacity || size > 0x7FFFFFFF) {
+    return NULL;
+  }
+
+  if (reader->entry_count >= reader->bucket_count && cache_rehash(reader) != SQLITE_OK && reader->bucket_count == 0) {
+    return NULL;
+  }
+
+  while (reader->oldest != NULL && reader->cache_bytes + size > reader->cache_capacity) {
+    cache_remove(reader, reader->oldest);
+  }
+
+  tile_entry_t *entry = (tile_entry_t *) sqlite3_malloc((int) size);
+  if (entry == NULL) {
+    return NULL;
+  }
+
+  entry->hash = cache_hash(zoom_level, tile_column, tile_row);
+  entry->zoom_level = zoom_level;
+  entry->tile_column = tile_column;
+  entry->tile_row = tile_row;
+  entry->missing = 0;
+  entry->length = length;
+
+  size_t bucket = entry->hash & (reader->bucket_count - 1);
+  entry->next_in_bucket = reader->buckets[bucket];
+  reader->buckets[bucket] = entry;
+  cache_link_newest(reader, entry);
+  reader->entry_count++;
+  reader->cache_bytes += size;
+  return entry;
+}
+
+/*
+ * Drops all cached tiles if the database may have changed since they were read. Changes made through this connection
+ * are detected using the total change count. Changes committed by other connections are detected using
+ * PRAGMA data_version, which is only meaningful at the start of a read transaction; it is checked whenever the reader
+ * does not hold a blob handle and right after a new one has been opened. SQLite versions that do not support the
+ * pragma return no rows, in which case the cache cannot outlive a read transaction.
+ */
+static int reader_check_version(gpkg_tile_reader_t *reader) {
+  int result = sqlite3_step(reader->version_stmt);
+  if (result == SQLITE_ROW) {
+    sqlite3_int64 data_version = sqlite3_column_int64(reader->version_stmt, 0);
+    if (!reader->has_data_version || data_version != reader->data_version) {
+      cache_clear(reader);
+    }
+    reader->has_data_version = 1;
+    reader->data_version = data_version;
+    result = SQLITE_OK;
+  } else if (result == SQLITE_DONE) {
+    cache_clear(reader);
+    result = SQLITE_OK;
+  } else {
+    error_append(&reader->error, "%s", sqlite3_errmsg(reader->db));
+  }
+  sqlite3_reset(reader->version_stmt);
+  return result;
+}
+
+static void reader_check_changes(gpkg_tile_reader_t *reader) {
+  int total_changes = sqlite3_total_changes(reader->db);
+  if (total_changes != reader->total_changes) {
+    cache_clear(reader);
+    reader->total_changes = total_changes;
+  }
+}
+
+static int reader_grow_buffer(gpkg_tile_reader_t *reader, size_t required) {
+  if (required <= reader->buffer_capacity) {
+    return SQLITE_OK;
+  }
+
+  size_t new_capacity = reader->buffer_capacity == 0 ? 4096 : reader->buffer_capacity;
+  while (new_capacity < required) {
+    new_capacity = (new_capacity * 3) / 2;
+  }
+
+  if (new_capacity > 0x7FFFFFFF) {
+    return SQLITE_NOMEM;
+  }
+
+  uint8_t *new_buffer = (uint8_t *) sqlite3_realloc(reader->buffer, (int) new_capacity);
+  if (new_buffer == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  reader->buffer = new_buffer;
+  reader->buffer_capacity = new_capacity;
+  return SQLITE_OK;
+}
+
+/*
+ * Points the blob handle at a row. An existing handle is moved using sqlite3_blob_reopen, which avoids compiling the
+ * internal statement sqlite3_blob_open uses. If that fails, for instance because the handle expired after the row it
+ * pointed to was modified, a new handle is opened.
+ */
+static int reader_open_blob(gpkg_tile_reader_t *reader, sqlite3_int64 rowid, int *opened) {
+  *opened = 0;
+
+  if (reader->blob != NULL) {
+    if (sqlite3_blob_reopen(reader->blob, rowid) == SQLITE_OK) {
+      return SQLITE_OK;
+    }
+    sqlite3_blob_close(reader->blob);
+    reader->blob = NULL;
+  }
+
+  int result = sqlite3_blob_open(reader->db, reader->db_name, reader->blob_table_name, "tile_data", rowid, 0, &reader->blob);
+  if (result != SQLITE_OK) {
+    error_append(&reader->error, "%s", sqlite3_errmsg(reader->db));
+    sqlite3_blob_close(reader->blob);
+    reader->blob = NULL;
+    return result;
+  }
+
+  *opened = 1;
+  return SQLITE_OK;
+}
+
+static gpkg_tile_reader_t *reader_init(sqlite3 *db) {
+  gpkg_tile_reader_t *reader = (gpkg_tile_reader_t *) sqlite3_malloc(sizeof(gpkg_tile_reader_t));
+  if (reader == NULL) {
+    return NULL;
+  }
+
+  memset(reader, 0, sizeof(gpkg_tile_reader_t));
+  error_init_fixed(&reader->error, reader->error_buffer, READER_ERROR_BUFFER_SIZE);
+  reader->db = db;
+  return reader;
+}
+
+GPKG_EXPORT int GPKG_CALL gpkg_tile_reader_open(sqlite3 *db, const char *db_name, const char *table_name, size_t cache_size, gpkg_tile_reader_t **reader_out) {
+  int result = SQLITE_OK;
+  int dedup = 0;
+  char *sql = NULL;
+  char *lookup_table_name = NULL;
+  const char *lookup_column_name;
+
+  gpkg_tile_reader_t *reader = reader_init(db);
+  *reader_out = reader;
+  if (reader == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  if (db_name == NULL) {
+    db_name = "main";
+  }
+
+  reader->db_name = sqlite3_mprintf("%s", db_name);
+  if (reader->db_name == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  result = tile_dedup_enabled(db, db_name, table_name, &dedup);
+  if (result != SQLITE_OK) {
+    error_append(&reader->error, "%s", sqlite3_errmsg(db));
+    goto exit;
+  }
+
+  // Deduplicated tiles are read from the blob table, after looking up the blob referenced by the tile coordinates
+  if (dedup) {
+    reader->blob_table_name = sqlite3_mprintf(TILE_DEDUP_BLOBS_TABLE, table_name);
+    lookup_table_name = sqlite3_mprintf(TILE_DEDUP_TILES_TABLE, table_name);
+    lookup_column_name = "blob_id";
+  } else {
+    reader->blob_table_name = sqlite3_mprintf("%s", table_name);
+    lookup_table_name = sqlite3_mprintf("%s", table_name);
+    lookup_column_name = "rowid";
+  }
+  if (reader->blob_table_name == NULL || lookup_table_name == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  sql = sqlite3_mprintf("SELECT %s FROM \"%w\".\"%w\" WHERE zoom_level = ?1 AND tile_column = ?2 AND tile_row = ?3", lookup_column_name, db_name, lookup_table_name);
+  if (sql == NULL) {
+    result = SQLITE_NOMEM;
+    goto exit;
+  }
+
+  result = sqlite3_prepare_v2(db, sql, -1, &reader->lookup_stmt, NULL);
+  if (result != SQLITE_OK) {
+    error_append(&reader->error, "%s", sqlite3_errmsg(db));
+    goto exit;
+  }
+
+  if (cache_size > 0) {
+    sqlite3_free(sql);
+    sql = sqlite3_mprintf("PRAGMA \"%w\".data_version", db_name);
+    if (sql == NULL) {
+      result = SQLITE_NOMEM;
+      goto exit;
+    }
+
+    result = sqlite3_prepare_v2(db, sql, -1, &reader->version_stmt, NULL);
+    if (result != SQLITE_OK) {
+      error_append(&reader->error, "%s", sqlite3_errmsg(db));
+      goto exit;
+    }
+
+    reader->cache_capacity = cache_size;
+    reader->total_changes = sqlite3_total_changes(db);
+  }
+
+exit:
+  sqlite3_free(sql);
+  sqlite3_free(lookup_table_name);
+  return result;
+}
+
+GPKG_EXPORT int GPKG_CALL gpkg_tile_reader_read(gpkg_tile_reader_t *reader, int zoom_level, int tile_column, int tile_row, const void **data, size_t *length) {
+  int result;
+  int opened;
+  sqlite3_int64 rowid;
+  tile_entry_t *entry = NULL;
+  uint8_t *target;
+  size_t tile_length;
+
+  *data = NULL;
+  *length = 0;
+
+  if (reader->lookup_stmt == NULL) {
+    return SQLITE_MISUSE;
+  }
+
+  error_reset(&reader->error);
+
+  if (reader->cache_capacity > 0) {
+    reader_check_changes(reader);
+    if (reader->blob == NULL) {
+      result = reader_check_version(reader);
+      if (result != SQLITE_OK) {
+        return result;
+      }
+    }
+
+    entry = cache_find(reader, zoom_level, tile_column, tile_row);
+    if (entry != NULL) {
+      cache_unlink_lru(reader, entry);
+      cache_link_newest(reader, entry);
+      if (entry->missing) {
+        return SQLITE_DONE;
+      }
+      *data = ENTRY_DATA(entry);
+      *length = entry->length;
+      return SQLITE_ROW;
+    }
+  }
+
+  sqlite3_bind_int(reader->lookup_stmt, 1, zoom_level);
+  sqlite3_bind_int(reader->lookup_stmt, 2, tile_column);
+  sqlite3_bind_int(reader->lookup_stmt, 3, tile_row);
+
+  result = sqlite3_step(reader->lookup_stmt);
+  if (result == SQLITE_DONE) {
+    sqlite3_reset(reader->lookup_stmt);
+    if (reader->cache_capacity > 0) {
+      entry = cache_insert(reader, zoom_level, tile_column, tile_row, 0);
+      if (entry != NULL) {
+        entry->missing = 1;
+      }
+    }
+    return SQLITE_DONE;
+  } else if (result != SQLITE_ROW) {
+    error_append(&reader->error, "%s", sqlite3_errmsg(reader->db));
+    sqlite3_reset(reader->lookup_stmt);
+    return result;
+  }
+
+  rowid = sqlite3_column_int64(reader->lookup_stmt, 0);
+
+  /* Keep the lookup statement active until the blob handle is open so both see the same read transaction */
+  result = reader_open_blob(reader, rowid, &opened);
+  sqlite3_reset(reader->lookup_stmt);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  if (opened && reader->cache_capacity > 0) {
+    result = reader_check_version(reader);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+  }
+
+  tile_length = (size_t) sqlite3_blob_bytes(reader->blob);
+  if (reader->cache_capacity > 0) {
+    entry = cache_insert(reader, zoom_level, tile_column, tile_row, tile_length);
+  }
+
+  if (entry != NULL) {
+    target = ENTRY_DATA(entry);
+  } else {
+    result = reader_grow_buffer(reader, tile_length);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    target = reader->buffer;
+  }
+
+  result = sqlite3_blob_read(reader->blob, target, (int) tile_length, 0);
+  if (result != SQLITE_OK) {
+    error_append(&reader->error, "%s", sqlite3_errmsg(reader->db));
+    if (entry != NULL) {
+      cache_remove(reader, entry);
+    }
+    sqlite3_blob_close(reader->blob);
+    reader->blob = NULL;
+    return result;
+  }
+
+  *data = target;
+  *length = tile_length;
+  return SQLITE_ROW;
+}
+
+GPKG_EXPORT void GPKG_CALL gpkg_tile_reader_release(gpkg_tile_reader_t *reader) {
+  if (reader->blob != NULL) {
+    sqlite3_blob_close(reader->blob);
+    reader->blob = NULL;
+  }
+}
+
+GPKG_EXPORT const char *GPKG_CALL gpkg_tile_reader_errmsg(gpkg_tile_reader_t *reader) {
+  if (reader == NULL) {
+    return "out of memory";
+  }
+  return error_message(&reader->error);
+}
+
+GPKG_EXPORT void GPKG_CALL gpkg_tile_reader_close(gpkg_tile_reader_t *reader) {
+  if (reader == NULL) {
+    return;
+  }
+
+  sqlite3_blob_close(reader->blob);
+  sqlite3_finalize(reader->lookup_stmt);
+  sqlite3_finalize(reader->version_stmt);
+  cache_clear(reader);
+  sqlite3_free(reader->buckets);
+  sqlite3_free(reader->buffer);
+  sqlite3_free(reader->db_name);
+  sqlite3_free(reader->blob_table_name);
+  error_destroy(&reader->error);
+  sqlite3_free(reader);
+}
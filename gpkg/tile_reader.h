@@ -0,0 +1,106 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GPKG_TILE_READER_H
+#define GPKG_TILE_READER_H
+
+#include <stddef.h>
+#include "gpkg.h"
+
+/**
+ * \addtogroup tile_reader Tile readers
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Reads tiles from a tile pyramid user data table by zoom level, tile column and tile row.
+ *
+ * The tile lookup is prepared once and tile data is read using an incremental blob handle that is moved from row to
+ * row, so no statement is compiled and no result value is materialized per tile. Optionally the most recently used
+ * tiles are kept in a cache that is bounded by the total size of the cached tile data.
+ *
+ * While the blob handle is open the connection holds a read transaction. In rollback journal mode this blocks writers,
+ * and in WAL mode changes committed by other connections do not become visible. Call gpkg_tile_reader_release()
+ * periodically, for instance after each batch of requests, to end that transaction. Releasing after every request
+ * works as well, but then each read that misses the cache opens a new blob handle, which costs about as much as
+ * preparing a statement. The cache is validated against
+ * PRAGMA data_version and the change count of the connection whenever a new read transaction starts, so cached tiles
+ * never outlive a change to the database.
+ *
+ * Tiles tables that use deduplicated storage are supported as well. The tile lookup then yields the row of the shared
+ * tile blob, which the blob handle reads from.
+ */
+typedef struct gpkg_tile_reader_t gpkg_tile_reader_t;
+
+/**
+ * Opens a tile reader on a tiles table.
+ *
+ * Even when this function fails a reader handle will usually be returned which can be passed to
+ * gpkg_tile_reader_errmsg(). In all cases the reader should be closed using gpkg_tile_reader_close().
+ *
+ * @param db the database handle
+ * @param db_name the database name (e.g. "main")
+ * @param table_name the name of the tiles table
+ * @param cache_size the maximum number of bytes of tile data to cache, or 0 to disable caching
+ * @param[out] reader the new reader
+ * @return SQLITE_OK on success, an error code otherwise
+ */
+GPKG_EXPORT int GPKG_CALL gpkg_tile_reader_open(sqlite3 *db, const char *db_name, const char *table_name, size_t cache_size, gpkg_tile_reader_t **reader);
+
+/**
+ * Reads a single tile. The returned data is owned by the reader and remains valid until the next call to any
+ * function on the reader.
+ *
+ * @param reader the reader
+ * @param zoom_level the zoom level of the tile
+ * @param tile_column the column of the tile
+ * @param tile_row the row of the tile
+ * @param[out] data receives a pointer to the tile data
+ * @param[out] length receives the length of the tile data in bytes
+ * @return SQLITE_ROW if the tile exists, SQLITE_DONE if it does not, an error code otherwise
+ */
+GPKG_EXPORT int GPKG_CALL gpkg_tile_reader_read(gpkg_tile_reader_t *reader, int zoom_level, int tile_column, int tile_row, const void **data, size_t *length);
+
+/**
+ * Closes the blob handle of the reader, ending the read transaction it holds. The next read that is not answered from
+ * the cache reopens it.
+ * @param reader the reader
+ */
+GPKG_EXPORT void GPKG_CALL gpkg_tile_reader_release(gpkg_tile_reader_t *reader);
+
+/**
+ * Returns a description of the last error that occurred.
+ * @param reader the reader
+ * @return an error message
+ */
+GPKG_EXPORT const char *GPKG_CALL gpkg_tile_reader_errmsg(gpkg_tile_reader_t *reader);
+
+/**
+ * Closes a reader and releases all of its resources.
+ * @param reader the reader to close. May be NULL.
+ */
+GPKG_EXPORT void GPKG_CALL gpkg_tile_reader_close(gpkg_tile_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+
+#endif
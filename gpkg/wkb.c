@@ -242,8 +242,79 @@ static int read_point(binstream_t *stream, wkb_dialect dialect, const geom_consu
 }
 
 #define COORD_BATCH_SIZE 10
+#define POINT_BATCH_SIZE 64
 
-static int read_points(binstream_t *stream, wkb_dialect dialect, const geom_consumer_t *consumer, const geom_header_t *header, uint32_t point_count, errorstream_t *error) {
+static uint64_t decode_u64_le(const uint8_t *data) {
+  return ((uint64_t) data[0] << 0) | ((uint64_t) data[1] << 8) | ((uint64_t) data[2] << 16) | ((uint64_t) data[3] << 24)
+         | ((uint64_t) data[4] << 32) | ((uint64_t) data[5] << 40) | ((uint64_t) data[6] << 48) | ((uint64_t) data[7] << 56);
+}
+
+static uint64_t decode_u64_be(const uint8_t *data) {
+  return ((uint64_t) data[7] << 0) | ((uint64_t) data[6] << 8) | ((uint64_t) data[5] << 16) | ((uint64_t) data[4] << 24)
+         | ((uint64_t) data[3] << 32) | ((uint64_t) data[2] << 40) | ((uint64_t) data[1] << 48) | ((uint64_t) data[0] << 56);
+}
+
+static double decode_double_le(const uint8_t *data) {
+  uint64_t bits = decode_u64_le(data);
+  double value;
+  memcpy(&value, &bits, sizeof(double));
+  return value;
+}
+
+static double decode_double_be(const uint8_t *data) {
+  uint64_t bits = decode_u64_be(data);
+  double value;
+  memcpy(&value, &bits, sizeof(double));
+  return value;
+}
+
+/*
+ * Coordinate readers specialized for a single coordinate size and byte order. The stream length is checked once for
+ * the whole point sequence, after which the coordinates are decoded straight from the stream buffer in batches of
+ * POINT_BATCH_SIZE points. Because the coordinate size and the byte order are constants, the decode loop compiles
+ * down to plain loads (and byte swaps for the non-native order) without any per value branching.
+ */
+#define WKB_POINT_READER(name, coord_size, decode) \
+static int name(binstream_t *stream, const geom_consumer_t *consumer, const geom_header_t *header, uint32_t point_count, errorstream_t *error) { \
+  double coord[(coord_size) * POINT_BATCH_SIZE]; \
+  size_t point_length = (coord_size) * sizeof(double); \
+\
+  if (binstream_available(stream) / point_length < point_count) { \
+    if (error) { \
+      error_append(error, "Error reading point coordinates"); \
+    } \
+    return SQLITE_IOERR; \
+  } \
+\
+  const uint8_t *data = binstream_data(stream); \
+  uint32_t remaining = point_count; \
+  while (remaining > 0) { \
+    uint32_t points_to_read = remaining > POINT_BATCH_SIZE ? POINT_BATCH_SIZE : remaining; \
+    for (uint32_t i = 0; i < points_to_read * (coord_size); i++) { \
+      coord[i] = decode(data + i * sizeof(double)); \
+    } \
+    data += points_to_read * point_length; \
+\
+    int result = consumer->coordinates(consumer, header, points_to_read, coord, 0, error); \
+    if (result != SQLITE_OK) { \
+      return result; \
+    } \
+    remaining -= points_to_read; \
+  } \
+\
+  return binstream_seek(stream, binstream_position(stream) + point_count * point_length); \
+}
+
+WKB_POINT_READER(read_points_xy_le, 2, decode_double_le)
+WKB_POINT_READER(read_points_xy_be, 2, decode_double_be)
+WKB_POINT_READER(read_points_xyz_le, 3, decode_double_le)
+WKB_POINT_READER(read_points_xyz_be, 3, decode_double_be)
+WKB_POINT_READER(read_points_xyzm_le, 4, decode_double_le)
+WKB_POINT_READER(read_points_xyzm_be, 4, decode_double_be)
+
+#undef WKB_POINT_READER
+
+static int read_points_generic(binstream_t *stream, wkb_dialect dialect, const geom_consumer_t *consumer, const geom_header_t *header, uint32_t point_count, errorstream_t *error) {
   int result;
   double coord[GEOM_MAX_COORD_SIZE * COORD_BATCH_SIZE];
   int max_coords_to_read = COORD_BATCH_SIZE;
@@ -288,6 +359,35 @@ static int read_points(binstream_t *stream, wkb_dialect dialect, const geom_cons
   return SQLITE_OK;
 }
 
+static int generic_point_reader = 0;
+
+void wkb_set_generic_point_reader(int generic) {
+  generic_point_reader = generic;
+}
+
+static int read_points(binstream_t *stream, wkb_dialect dialect, const geom_consumer_t *consumer, const geom_header_t *header, uint32_t point_count, errorstream_t *error) {
+  /*
+   * Circular strings repeat the last point of each batch as the first point of the next one, so they go through the
+   * generic reader. Dialects only differ in how the byte order is determined, which has already been applied to the
+   * stream at this point.
+   */
+  if (header->geom_type == GEOM_CIRCULARSTRING || generic_point_reader) {
+    return read_points_generic(stream, dialect, consumer, header, point_count, error);
+  }
+
+  int little_endian = binstream_get_endianness(stream) == LITTLE;
+  switch (header->coord_size) {
+    case 2:
+      return (little_endian ? read_points_xy_le : read_points_xy_be)(stream, consumer, header, point_count, error);
+    case 3:
+      return (little_endian ? read_points_xyz_le : read_points_xyz_be)(stream, consumer, header, point_count, error);
+    case 4:
+      return (little_endian ? read_points_xyzm_le : read_points_xyzm_be)(stream, consumer, header, point_count, error);
+    default:
+      return read_points_generic(stream, dialect, consumer, header, point_count, error);
+  }
+}
+
 static int read_linearring(binstream_t *stream, wkb_dialect dialect, const geom_consumer_t *consumer, const geom_header_t *header, errorstream_t *error) {
   int result = SQLITE_OK;
 
@@ -841,6 +941,13 @@ int wkb_writer_init(wkb_writer_t *writer, wkb_dialect dialect) {
   return SQLITE_OK;
 }
 
+void wkb_writer_reset(wkb_writer_t *writer) {
+  binstream_reset(&writer->stream);
+  memset(writer->start, 0, GEOM_MAX_DEPTH * sizeof(size_t));
+  memset(writer->children, 0, GEOM_MAX_DEPTH * sizeof(size_t));
+  writer->offset = -1;
+}
+
 geom_consumer_t *wkb_writer_geom_consumer(wkb_writer_t *writer) {
   return &writer->geom_consumer;
 }
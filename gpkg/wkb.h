@@ -56,6 +56,13 @@ typedef struct {
  */
 int wkb_writer_init(wkb_writer_t *writer, wkb_dialect dialect);
 
+/**
+ * Resets a Well-Known Binary writer so it can be used to write another geometry. The internal buffer of the writer is
+ * retained, which avoids allocating a new buffer for each geometry.
+ * @param writer the writer to reset
+ */
+void wkb_writer_reset(wkb_writer_t *writer);
+
 /**
  * Destroys a Well-Known Binary writer.
  * @param writer the writer to destroy
@@ -119,6 +126,16 @@ int wkb_fill_envelope(binstream_t *stream, wkb_dialect dialect, geom_envelope_t
 
 int wkb_fill_geom_header(uint32_t wkb_type, geom_header_t *header, errorstream_t *error);
 
+/**
+ * Selects the coordinate reader used by wkb_read_geometry() and wkb_fill_envelope(). Coordinates are normally decoded
+ * by readers specialized per coordinate size and byte order. Passing a non-zero value makes all coordinates go through
+ * the generic reader instead, which is only meant for comparing both readers in benchmarks. This setting is process
+ * wide and should not be changed while other threads are reading WKB.
+ *
+ * @param generic non-zero to force the generic coordinate reader, zero to use the specialized readers
+ */
+void wkb_set_generic_point_reader(int generic);
+
 /** @} */
 
 #endif
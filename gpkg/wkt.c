@@ -217,6 +217,13 @@ int wkt_writer_init(wkt_writer_t *writer) {
   return SQLITE_OK;
 }
 
+void wkt_writer_reset(wkt_writer_t *writer) {
+  strbuf_reset(&writer->strbuf);
+  memset(writer->type, 0, GEOM_MAX_DEPTH * sizeof(int));
+  memset(writer->children, 0, GEOM_MAX_DEPTH * sizeof(int));
+  writer->offset = -1;
+}
+
 geom_consumer_t *wkt_writer_geom_consumer(wkt_writer_t *writer) {
   return &writer->geom_consumer;
 }
@@ -54,6 +54,13 @@ typedef struct {
  */
 int wkt_writer_init(wkt_writer_t *writer);
 
+/**
+ * Resets a Well-Known Text writer so it can be used to write another geometry. The internal buffer of the writer is
+ * retained.
+ * @param writer the writer to reset
+ */
+void wkt_writer_reset(wkt_writer_t *writer);
+
 /**
  * Destroys a Well-Known Text writer.
  * @param writer the writer to destroy
@@ -0,0 +1,292 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string.h>
+#include "sqlite.h"
+#include "writer_pool.h"
+
+#define SLOT_EMPTY 0
+#define SLOT_IDLE 1
+#define SLOT_BUSY 2
+
+/*
+ * Every TRIM_INTERVAL releases, idle writers whose buffer is more than TRIM_FACTOR times larger than the largest
+ * result written since the previous check are freed. This prevents a single huge geometry from pinning memory for the
+ * lifetime of the connection.
+ */
+#define TRIM_INTERVAL 64
+#define TRIM_FACTOR 4
+#define TRIM_MIN_CAPACITY (16 * 1024)
+
+typedef union {
+  size_t size;
+  double align;
+} block_header_t;
+
+static size_t wkb_capacity(wkb_writer_t *writer) {
+  return writer->stream.capacity;
+}
+
+static size_t wkt_capacity(wkt_writer_t *writer) {
+  return writer->strbuf.capacity;
+}
+
+static int slot_should_trim(writer_slot_t *slot, size_t capacity) {
+  return slot->state == SLOT_IDLE && capacity > TRIM_MIN_CAPACITY && capacity > TRIM_FACTOR * slot->high_water;
+}
+
+static void writer_pool_trim(writer_pool_t *pool) {
+  pool->releases++;
+  if (pool->releases % TRIM_INTERVAL != 0) {
+    return;
+  }
+
+  if (slot_should_trim(&pool->wkb_slot, wkb_capacity(&pool->wkb))) {
+    wkb_writer_destroy(&pool->wkb, 1);
+    pool->wkb_slot.state = SLOT_EMPTY;
+  }
+  if (slot_should_trim(&pool->wkt_slot, wkt_capacity(&pool->wkt))) {
+    wkt_writer_destroy(&pool->wkt);
+    pool->wkt_slot.state = SLOT_EMPTY;
+  }
+  if (slot_should_trim(&pool->blob_slot, wkb_capacity(&pool->blob.wkb_writer))) {
+    pool->spatialdb->writer_destroy(&pool->blob, 1);
+    pool->blob_slot.state = SLOT_EMPTY;
+  }
+
+  pool->wkb_slot.high_water = 0;
+  pool->wkt_slot.high_water = 0;
+  pool->blob_slot.high_water = 0;
+}
+
+static void slot_release(writer_pool_t *pool, writer_slot_t *slot, size_t capacity, size_t length, int transferred) {
+  if (transferred) {
+    pool->stats.transferred++;
+    slot->state = SLOT_EMPTY;
+    return;
+  }
+
+  if (capacity != slot->capacity) {
+    pool->stats.allocated++;
+    slot->capacity = capacity;
+  }
+  if (length > capacity) {
+    length = capacity;
+  }
+  if (length > slot->high_water) {
+    slot->high_water = length;
+  }
+  slot->state = SLOT_IDLE;
+}
+
+void writer_pool_init(writer_pool_t *pool, const spatialdb_t *spatialdb) {
+  memset(pool, 0, sizeof(writer_pool_t));
+  pool->spatialdb = spatialdb;
+}
+
+void writer_pool_destroy(writer_pool_t *pool) {
+  if (pool->wkb_slot.state != SLOT_EMPTY) {
+    wkb_writer_destroy(&pool->wkb, 1);
+  }
+  if (pool->wkt_slot.state != SLOT_EMPTY) {
+    wkt_writer_destroy(&pool->wkt);
+  }
+  if (pool->blob_slot.state != SLOT_EMPTY) {
+    pool->spatialdb->writer_destroy(&pool->blob, 1);
+  }
+  for (int i = 0; i < pool->block_count; i++) {
+    sqlite3_free(pool->blocks[i]);
+    pool->blocks[i] = NULL;
+  }
+  pool->block_count = 0;
+  pool->wkb_slot.state = SLOT_EMPTY;
+  pool->wkt_slot.state = SLOT_EMPTY;
+  pool->blob_slot.state = SLOT_EMPTY;
+}
+
+wkb_writer_t *writer_pool_wkb_acquire(writer_pool_t *pool, wkb_writer_t *fallback) {
+  wkb_writer_t *writer;
+  writer_slot_t *slot = &pool->wkb_slot;
+
+  pool->stats.acquired++;
+  if (slot->state == SLOT_IDLE) {
+    writer = &pool->wkb;
+    wkb_writer_reset(writer);
+    pool->stats.reused++;
+  } else {
+    writer = slot->state == SLOT_EMPTY ? &pool->wkb : fallback;
+    if (wkb_writer_init(writer, WKB_ISO) != SQLITE_OK) {
+      return NULL;
+    }
+    pool->stats.allocated++;
+  }
+
+  if (writer == &pool->wkb) {
+    slot->state = SLOT_BUSY;
+    slot->capacity = wkb_capacity(writer);
+  }
+  return writer;
+}
+
+void writer_pool_wkb_release(writer_pool_t *pool, wkb_writer_t *writer, int transferred) {
+  if (writer == NULL) {
+    return;
+  }
+
+  if (writer == &pool->wkb) {
+    if (transferred) {
+      wkb_writer_destroy(writer, 0);
+    }
+    slot_release(pool, &pool->wkb_slot, wkb_capacity(writer), wkb_writer_length(writer), transferred);
+    writer_pool_trim(pool);
+  } else {
+    if (transferred) {
+      pool->stats.transferred++;
+    }
+    wkb_writer_destroy(writer, !transferred);
+  }
+}
+
+wkt_writer_t *writer_pool_wkt_acquire(writer_pool_t *pool, wkt_writer_t *fallback) {
+  wkt_writer_t *writer;
+  writer_slot_t *slot = &pool->wkt_slot;
+
+  pool->stats.acquired++;
+  if (slot->state == SLOT_IDLE) {
+    writer = &pool->wkt;
+    wkt_writer_reset(writer);
+    pool->stats.reused++;
+  } else {
+    writer = slot->state == SLOT_EMPTY ? &pool->wkt : fallback;
+    if (wkt_writer_init(writer) != SQLITE_OK) {
+      return NULL;
+    }
+    pool->stats.allocated++;
+  }
+
+  if (writer == &pool->wkt) {
+    slot->state = SLOT_BUSY;
+    slot->capacity = wkt_capacity(writer);
+  }
+  return writer;
+}
+
+void writer_pool_wkt_release(writer_pool_t *pool, wkt_writer_t *writer, int transferred) {
+  if (writer == NULL) {
+    return;
+  }
+
+  if (writer == &pool->wkt) {
+    slot_release(pool, &pool->wkt_slot, wkt_capacity(writer), wkt_writer_length(writer), transferred);
+    writer_pool_trim(pool);
+  } else {
+    if (transferred) {
+      pool->stats.transferred++;
+    } else {
+      wkt_writer_destroy(writer);
+    }
+  }
+}
+
+geom_blob_writer_t *writer_pool_blob_acquire(writer_pool_t *pool, geom_blob_writer_t *fallback, int use_srid, int32_t srid) {
+  geom_blob_writer_t *writer;
+  writer_slot_t *slot = &pool->blob_slot;
+  const spatialdb_t *spatialdb = pool->spatialdb;
+
+  pool->stats.acquired++;
+  if (slot->state == SLOT_IDLE) {
+    writer = &pool->blob;
+    geom_blob_writer_reset(writer, &pool->blob_header, use_srid ? srid : pool->blob_header.srid);
+    pool->stats.reused++;
+  } else if (slot->state == SLOT_EMPTY) {
+    writer = &pool->blob;
+    if (spatialdb->writer_init(writer) != SQLITE_OK) {
+      return NULL;
+    }
+    pool->blob_header = writer->header;
+    if (use_srid) {
+      writer->header.srid = srid;
+    }
+    pool->stats.allocated++;
+  } else {
+    writer = fallback;
+    int result = use_srid ? spatialdb->writer_init_srid(writer, srid) : spatialdb->writer_init(writer);
+    if (result != SQLITE_OK) {
+      return NULL;
+    }
+    pool->stats.allocated++;
+  }
+
+  if (writer == &pool->blob) {
+    slot->state = SLOT_BUSY;
+    slot->capacity = wkb_capacity(&writer->wkb_writer);
+  }
+  return writer;
+}
+
+void writer_pool_blob_release(writer_pool_t *pool, geom_blob_writer_t *writer, int transferred) {
+  if (writer == NULL) {
+    return;
+  }
+
+  if (writer == &pool->blob) {
+    if (transferred) {
+      pool->spatialdb->writer_destroy(writer, 0);
+    }
+    slot_release(pool, &pool->blob_slot, wkb_capacity(&writer->wkb_writer), geom_blob_writer_length(writer), transferred);
+    writer_pool_trim(pool);
+  } else {
+    if (transferred) {
+      pool->stats.transferred++;
+    }
+    pool->spatialdb->writer_destroy(writer, !transferred);
+  }
+}
+
+void *writer_pool_block_alloc(writer_pool_t *pool, size_t size) {
+  block_header_t *header;
+
+  for (int i = 0; i < pool->block_count; i++) {
+    header = (block_header_t *) pool->blocks[i];
+    if (header->size >= size) {
+      pool->block_count--;
+      pool->blocks[i] = pool->blocks[pool->block_count];
+      pool->blocks[pool->block_count] = NULL;
+      pool->stats.reused++;
+      return header + 1;
+    }
+  }
+
+  header = (block_header_t *) sqlite3_malloc((int) (sizeof(block_header_t) + size));
+  if (header == NULL) {
+    return NULL;
+  }
+  header->size = size;
+  pool->stats.allocated++;
+  return header + 1;
+}
+
+void writer_pool_block_free(writer_pool_t *pool, void *block) {
+  if (block == NULL) {
+    return;
+  }
+
+  block_header_t *header = ((block_header_t *) block) - 1;
+  if (pool->block_count < WRITER_POOL_BLOCKS && header->size < WRITER_POOL_TRANSFER_SIZE) {
+    pool->blocks[pool->block_count++] = header;
+  } else {
+    sqlite3_free(header);
+  }
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2013 Luciad (http://www.luciad.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GPKG_WRITER_POOL_H
+#define GPKG_WRITER_POOL_H
+
+#include "blobio.h"
+#include "spatialdb.h"
+#include "wkb.h"
+#include "wkt.h"
+
+/**
+ * \addtogroup writer_pool Reusable geometry writers
+ * @{
+ */
+
+/**
+ * Results of at least this many bytes are handed over to SQLite instead of being copied out of a pooled writer.
+ */
+#define WRITER_POOL_TRANSFER_SIZE (64 * 1024)
+
+/**
+ * The number of spare blocks retained by a writer pool.
+ */
+#define WRITER_POOL_BLOCKS 4
+
+/**
+ * Allocation statistics of a writer pool.
+ */
+typedef struct {
+  /**
+   * The number of times a writer was requested.
+   */
+  sqlite3_int64 acquired;
+  /**
+   * The number of times a pooled writer or block was reused without allocating memory.
+   */
+  sqlite3_int64 reused;
+  /**
+   * The number of heap allocations and reallocations performed for writers and blocks.
+   */
+  sqlite3_int64 allocated;
+  /**
+   * The number of writer buffers that were handed over to SQLite.
+   */
+  sqlite3_int64 transferred;
+} writer_pool_stats_t;
+
+/** @private */
+typedef struct {
+  /** @private */
+  int state;
+  /** @private */
+  size_t capacity;
+  /** @private */
+  size_t high_water;
+} writer_slot_t;
+
+/**
+ * A per connection pool of geometry writers. Pooled writers keep their buffers between calls so that, once their
+ * buffers have grown to the size of recently written geometries, SQL functions can produce results without
+ * allocating memory.
+ *
+ * A pool is not thread safe. SQLite never invokes functions of a single connection concurrently, so a pool should
+ * be owned by exactly one connection.
+ */
+typedef struct {
+  /** @private */
+  const spatialdb_t *spatialdb;
+  /** @private */
+  wkb_writer_t wkb;
+  /** @private */
+  writer_slot_t wkb_slot;
+  /** @private */
+  wkt_writer_t wkt;
+  /** @private */
+  writer_slot_t wkt_slot;
+  /** @private */
+  geom_blob_writer_t blob;
+  /** @private */
+  geom_blob_header_t blob_header;
+  /** @private */
+  writer_slot_t blob_slot;
+  /** @private */
+  void *blocks[WRITER_POOL_BLOCKS];
+  /** @private */
+  int block_count;
+  /** @private */
+  unsigned int releases;
+  /** @private */
+  writer_pool_stats_t stats;
+} writer_pool_t;
+
+/**
+ * Initializes a writer pool. No memory is allocated until writers are requested.
+ * @param pool the pool to initialize
+ * @param spatialdb the spatial database schema used to create geometry blob writers
+ */
+void writer_pool_init(writer_pool_t *pool, const spatialdb_t *spatialdb);
+
+/**
+ * Destroys a writer pool, freeing all retained buffers.
+ * @param pool the pool to destroy
+ */
+void writer_pool_destroy(writer_pool_t *pool);
+
+/**
+ * Obtains a Well-Known Binary writer. If the pooled writer is in use, the writer passed in fallback is initialized
+ * and returned instead.
+ * @param pool the pool
+ * @param fallback a writer that may be used if the pooled writer is not available
+ * @return an initialized writer or NULL if no memory could be allocated
+ */
+wkb_writer_t *writer_pool_wkb_acquire(writer_pool_t *pool, wkb_writer_t *fallback);
+
+/**
+ * Returns a Well-Known Binary writer to the pool.
+ * @param pool the pool
+ * @param writer a writer obtained using writer_pool_wkb_acquire()
+ * @param transferred non-zero if ownership of the written data was handed over using sqlite3_free as destructor
+ */
+void writer_pool_wkb_release(writer_pool_t *pool, wkb_writer_t *writer, int transferred);
+
+/**
+ * Obtains a Well-Known Text writer. If the pooled writer is in use, the writer passed in fallback is initialized
+ * and returned instead.
+ * @param pool the pool
+ * @param fallback a writer that may be used if the pooled writer is not available
+ * @return an initialized writer or NULL if no memory could be allocated
+ */
+wkt_writer_t *writer_pool_wkt_acquire(writer_pool_t *pool, wkt_writer_t *fallback);
+
+/**
+ * Returns a Well-Known Text writer to the pool.
+ * @param pool the pool
+ * @param writer a writer obtained using writer_pool_wkt_acquire()
+ * @param transferred non-zero if ownership of the written data was handed over using sqlite3_free as destructor
+ */
+void writer_pool_wkt_release(writer_pool_t *pool, wkt_writer_t *writer, int transferred);
+
+/**
+ * Obtains a geometry blob writer for the spatial database of the pool. If the pooled writer is in use, the writer
+ * passed in fallback is initialized and returned instead.
+ * @param pool the pool
+ * @param fallback a writer that may be used if the pooled writer is not available
+ * @param use_srid if non-zero srid is used as SRID, otherwise the default SRID of the spatial database is used
+ * @param srid the SRID to use
+ * @return an initialized writer or NULL if no memory could be allocated
+ */
+geom_blob_writer_t *writer_pool_blob_acquire(writer_pool_t *pool, geom_blob_writer_t *fallback, int use_srid, int32_t srid);
+
+/**
+ * Returns a geometry blob writer to the pool.
+ * @param pool the pool
+ * @param writer a writer obtained using writer_pool_blob_acquire()
+ * @param transferred non-zero if ownership of the written data was handed over using sqlite3_free as destructor
+ */
+void writer_pool_blob_release(writer_pool_t *pool, geom_blob_writer_t *writer, int transferred);
+
+/**
+ * Allocates a block of memory, reusing a previously freed block when possible.
+ * @param pool the pool
+ * @param size the required size in bytes
+ * @return a block of at least size bytes or NULL if no memory could be allocated
+ */
+void *writer_pool_block_alloc(writer_pool_t *pool, size_t size);
+
+/**
+ * Frees a block obtained using writer_pool_block_alloc().
+ * @param pool the pool
+ * @param block the block to free
+ */
+void writer_pool_block_free(writer_pool_t *pool, void *block);
+
+/** @} */
+
+#endif
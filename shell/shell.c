@@ -10871,6 +10871,8 @@ static char zHelp[] =
   ".headers on|off        Turn display of headers on or off\n"
   ".help                  Show this message\n"
   ".import FILE TABLE     Import data from FILE into TABLE\n"
+  ".importtiles SRC TABLE Import a tile pyramid from a z/x/y directory tree or an\n"
+  "                         MBTiles file SRC into the tiles table TABLE\n"
 #ifndef SQLITE_OMIT_TEST_CONTROL
   ".imposter INDEX TABLE  Create imposter table TABLE on index INDEX\n"
 #endif
@@ -13810,6 +13812,27 @@ static int do_meta_command(char *zLine, ShellState *p){
     if( needCommit ) sqlite3_exec(p->db, "COMMIT", 0, 0, 0);
   }else
 
+  if( c=='i' && strncmp(azArg[0], "importtiles", n)==0 ){
+    char *zErrMsg = 0;
+    sqlite3_int64 nTile = 0;
+
+    if( nArg!=3 ){
+      raw_printf(stderr, "Usage: .importtiles SOURCE TABLE\n");
+      rc = 1;
+      goto meta_command_exit;
+    }
+    open_db(p, 0);
+    rc = gpkg_import_tiles(p->db, "main", azArg[2], azArg[1], &nTile, &zErrMsg);
+    if( rc==SQLITE_OK ){
+      utf8_printf(p->out, "Imported %lld tiles into %s\n", nTile, azArg[2]);
+      rc = 0;
+    }else{
+      utf8_printf(stderr, "Error: %s\n", zErrMsg ? zErrMsg : sqlite3_errstr(rc));
+      rc = 1;
+    }
+    sqlite3_free(zErrMsg);
+  }else
+
 #ifndef SQLITE_UNTESTABLE
   if( c=='i' && strncmp(azArg[0], "imposter", n)==0 ){
     char *zSql;
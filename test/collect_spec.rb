@@ -0,0 +1,61 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+require_relative 'gpkg'
+
+describe 'ST_Collect' do
+  it 'should collect geometries of the same type in a multi geometry' do
+    expect("SELECT ST_AsText(ST_Collect(g)) FROM (SELECT GeomFromText('POINT(1 2)') AS g UNION ALL SELECT NULL UNION ALL SELECT GeomFromText('POINT(3 4)'))").to have_result 'MultiPoint ((1 2), (3 4))'
+    expect("SELECT ST_AsText(ST_Collect(g)) FROM (SELECT GeomFromText('LINESTRING(1 2, 3 4)') AS g UNION ALL SELECT GeomFromText('MULTILINESTRING((5 6, 7 8))'))").to have_result 'MultiLineString ((1 2, 3 4), (5 6, 7 8))'
+    expect("SELECT ST_AsText(ST_Collect(GeomFromText('POINT Z(1 2 3)')))").to have_result 'MultiPoint Z ((1 2 3))'
+  end
+
+  it 'should collect geometries of different types in a geometry collection' do
+    expect("SELECT ST_AsText(ST_Collect(g)) FROM (SELECT GeomFromText('POINT(1 2)') AS g UNION ALL SELECT GeomFromText('GEOMETRYCOLLECTION(POLYGON((0 0, 1 0, 1 1, 0 0)), MULTIPOINT((5 5)))'))").to have_result 'GeometryCollection (Point (1 2), Polygon ((0 0, 1 0, 1 1, 0 0)), Point (5 5))'
+  end
+
+  it 'should compute the envelope and keep the SRID' do
+    expect("SELECT ST_AsText(ST_Envelope(ST_Collect(g))), ST_SRID(ST_Collect(g)) FROM (SELECT GeomFromText('POINT(1 2)', 4326) AS g UNION ALL SELECT GeomFromText('POINT(-3 7)', 4326))").to have_result ['Polygon ((-3 2, 1 2, 1 7, -3 7, -3 2))', 4326]
+  end
+
+  it 'should reject mixed SRIDs and dimensions' do
+    expect("SELECT ST_Collect(g) FROM (SELECT GeomFromText('POINT(1 2)', 4326) AS g UNION ALL SELECT GeomFromText('POINT(1 2)', 3857))").to raise_sql_error
+    expect("SELECT ST_Collect(g) FROM (SELECT GeomFromText('POINT(1 2)') AS g UNION ALL SELECT GeomFromText('POINT Z(1 2 3)'))").to raise_sql_error
+  end
+
+  it 'should return NULL without geometries' do
+    expect('SELECT ST_Collect(NULL)').to have_result nil
+  end
+end
+
+describe 'ST_MakeLine' do
+  it 'should connect the vertices of all geometries' do
+    expect("SELECT ST_AsText(ST_MakeLine(g)) FROM (SELECT GeomFromText('POINT(1 2)') AS g UNION ALL SELECT GeomFromText('POINT EMPTY') UNION ALL SELECT GeomFromText('LINESTRING(3 4, 5 6)') UNION ALL SELECT GeomFromText('MULTIPOINT((7 8))'))").to have_result 'LineString (1 2, 3 4, 5 6, 7 8)'
+    expect("SELECT ST_MaxX(ST_MakeLine(g)) FROM (SELECT GeomFromText('POINT(1 2)') AS g UNION ALL SELECT GeomFromText('POINT(-3 7)'))").to have_result 1.0
+  end
+
+  it 'should order the vertices by the order key' do
+    expect("SELECT ST_AsText(ST_MakeLine(g, t)) FROM (SELECT GeomFromText('POINT(1 1)') AS g, 3 AS t UNION ALL SELECT GeomFromText('POINT(2 2)'), 1 UNION ALL SELECT GeomFromText('POINT(3 3)'), 2.5 UNION ALL SELECT GeomFromText('POINT(4 4)'), 1)").to have_result 'LineString (2 2, 4 4, 3 3, 1 1)'
+    expect("SELECT ST_MakeLine(GeomFromText('POINT(1 1)'), 'a')").to raise_sql_error
+  end
+
+  it 'should reject geometries without a vertex order' do
+    expect("SELECT ST_MakeLine(GeomFromText('POLYGON((0 0, 1 0, 1 1, 0 0))'))").to raise_sql_error
+  end
+
+  it 'should return NULL without geometries' do
+    expect('SELECT ST_MakeLine(NULL)').to have_result nil
+    expect('SELECT ST_MakeLine(NULL, 1)').to have_result nil
+  end
+end
@@ -0,0 +1,95 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+require_relative 'gpkg'
+
+describe 'EnableContentsExtent' do
+  if mode == :gpkg
+    before(:each) do
+      expect('SELECT InitSpatialMetadata()').to have_result nil
+      expect('CREATE TABLE test (id INTEGER PRIMARY KEY)').to have_result nil
+      expect("INSERT INTO gpkg_contents (table_name, data_type, srs_id) VALUES ('test', 'features', 0)").to have_result nil
+      expect("SELECT AddGeometryColumn('test', 'geom', 'point', 0, 0, 0)").to have_result nil
+      expect("INSERT INTO test VALUES (1, GeomFromText('POINT(1 2)', 0))").to have_result nil
+    end
+
+    it 'should compute the extent of existing geometries' do
+      expect("SELECT min_x FROM gpkg_contents WHERE table_name = 'test'").to have_result nil
+      expect('SELECT EnableContentsExtent()').to have_result nil
+      expect("SELECT min_x || ',' || min_y || ',' || max_x || ',' || max_y FROM gpkg_contents WHERE table_name = 'test'").to have_result '1.0,2.0,1.0,2.0'
+      expect("SELECT count(*) FROM gpkg_extensions WHERE extension_name = 'libgpkg_contents_extent'").to have_result 2
+    end
+
+    it 'should extend the extent on insert and update' do
+      expect('SELECT EnableContentsExtent()').to have_result nil
+      expect("INSERT INTO test VALUES (2, GeomFromText('POINT(-5 9)', 0))").to have_result nil
+      expect("INSERT INTO test VALUES (3, GeomFromText('POINT(3 4)', 0))").to have_result nil
+      expect("SELECT min_x || ',' || min_y || ',' || max_x || ',' || max_y FROM gpkg_contents WHERE table_name = 'test'").to have_result '-5.0,2.0,1.0,9.0'
+      expect("UPDATE test SET geom = GeomFromText('POINT(8 0)', 0) WHERE id = 3").to have_result nil
+      expect("SELECT min_x || ',' || min_y || ',' || max_x || ',' || max_y FROM gpkg_contents WHERE table_name = 'test'").to have_result '-5.0,0.0,8.0,9.0'
+    end
+
+    it 'should mark the extent as stale on delete and update of boundary geometries' do
+      expect('SELECT EnableContentsExtent()').to have_result nil
+      expect("INSERT INTO test VALUES (2, GeomFromText('POINT(-5 9)', 0))").to have_result nil
+      expect("INSERT INTO test VALUES (3, GeomFromText('POINT(7 3)', 0))").to have_result nil
+      expect('DELETE FROM test WHERE id = 2').to have_result nil
+      expect("SELECT min_x FROM gpkg_contents WHERE table_name = 'test'").to have_result nil
+      expect("SELECT GPKG_RefreshContentsExtent('test', 'geom')").to have_result nil
+      expect("SELECT min_x || ',' || min_y || ',' || max_x || ',' || max_y FROM gpkg_contents WHERE table_name = 'test'").to have_result '1.0,2.0,7.0,3.0'
+      expect("UPDATE test SET geom = NULL WHERE id = 3").to have_result nil
+      expect("SELECT min_x FROM gpkg_contents WHERE table_name = 'test'").to have_result nil
+      expect('DELETE FROM test').to have_result nil
+      expect("SELECT min_x FROM gpkg_contents WHERE table_name = 'test'").to have_result nil
+    end
+
+    it 'should recompute a stale extent on the next insert' do
+      expect('SELECT EnableContentsExtent()').to have_result nil
+      expect("INSERT INTO test VALUES (2, GeomFromText('POINT(-5 9)', 0))").to have_result nil
+      expect("INSERT INTO test VALUES (3, GeomFromText('POINT(7 3)', 0))").to have_result nil
+      expect('DELETE FROM test WHERE id = 2').to have_result nil
+      expect("INSERT INTO test VALUES (4, GeomFromText('POINT(2 2)', 0))").to have_result nil
+      expect("SELECT min_x || ',' || min_y || ',' || max_x || ',' || max_y FROM gpkg_contents WHERE table_name = 'test'").to have_result '1.0,2.0,7.0,3.0'
+    end
+
+    it 'should recompute the extent from the spatial index on delete and update of boundary geometries' do
+      expect('SELECT EnableContentsExtent()').to have_result nil
+      expect("SELECT CreateSpatialIndex('test', 'geom', 'id')").to have_result nil
+      expect("INSERT INTO test VALUES (2, GeomFromText('POINT(-5 9)', 0))").to have_result nil
+      expect("INSERT INTO test VALUES (3, GeomFromText('POINT(7 3)', 0))").to have_result nil
+      expect('DELETE FROM test WHERE id = 2').to have_result nil
+      expect("SELECT min_x || ',' || min_y || ',' || max_x || ',' || max_y FROM gpkg_contents WHERE table_name = 'test'").to have_result '1.0,2.0,7.0,3.0'
+      expect("INSERT INTO test VALUES (4, GeomFromText('POINT(2 2)', 0))").to have_result nil
+      expect("SELECT min_x || ',' || min_y || ',' || max_x || ',' || max_y FROM gpkg_contents WHERE table_name = 'test'").to have_result '1.0,2.0,7.0,3.0'
+      expect("UPDATE test SET geom = GeomFromText('POINT(2 2)', 0) WHERE id = 3").to have_result nil
+      expect("SELECT min_x || ',' || min_y || ',' || max_x || ',' || max_y FROM gpkg_contents WHERE table_name = 'test'").to have_result '1.0,2.0,2.0,2.0'
+      expect('SELECT count(*) FROM rtree_test_geom').to have_result 3
+      expect('DELETE FROM test').to have_result nil
+      expect("SELECT min_x FROM gpkg_contents WHERE table_name = 'test'").to have_result nil
+    end
+
+    it 'should recompute the extent from a spatial index created before maintenance was enabled' do
+      expect("SELECT CreateSpatialIndex('test', 'geom', 'id')").to have_result nil
+      expect('SELECT EnableContentsExtent()').to have_result nil
+      expect("INSERT INTO test VALUES (2, GeomFromText('POINT(-5 9)', 0))").to have_result nil
+      expect("INSERT INTO test VALUES (3, GeomFromText('POINT(7 3)', 0))").to have_result nil
+      expect('DELETE FROM test WHERE id = 2').to have_result nil
+      expect("SELECT min_x || ',' || min_y || ',' || max_x || ',' || max_y FROM gpkg_contents WHERE table_name = 'test'").to have_result '1.0,2.0,7.0,3.0'
+    end
+  else
+    it 'should not be supported' do
+      expect('SELECT EnableContentsExtent()').to raise_sql_error
+    end
+  end
+end
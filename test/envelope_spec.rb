@@ -0,0 +1,82 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+require_relative 'gpkg'
+
+describe 'ST_Envelope' do
+  it 'should return NULL when either argument is NULL' do
+    expect('SELECT ST_Envelope(NULL)').to have_result nil
+  end
+
+  it 'should raise an error on invalid input' do
+    expect("SELECT ST_Envelope(x'FFFFFFFFFF')").to raise_sql_error
+  end
+
+  it 'should return a valid value' do
+    expect("SELECT AsText(ST_Envelope(GeomFromText('Point (0 100)')))").to have_result 'Point (0 100)'
+    expect("SELECT AsText(ST_Envelope(GeomFromText('LineString (0 100, 0 10, 80 10)')))").to have_result 'Polygon ((0 10, 80 10, 80 100, 0 100, 0 10))'
+    expect("SELECT AsText(ST_Envelope(GeomFromText('Polygon((0 0, 2 0, 2 2, 1 3, 0 2, 0 0))')))").to have_result 'Polygon ((0 0, 2 0, 2 3, 0 3, 0 0))'
+    expect("SELECT AsText(ST_Envelope(GeomFromText('LineString (0 100, 0 10)')))").to have_result 'LineString (0 10, 0 100)'
+  end
+
+  it 'should preserve the SRID' do
+    expect("SELECT ST_SRID(ST_Envelope(GeomFromText('LineString (0 100, 0 10, 80 10)', 4326)))").to have_result 4326
+  end
+
+  it 'should return empty geometries unchanged' do
+    expect("SELECT AsText(ST_Envelope(GeomFromText('Point EMPTY')))").to have_result 'Point EMPTY'
+    expect("SELECT AsText(ST_Envelope(GeomFromText('LineString EMPTY')))").to have_result 'LineString EMPTY'
+    expect("SELECT AsText(ST_Envelope(GeomFromText('Polygon EMPTY')))").to have_result 'Polygon EMPTY'
+    expect("SELECT AsText(ST_Envelope(GeomFromText('GeometryCollection EMPTY')))").to have_result 'GeometryCollection EMPTY'
+  end
+end
+
+describe 'ST_EnvIntersects' do
+  it 'should return NULL when either argument is NULL' do
+    expect("SELECT ST_EnvIntersects(NULL, GeomFromText('Point (0 0)'))").to have_result nil
+    expect("SELECT ST_EnvIntersects(GeomFromText('Point (0 0)'), NULL)").to have_result nil
+  end
+
+  it 'should raise an error on invalid input' do
+    expect("SELECT ST_EnvIntersects(x'FFFFFFFFFF', GeomFromText('Point (0 0)'))").to raise_sql_error
+  end
+
+  it 'should compare envelopes' do
+    expect("SELECT ST_EnvIntersects(GeomFromText('LineString (0 0, 10 10)'), GeomFromText('Point (10 0)'))").to have_result 1
+    expect("SELECT ST_EnvIntersects(GeomFromText('LineString (0 0, 10 10)'), GeomFromText('Point (10 10)'))").to have_result 1
+    expect("SELECT ST_EnvIntersects(GeomFromText('LineString (0 0, 10 10)'), GeomFromText('Point (11 0)'))").to have_result 0
+    expect("SELECT ST_EnvIntersects(GeomFromText('LineString (0 0, 10 10)'), GeomFromText('Point EMPTY'))").to have_result 0
+  end
+end
+
+describe 'ST_EnvContains' do
+  it 'should compare envelopes' do
+    expect("SELECT ST_EnvContains(GeomFromText('LineString (0 0, 10 10)'), GeomFromText('LineString (10 0, 0 10)'))").to have_result 1
+    expect("SELECT ST_EnvContains(GeomFromText('LineString (0 0, 10 10)'), GeomFromText('LineString (5 5, 11 5)'))").to have_result 0
+    expect("SELECT ST_EnvContains(GeomFromText('Point EMPTY'), GeomFromText('Point EMPTY'))").to have_result 0
+  end
+end
+
+describe 'ST_EnvWithin' do
+  it 'should compare envelopes' do
+    expect("SELECT ST_EnvWithin(GeomFromText('Point (5 5)'), GeomFromText('LineString (0 0, 10 10)'))").to have_result 1
+    expect("SELECT ST_EnvWithin(GeomFromText('LineString (0 0, 10 10)'), GeomFromText('Point (5 5)'))").to have_result 0
+  end
+end
+
+describe 'Envelope accessors' do
+  it 'should return the envelope of long geometries' do
+    expect("WITH RECURSIVE c(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM c WHERE i < 100) SELECT ST_MinX(g) || ' ' || ST_MaxX(g) || ' ' || ST_MaxY(g) || ' ' || ST_MinZ(g) FROM (SELECT GeomFromText('LineString Z (' || group_concat(i || ' ' || (i % 13) || ' ' || (-i), ', ') || ')') AS g FROM c)").to have_result '0.0 100.0 12.0 -100.0'
+  end
+end
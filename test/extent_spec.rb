@@ -0,0 +1,57 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+require_relative 'gpkg'
+
+describe 'ST_Extent' do
+  it 'should return the extent of all geometries' do
+    expect("SELECT ST_AsText(ST_Extent(g)) FROM (SELECT GeomFromText('POINT(1 2)') AS g UNION ALL SELECT GeomFromText('LINESTRING(-5 3, 7 9)') UNION ALL SELECT NULL)").to have_result 'Polygon ((-5 2, 7 2, 7 9, -5 9, -5 2))'
+    expect("SELECT ST_AsText(ST_Extent(GeomFromText('POINT(1 2)')))").to have_result 'Point (1 2)'
+  end
+
+  it 'should keep the SRID of the geometries' do
+    expect("SELECT ST_SRID(ST_Extent(GeomFromText('POINT(1 2)', 4326)))").to have_result 4326
+    expect("SELECT ST_Extent(g) FROM (SELECT GeomFromText('POINT(1 2)', 4326) AS g UNION ALL SELECT GeomFromText('POINT(1 2)', 3857))").to raise_sql_error
+  end
+
+  it 'should return NULL without geometries' do
+    expect('SELECT ST_Extent(NULL)').to have_result nil
+    expect("SELECT ST_Extent(GeomFromText('POINT(1 2)')) WHERE 0").to have_result nil
+  end
+end
+
+describe 'gpkg_table_extent' do
+  before(:each) do
+    expect('SELECT InitSpatialMetadata()').to have_result nil
+    expect('CREATE TABLE test (id INTEGER PRIMARY KEY)').to have_result nil
+    expect("SELECT AddGeometryColumn('test', 'geom', 'point', 0, 0, 0)").to have_result nil
+    expect("INSERT INTO test VALUES (1, GeomFromText('POINT(1 2)', 0))").to have_result nil
+    expect("INSERT INTO test VALUES (2, GeomFromText('POINT(-5 9)', 0))").to have_result nil
+    expect("INSERT INTO test VALUES (3, GeomFromText('POINT(7 3)', 0))").to have_result nil
+  end
+
+  it 'should compute the extent of a column without spatial index' do
+    expect("SELECT ST_AsText(gpkg_table_extent('test', 'geom'))").to have_result 'Polygon ((-5 2, 7 2, 7 9, -5 9, -5 2))'
+  end
+
+  it 'should read the extent from the spatial index' do
+    expect("SELECT CreateSpatialIndex('test', 'geom', 'id')").to have_result nil
+    expect("SELECT ST_AsText(gpkg_table_extent('main', 'test', 'geom'))").to have_result 'Polygon ((-5 2, 7 2, 7 9, -5 9, -5 2))'
+    expect("SELECT ST_SRID(gpkg_table_extent('test', 'geom'))").to have_result 0
+    expect('DELETE FROM test WHERE id > 1').to have_result nil
+    expect("SELECT ST_AsText(gpkg_table_extent('test', 'geom'))").to have_result 'Point (1 2)'
+    expect('DELETE FROM test').to have_result nil
+    expect("SELECT gpkg_table_extent('test', 'geom')").to have_result nil
+  end
+end
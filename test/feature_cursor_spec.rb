@@ -0,0 +1,83 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+require_relative 'gpkg'
+
+module FeatureCursor
+  extend FFI::Library
+  ffi_lib ENV['GPKG_EXTENSION'], SQLite3::LIBRARY
+
+  attach_function :gpkg_feature_cursor_open, [:pointer, :string, :string, :string, :pointer, :pointer], :int
+  attach_function :gpkg_feature_cursor_next, [:pointer], :int
+  attach_function :gpkg_feature_cursor_stmt, [:pointer], :pointer
+  attach_function :gpkg_feature_cursor_close, [:pointer], :void
+  attach_function :sqlite3_column_int64, [:pointer, :int], :long_long
+
+  def self.ids(db, bbox)
+    bbox_ptr = nil
+    if bbox
+      bbox_ptr = FFI::MemoryPointer.new(:double, 4)
+      bbox_ptr.write_array_of_double(bbox)
+    end
+
+    cursor_ptr = FFI::MemoryPointer.new :pointer
+    res = gpkg_feature_cursor_open(db.handle, nil, 'test', 'geom', bbox_ptr, cursor_ptr)
+    cursor = cursor_ptr.get_pointer(0)
+    ids = []
+    begin
+      raise SQLite3::SQLite3Error.new("gpkg_feature_cursor_open failed (#{res})") if res != SQLite3::OK
+      while (res = gpkg_feature_cursor_next(cursor)) == SQLite3::ROW
+        ids << sqlite3_column_int64(gpkg_feature_cursor_stmt(cursor), 0)
+      end
+      raise SQLite3::SQLite3Error.new("gpkg_feature_cursor_next failed (#{res})") if res != SQLite3::DONE
+    ensure
+      gpkg_feature_cursor_close(cursor)
+    end
+    ids
+  end
+end
+
+describe 'gpkg_feature_cursor_open' do
+  index = mode == :gpkg ? 'rtree_test_geom' : 'idx_test_geom'
+  index_id = mode == :gpkg ? 'id' : 'pkid'
+
+  before(:each) do
+    expect('SELECT InitSpatialMetadata()').to have_result nil
+    expect('CREATE TABLE test (id INTEGER PRIMARY KEY)').to have_result nil
+    expect("SELECT AddGeometryColumn('test', 'geom', 'point', 0, 0, 0)").to have_result nil
+    expect("INSERT INTO test VALUES (1, GeomFromText('POINT(0 0)'))").to have_result nil
+    expect("INSERT INTO test VALUES (2, GeomFromText('POINT(5 5)'))").to have_result nil
+    expect("INSERT INTO test VALUES (3, GeomFromText('POINT(10 0)'))").to have_result nil
+    expect("INSERT INTO test VALUES (4, GeomFromText('POINT(6 5)'))").to have_result nil
+    expect("INSERT INTO test VALUES (5, NULL)").to have_result nil
+  end
+
+  it 'should return all rows without a bounding box' do
+    expect(FeatureCursor.ids(@db, nil)).to eq [1, 2, 3, 4, 5]
+  end
+
+  it 'should filter on the geometry envelope without a spatial index' do
+    expect(FeatureCursor.ids(@db, [4.0, 4.0, 7.0, 7.0])).to eq [2, 4]
+    expect(FeatureCursor.ids(@db, [20.0, 20.0, 30.0, 30.0])).to eq []
+  end
+
+  it 'should filter using the spatial index' do
+    expect("SELECT CreateSpatialIndex('test', 'geom', 'id')").to have_result nil
+    expect(FeatureCursor.ids(@db, [4.0, 4.0, 7.0, 7.0])).to eq [2, 4]
+    expect(FeatureCursor.ids(@db, [20.0, 20.0, 30.0, 30.0])).to eq []
+
+    # Rows missing from the index are not visited at all
+    expect("DELETE FROM #{index} WHERE #{index_id} = 4").to have_result nil
+    expect(FeatureCursor.ids(@db, [4.0, 4.0, 7.0, 7.0])).to eq [2]
+  end
+end
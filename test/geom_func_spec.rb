@@ -244,6 +244,10 @@ if ENV['GPKG_GEOM_FUNC']
       expect("SELECT ST_Within(GeomFromText('Polygon((1 1, 2 1, 2 2, 1 2, 1 1))'), GeomFromText('Polygon((0 0, 3 0, 3 3, 0 3, 0 0))'))").to have_result 1
       expect("SELECT ST_Within(GeomFromText('Polygon((0 0, 3 0, 3 3, 0 3, 0 0))'), GeomFromText('Polygon((1 1, 2 1, 2 2, 1 2, 1 1))'))").to have_result 0
     end
+
+    it 'should return a valid value for every row when the second argument is constant' do
+      expect("WITH RECURSIVE c(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM c WHERE i < 9) SELECT group_concat(i) FROM c WHERE ST_Within(GeomFromText('Point(' || i || ' ' || i || ')'), GeomFromText('Polygon((-1 -1, 4.5 -1, 4.5 4.5, -1 4.5, -1 -1))'))").to have_result '0,1,2,3,4'
+    end
   end
 
   describe 'ST_Contains' do
@@ -263,6 +267,10 @@ if ENV['GPKG_GEOM_FUNC']
       expect("SELECT ST_Contains(GeomFromText('Polygon((1 1, 2 1, 2 2, 1 2, 1 1))'), GeomFromText('Polygon((0 0, 3 0, 3 3, 0 3, 0 0))'))").to have_result 0
       expect("SELECT ST_Contains(GeomFromText('Polygon((0 0, 3 0, 3 3, 0 3, 0 0))'), GeomFromText('Polygon((1 1, 2 1, 2 2, 1 2, 1 1))'))").to have_result 1
     end
+
+    it 'should return a valid value for every row when the second argument is constant' do
+      expect("WITH RECURSIVE c(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM c WHERE i < 9) SELECT group_concat(i) FROM c WHERE ST_Contains(GeomFromText('Polygon((' || i || ' ' || i || ', ' || (i + 3) || ' ' || i || ', ' || (i + 3) || ' ' || (i + 3) || ', ' || i || ' ' || (i + 3) || ', ' || i || ' ' || i || '))'), GeomFromText('Point(4.5 4.5)'))").to have_result '2,3,4'
+    end
   end
 
   describe 'ST_Overlaps' do
@@ -345,6 +353,111 @@ if ENV['GPKG_GEOM_FUNC']
     end
   end
 
+  describe 'Point in polygon predicates' do
+    polygon = "GeomFromText('Polygon((0 0, 10 0, 10 10, 0 10, 0 0), (4 4, 6 4, 6 6, 4 6, 4 4))')"
+    multipolygon = "GeomFromText('MultiPolygon(((0 0, 1 0, 1 1, 0 1, 0 0)), ((5 5, 6 5, 6 6, 5 5)))')"
+
+    it 'should handle points in the interior, exterior and holes' do
+      expect("SELECT ST_Contains(#{polygon}, GeomFromText('Point(2 2)'))").to have_result 1
+      expect("SELECT ST_Contains(#{polygon}, GeomFromText('Point(5 5)'))").to have_result 0
+      expect("SELECT ST_Contains(#{polygon}, GeomFromText('Point(12 5)'))").to have_result 0
+      expect("SELECT ST_Within(GeomFromText('Point(2 2)'), #{polygon})").to have_result 1
+      expect("SELECT ST_Within(#{polygon}, GeomFromText('Point(2 2)'))").to have_result 0
+      expect("SELECT ST_Intersects(GeomFromText('Point(5 5)'), #{polygon})").to have_result 0
+      expect("SELECT ST_Disjoint(#{polygon}, GeomFromText('Point(5 5)'))").to have_result 1
+      expect("SELECT ST_Intersects(GeomFromText('Point(5.8 5.2)'), #{multipolygon})").to have_result 1
+      expect("SELECT ST_Intersects(GeomFromText('Point(5.2 5.8)'), #{multipolygon})").to have_result 0
+    end
+
+    it 'should handle points on the boundary' do
+      expect("SELECT ST_Contains(#{polygon}, GeomFromText('Point(0 5)'))").to have_result 0
+      expect("SELECT ST_Intersects(#{polygon}, GeomFromText('Point(4 5)'))").to have_result 1
+      expect("SELECT ST_Touches(GeomFromText('Point(10 10)'), #{polygon})").to have_result 1
+      expect("SELECT ST_Touches(GeomFromText('Point(2 2)'), #{polygon})").to have_result 0
+    end
+
+    it 'should return a valid value for every row when the polygon is constant' do
+      expect("WITH RECURSIVE c(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM c WHERE i < 11) SELECT group_concat(i) FROM c WHERE ST_Intersects(#{polygon}, GeomFromText('Point(' || i || ' 4.5)'))").to have_result '0,1,2,3,4,6,7,8,9,10'
+      expect("WITH RECURSIVE c(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM c WHERE i < 11) SELECT group_concat(i) FROM c WHERE ST_Within(GeomFromText('Point(' || i || ' 4.5)'), #{polygon})").to have_result '1,2,3,7,8,9'
+    end
+
+    it 'should raise an error when SRIDs differ' do
+      expect("SELECT ST_Contains(GeomFromText('Polygon((0 0, 10 0, 10 10, 0 0))', 4326), GeomFromText('Point(5 1)'))").to raise_sql_error
+    end
+  end
+
+  describe 'ST_Distance' do
+    it 'should return NULL when either argument is NULL' do
+      expect("SELECT ST_Distance(NULL, GeomFromText('Polygon((0 0, 2 0, 1 2, 0 0))'))").to have_result nil
+      expect("SELECT ST_Distance(GeomFromText('Polygon((0 0, 2 0, 1 2, 0 0))'), NULL)").to have_result nil
+      expect('SELECT ST_Distance(NULL, NULL)').to have_result nil
+    end
+
+    it 'should raise an error on invalid input' do
+      expect("SELECT ST_Distance(x'FFFFFFFFFF', GeomFromText('Polygon((0 0, 2 0, 1 2, 0 0))'))").to raise_sql_error
+      expect("SELECT ST_Distance(GeomFromText('Polygon((0 0, 2 0, 1 2, 0 0))'), x'FFFFFFFFFF')").to raise_sql_error
+      expect("SELECT ST_Distance(x'FFFFFFFFFF', x'FFFFFFFFFF')").to raise_sql_error
+    end
+
+    it 'should return a valid value' do
+      expect("SELECT ST_Distance(GeomFromText('Point(0 0)'), GeomFromText('Point(0 2)'))").to have_result 2.0
+    end
+  end
+
+  describe 'ST_HausdorffDistance' do
+    it 'should return NULL when either argument is NULL' do
+      expect("SELECT ST_HausdorffDistance(NULL, GeomFromText('Polygon((0 0, 2 0, 1 2, 0 0))'))").to have_result nil
+      expect("SELECT ST_HausdorffDistance(GeomFromText('Polygon((0 0, 2 0, 1 2, 0 0))'), NULL)").to have_result nil
+      expect('SELECT ST_HausdorffDistance(NULL, NULL)').to have_result nil
+    end
+
+    it 'should raise an error on invalid input' do
+      expect("SELECT ST_HausdorffDistance(x'FFFFFFFFFF', GeomFromText('Polygon((0 0, 2 0, 1 2, 0 0))'))").to raise_sql_error
+      expect("SELECT ST_HausdorffDistance(GeomFromText('Polygon((0 0, 2 0, 1 2, 0 0))'), x'FFFFFFFFFF')").to raise_sql_error
+      expect("SELECT ST_HausdorffDistance(x'FFFFFFFFFF', x'FFFFFFFFFF')").to raise_sql_error
+    end
+
+    it 'should return a valid value' do
+      expect("SELECT ST_HausdorffDistance(GeomFromText('LineString (0 0, 100 0, 10 100, 10 100)'), GeomFromText('LineString (0 100, 0 10, 80 10)'))").to have_result 22.360679774997898
+    end
+  end
+
+  describe 'ST_Boundary' do
+    it 'should return NULL when either argument is NULL' do
+      expect('SELECT ST_Boundary(NULL)').to have_result nil
+    end
+
+    it 'should raise an error on invalid input' do
+      expect("SELECT ST_Boundary(x'FFFFFFFFFF')").to raise_sql_error
+    end
+
+    it 'should return a valid value' do
+      expect("SELECT AsText(ST_Boundary(GeomFromText('Point (0 100)')))").to have_result 'GeometryCollection EMPTY'
+      expect("SELECT AsText(ST_Boundary(GeomFromText('LineString (0 100, 0 10, 80 10)')))").to have_result 'MultiPoint ((0 100), (80 10))'
+      expect("SELECT AsText(ST_Boundary(GeomFromText('Polygon((0 0, 2 0, 2 2, 1 1, 0 2, 0 0))')))").to have_result 'LineString (0 0, 2 0, 2 2, 1 1, 0 2, 0 0)'
+    end
+
+    it 'should return all coordinates of large geometries' do
+      expect("SELECT AsText(ST_Boundary(GeomFromText('Polygon((0 0, 1 0, 2 0, 3 0, 4 0, 5 0, 6 0, 7 0, 8 0, 9 0, 10 0, 11 0, 12 0, 12 1, 0 1, 0 0))')))").to have_result 'LineString (0 0, 1 0, 2 0, 3 0, 4 0, 5 0, 6 0, 7 0, 8 0, 9 0, 10 0, 11 0, 12 0, 12 1, 0 1, 0 0)'
+    end
+  end
+
+  describe 'ST_ConvexHull' do
+    it 'should return NULL when either argument is NULL' do
+      expect('SELECT ST_ConvexHull(NULL)').to have_result nil
+    end
+
+    it 'should raise an error on invalid input' do
+      expect("SELECT ST_ConvexHull(x'FFFFFFFFFF')").to raise_sql_error
+    end
+
+    it 'should return a valid value' do
+      expect("SELECT AsText(ST_ConvexHull(GeomFromText('Point (0 100)')))").to have_result 'Point (0 100)'
+      expect("SELECT AsText(ST_ConvexHull(GeomFromText('LineString (0 100, 0 10, 80 10)')))").to have_result 'Polygon ((0 10, 0 100, 80 10, 0 10))'
+      expect("SELECT AsText(ST_ConvexHull(GeomFromText('Polygon((0 0, 2 0, 2 2, 1 1, 0 2, 0 0))')))").to have_result 'Polygon ((0 0, 0 2, 2 2, 2 0, 0 0))'
+    end
+  end
+
   describe 'ST_Distance' do
     it 'should return NULL when either argument is NULL' do
       expect("SELECT ST_Distance(NULL, GeomFromText('Polygon((0 0, 2 0, 1 2, 0 0))'))").to have_result nil
@@ -509,4 +622,26 @@ if ENV['GPKG_GEOM_FUNC']
       expect("SELECT AsText(ST_Union(GeomFromText('Polygon((0 0, 2 0, 2 2, 0 2, 0 0))'), GeomFromText('Polygon((1 0, 3 0, 3 2, 1 2, 1 0))')))").to have_result 'Polygon ((1 0, 0 0, 0 2, 1 2, 2 2, 3 2, 3 0, 2 0, 1 0))'
     end
   end
+
+  describe 'ST_Union aggregate' do
+    it 'should return NULL without geometries' do
+      expect('SELECT ST_Union(NULL)').to have_result nil
+      expect("SELECT ST_Union(GeomFromText('Point(0 0)')) WHERE 0").to have_result nil
+    end
+
+    it 'should raise an error on invalid input' do
+      expect("SELECT ST_Union(x'FFFFFFFFFF')").to raise_sql_error
+      expect("SELECT ST_Union(g) FROM (SELECT GeomFromText('Point(0 0)', 4326) AS g UNION ALL SELECT GeomFromText('Point(0 0)', 3857))").to raise_sql_error
+    end
+
+    it 'should dissolve all geometries' do
+      expect("SELECT AsText(ST_Union(g)) FROM (SELECT GeomFromText('Point(0 0)') AS g UNION ALL SELECT GeomFromText('Point(0 0)') UNION ALL SELECT NULL)").to have_result 'Point (0 0)'
+      expect("SELECT ST_Area(ST_Union(g)) FROM (SELECT GeomFromText('Polygon((0 0, 2 0, 2 2, 0 2, 0 0))') AS g UNION ALL SELECT GeomFromText('Polygon((1 0, 3 0, 3 2, 1 2, 1 0))') UNION ALL SELECT GeomFromText('Polygon((2 0, 4 0, 4 2, 2 2, 2 0))'))").to have_result 8.0
+      expect("SELECT ST_SRID(GUnion(GeomFromText('Point(0 0)', 4326)))").to have_result 4326
+    end
+
+    it 'should merge partitions of large inputs' do
+      expect("WITH RECURSIVE c(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM c WHERE i < 2999) SELECT ST_NumGeometries(u) || ' ' || ST_Area(u) FROM (SELECT ST_Union(GeomFromText(printf('Polygon((%d 0, %d 0, %d 1, %d 1, %d 0))', i, i + 2, i + 2, i, i))) AS u FROM c)").to have_result '1 3001.0'
+    end
+  end
 end
\ No newline at end of file
@@ -0,0 +1,39 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+require_relative 'gpkg'
+
+describe 'ST_Point' do
+  it 'should create points from coordinates' do
+    expect('SELECT ST_AsText(ST_Point(1.0, 2.0))').to have_result 'Point (1 2)'
+    expect('SELECT ST_AsText(ST_Point(1.0, 2.0, 3.0))').to have_result 'Point Z (1 2 3)'
+    expect('SELECT ST_AsText(ST_Point(1.0, 2.0, 3.0, 4.0))').to have_result 'Point ZM (1 2 3 4)'
+  end
+
+  it 'should use a trailing integer as SRID' do
+    expect('SELECT ST_SRID(ST_Point(1.0, 2.0, 4326))').to have_result 4326
+    expect('SELECT ST_SRID(ST_Point(1.0, 2.0, 3.0, 4.0, 3857))').to have_result 3857
+  end
+
+  it 'should create the same blob as the geometry writer' do
+    expect("SELECT ST_Point(1.5, -2.0) = GeomFromText('POINT(1.5 -2)')").to have_result 1
+    expect("SELECT ST_Point(1.5, -2.0, 3.0, 4326) = GeomFromText('POINT Z(1.5 -2 3)', 4326)").to have_result 1
+    expect("SELECT ST_Point(1.5, -2.0, 3.0, 4.0) = GeomFromText('POINT ZM(1.5 -2 3 4)')").to have_result 1
+  end
+
+  it 'should reject an invalid number of coordinates' do
+    expect('SELECT ST_Point(1.0)').to raise_sql_error
+    expect('SELECT ST_Point(1.0, 4326)').to raise_sql_error
+  end
+end
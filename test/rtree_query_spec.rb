@@ -0,0 +1,53 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+require_relative 'gpkg'
+
+describe 'R*Tree query functions' do
+  index = mode == :gpkg ? 'rtree_test_geom' : 'idx_test_geom'
+  index_id = mode == :gpkg ? 'id' : 'pkid'
+
+  before(:each) do
+    expect('SELECT InitSpatialMetadata()').to have_result nil
+    expect('CREATE TABLE test (id INTEGER PRIMARY KEY)').to have_result nil
+    expect("SELECT AddGeometryColumn('test', 'geom', 'point', 0, 0, 0)").to have_result nil
+    expect("SELECT CreateSpatialIndex('test', 'geom', 'id')").to have_result nil
+    expect("INSERT INTO test VALUES (1, GeomFromText('POINT(0 0)'))").to have_result nil
+    expect("INSERT INTO test VALUES (2, GeomFromText('POINT(5 5)'))").to have_result nil
+    expect("INSERT INTO test VALUES (3, GeomFromText('POINT(10 0)'))").to have_result nil
+    expect("INSERT INTO test VALUES (4, GeomFromText('POINT(6 5)'))").to have_result nil
+  end
+
+  it 'should test entries against the query geometry rather than its envelope' do
+    expect("SELECT group_concat(#{index_id}) FROM #{index} WHERE #{index_id} MATCH gpkg_rtree_intersects(GeomFromText('LINESTRING(0 0, 10 10)'))").to have_result '1,2'
+    expect("SELECT group_concat(#{index_id}) FROM #{index} WHERE #{index_id} MATCH gpkg_rtree_intersects(GeomFromText('POLYGON((0 0, 10 0, 10 10, 0 0))'))").to have_result '1,2,3,4'
+    expect("SELECT count(*) FROM #{index} WHERE #{index_id} MATCH gpkg_rtree_intersects(NULL)").to have_result 0
+  end
+
+  it 'should only return entries inside a polygon for gpkg_rtree_polygon' do
+    expect("SELECT group_concat(#{index_id}) FROM #{index} WHERE #{index_id} MATCH gpkg_rtree_polygon(GeomFromText('POLYGON((0 0, 10 0, 10 10, 0 0))'))").to have_result '4'
+  end
+
+  it 'should raise an error for invalid query geometries' do
+    expect("SELECT count(*) FROM #{index} WHERE #{index_id} MATCH gpkg_rtree_intersects(x'FFFFFFFFFF')").to raise_sql_error
+    expect("SELECT count(*) FROM #{index} WHERE #{index_id} MATCH gpkg_rtree_polygon(x'FFFFFFFFFF')").to raise_sql_error
+    expect("SELECT count(*) FROM #{index} WHERE #{index_id} MATCH gpkg_rtree_within_distance(GeomFromText('LINESTRING(0 0, 10 10)'), 2)").to raise_sql_error
+  end
+
+  it 'should return entries within distance nearest first' do
+    expect("SELECT group_concat(#{index_id}) FROM #{index} WHERE #{index_id} MATCH gpkg_rtree_within_distance(GeomFromText('POINT(5.8 5)'), 2)").to have_result '4,2'
+    expect("SELECT group_concat(#{index_id}) FROM #{index} WHERE #{index_id} MATCH gpkg_rtree_within_distance(5.2, 5, 2)").to have_result '2,4'
+    expect("SELECT count(*) FROM #{index} WHERE #{index_id} MATCH gpkg_rtree_within_distance(0, 0, 1)").to have_result 1
+  end
+end
@@ -0,0 +1,37 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+require_relative 'gpkg'
+
+describe 'ST_Simplify' do
+  it 'should remove vertices within the tolerance' do
+    expect("SELECT ST_AsText(ST_Simplify(GeomFromText('LINESTRING(0 0, 1 0.1, 2 -0.1, 3 5, 4 6, 5 7.01, 6 8)'), 0.5))").to have_result 'LineString (0 0, 2 -0.1, 3 5, 6 8)'
+    expect("SELECT ST_AsText(ST_Simplify(GeomFromText('LINESTRING Z(0 0 1, 1 0.1 2, 2 0 3)'), 0.5))").to have_result 'LineString Z (0 0 1, 2 0 3)'
+    expect("SELECT ST_AsText(ST_Simplify(GeomFromText('POLYGON((0 0, 10 0, 10.1 5, 10 10, 0 10, 0 0),(2 2, 3 2, 3 3, 2.5 3.01, 2 3, 2 2))'), 0.5))").to have_result 'Polygon ((0 0, 10 0, 10 10, 0 10, 0 0), (2 2, 3 2, 3 3, 2 3, 2 2))'
+  end
+
+  it 'should not collapse rings' do
+    expect("SELECT ST_AsText(ST_Simplify(GeomFromText('POLYGON((0 0, 1 0, 1 1, 0.5 1.01, 0 1, 0 0))'), 100))").to have_result 'Polygon ((0 0, 1 0, 1 1, 0 0))'
+  end
+
+  it 'should keep points and the SRID' do
+    expect("SELECT ST_AsText(ST_Simplify(GeomFromText('GEOMETRYCOLLECTION(POINT(1 1), LINESTRING(0 0, 1 0.1, 2 0))'), 1))").to have_result 'GeometryCollection (Point (1 1), LineString (0 0, 2 0))'
+    expect("SELECT ST_SRID(ST_Simplify(GeomFromText('LINESTRING(0 0, 1 1)', 4326), 1))").to have_result 4326
+  end
+
+  it 'should reject negative tolerances' do
+    expect("SELECT ST_Simplify(GeomFromText('LINESTRING(0 0, 1 1)'), -1)").to raise_sql_error
+    expect("SELECT ST_Simplify(GeomFromText('LINESTRING(0 0, 1 1)'), NULL)").to have_result nil
+  end
+end
@@ -0,0 +1,69 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+require_relative 'gpkg'
+
+describe 'gpkg_spatial' do
+  before(:each) do
+    expect('SELECT InitSpatialMetadata()').to have_result nil
+    expect('CREATE TABLE test (id INTEGER PRIMARY KEY, name TEXT)').to have_result nil
+    expect("SELECT AddGeometryColumn('test', 'geom', 'point', 0, 0, 0)").to have_result nil
+    expect("SELECT CreateSpatialIndex('test', 'geom', 'id')").to have_result nil
+    expect("INSERT INTO test VALUES (1, 'a', GeomFromText('POINT(1 1)'))").to have_result nil
+    expect("INSERT INTO test VALUES (2, 'b', GeomFromText('POINT(5 5)'))").to have_result nil
+    expect("INSERT INTO test VALUES (3, 'c', GeomFromText('POINT(9 9)'))").to have_result nil
+  end
+
+  it 'should expose all rows of the feature table' do
+    expect('CREATE VIRTUAL TABLE temp.test_idx USING gpkg_spatial(test)').to have_result nil
+    expect('SELECT count(*) FROM test_idx').to have_result 3
+    expect('SELECT group_concat(name) FROM test_idx').to have_result 'a,b,c'
+    expect('SELECT ST_MinX(geom) FROM test_idx WHERE id = 2').to have_result 5.0
+  end
+
+  it 'should accept an explicit geometry column' do
+    expect('CREATE VIRTUAL TABLE temp.test_idx USING gpkg_spatial(test, geom)').to have_result nil
+    expect('SELECT count(*) FROM test_idx').to have_result 3
+  end
+
+  it 'should reject unknown tables and columns' do
+    expect('CREATE VIRTUAL TABLE temp.test_idx USING gpkg_spatial(nope)').to raise_sql_error
+    expect('CREATE VIRTUAL TABLE temp.test_idx USING gpkg_spatial(test, nope)').to raise_sql_error
+  end
+
+  it 'should be read only' do
+    expect('CREATE VIRTUAL TABLE temp.test_idx USING gpkg_spatial(test)').to have_result nil
+    expect("INSERT INTO test_idx (name) VALUES ('d')").to raise_sql_error
+  end
+
+  if ENV['GPKG_GEOM_FUNC']
+    it 'should return the same rows as the feature table for spatial predicates' do
+      expect('CREATE VIRTUAL TABLE temp.test_idx USING gpkg_spatial(test)').to have_result nil
+      expect("SELECT group_concat(name) FROM test_idx WHERE ST_Intersects(geom, GeomFromText('POLYGON((0 0, 6 0, 6 6, 0 6, 0 0))'))").to have_result 'a,b'
+      expect("SELECT group_concat(name) FROM test_idx WHERE ST_Within(geom, GeomFromText('POLYGON((4 4, 10 4, 10 10, 4 10, 4 4))'))").to have_result 'b,c'
+      expect("SELECT count(*) FROM test_idx WHERE ST_Contains(geom, GeomFromText('POINT(5 5)'))").to have_result 1
+      expect("SELECT count(*) FROM test_idx WHERE ST_Intersects(geom, NULL)").to have_result 0
+    end
+
+    it 'should answer predicates on the geometry column from the spatial index' do
+      expect('CREATE VIRTUAL TABLE temp.test_idx USING gpkg_spatial(test)').to have_result nil
+      plan = lambda { |where| @db.execute("EXPLAIN QUERY PLAN SELECT name FROM test_idx WHERE #{where}").map { |row| row[3] }.join("\n") }
+      expect(plan.call("ST_Intersects(geom, GeomFromText('POINT(1 1)'))")).to include 'VIRTUAL TABLE INDEX 2:1'
+      expect(plan.call("ST_Contains(geom, GeomFromText('POINT(1 1)'))")).to include 'VIRTUAL TABLE INDEX 2:2'
+      expect(plan.call("ST_Within(geom, GeomFromText('POINT(1 1)'))")).to include 'VIRTUAL TABLE INDEX 2:3'
+      # SQLite only offers a function to the virtual table if the column is its first argument
+      expect(plan.call("ST_Contains(GeomFromText('POINT(1 1)'), geom)")).to include 'VIRTUAL TABLE INDEX 0:'
+    end
+  end
+end
@@ -102,6 +102,12 @@ module SQLite3
       end
     end
 
+    ##
+    # Returns the native sqlite3 connection pointer so that C APIs of the extension can be called on it.
+    def handle
+      @db
+    end
+
     def close
       if @db
         sqlite3_close_v2(@db)
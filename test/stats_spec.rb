@@ -0,0 +1,53 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+require_relative 'gpkg'
+
+if ENV['GPKG_STATS']
+  describe 'gpkg_stats' do
+    it 'should count function calls' do
+      expect('SELECT GPKG_ResetStats()').to have_result nil
+      expect("SELECT ST_MinX(GeomFromText('Point(1 0)'))").to have_result 1.0
+      expect("SELECT ST_MinX(GeomFromText('Point(2 0)'))").to have_result 2.0
+      expect("SELECT calls FROM gpkg_stats WHERE name = 'ST_MinX'").to have_result 2
+    end
+
+    it 'should count geometry constructors under their own names' do
+      expect('SELECT GPKG_ResetStats()').to have_result nil
+      expect("SELECT ST_GeomFromText('Point(1 0)') IS NOT NULL").to have_result 1
+      expect("SELECT ST_Point('Point(1 0)') IS NOT NULL").to have_result 1
+      expect("SELECT calls FROM gpkg_stats WHERE name = 'ST_GeomFromText'").to have_result 1
+      expect("SELECT calls FROM gpkg_stats WHERE name = 'ST_Point'").to have_result 1
+      expect("SELECT count(*) FROM gpkg_stats WHERE name = 'geometry_constructor'").to have_result 0
+    end
+
+    it 'should count errors' do
+      expect('SELECT GPKG_ResetStats()').to have_result nil
+      expect("SELECT ST_MinX(x'FFFFFFFFFF')").to raise_sql_error
+      expect("SELECT errors FROM gpkg_stats WHERE name = 'ST_MinX'").to have_result 1
+    end
+
+    it 'should count decoded bytes' do
+      expect('SELECT GPKG_ResetStats()').to have_result nil
+      expect("SELECT ST_MinX(GeomFromText('Point(1 0)'))").to have_result 1.0
+      expect("SELECT bytes = length(GeomFromText('Point(1 0)')) FROM gpkg_stats WHERE name = 'ST_MinX'").to have_result 1
+    end
+
+    it 'should clear all counters on reset' do
+      expect("SELECT ST_MinX(GeomFromText('Point(1 0)'))").to have_result 1.0
+      expect('SELECT GPKG_ResetStats()').to have_result nil
+      expect('SELECT count(*) FROM gpkg_stats').to have_result 0
+    end
+  end
+end
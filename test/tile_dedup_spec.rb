@@ -0,0 +1,84 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+require 'fileutils'
+require 'tmpdir'
+require_relative 'gpkg'
+
+describe 'GPKG_CreateDedupTilesTable' do
+  if mode == :gpkg
+    it 'should store identical tiles once' do
+      expect("SELECT GPKG_CreateDedupTilesTable('tiles')").to have_result nil
+      expect("INSERT INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (0, 0, 0, x'01'), (1, 0, 0, x'01'), (1, 0, 1, x'02'), (1, 1, 0, x'01')").to have_result nil
+      expect('SELECT count(*) FROM tiles').to have_result 4
+      expect('SELECT count(*) FROM dedup_tiles_blobs').to have_result 2
+      expect('SELECT hex(tile_data) FROM tiles WHERE zoom_level = 1 AND tile_column = 0 AND tile_row = 1').to have_result '02'
+      expect("SELECT extension_name FROM gpkg_extensions WHERE table_name = 'tiles'").to have_result 'libgpkg_tile_dedup'
+    end
+
+    it 'should remove blobs that are no longer used' do
+      expect("SELECT GPKG_CreateDedupTilesTable('tiles')").to have_result nil
+      expect("INSERT INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (0, 0, 0, x'01'), (1, 0, 0, x'01'), (1, 0, 1, x'02')").to have_result nil
+      expect("INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (1, 0, 1, x'01')").to have_result nil
+      expect('SELECT count(*) FROM dedup_tiles_blobs').to have_result 1
+      expect("UPDATE tiles SET tile_data = x'03' WHERE zoom_level = 1").to have_result nil
+      expect('SELECT group_concat(hex(tile_data)) FROM (SELECT tile_data FROM dedup_tiles_blobs ORDER BY tile_data)').to have_result '01,03'
+      expect('DELETE FROM tiles WHERE zoom_level = 0').to have_result nil
+      expect('SELECT group_concat(hex(tile_data)) FROM dedup_tiles_blobs').to have_result '03'
+      expect('SELECT count(*) FROM tiles').to have_result 2
+    end
+
+    it 'should only use built-in SQLite functions in its triggers and indexes' do
+      expect("SELECT GPKG_CreateDedupTilesTable('tiles')").to have_result nil
+      expect("SELECT count(*) FROM sqlite_master WHERE name GLOB 'dedup_*' AND sql GLOB '*GPKG_*'").to have_result 0
+      expect("SELECT count(*) FROM sqlite_master WHERE name GLOB 'dedup_*' AND type = 'trigger'").to have_result 3
+    end
+
+    it 'should keep tiles when an insert conflicts' do
+      expect("SELECT GPKG_CreateDedupTilesTable('tiles')").to have_result nil
+      expect("INSERT INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (0, 0, 0, x'01')").to have_result nil
+      expect("INSERT INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (0, 0, 0, x'02')").to raise_sql_error
+      expect("INSERT OR IGNORE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (0, 0, 0, x'02')").to have_result nil
+      expect('SELECT hex(tile_data) FROM tiles').to have_result '01'
+      expect('SELECT count(*) FROM dedup_tiles_blobs').to have_result 1
+    end
+
+    it 'should move the tiles of an existing tiles table' do
+      expect("SELECT GPKG_CreateTilesTable('tiles')").to have_result nil
+      expect("INSERT INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (0, 0, 0, x'01'), (1, 0, 0, x'01')").to have_result nil
+      expect("SELECT GPKG_CreateDedupTilesTable('tiles')").to have_result nil
+      expect("SELECT type FROM sqlite_master WHERE name = 'tiles'").to have_result 'view'
+      expect('SELECT count(*) FROM tiles').to have_result 2
+      expect('SELECT count(*) FROM dedup_tiles_blobs').to have_result 1
+    end
+
+    it 'should import tiles' do
+      Dir.mktmpdir do |dir|
+        (0..1).each do |x|
+          FileUtils.mkdir_p(File.join(dir, '1', x.to_s))
+          (0..1).each { |y| File.binwrite(File.join(dir, '1', x.to_s, "#{y}.png"), 'empty') }
+        end
+        expect("SELECT GPKG_CreateDedupTilesTable('tiles')").to have_result nil
+        expect(query("SELECT GPKG_ImportTiles('tiles', ?)", dir)).to have_result 4
+        expect(query("SELECT GPKG_ImportTiles('tiles', ?)", dir)).to have_result 4
+      end
+      expect('SELECT count(*) FROM tiles').to have_result 4
+      expect('SELECT count(*) FROM dedup_tiles_blobs').to have_result 1
+    end
+  else
+    it 'should raise an error' do
+      expect("SELECT GPKG_CreateDedupTilesTable('tiles')").to raise_sql_error
+    end
+  end
+end
@@ -0,0 +1,115 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+require 'fileutils'
+require 'tmpdir'
+require_relative 'gpkg'
+
+def png_tile(size, name)
+  "\x89PNG\r\n\x1a\n".b + [13].pack('N') + 'IHDR' + [size, size].pack('NN') + [8, 2, 0, 0, 0, 0].pack('CCCCCN') + name
+end
+
+def write_tile_tree(root, max_zoom, tms = false)
+  (0..max_zoom).each do |z|
+    (0...(1 << z)).each do |x|
+      FileUtils.mkdir_p(File.join(root, z.to_s, x.to_s))
+      (0...(1 << z)).each do |y|
+        File.binwrite(File.join(root, z.to_s, x.to_s, "#{y}.png"), png_tile(z == 1 ? 512 : 256, "#{z}/#{x}/#{y}"))
+      end
+    end
+  end
+  File.write(File.join(root, 'tilemapresource.xml'), '<TileMap/>') if tms
+end
+
+describe 'GPKG_ImportTiles' do
+  around(:each) do |example|
+    Dir.mktmpdir do |dir|
+      @dir = dir
+      example.run
+    end
+  end
+
+  if mode == :gpkg
+    it 'should import a z/x/y directory tree' do
+      write_tile_tree(File.join(@dir, 'xyz'), 2)
+      expect(query("SELECT GPKG_ImportTiles('tiles', ?)", File.join(@dir, 'xyz'))).to have_result 21
+      expect('SELECT count(*) FROM tiles').to have_result 21
+      expect("SELECT CAST(substr(tile_data, 34) AS TEXT) FROM tiles WHERE zoom_level = 2 AND tile_column = 1 AND tile_row = 3").to have_result '2/1/3'
+      expect('SELECT group_concat(zoom_level || \':\' || matrix_width || \':\' || tile_width) FROM gpkg_tile_matrix').to have_result '0:1:256,1:2:512,2:4:256'
+      expect('SELECT srs_id FROM gpkg_tile_matrix_set WHERE table_name = \'tiles\'').to have_result 3857
+      expect('SELECT data_type FROM gpkg_contents WHERE table_name = \'tiles\'').to have_result 'tiles'
+      expect('SELECT CheckSpatialMetaData()').to have_result nil
+    end
+
+    it 'should flip the rows of TMS directory trees' do
+      write_tile_tree(File.join(@dir, 'tms'), 2, true)
+      expect(query("SELECT GPKG_ImportTiles('tiles', ?)", File.join(@dir, 'tms'))).to have_result 21
+      expect("SELECT CAST(substr(tile_data, 34) AS TEXT) FROM tiles WHERE zoom_level = 2 AND tile_column = 1 AND tile_row = 3").to have_result '2/1/0'
+    end
+
+    it 'should import an MBTiles file' do
+      path = File.join(@dir, 'tiles.mbtiles')
+      mbtiles = SQLite3::Database.new(path, SQLite3::OPEN_READWRITE | SQLite3::OPEN_CREATE)
+      mbtiles.execute('CREATE TABLE tiles (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_data BLOB)')
+      mbtiles.execute("INSERT INTO tiles VALUES (1, 0, 0, x'00'), (1, 0, 1, x'01'), (0, 0, 0, x'02')")
+      mbtiles.close
+
+      expect(query("SELECT GPKG_ImportTiles('tiles', ?)", path)).to have_result 3
+      expect('SELECT hex(tile_data) FROM tiles WHERE zoom_level = 1 AND tile_column = 0 AND tile_row = 0').to have_result '01'
+      expect('SELECT hex(tile_data) FROM tiles WHERE zoom_level = 1 AND tile_column = 0 AND tile_row = 1').to have_result '00'
+    end
+
+    it 'should replace existing tiles' do
+      write_tile_tree(File.join(@dir, 'xyz'), 1)
+      expect(query("SELECT GPKG_ImportTiles('tiles', ?)", File.join(@dir, 'xyz'))).to have_result 5
+      expect(query("SELECT GPKG_ImportTiles('tiles', ?)", File.join(@dir, 'xyz'))).to have_result 5
+      expect('SELECT count(*) FROM tiles').to have_result 5
+    end
+
+    it 'should roll back when a tile is outside the tile matrix' do
+      write_tile_tree(File.join(@dir, 'xyz'), 1)
+      FileUtils.mkdir_p(File.join(@dir, 'xyz', '1', '2'))
+      File.binwrite(File.join(@dir, 'xyz', '1', '2', '0.png'), png_tile(256, 'x'))
+      expect(query("SELECT GPKG_ImportTiles('tiles', ?)", File.join(@dir, 'xyz'))).to raise_sql_error
+      expect('SELECT count(*) FROM sqlite_master WHERE name = \'tiles\'').to have_result 0
+    end
+
+    it 'should reject files that map to the same tile' do
+      write_tile_tree(File.join(@dir, 'xyz'), 1)
+      File.binwrite(File.join(@dir, 'xyz', '1', '0', '0.jpg'), png_tile(256, 'x'))
+      expect(query("SELECT GPKG_ImportTiles('tiles', ?)", File.join(@dir, 'xyz'))).to raise_sql_error
+      expect('SELECT count(*) FROM sqlite_master WHERE name = \'tiles\'').to have_result 0
+    end
+
+    it 'should not be callable from triggers or views' do
+      write_tile_tree(File.join(@dir, 'xyz'), 0)
+      source = File.join(@dir, 'xyz').gsub("'", "''")
+      expect('CREATE TABLE test (id int)').to have_result nil
+      expect("CREATE TRIGGER test_import AFTER INSERT ON test BEGIN SELECT GPKG_ImportTiles('tiles', '#{source}'); END").to have_result nil
+      expect("CREATE VIEW test_import_view AS SELECT GPKG_ImportTiles('tiles', '#{source}')").to have_result nil
+      expect('INSERT INTO test VALUES (1)').to raise_sql_error
+      expect('SELECT * FROM test_import_view').to raise_sql_error
+      expect('SELECT count(*) FROM sqlite_master WHERE name = \'tiles\'').to have_result 0
+    end
+
+    it 'should raise an error when the source does not exist' do
+      expect(query("SELECT GPKG_ImportTiles('tiles', ?)", File.join(@dir, 'missing'))).to raise_sql_error
+    end
+  else
+    it 'should raise an error' do
+      write_tile_tree(File.join(@dir, 'xyz'), 0)
+      expect(query("SELECT GPKG_ImportTiles('tiles', ?)", File.join(@dir, 'xyz'))).to raise_sql_error
+    end
+  end
+end
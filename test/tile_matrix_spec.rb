@@ -0,0 +1,76 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+require_relative 'gpkg'
+
+describe 'Tile matrix functions' do
+  if mode == :gpkg
+    before(:each) do
+      expect("SELECT GPKG_CreateTilesTable('tiles')").to have_result nil
+      expect("INSERT INTO gpkg_contents (table_name, data_type, srs_id) VALUES ('tiles', 'tiles', 4326)").to have_result nil
+      expect("INSERT INTO gpkg_tile_matrix_set VALUES ('tiles', 4326, 0, 0, 400, 200)").to have_result nil
+      expect("INSERT INTO gpkg_tile_matrix VALUES ('tiles', 1, 4, 2, 100, 100, 1, 1)").to have_result nil
+      expect("INSERT INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (1, 0, 0, x'00'), (1, 1, 1, x'11'), (1, 3, 0, x'30'), (1, 3, 1, x'31')").to have_result nil
+    end
+
+    it 'should return the bounding box of a tile' do
+      expect("SELECT ST_AsText(gpkg_tile_bbox('tiles', 1, 1, 0))").to have_result 'Polygon ((100 100, 200 100, 200 200, 100 200, 100 100))'
+      expect("SELECT ST_SRID(gpkg_tile_bbox('tiles', 1, 3, 1))").to have_result 4326
+      expect("SELECT gpkg_tile_bbox('tiles', 1, 4, 0)").to have_result nil
+      expect("SELECT gpkg_tile_bbox('tiles', 2, 0, 0)").to raise_sql_error
+    end
+
+    it 'should see tile matrix changes' do
+      expect("SELECT ST_MaxX(gpkg_tile_bbox('tiles', 1, 0, 0))").to have_result 100.0
+      expect("UPDATE gpkg_tile_matrix SET pixel_x_size = 0.5").to have_result nil
+      expect("SELECT ST_MaxX(gpkg_tile_bbox('tiles', 1, 0, 0))").to have_result 50.0
+    end
+
+    it 'should return the existing tiles covering a geometry' do
+      expect("SELECT group_concat(tile_column || '/' || tile_row || '=' || hex(tile_data), ' ') FROM gpkg_tiles_covering('tiles', 1, ST_GeomFromText('POLYGON((50 50, 350 50, 350 150, 50 150, 50 50))'))").to have_result '0/0=00 1/1=11 3/0=30 3/1=31'
+      expect("SELECT group_concat(tile_column || '/' || tile_row, ' ') FROM gpkg_tiles_covering('tiles', 1, ST_GeomFromText('LINESTRING(150 50, 400 50)'))").to have_result '1/1 3/1'
+      expect("SELECT min_x || ',' || min_y || ',' || max_x || ',' || max_y FROM gpkg_tiles_covering('tiles', 1, ST_GeomFromText('POINT(350 150)'))").to have_result '300.0,100.0,400.0,200.0'
+      expect("SELECT count(*) FROM gpkg_tiles_covering('tiles', 1, ST_GeomFromText('POINT(500 500)'))").to have_result 0
+      expect("SELECT count(*) FROM gpkg_tiles_covering('tiles', 1, NULL)").to have_result 0
+    end
+
+    it 'should return the arguments from the hidden columns' do
+      expect("SELECT table_name || ',' || zoom || ',' || ST_AsText(geom) FROM gpkg_tiles_covering('tiles', 1, ST_GeomFromText('POINT(350 150)'))").to have_result 'tiles,1,Point (350 150)'
+    end
+
+    it 'should apply repeated constraints on the arguments' do
+      expect("SELECT count(*) FROM gpkg_tiles_covering WHERE table_name = 'tiles' AND zoom = 1 AND zoom = 1 AND geom = ST_GeomFromText('POINT(350 150)')").to have_result 1
+      expect("SELECT count(*) FROM gpkg_tiles_covering WHERE table_name = 'tiles' AND zoom = 1 AND zoom = 2 AND geom = ST_GeomFromText('POINT(350 150)')").to have_result 0
+      expect("SELECT count(*) FROM gpkg_tiles_covering WHERE table_name = 'tiles' AND table_name = 'other' AND zoom = 1 AND geom = ST_GeomFromText('POINT(350 150)')").to have_result 0
+    end
+
+    it 'should return the edge tiles for geometries on the edge of the matrix' do
+      expect("SELECT group_concat(tile_column || '/' || tile_row, ' ') FROM gpkg_tiles_covering('tiles', 1, ST_GeomFromText('POINT(400 0)'))").to have_result '3/1'
+      expect("SELECT group_concat(tile_column || '/' || tile_row, ' ') FROM gpkg_tiles_covering('tiles', 1, ST_GeomFromText('POINT(0 200)'))").to have_result '0/0'
+      expect("SELECT group_concat(tile_column || '/' || tile_row, ' ') FROM gpkg_tiles_covering('tiles', 1, ST_GeomFromText('LINESTRING(0 0, 400 0)'))").to have_result '1/1 3/1'
+      expect("SELECT group_concat(tile_column || '/' || tile_row, ' ') FROM gpkg_tiles_covering('tiles', 1, ST_GeomFromText('LINESTRING(400 0, 400 200)'))").to have_result '3/0 3/1'
+      expect("SELECT count(*) FROM gpkg_tiles_covering('tiles', 1, ST_GeomFromText('POINT(400.5 0)'))").to have_result 0
+    end
+
+    it 'should accept arguments from other tables in a join' do
+      expect("SELECT group_concat(tile_column || '/' || tile_row, ' ') FROM (SELECT 1 AS z, ST_GeomFromText('POINT(350 150)') AS g) JOIN gpkg_tiles_covering('tiles', z, g)").to have_result '3/0'
+      expect("SELECT group_concat(tile_column || '/' || tile_row, ' ') FROM (SELECT 'tiles' AS t, 1 AS z) q JOIN gpkg_tiles_covering(q.t, q.z, ST_GeomFromText('POLYGON((50 50, 350 50, 350 150, 50 150, 50 50))'))").to have_result '0/0 1/1 3/0 3/1'
+    end
+
+    it 'should raise an error for missing arguments' do
+      expect('SELECT count(*) FROM gpkg_tiles_covering').to raise_sql_error
+      expect("SELECT count(*) FROM gpkg_tiles_covering('tiles', 5, ST_GeomFromText('POINT(0 0)'))").to raise_sql_error
+    end
+  end
+end
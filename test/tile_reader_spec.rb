@@ -0,0 +1,131 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+require 'tmpdir'
+require_relative 'gpkg'
+
+module TileReader
+  extend FFI::Library
+  ffi_lib ENV['GPKG_EXTENSION']
+
+  attach_function :gpkg_tile_reader_open, [:pointer, :string, :string, :size_t, :pointer], :int
+  attach_function :gpkg_tile_reader_read, [:pointer, :int, :int, :int, :pointer, :pointer], :int
+  attach_function :gpkg_tile_reader_release, [:pointer], :void
+  attach_function :gpkg_tile_reader_errmsg, [:pointer], :string
+  attach_function :gpkg_tile_reader_close, [:pointer], :void
+
+  def self.open(db, table_name, cache_size)
+    reader_ptr = FFI::MemoryPointer.new :pointer
+    res = gpkg_tile_reader_open(db.handle, nil, table_name, cache_size, reader_ptr)
+    reader = reader_ptr.get_pointer(0)
+    if res != SQLite3::OK
+      message = gpkg_tile_reader_errmsg(reader)
+      gpkg_tile_reader_close(reader)
+      raise SQLite3::SQLite3Error.new(message.strip)
+    end
+    reader
+  end
+
+  def self.read(reader, zoom_level, tile_column, tile_row)
+    data_ptr = FFI::MemoryPointer.new :pointer
+    length_ptr = FFI::MemoryPointer.new :size_t
+    res = gpkg_tile_reader_read(reader, zoom_level, tile_column, tile_row, data_ptr, length_ptr)
+    case res
+      when SQLite3::ROW
+        length = FFI.type_size(:size_t) == 8 ? length_ptr.read_uint64 : length_ptr.read_uint32
+        data_ptr.get_pointer(0).get_bytes(0, length)
+      when SQLite3::DONE
+        nil
+      else
+        raise SQLite3::SQLite3Error.new(gpkg_tile_reader_errmsg(reader).strip)
+    end
+  end
+end
+
+describe 'gpkg_tile_reader' do
+  def open_db(path)
+    db = SQLite3::Database.new(path, SQLite3::OPEN_READWRITE | SQLite3::OPEN_CREATE)
+    db.load_extension ENV['GPKG_EXTENSION'], "sqlite3_#{ENV['GPKG_ENTRY_POINT']}_init"
+    db
+  end
+
+  def create_tiles(db)
+    db.execute('CREATE TABLE tiles (id INTEGER PRIMARY KEY AUTOINCREMENT, zoom_level INTEGER NOT NULL, tile_column INTEGER NOT NULL, tile_row INTEGER NOT NULL, tile_data BLOB NOT NULL, UNIQUE (zoom_level, tile_column, tile_row))')
+    db.execute("INSERT INTO tiles VALUES (NULL, 0, 0, 0, CAST('a' AS BLOB))")
+    db.execute("INSERT INTO tiles VALUES (NULL, 1, 0, 0, CAST('b' AS BLOB))")
+  end
+
+  it 'should raise an error for unknown tables' do
+    expect { TileReader.open(@db, 'missing', 0) }.to raise_error(SQLite3::SQLite3Error, /no such table/)
+    expect { TileReader.open(@db, 'missing', 1024) }.to raise_error(SQLite3::SQLite3Error, /no such table/)
+    expect { TileReader.open(@db, 'mis"sing', 1024) }.to raise_error(SQLite3::SQLite3Error, /no such table/)
+  end
+
+  [0, 1024].each do |cache_size|
+    context "with cache size #{cache_size}" do
+      before(:each) do
+        create_tiles(@db)
+        @reader = TileReader.open(@db, 'tiles', cache_size)
+      end
+
+      after(:each) do
+        TileReader.gpkg_tile_reader_close(@reader)
+      end
+
+      it 'should read existing tiles' do
+        expect(TileReader.read(@reader, 0, 0, 0)).to eq 'a'
+        expect(TileReader.read(@reader, 1, 0, 0)).to eq 'b'
+        expect(TileReader.read(@reader, 0, 0, 0)).to eq 'a'
+        expect(TileReader.read(@reader, 2, 0, 0)).to be_nil
+      end
+
+      it 'should see changes made through the same connection' do
+        expect(TileReader.read(@reader, 0, 0, 0)).to eq 'a'
+        expect(TileReader.read(@reader, 2, 0, 0)).to be_nil
+        @db.execute("UPDATE tiles SET tile_data = CAST('c' AS BLOB) WHERE zoom_level = 0")
+        @db.execute("INSERT INTO tiles VALUES (NULL, 2, 0, 0, CAST('d' AS BLOB))")
+        expect(TileReader.read(@reader, 0, 0, 0)).to eq 'c'
+        expect(TileReader.read(@reader, 2, 0, 0)).to eq 'd'
+      end
+    end
+  end
+
+  it 'should see changes committed by other connections after release in WAL mode' do
+    Dir.mktmpdir do |dir|
+      path = File.join(dir, 'tiles.gpkg')
+      db = open_db(path)
+      other = nil
+      reader = nil
+      begin
+        expect(db.get_first_value('PRAGMA journal_mode = WAL')).to eq 'wal'
+        create_tiles(db)
+        reader = TileReader.open(db, 'tiles', 1024)
+        expect(TileReader.read(reader, 0, 0, 0)).to eq 'a'
+        expect(TileReader.read(reader, 2, 0, 0)).to be_nil
+        TileReader.gpkg_tile_reader_release(reader)
+
+        other = open_db(path)
+        other.execute("UPDATE tiles SET tile_data = CAST('c' AS BLOB) WHERE zoom_level = 0")
+        other.execute("INSERT INTO tiles VALUES (NULL, 2, 0, 0, CAST('d' AS BLOB))")
+
+        expect(TileReader.read(reader, 0, 0, 0)).to eq 'c'
+        expect(TileReader.read(reader, 2, 0, 0)).to eq 'd'
+        expect(TileReader.read(reader, 1, 0, 0)).to eq 'b'
+      ensure
+        TileReader.gpkg_tile_reader_close(reader) if reader
+        other.close if other
+        db.close
+      end
+    end
+  end
+end
@@ -156,6 +156,10 @@ describe 'AsText' do
   it  'should format XYZM curvepolygon correctly' do
     expect(query(AS_TEXT, 'curvepolygon ZM(CompoundCurve ZM((0 0 1 3, 2 2 2 5, 4 3 2 6), circularstring ZM(1 2 3 5, 3 4 3 8, 5 6 7 9)))')).to have_result 'CurvePolygon ZM (CompoundCurve ZM ((0 0 1 3, 2 2 2 5, 4 3 2 6), CircularString ZM (1 2 3 5, 3 4 3 8, 5 6 7 9)))'
   end
+
+  it 'should format consecutive geometries of different sizes correctly' do
+    expect(query("SELECT group_concat(AsText(GeomFromText(wkt)), ';') FROM (SELECT 'LineString(1 2, 3 4, 5 6)' AS wkt UNION ALL SELECT 'Point(1 2)')")).to have_result 'LineString (1 2, 3 4, 5 6);Point (1 2)'
+  end
 end
 
 describe 'AsBinary' do
@@ -569,4 +573,12 @@ describe 'GeomFromWKB' do
                    '0001ffffffff000000000000f87f000000000000f87f000000000000f87f000000000000f87f7c0600000000000000fe'
            )
   end
+
+  it 'should parse big endian geometries correctly' do
+    expect("SELECT AsText(GeomFromWKB(x'0000000002000000023ff0000000000000400000000000000040080000000000004010000000000000'))").to have_result 'LineString (1 2, 3 4)'
+  end
+
+  it 'should raise an error on truncated coordinates' do
+    expect("SELECT AsText(GeomFromWKB(x'010200000003000000000000000000f03f000000000000004000000000000008400000000000001040'))").to raise_sql_error
+  end
 end
\ No newline at end of file
@@ -0,0 +1,51 @@
+# Copyright 2013 Luciad (http://www.luciad.com)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+require_relative 'gpkg'
+
+describe 'GPKG_WriterPoolStats' do
+  def pool_stats
+    @db.get_first_row("SELECT GPKG_WriterPoolStats('acquired'), GPKG_WriterPoolStats('reused'), GPKG_WriterPoolStats('allocated'), GPKG_WriterPoolStats('transferred')")
+  end
+
+  it 'should return NULL when passed NULL' do
+    expect('SELECT GPKG_WriterPoolStats(NULL)').to have_result nil
+  end
+
+  it 'should raise an error for unknown counters' do
+    expect("SELECT GPKG_WriterPoolStats('foo')").to raise_sql_error
+  end
+
+  it 'should count acquired writers' do
+    acquired, = pool_stats
+    expect("SELECT length(GeomFromText('Point (1 2)')) > 0").to have_result 1
+    expect(pool_stats[0]).to eq(acquired + 1)
+    expect("SELECT length(GeomFromText('Point (1 2)')) > 0").to have_result 1
+    expect(pool_stats[0]).to eq(acquired + 2)
+  end
+
+  it 'should reuse writers without allocating' do
+    expect("SELECT length(GeomFromText('Point (1 2)')) > 0").to have_result 1
+    _, reused, allocated, = pool_stats
+    expect("SELECT length(GeomFromText('Point (3 4)')) > 0").to have_result 1
+    stats = pool_stats
+    expect(stats[1]).to be > reused
+    expect(stats[2]).to eq allocated
+  end
+
+  it 'should transfer large results' do
+    transferred = pool_stats[3]
+    expect("WITH RECURSIVE c(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM c WHERE i < 5000) SELECT length(GeomFromText('LineString (' || group_concat(i || ' ' || i, ', ') || ')')) > 65536 FROM c").to have_result 1
+    expect(pool_stats[3]).to eq(transferred + 1)
+  end
+end